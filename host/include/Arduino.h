@@ -0,0 +1,220 @@
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+// Host (Linux) stand-in for the parts of the Arduino-ESP32 core the firmware
+// uses. Only built for the native environment; see host/README.md.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <math.h>
+#include <time.h>
+#include <algorithm>
+#include <string>
+
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+
+using std::min;
+using std::max;
+
+#define IRAM_ATTR
+#define DRAM_ATTR
+
+#define HIGH    1
+#define LOW     0
+#define INPUT   0x01
+#define OUTPUT  0x03
+
+#define DEC     10
+#define HEX     16
+#define OCT     8
+#define BIN     2
+
+template <typename T, typename L, typename H>
+static inline auto constrain(T x, L low, H high) -> decltype(x + low + high) {
+    return x < low ? low : (x > high ? high : x);
+}
+
+// Timing (monotonic since process start)
+unsigned long millis();
+unsigned long micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+void yield();
+
+long random(long max);
+long random(long min, long max);
+void randomSeed(unsigned long seed);
+
+static inline void pinMode(uint8_t, uint8_t) {}
+static inline void digitalWrite(uint8_t, uint8_t) {}
+static inline int digitalRead(uint8_t) { return LOW; }
+
+// PSRAM allocations come from the normal heap on the host
+static inline void* ps_malloc(size_t size) { return malloc(size); }
+static inline void* ps_calloc(size_t n, size_t size) { return calloc(n, size); }
+static inline void* ps_realloc(void* ptr, size_t size) { return realloc(ptr, size); }
+
+// SNTP is the host's job; only the time zone is applied
+void configTzTime(const char* tz, const char* server1, const char* server2 = nullptr,
+                  const char* server3 = nullptr);
+
+class String {
+public:
+    String(const char* s = "") : _s(s ? s : "") {}
+    String(const std::string& s) : _s(s) {}
+    String(char c) : _s(1, c) {}
+    String(int value, unsigned char base = DEC) { _s = format((long long)value, base); }
+    String(unsigned int value, unsigned char base = DEC) { _s = format((unsigned long long)value, base); }
+    String(long value, unsigned char base = DEC) { _s = format((long long)value, base); }
+    String(unsigned long value, unsigned char base = DEC) { _s = format((unsigned long long)value, base); }
+    String(float value, unsigned char decimals = 2) { _s = formatFloat(value, decimals); }
+    String(double value, unsigned char decimals = 2) { _s = formatFloat(value, decimals); }
+
+    unsigned int length() const { return (unsigned int)_s.size(); }
+    bool isEmpty() const { return _s.empty(); }
+    const char* c_str() const { return _s.c_str(); }
+    char charAt(unsigned int i) const { return i < _s.size() ? _s[i] : 0; }
+    char operator[](unsigned int i) const { return charAt(i); }
+
+    String substring(unsigned int from) const { return from < _s.size() ? String(_s.substr(from)) : String(); }
+    String substring(unsigned int from, unsigned int to) const {
+        if (from > to) std::swap(from, to);
+        if (from >= _s.size()) return String();
+        return String(_s.substr(from, to - from));
+    }
+    int indexOf(char c, unsigned int from = 0) const { return found(_s.find(c, from)); }
+    int indexOf(const String& s, unsigned int from = 0) const { return found(_s.find(s._s, from)); }
+    int lastIndexOf(char c) const { return found(_s.rfind(c)); }
+    bool startsWith(const String& prefix) const { return _s.compare(0, prefix._s.size(), prefix._s) == 0; }
+    bool endsWith(const String& suffix) const {
+        return _s.size() >= suffix._s.size() &&
+               _s.compare(_s.size() - suffix._s.size(), suffix._s.size(), suffix._s) == 0;
+    }
+    bool equals(const String& other) const { return _s == other._s; }
+    long toInt() const { return atol(_s.c_str()); }
+    float toFloat() const { return (float)atof(_s.c_str()); }
+
+    void trim();
+    void toLowerCase();
+    void toUpperCase();
+    void reserve(unsigned int size) { _s.reserve(size); }
+
+    String& operator+=(const String& other) { _s += other._s; return *this; }
+    String& operator+=(const char* other) { _s += other; return *this; }
+    String& operator+=(char c) { _s += c; return *this; }
+    bool concat(const String& other) { _s += other._s; return true; }
+
+    friend String operator+(const String& a, const String& b) { return String(a._s + b._s); }
+    friend String operator+(const String& a, const char* b) { return String(a._s + b); }
+    friend String operator+(const char* a, const String& b) { return String(a + b._s); }
+    bool operator==(const String& other) const { return _s == other._s; }
+    bool operator==(const char* other) const { return _s == other; }
+    bool operator!=(const String& other) const { return _s != other._s; }
+    bool operator!=(const char* other) const { return _s != other; }
+    bool operator<(const String& other) const { return _s < other._s; }
+
+private:
+    std::string _s;
+
+    static int found(size_t pos) { return pos == std::string::npos ? -1 : (int)pos; }
+    static std::string format(long long value, unsigned char base);
+    static std::string format(unsigned long long value, unsigned char base);
+    static std::string formatFloat(double value, unsigned char decimals);
+};
+
+class Print {
+public:
+    virtual ~Print() {}
+
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t* buffer, size_t size);
+    size_t write(const char* s) { return s ? write((const uint8_t*)s, strlen(s)) : 0; }
+    size_t write(const char* buffer, size_t size) { return write((const uint8_t*)buffer, size); }
+    virtual void flush() {}
+
+    size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+    size_t print(const char* s) { return write(s); }
+    size_t print(const String& s) { return write(s.c_str()); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(int n, int base = DEC) { return print((long)n, base); }
+    size_t print(unsigned int n, int base = DEC) { return print((unsigned long)n, base); }
+    size_t print(long n, int base = DEC);
+    size_t print(unsigned long n, int base = DEC);
+    size_t print(long long n, int base = DEC);
+    size_t print(unsigned long long n, int base = DEC);
+    size_t print(double n, int digits = 2);
+
+    size_t println() { return write("\r\n"); }
+    template <typename T> size_t println(const T& value) { size_t n = print(value); return n + println(); }
+    template <typename T> size_t println(const T& value, int format) {
+        size_t n = print(value, format);
+        return n + println();
+    }
+};
+
+class Stream : public Print {
+public:
+    Stream() : _timeout(1000) {}
+
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() { return -1; }
+
+    void setTimeout(unsigned long timeout) { _timeout = timeout; }
+    size_t readBytes(uint8_t* buffer, size_t length);
+    size_t readBytes(char* buffer, size_t length) { return readBytes((uint8_t*)buffer, length); }
+
+protected:
+    unsigned long _timeout;
+};
+
+// Console: writes to stdout, reads stdin without blocking
+class HardwareSerial : public Stream {
+public:
+    void begin(unsigned long baud) { (void)baud; }
+    void end() {}
+    operator bool() const { return true; }
+
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t* buffer, size_t size) override;
+    using Print::write;
+    void flush() override;
+
+    int available() override;
+    int read() override;
+};
+
+extern HardwareSerial Serial;
+
+class EspClass {
+public:
+    uint32_t getCpuFreqMHz() { return 240; }
+    uint32_t getCycleCount();           // Derived from the monotonic clock at 240 MHz
+
+    uint32_t getHeapSize();
+    uint32_t getFreeHeap();
+    uint32_t getMinFreeHeap();
+    uint32_t getMaxAllocHeap() { return getFreeHeap(); }
+    uint32_t getPsramSize();
+    uint32_t getFreePsram();
+    uint32_t getMinFreePsram() { return getFreePsram(); }
+
+    uint32_t getFlashChipSize() { return 8 * 1024 * 1024; }
+    uint64_t getEfuseMac();
+    const char* getSdkVersion() { return "host"; }
+
+    void restart();
+};
+
+extern EspClass ESP;
+
+#endif // HOST_ARDUINO_H
@@ -0,0 +1,145 @@
+#ifndef HOST_NIMBLE_DEVICE_H
+#define HOST_NIMBLE_DEVICE_H
+
+// NimBLE-Arduino surface used by BLEProvisioning. There is no radio on the
+// host: the GATT objects exist so the code runs, but nothing ever connects.
+// Provision through the NVS_* environment variables instead (Preferences.h).
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace NIMBLE_PROPERTY {
+    enum : uint16_t {
+        BROADCAST = 0x0001,
+        READ = 0x0002,
+        WRITE_NR = 0x0004,
+        WRITE = 0x0008,
+        NOTIFY = 0x0010,
+        INDICATE = 0x0020,
+    };
+}
+
+class NimBLEServer;
+class NimBLECharacteristic;
+
+class NimBLEUUID {
+public:
+    NimBLEUUID(const char* uuid = "") : _uuid(uuid) {}
+    std::string toString() const { return _uuid; }
+
+private:
+    std::string _uuid;
+};
+
+class NimBLEServerCallbacks {
+public:
+    virtual ~NimBLEServerCallbacks() {}
+    virtual void onConnect(NimBLEServer* pServer) { (void)pServer; }
+    virtual void onDisconnect(NimBLEServer* pServer) { (void)pServer; }
+};
+
+class NimBLECharacteristicCallbacks {
+public:
+    virtual ~NimBLECharacteristicCallbacks() {}
+    virtual void onWrite(NimBLECharacteristic* pCharacteristic) { (void)pCharacteristic; }
+    virtual void onRead(NimBLECharacteristic* pCharacteristic) { (void)pCharacteristic; }
+};
+
+class NimBLECharacteristic {
+public:
+    NimBLECharacteristic(const char* uuid, uint32_t properties)
+        : _uuid(uuid), _properties(properties), _callbacks(nullptr) {}
+    ~NimBLECharacteristic() { delete _callbacks; }
+
+    NimBLEUUID getUUID() const { return _uuid; }
+    std::string getValue() const { return _value; }
+    void setValue(const char* value) { _value = value ? value : ""; }
+    void setValue(const std::string& value) { _value = value; }
+    void setCallbacks(NimBLECharacteristicCallbacks* callbacks) { delete _callbacks; _callbacks = callbacks; }
+    void notify() {}
+
+private:
+    NimBLEUUID _uuid;
+    uint32_t _properties;
+    std::string _value;
+    NimBLECharacteristicCallbacks* _callbacks;
+};
+
+class NimBLEService {
+public:
+    ~NimBLEService() {
+        for (NimBLECharacteristic* characteristic : _characteristics) {
+            delete characteristic;
+        }
+    }
+
+    NimBLECharacteristic* createCharacteristic(const char* uuid, uint32_t properties) {
+        _characteristics.push_back(new NimBLECharacteristic(uuid, properties));
+        return _characteristics.back();
+    }
+    bool start() { return true; }
+
+private:
+    std::vector<NimBLECharacteristic*> _characteristics;
+};
+
+class NimBLEServer {
+public:
+    NimBLEServer() : _callbacks(nullptr) {}
+    ~NimBLEServer() {
+        delete _callbacks;
+        for (NimBLEService* service : _services) {
+            delete service;
+        }
+    }
+
+    void setCallbacks(NimBLEServerCallbacks* callbacks) { delete _callbacks; _callbacks = callbacks; }
+    NimBLEService* createService(const char* uuid) {
+        (void)uuid;
+        _services.push_back(new NimBLEService());
+        return _services.back();
+    }
+    bool startAdvertising() { return true; }
+
+private:
+    NimBLEServerCallbacks* _callbacks;
+    std::vector<NimBLEService*> _services;
+};
+
+class NimBLEAdvertising {
+public:
+    void addServiceUUID(const char* uuid) { (void)uuid; }
+    void setScanResponse(bool enable) { (void)enable; }
+    void setMinPreferred(uint16_t interval) { (void)interval; }
+    void setMaxPreferred(uint16_t interval) { (void)interval; }
+    bool start() { return true; }
+    bool stop() { return true; }
+};
+
+class NimBLEDevice {
+public:
+    static void init(const std::string& deviceName) { (void)deviceName; }
+    static void deinit(bool clearAll = false) {
+        if (clearAll) {
+            delete _server;
+            _server = nullptr;
+        }
+    }
+
+    static NimBLEServer* createServer() {
+        if (!_server) {
+            _server = new NimBLEServer();
+        }
+        return _server;
+    }
+    static NimBLEAdvertising* getAdvertising() { return &_advertising; }
+    static bool startAdvertising() { return true; }
+    static bool stopAdvertising() { return true; }
+
+private:
+    static inline NimBLEServer* _server = nullptr;
+    static inline NimBLEAdvertising _advertising;
+};
+
+#endif // HOST_NIMBLE_DEVICE_H
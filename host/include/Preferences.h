@@ -0,0 +1,34 @@
+#ifndef HOST_PREFERENCES_H
+#define HOST_PREFERENCES_H
+
+// In-memory NVS. A namespace is seeded on first use from environment
+// variables named NVS_<NAMESPACE>_<KEY> (upper-cased), e.g. NVS_WIFI_SSID or
+// NVS_RTMP_URL, so provisioning can be scripted without BLE.
+
+#include <Arduino.h>
+
+class Preferences {
+public:
+    Preferences() : _readOnly(true), _open(false) {}
+
+    bool begin(const char* name, bool readOnly = false, const char* partition = nullptr);
+    void end() { _open = false; }
+
+    bool isKey(const char* key);
+    bool remove(const char* key);
+    bool clear();
+
+    String getString(const char* key, const String& defaultValue = String());
+    size_t putString(const char* key, const String& value);
+    size_t putString(const char* key, const char* value) { return putString(key, String(value)); }
+
+    uint32_t getUInt(const char* key, uint32_t defaultValue = 0);
+    size_t putUInt(const char* key, uint32_t value);
+
+private:
+    std::string _namespace;
+    bool _readOnly;
+    bool _open;
+};
+
+#endif // HOST_PREFERENCES_H
@@ -0,0 +1,83 @@
+#ifndef HOST_WIFI_H
+#define HOST_WIFI_H
+
+// The host is always "associated": begin() succeeds at once and raises the
+// same station events the ESP32 core does. RSSI is fixed (HOST_WIFI_RSSI,
+// default -55 dBm) so the metrics and health output have something to show.
+
+#include <Arduino.h>
+#include <functional>
+#include "WiFiClient.h"
+#include "WiFiServer.h"
+
+typedef enum {
+    WL_NO_SHIELD = 255,
+    WL_IDLE_STATUS = 0,
+    WL_NO_SSID_AVAIL,
+    WL_SCAN_COMPLETED,
+    WL_CONNECTED,
+    WL_CONNECT_FAILED,
+    WL_CONNECTION_LOST,
+    WL_DISCONNECTED
+} wl_status_t;
+
+typedef enum {
+    WIFI_OFF = 0,
+    WIFI_STA,
+    WIFI_AP,
+    WIFI_AP_STA
+} wifi_mode_t;
+
+typedef enum {
+    ARDUINO_EVENT_WIFI_READY = 0,
+    ARDUINO_EVENT_WIFI_STA_START,
+    ARDUINO_EVENT_WIFI_STA_STOP,
+    ARDUINO_EVENT_WIFI_STA_CONNECTED,
+    ARDUINO_EVENT_WIFI_STA_DISCONNECTED,
+    ARDUINO_EVENT_WIFI_STA_GOT_IP,
+    ARDUINO_EVENT_WIFI_STA_LOST_IP,
+} arduino_event_id_t;
+
+typedef arduino_event_id_t WiFiEvent_t;
+typedef void (*WiFiEventCb)(WiFiEvent_t event);
+
+class IPAddress {
+public:
+    IPAddress() : _address(0) {}
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d)
+        : _address((uint32_t)a | ((uint32_t)b << 8) | ((uint32_t)c << 16) | ((uint32_t)d << 24)) {}
+
+    uint8_t operator[](int index) const { return (uint8_t)(_address >> (index * 8)); }
+    String toString() const;
+
+private:
+    uint32_t _address;          // Network order, as lwIP stores it
+};
+
+class WiFiClass {
+public:
+    WiFiClass();
+
+    int onEvent(WiFiEventCb callback);
+    bool mode(wifi_mode_t mode) { _mode = mode; return true; }
+    wl_status_t begin(const char* ssid, const char* password = nullptr);
+    bool disconnect(bool wifiOff = false);
+    wl_status_t status() { return _status; }
+
+    IPAddress localIP();
+    int8_t RSSI();
+    String SSID() { return _ssid; }
+
+private:
+    wifi_mode_t _mode;
+    wl_status_t _status;
+    String _ssid;
+    WiFiEventCb _callbacks[4];
+    uint8_t _callbackCount;
+
+    void raise(WiFiEvent_t event);
+};
+
+extern WiFiClass WiFi;
+
+#endif // HOST_WIFI_H
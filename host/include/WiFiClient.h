@@ -0,0 +1,41 @@
+#ifndef HOST_WIFI_CLIENT_H
+#define HOST_WIFI_CLIENT_H
+
+// Arduino WiFiClient over a POSIX TCP socket. Copies share the socket (as the
+// ESP32 core does) and it is closed with the last copy or stop().
+
+#include <Arduino.h>
+#include <memory>
+
+class WiFiClient : public Stream {
+public:
+    WiFiClient();
+    explicit WiFiClient(int fd);
+    ~WiFiClient();
+
+    int connect(const char* host, uint16_t port);
+    int connect(const char* host, uint16_t port, int32_t timeoutMs);
+    void stop();
+
+    uint8_t connected();
+    operator bool() { return connected(); }
+
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t* buffer, size_t size) override;
+    using Print::write;
+    void flush() override {}
+
+    int available() override;
+    int read() override;
+    int read(uint8_t* buffer, size_t size);
+    int peek() override;
+
+    int setNoDelay(bool noDelay);
+    int fd() const;
+
+private:
+    struct Socket;
+    std::shared_ptr<Socket> _socket;
+};
+
+#endif // HOST_WIFI_CLIENT_H
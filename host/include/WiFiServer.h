@@ -0,0 +1,31 @@
+#ifndef HOST_WIFI_SERVER_H
+#define HOST_WIFI_SERVER_H
+
+#include <Arduino.h>
+#include "WiFiClient.h"
+
+// Listening TCP socket; available() accepts without blocking and returns an
+// unconnected client when nobody is waiting.
+
+class WiFiServer {
+public:
+    explicit WiFiServer(uint16_t port = 80, uint8_t maxClients = 4);
+    ~WiFiServer();
+
+    void begin(uint16_t port = 0);
+    void end();
+    void setNoDelay(bool noDelay) { _noDelay = noDelay; }
+
+    WiFiClient available();
+    WiFiClient accept() { return available(); }
+
+    operator bool() const { return _fd >= 0; }
+
+private:
+    int _fd;
+    uint16_t _port;
+    uint8_t _maxClients;
+    bool _noDelay;
+};
+
+#endif // HOST_WIFI_SERVER_H
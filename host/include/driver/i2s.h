@@ -0,0 +1,78 @@
+#ifndef HOST_DRIVER_I2S_H
+#define HOST_DRIVER_I2S_H
+
+// Legacy I2S driver API on the host. Reads are paced at the configured sample
+// rate and filled from HOST_AUDIO_FILE (raw s16le, looped) or a synthetic
+// tone over noise; see host/src/HostI2S.cpp.
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+
+typedef enum { I2S_NUM_0 = 0, I2S_NUM_1 = 1, I2S_NUM_MAX } i2s_port_t;
+
+typedef enum {
+    I2S_MODE_MASTER = (0x1 << 0),
+    I2S_MODE_SLAVE = (0x1 << 1),
+    I2S_MODE_TX = (0x1 << 2),
+    I2S_MODE_RX = (0x1 << 3),
+    I2S_MODE_DAC_BUILT_IN = (0x1 << 4),
+    I2S_MODE_ADC_BUILT_IN = (0x1 << 5),
+    I2S_MODE_PDM = (0x1 << 6),
+} i2s_mode_t;
+
+typedef enum {
+    I2S_BITS_PER_SAMPLE_8BIT = 8,
+    I2S_BITS_PER_SAMPLE_16BIT = 16,
+    I2S_BITS_PER_SAMPLE_24BIT = 24,
+    I2S_BITS_PER_SAMPLE_32BIT = 32,
+} i2s_bits_per_sample_t;
+
+typedef enum {
+    I2S_CHANNEL_FMT_RIGHT_LEFT,
+    I2S_CHANNEL_FMT_ALL_RIGHT,
+    I2S_CHANNEL_FMT_ALL_LEFT,
+    I2S_CHANNEL_FMT_ONLY_RIGHT,
+    I2S_CHANNEL_FMT_ONLY_LEFT,
+} i2s_channel_fmt_t;
+
+typedef enum {
+    I2S_COMM_FORMAT_STAND_I2S = 0x01,
+    I2S_COMM_FORMAT_STAND_MSB = 0x03,
+    I2S_COMM_FORMAT_STAND_PCM_SHORT = 0x04,
+    I2S_COMM_FORMAT_STAND_PCM_LONG = 0x0C,
+} i2s_comm_format_t;
+
+typedef struct {
+    i2s_mode_t mode;
+    uint32_t sample_rate;
+    i2s_bits_per_sample_t bits_per_sample;
+    i2s_channel_fmt_t channel_format;
+    i2s_comm_format_t communication_format;
+    int intr_alloc_flags;
+    int dma_buf_count;
+    int dma_buf_len;
+    bool use_apll;
+    bool tx_desc_auto_clear;
+    int fixed_mclk;
+} i2s_config_t;
+
+typedef struct {
+    int mck_io_num;
+    int bck_io_num;
+    int ws_io_num;
+    int data_out_num;
+    int data_in_num;
+} i2s_pin_config_t;
+
+#define I2S_PIN_NO_CHANGE       (-1)
+#define ESP_INTR_FLAG_LEVEL1    (1 << 1)
+
+esp_err_t i2s_driver_install(i2s_port_t port, const i2s_config_t* config, int queueSize, void* queue);
+esp_err_t i2s_driver_uninstall(i2s_port_t port);
+esp_err_t i2s_set_pin(i2s_port_t port, const i2s_pin_config_t* pins);
+esp_err_t i2s_zero_dma_buffer(i2s_port_t port);
+esp_err_t i2s_read(i2s_port_t port, void* dest, size_t size, size_t* bytesRead, TickType_t ticksToWait);
+
+#endif // HOST_DRIVER_I2S_H
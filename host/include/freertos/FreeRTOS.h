@@ -0,0 +1,42 @@
+#ifndef HOST_FREERTOS_H
+#define HOST_FREERTOS_H
+
+// FreeRTOS API subset on top of std::thread / std::condition_variable.
+//
+// One tick is one millisecond. Tasks are plain threads: priorities and stack
+// sizes are recorded but not enforced, and the core a task is pinned to is
+// only reported back through xPortGetCoreID() (per-core data such as the
+// Counter shards and trace rings still splits the way it does on the chip).
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+
+typedef void (*TaskFunction_t)(void*);
+
+typedef struct HostTask* TaskHandle_t;
+typedef struct HostQueue* QueueHandle_t;
+typedef struct HostQueue* SemaphoreHandle_t;
+
+#define pdFALSE                 ((BaseType_t)0)
+#define pdTRUE                  ((BaseType_t)1)
+#define pdFAIL                  pdFALSE
+#define pdPASS                  pdTRUE
+#define errQUEUE_FULL           ((BaseType_t)0)
+#define errQUEUE_EMPTY          ((BaseType_t)0)
+
+#define configTICK_RATE_HZ      1000
+#define portTICK_PERIOD_MS      ((TickType_t)1000 / configTICK_RATE_HZ)
+#define portMAX_DELAY           ((TickType_t)0xFFFFFFFFUL)
+#define pdMS_TO_TICKS(ms)       ((TickType_t)(((TickType_t)(ms) * configTICK_RATE_HZ) / 1000))
+
+#define tskNO_AFFINITY          ((BaseType_t)0x7FFFFFFF)
+#define portNUM_PROCESSORS      2
+
+// Core the calling task was pinned to (0 for unpinned and foreign threads)
+BaseType_t xPortGetCoreID();
+
+#endif // HOST_FREERTOS_H
@@ -0,0 +1,314 @@
+#include <Arduino.h>
+#include <esp_timer.h>
+#include <ctype.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <malloc.h>
+#include <chrono>
+#include <thread>
+
+HardwareSerial Serial;
+EspClass ESP;
+
+// ============================================================================
+// Timing
+// ============================================================================
+
+static const std::chrono::steady_clock::time_point bootTime = std::chrono::steady_clock::now();
+
+int64_t esp_timer_get_time() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now() - bootTime).count();
+}
+
+unsigned long millis() {
+    return (unsigned long)(uint32_t)(esp_timer_get_time() / 1000);
+}
+
+unsigned long micros() {
+    return (unsigned long)(uint32_t)esp_timer_get_time();
+}
+
+void delay(uint32_t ms) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void delayMicroseconds(uint32_t us) {
+    std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+void yield() {
+    std::this_thread::yield();
+}
+
+static uint32_t randomState = 0x12345678;
+
+void randomSeed(unsigned long seed) {
+    if (seed != 0) {
+        randomState = (uint32_t)seed;
+    }
+}
+
+long random(long max) {
+    if (max <= 0) {
+        return 0;
+    }
+    randomState = randomState * 1664525u + 1013904223u;
+    return (long)((randomState >> 1) % (uint32_t)max);
+}
+
+long random(long min, long max) {
+    return min >= max ? min : min + random(max - min);
+}
+
+void configTzTime(const char* tz, const char* server1, const char* server2, const char* server3) {
+    (void)server1;
+    (void)server2;
+    (void)server3;
+    setenv("TZ", tz, 1);
+    tzset();
+}
+
+// ============================================================================
+// String
+// ============================================================================
+
+std::string String::format(long long value, unsigned char base) {
+    if (base == DEC) {
+        return std::to_string(value);
+    }
+    // Arduino prints negative numbers in other bases as their two's complement
+    return format((unsigned long long)(unsigned long)value, base);
+}
+
+std::string String::format(unsigned long long value, unsigned char base) {
+    if (base < 2 || base > 36) {
+        base = DEC;
+    }
+    char buffer[65];
+    char* p = buffer + sizeof(buffer) - 1;
+    *p = '\0';
+    do {
+        unsigned digit = (unsigned)(value % base);
+        *--p = (char)(digit < 10 ? '0' + digit : 'a' + digit - 10);
+        value /= base;
+    } while (value);
+    return std::string(p);
+}
+
+std::string String::formatFloat(double value, unsigned char decimals) {
+    char buffer[48];
+    snprintf(buffer, sizeof(buffer), "%.*f", (int)decimals, value);
+    return std::string(buffer);
+}
+
+void String::trim() {
+    size_t start = 0;
+    while (start < _s.size() && isspace((unsigned char)_s[start])) {
+        start++;
+    }
+    size_t end = _s.size();
+    while (end > start && isspace((unsigned char)_s[end - 1])) {
+        end--;
+    }
+    _s = _s.substr(start, end - start);
+}
+
+void String::toLowerCase() {
+    for (char& c : _s) {
+        c = (char)tolower((unsigned char)c);
+    }
+}
+
+void String::toUpperCase() {
+    for (char& c : _s) {
+        c = (char)toupper((unsigned char)c);
+    }
+}
+
+// ============================================================================
+// Print / Stream
+// ============================================================================
+
+size_t Print::write(const uint8_t* buffer, size_t size) {
+    size_t n = 0;
+    while (size--) {
+        if (!write(*buffer++)) {
+            break;
+        }
+        n++;
+    }
+    return n;
+}
+
+size_t Print::printf(const char* format, ...) {
+    char stackBuffer[256];
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(stackBuffer, sizeof(stackBuffer), format, args);
+    va_end(args);
+    if (len < 0) {
+        return 0;
+    }
+    if ((size_t)len < sizeof(stackBuffer)) {
+        return write((const uint8_t*)stackBuffer, (size_t)len);
+    }
+
+    char* heapBuffer = (char*)malloc((size_t)len + 1);
+    if (!heapBuffer) {
+        return 0;
+    }
+    va_start(args, format);
+    vsnprintf(heapBuffer, (size_t)len + 1, format, args);
+    va_end(args);
+    size_t n = write((const uint8_t*)heapBuffer, (size_t)len);
+    free(heapBuffer);
+    return n;
+}
+
+size_t Print::print(long n, int base) {
+    return print(String(n, (unsigned char)base));
+}
+
+size_t Print::print(unsigned long n, int base) {
+    return print(String(n, (unsigned char)base));
+}
+
+size_t Print::print(long long n, int base) {
+    return base == DEC ? print(String(std::to_string(n))) : print((unsigned long long)n, base);
+}
+
+size_t Print::print(unsigned long long n, int base) {
+    char buffer[65];
+    char* p = buffer + sizeof(buffer) - 1;
+    *p = '\0';
+    if (base < 2) {
+        base = DEC;
+    }
+    do {
+        unsigned digit = (unsigned)(n % (unsigned)base);
+        *--p = (char)(digit < 10 ? '0' + digit : 'A' + digit - 10);
+        n /= (unsigned)base;
+    } while (n);
+    return write(p);
+}
+
+size_t Print::print(double n, int digits) {
+    return print(String(n, (unsigned char)digits));
+}
+
+size_t Stream::readBytes(uint8_t* buffer, size_t length) {
+    size_t count = 0;
+    unsigned long start = millis();
+    while (count < length) {
+        int c = read();
+        if (c < 0) {
+            if (millis() - start >= _timeout) {
+                break;
+            }
+            delay(1);
+            continue;
+        }
+        buffer[count++] = (uint8_t)c;
+    }
+    return count;
+}
+
+// ============================================================================
+// Serial: stdout out, stdin in
+// ============================================================================
+
+static int serialPending = -1;
+static bool serialEof = false;
+
+size_t HardwareSerial::write(uint8_t c) {
+    return fputc(c, stdout) == EOF ? 0 : 1;
+}
+
+size_t HardwareSerial::write(const uint8_t* buffer, size_t size) {
+    return fwrite(buffer, 1, size, stdout);
+}
+
+void HardwareSerial::flush() {
+    fflush(stdout);
+}
+
+int HardwareSerial::available() {
+    if (serialPending >= 0) {
+        return 1;
+    }
+    if (serialEof) {
+        return 0;
+    }
+
+    struct pollfd pfd = { STDIN_FILENO, POLLIN, 0 };
+    if (poll(&pfd, 1, 0) <= 0) {
+        return 0;
+    }
+    uint8_t c;
+    ssize_t n = ::read(STDIN_FILENO, &c, 1);
+    if (n <= 0) {
+        // Closed or redirected from /dev/null: stop polling it
+        serialEof = n == 0 || (errno != EINTR && errno != EAGAIN);
+        return 0;
+    }
+    serialPending = c;
+    return 1;
+}
+
+int HardwareSerial::read() {
+    if (!available()) {
+        return -1;
+    }
+    int c = serialPending;
+    serialPending = -1;
+    return c;
+}
+
+// ============================================================================
+// ESP
+// ============================================================================
+
+// Internal RAM is fixed at its boot-time free size; PSRAM is charged with
+// everything the process has malloc'd, so leaks still show up as a falling
+// free-PSRAM line in the health output and metrics.
+#define HOST_HEAP_SIZE      (320 * 1024)
+#define HOST_PSRAM_SIZE     (8 * 1024 * 1024)
+
+uint32_t EspClass::getCycleCount() {
+    return (uint32_t)((uint64_t)esp_timer_get_time() * getCpuFreqMHz());
+}
+
+uint32_t EspClass::getHeapSize() {
+    return HOST_HEAP_SIZE;
+}
+
+uint32_t EspClass::getFreeHeap() {
+    return HOST_HEAP_SIZE;
+}
+
+uint32_t EspClass::getMinFreeHeap() {
+    return HOST_HEAP_SIZE;
+}
+
+uint32_t EspClass::getPsramSize() {
+    return HOST_PSRAM_SIZE;
+}
+
+uint32_t EspClass::getFreePsram() {
+    struct mallinfo2 info = mallinfo2();
+    uint32_t used = info.uordblks + info.hblkhd < HOST_PSRAM_SIZE
+                        ? (uint32_t)(info.uordblks + info.hblkhd) : HOST_PSRAM_SIZE;
+    return HOST_PSRAM_SIZE - used;
+}
+
+uint64_t EspClass::getEfuseMac() {
+    return 0x00000000CAFEF00DULL;
+}
+
+void EspClass::restart() {
+    Serial.println("ESP: restart requested, exiting");
+    fflush(stdout);
+    _exit(0);
+}
@@ -0,0 +1,306 @@
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+unsigned long millis();
+
+// ============================================================================
+// Tasks
+// ============================================================================
+
+struct HostTask {
+    std::string name;
+    BaseType_t core;
+    UBaseType_t priority;
+    uint32_t stackDepth;
+
+    std::mutex lock;
+    std::condition_variable notified;
+    uint32_t notifications;
+};
+
+// Handles live for the whole run, so notifying a task that has returned is
+// harmless (FreeRTOS would have crashed instead)
+static thread_local HostTask* currentTask = nullptr;
+static thread_local std::unique_ptr<HostTask> foreignTask;
+
+static HostTask* newTask(const char* name, BaseType_t core, UBaseType_t priority, uint32_t stackDepth) {
+    HostTask* task = new HostTask();
+    task->name = name ? name : "";
+    task->core = core;
+    task->priority = priority;
+    task->stackDepth = stackDepth;
+    task->notifications = 0;
+    return task;
+}
+
+static HostTask* current() {
+    if (!currentTask) {
+        foreignTask.reset(newTask("host", 0, 0, 0));
+        currentTask = foreignTask.get();
+    }
+    return currentTask;
+}
+
+// Deadline for a timed wait; portMAX_DELAY waits forever
+template <typename Lock, typename Predicate>
+static bool waitFor(std::condition_variable& cv, Lock& lock, TickType_t ticks, Predicate ready) {
+    if (ticks == portMAX_DELAY) {
+        cv.wait(lock, ready);
+        return true;
+    }
+    return cv.wait_for(lock, std::chrono::milliseconds(ticks * portTICK_PERIOD_MS), ready);
+}
+
+BaseType_t xPortGetCoreID() {
+    BaseType_t core = current()->core;
+    return core == tskNO_AFFINITY ? 0 : core;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t code, const char* name, uint32_t stackDepth,
+                                   void* parameters, UBaseType_t priority, TaskHandle_t* created,
+                                   BaseType_t coreId) {
+    HostTask* task = newTask(name, coreId, priority, stackDepth);
+    try {
+        std::thread([task, code, parameters]() {
+            currentTask = task;
+            pthread_setname_np(pthread_self(), task->name.substr(0, 15).c_str());
+            code(parameters);
+            // Returning from a task is a bug on FreeRTOS; here the thread just ends
+            fprintf(stderr, "FreeRTOS: task '%s' returned\n", task->name.c_str());
+        }).detach();
+    } catch (const std::system_error&) {
+        delete task;
+        return pdFAIL;
+    }
+
+    if (created) {
+        *created = task;
+    }
+    return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t code, const char* name, uint32_t stackDepth,
+                       void* parameters, UBaseType_t priority, TaskHandle_t* created) {
+    return xTaskCreatePinnedToCore(code, name, stackDepth, parameters, priority, created, tskNO_AFFINITY);
+}
+
+void vTaskDelete(TaskHandle_t task) {
+    if (task == nullptr || task == currentTask) {
+        pthread_exit(nullptr);
+    }
+    fprintf(stderr, "FreeRTOS: vTaskDelete('%s') from another task is not supported\n", task->name.c_str());
+}
+
+void vTaskDelay(TickType_t ticks) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ticks * portTICK_PERIOD_MS));
+}
+
+void vTaskYield() {
+    std::this_thread::yield();
+}
+
+void vTaskDelayUntil(TickType_t* previousWakeTime, TickType_t increment) {
+    *previousWakeTime += increment;
+    TickType_t now = xTaskGetTickCount();
+    int32_t remaining = (int32_t)(*previousWakeTime - now);
+    if (remaining > 0) {
+        vTaskDelay((TickType_t)remaining);
+    }
+}
+
+TickType_t xTaskGetTickCount() {
+    return (TickType_t)millis() / portTICK_PERIOD_MS;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+    return current();
+}
+
+char* pcTaskGetName(TaskHandle_t task) {
+    return &(task ? task : current())->name[0];
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task) {
+    // Host threads have megabytes of stack; report the configured depth
+    return (task ? task : current())->stackDepth;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+    {
+        std::lock_guard<std::mutex> guard(task->lock);
+        task->notifications++;
+    }
+    task->notified.notify_one();
+    return pdPASS;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearCountOnExit, TickType_t ticksToWait) {
+    HostTask* task = current();
+    std::unique_lock<std::mutex> lock(task->lock);
+    waitFor(task->notified, lock, ticksToWait, [task]() { return task->notifications > 0; });
+
+    uint32_t value = task->notifications;
+    if (value > 0) {
+        task->notifications = clearCountOnExit ? 0 : value - 1;
+    }
+    return value;
+}
+
+// ============================================================================
+// Queues and semaphores
+// ============================================================================
+
+struct HostQueue {
+    std::mutex lock;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
+
+    UBaseType_t length;
+    UBaseType_t itemSize;
+    UBaseType_t count;
+    UBaseType_t head;
+    std::vector<uint8_t> storage;       // Empty for semaphores
+};
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+    if (length == 0) {
+        return nullptr;
+    }
+    HostQueue* queue = new HostQueue();
+    queue->length = length;
+    queue->itemSize = itemSize;
+    queue->count = 0;
+    queue->head = 0;
+    queue->storage.resize((size_t)length * itemSize);
+    return queue;
+}
+
+void vQueueDelete(QueueHandle_t queue) {
+    delete queue;
+}
+
+static BaseType_t queueSend(QueueHandle_t queue, const void* item, TickType_t ticksToWait, bool front) {
+    std::unique_lock<std::mutex> lock(queue->lock);
+    if (!waitFor(queue->notFull, lock, ticksToWait, [queue]() { return queue->count < queue->length; })) {
+        return errQUEUE_FULL;
+    }
+
+    UBaseType_t slot;
+    if (front) {
+        queue->head = (queue->head + queue->length - 1) % queue->length;
+        slot = queue->head;
+    } else {
+        slot = (queue->head + queue->count) % queue->length;
+    }
+    if (queue->itemSize) {
+        memcpy(&queue->storage[(size_t)slot * queue->itemSize], item, queue->itemSize);
+    }
+    queue->count++;
+    lock.unlock();
+    queue->notEmpty.notify_one();
+    return pdPASS;
+}
+
+static BaseType_t queueReceive(QueueHandle_t queue, void* buffer, TickType_t ticksToWait, bool remove) {
+    std::unique_lock<std::mutex> lock(queue->lock);
+    if (!waitFor(queue->notEmpty, lock, ticksToWait, [queue]() { return queue->count > 0; })) {
+        return errQUEUE_EMPTY;
+    }
+
+    if (queue->itemSize && buffer) {
+        memcpy(buffer, &queue->storage[(size_t)queue->head * queue->itemSize], queue->itemSize);
+    }
+    if (!remove) {
+        return pdPASS;
+    }
+    queue->head = (queue->head + 1) % queue->length;
+    queue->count--;
+    lock.unlock();
+    queue->notFull.notify_one();
+    return pdPASS;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t ticksToWait) {
+    return queueSend(queue, item, ticksToWait, false);
+}
+
+BaseType_t xQueueSendToFront(QueueHandle_t queue, const void* item, TickType_t ticksToWait) {
+    return queueSend(queue, item, ticksToWait, true);
+}
+
+BaseType_t xQueueOverwrite(QueueHandle_t queue, const void* item) {
+    {
+        std::lock_guard<std::mutex> guard(queue->lock);
+        queue->count = 0;
+        queue->head = 0;
+    }
+    return queueSend(queue, item, 0, false);
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void* buffer, TickType_t ticksToWait) {
+    return queueReceive(queue, buffer, ticksToWait, true);
+}
+
+BaseType_t xQueuePeek(QueueHandle_t queue, void* buffer, TickType_t ticksToWait) {
+    return queueReceive(queue, buffer, ticksToWait, false);
+}
+
+BaseType_t xQueueReset(QueueHandle_t queue) {
+    {
+        std::lock_guard<std::mutex> guard(queue->lock);
+        queue->count = 0;
+        queue->head = 0;
+    }
+    queue->notFull.notify_all();
+    return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+    std::lock_guard<std::mutex> guard(queue->lock);
+    return queue->count;
+}
+
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue) {
+    std::lock_guard<std::mutex> guard(queue->lock);
+    return queue->length - queue->count;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex() {
+    return xSemaphoreCreateCounting(1, 1);
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary() {
+    return xSemaphoreCreateCounting(1, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t maxCount, UBaseType_t initialCount) {
+    SemaphoreHandle_t semaphore = xQueueCreate(maxCount, 0);
+    if (semaphore) {
+        semaphore->count = initialCount < maxCount ? initialCount : maxCount;
+    }
+    return semaphore;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticksToWait) {
+    return queueReceive(semaphore, nullptr, ticksToWait, true);
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+    return queueSend(semaphore, nullptr, 0, false);
+}
+
+UBaseType_t uxSemaphoreGetCount(SemaphoreHandle_t semaphore) {
+    return uxQueueMessagesWaiting(semaphore);
+}
@@ -0,0 +1,429 @@
+#include <Arduino.h>
+#include <esp_camera.h>
+#include <esp_timer.h>
+#include <SyntheticJpeg.h>
+#include <dirent.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../../lib/CaptureTrace/CaptureTrace.h"
+#include "HostCaptureTrace.h"
+
+// Stand-in for the OV2640 + esp32-camera driver. A sensor thread produces a
+// JPEG every 1/HOST_CAMERA_SENSOR_FPS seconds (default 60, roughly what the
+// OV2640 manages at QVGA with a 20 MHz XCLK) into one of fb_count buffers.
+// As with CAMERA_GRAB_LATEST, a newer frame replaces any frame nobody has
+// taken yet, and when every buffer is held by the application the sensor
+// frame is lost. esp_camera_fb_get() waits for a frame newer than the last
+// one handed out, for up to the driver's 4 s timeout.
+//
+// Frames come from HOST_CAPTURE_TRACE (a device recording, at its own
+// timestamps and sizes, looped; see HostCaptureTrace.h for the replay
+// speed), HOST_CAMERA_DIR (every *.jpg, in name order, looped) or, when
+// neither is set, from SyntheticJpeg, which honours set_quality() so the rate
+// controller has a real loop to close. Recorded frames ignore set_quality()
+// and set_framesize().
+
+#define HOST_CAMERA_DEFAULT_FPS     60
+#define HOST_CAMERA_FB_TIMEOUT_MS   4000
+
+enum class BufferState : uint8_t {
+    FREE,
+    READY,
+    HELD
+};
+
+struct HostFrameBuffer {
+    camera_fb_t fb;
+    std::vector<uint8_t> data;
+    BufferState state;
+    uint32_t sequence;
+};
+
+const resolution_info_t resolution[FRAMESIZE_INVALID] = {
+    { 96, 96 }, { 160, 120 }, { 176, 144 }, { 240, 176 }, { 240, 240 }, { 320, 240 }, { 400, 296 },
+    { 480, 320 }, { 640, 480 }, { 800, 600 }, { 1024, 768 }, { 1280, 720 }, { 1280, 1024 }, { 1600, 1200 },
+};
+
+struct TraceFrame {
+    int64_t micros;
+    const uint8_t* data;
+    size_t len;
+    uint16_t width;
+    uint16_t height;
+};
+
+static std::mutex cameraLock;
+static std::condition_variable frameReady;
+static std::condition_variable bufferReleased;
+static std::vector<HostFrameBuffer> buffers;
+static std::thread sensorThread;
+static std::atomic<bool> running(false);
+static uint32_t sequence = 0;
+static uint32_t lastHandedOut = 0;
+
+static SyntheticJpeg synthetic;
+static std::vector<std::vector<uint8_t>> recorded;
+static std::vector<TraceFrame> traceFrames;
+static int64_t traceLoopMicros = 0;
+static std::atomic<int> pendingQuality(-1);
+static std::atomic<int> pendingFrameSize(-1);
+static sensor_t sensor;
+
+static bool loadRecorded(const char* dir) {
+    DIR* d = opendir(dir);
+    if (!d) {
+        Serial.printf("HostCamera: Cannot open HOST_CAMERA_DIR '%s'\n", dir);
+        return false;
+    }
+    std::vector<std::string> names;
+    while (struct dirent* entry = readdir(d)) {
+        std::string name = entry->d_name;
+        if (name.size() > 4 && (name.compare(name.size() - 4, 4, ".jpg") == 0 ||
+                                name.compare(name.size() - 4, 4, ".JPG") == 0)) {
+            names.push_back(name);
+        }
+    }
+    closedir(d);
+    std::sort(names.begin(), names.end());
+
+    for (const std::string& name : names) {
+        std::string path = std::string(dir) + "/" + name;
+        FILE* f = fopen(path.c_str(), "rb");
+        if (!f) {
+            continue;
+        }
+        std::vector<uint8_t> jpeg;
+        uint8_t chunk[4096];
+        size_t n;
+        while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) {
+            jpeg.insert(jpeg.end(), chunk, chunk + n);
+        }
+        fclose(f);
+        if (jpeg.size() >= 4 && jpeg[0] == 0xFF && jpeg[1] == 0xD8) {
+            recorded.push_back(std::move(jpeg));
+        }
+    }
+    Serial.printf("HostCamera: Loaded %u JPEG frames from %s\n", (unsigned)recorded.size(), dir);
+    return !recorded.empty();
+}
+
+static bool loadTrace(const HostCaptureTrace* trace) {
+    CaptureTraceReader reader;
+    if (!trace || !reader.open(trace->data.data(), trace->data.size())) {
+        return false;
+    }
+    CaptureTraceRecord record;
+    int64_t end = 0;
+    while (reader.next(record)) {
+        end = record.micros > end ? record.micros : end;
+        if (record.kind == CAPTURE_TRACE_VIDEO && record.format == PIXFORMAT_JPEG) {
+            traceFrames.push_back({ record.micros, record.payload, record.length, record.width, record.height });
+        }
+    }
+    if (traceFrames.empty()) {
+        Serial.println("HostCamera: Capture trace has no JPEG frames");
+        return false;
+    }
+    // One average frame period after the end before the trace starts over
+    int64_t span = traceFrames.back().micros - traceFrames.front().micros;
+    int64_t period = traceFrames.size() > 1 ? span / (int64_t)(traceFrames.size() - 1) : 33333;
+    traceLoopMicros = end + period;
+    return true;
+}
+
+// Pick the buffer a new sensor frame goes into: a free one, else the oldest
+// frame not yet taken (grab-latest drops it), else none
+static HostFrameBuffer* claimBuffer() {
+    HostFrameBuffer* oldestReady = nullptr;
+    for (HostFrameBuffer& buffer : buffers) {
+        if (buffer.state == BufferState::FREE) {
+            return &buffer;
+        }
+        if (buffer.state == BufferState::READY &&
+            (!oldestReady || (int32_t)(buffer.sequence - oldestReady->sequence) < 0)) {
+            oldestReady = &buffer;
+        }
+    }
+    return oldestReady;
+}
+
+// Replay at the trace's own timestamps (scaled by the speed), or when the
+// speed is 0, hand over the next frame once the previous one has been taken
+static void waitForTraceFrame(const HostCaptureTrace* trace, uint64_t frameIndex) {
+    if (trace->speed <= 0.0) {
+        auto taken = []() {
+            bool ready = false;
+            bool free = false;
+            for (const HostFrameBuffer& buffer : buffers) {
+                ready = ready || buffer.state == BufferState::READY;
+                free = free || buffer.state == BufferState::FREE;
+            }
+            return !ready && free;
+        };
+        std::unique_lock<std::mutex> lock(cameraLock);
+        while (running.load() && !bufferReleased.wait_for(lock, std::chrono::milliseconds(100), taken)) {
+        }
+        return;
+    }
+    const TraceFrame& frame = traceFrames[frameIndex % traceFrames.size()];
+    int64_t traceMicros = (int64_t)(frameIndex / traceFrames.size()) * traceLoopMicros + frame.micros;
+    int64_t due = trace->epochMicros + (int64_t)(traceMicros / trace->speed);
+    int64_t now = esp_timer_get_time();
+    if (due > now) {
+        delayMicroseconds((uint32_t)(due - now));
+    }
+}
+
+static void sensorLoop(uint32_t fps) {
+    const int64_t period = 1000000 / fps;
+    const HostCaptureTrace* trace = traceFrames.empty() ? nullptr : hostCaptureTrace();
+    int64_t next = esp_timer_get_time();
+    uint32_t frameIndex = 0;
+    std::vector<uint8_t> jpeg;
+
+    while (running.load()) {
+        if (trace) {
+            waitForTraceFrame(trace, frameIndex);
+            if (!running.load()) {
+                break;
+            }
+        } else {
+            int64_t now = esp_timer_get_time();
+            if (next > now) {
+                delayMicroseconds((uint32_t)(next - now));
+            }
+            next += period;
+        }
+
+        int64_t captured = esp_timer_get_time();
+        int frameSize = pendingFrameSize.exchange(-1);
+        int quality = pendingQuality.exchange(-1);
+        size_t width = resolution[sensor.framesize].width;
+        size_t height = resolution[sensor.framesize].height;
+        if (trace) {
+            const TraceFrame& frame = traceFrames[frameIndex % traceFrames.size()];
+            jpeg.assign(frame.data, frame.data + frame.len);
+            width = frame.width;
+            height = frame.height;
+        } else if (recorded.empty()) {
+            if (frameSize >= 0) {
+                synthetic.begin(resolution[frameSize].width, resolution[frameSize].height, (uint8_t)sensor.quality);
+            } else if (quality >= 0) {
+                synthetic.setQuality((uint8_t)quality);
+            }
+            if (!synthetic.capture(frameIndex, jpeg)) {
+                continue;
+            }
+            width = synthetic.getWidth();
+            height = synthetic.getHeight();
+        } else {
+            jpeg = recorded[frameIndex % recorded.size()];
+        }
+        frameIndex++;
+
+        std::lock_guard<std::mutex> guard(cameraLock);
+        HostFrameBuffer* buffer = claimBuffer();
+        if (!buffer) {
+            continue;                               // Every buffer is held: the frame is lost
+        }
+        buffer->data.swap(jpeg);
+        buffer->state = BufferState::READY;
+        buffer->sequence = ++sequence;
+        buffer->fb.buf = buffer->data.data();
+        buffer->fb.len = buffer->data.size();
+        buffer->fb.width = width;
+        buffer->fb.height = height;
+        buffer->fb.format = PIXFORMAT_JPEG;
+        buffer->fb.timestamp.tv_sec = captured / 1000000;
+        buffer->fb.timestamp.tv_usec = captured % 1000000;
+        frameReady.notify_all();
+    }
+}
+
+// ============================================================================
+// Sensor controls
+// ============================================================================
+
+static int setNothing(sensor_t*, int) {
+    return 0;
+}
+
+static int setGainCeiling(sensor_t*, gainceiling_t) {
+    return 0;
+}
+
+static int setPixformat(sensor_t* s, pixformat_t pixformat) {
+    if (pixformat != PIXFORMAT_JPEG) {
+        return -1;                                  // Only JPEG is emulated
+    }
+    s->pixformat = pixformat;
+    return 0;
+}
+
+static int setFramesize(sensor_t* s, framesize_t framesize) {
+    if (framesize >= FRAMESIZE_INVALID) {
+        return -1;
+    }
+    s->framesize = framesize;
+    pendingFrameSize.store(framesize);
+    return 0;
+}
+
+static int setQuality(sensor_t* s, int quality) {
+    if (quality < 0 || quality > 63) {
+        return -1;
+    }
+    s->quality = quality;
+    pendingQuality.store(quality);
+    return 0;
+}
+
+static void initSensor(const camera_config_t* config) {
+    sensor.id.MIDH = 0x7F;                          // OV2640 identification registers
+    sensor.id.MIDL = 0xA2;
+    sensor.id.PID = 0x26;
+    sensor.id.VER = 0x42;
+    sensor.pixformat = config->pixel_format;
+    sensor.framesize = config->frame_size;
+    sensor.quality = config->jpeg_quality;
+
+    sensor.set_pixformat = setPixformat;
+    sensor.set_framesize = setFramesize;
+    sensor.set_quality = setQuality;
+    sensor.set_gainceiling = setGainCeiling;
+    sensor.set_contrast = setNothing;
+    sensor.set_brightness = setNothing;
+    sensor.set_saturation = setNothing;
+    sensor.set_sharpness = setNothing;
+    sensor.set_denoise = setNothing;
+    sensor.set_colorbar = setNothing;
+    sensor.set_whitebal = setNothing;
+    sensor.set_gain_ctrl = setNothing;
+    sensor.set_exposure_ctrl = setNothing;
+    sensor.set_hmirror = setNothing;
+    sensor.set_vflip = setNothing;
+    sensor.set_aec2 = setNothing;
+    sensor.set_awb_gain = setNothing;
+    sensor.set_agc_gain = setNothing;
+    sensor.set_aec_value = setNothing;
+    sensor.set_special_effect = setNothing;
+    sensor.set_wb_mode = setNothing;
+    sensor.set_ae_level = setNothing;
+    sensor.set_dcw = setNothing;
+    sensor.set_bpc = setNothing;
+    sensor.set_wpc = setNothing;
+    sensor.set_raw_gma = setNothing;
+    sensor.set_lenc = setNothing;
+}
+
+// ============================================================================
+// Driver API
+// ============================================================================
+
+esp_err_t esp_camera_init(const camera_config_t* config) {
+    if (running.load()) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (config->pixel_format != PIXFORMAT_JPEG || config->frame_size >= FRAMESIZE_INVALID ||
+        config->fb_count == 0) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    initSensor(config);
+    recorded.clear();
+    traceFrames.clear();
+    const char* dir = getenv("HOST_CAMERA_DIR");
+    if (hostCaptureTraceRequested()) {
+        if (!loadTrace(hostCaptureTrace())) {
+            return ESP_ERR_NOT_FOUND;
+        }
+    } else if (dir && *dir) {
+        if (!loadRecorded(dir)) {
+            return ESP_ERR_NOT_FOUND;
+        }
+    } else {
+        synthetic.begin(resolution[config->frame_size].width, resolution[config->frame_size].height,
+                        (uint8_t)config->jpeg_quality);
+    }
+
+    const char* fpsText = getenv("HOST_CAMERA_SENSOR_FPS");
+    uint32_t fps = fpsText && atoi(fpsText) > 0 ? (uint32_t)atoi(fpsText) : HOST_CAMERA_DEFAULT_FPS;
+
+    buffers.clear();
+    buffers.resize(config->fb_count);
+    for (HostFrameBuffer& buffer : buffers) {
+        buffer.fb = camera_fb_t();
+        buffer.state = BufferState::FREE;
+        buffer.sequence = 0;
+    }
+    sequence = 0;
+    lastHandedOut = 0;
+
+    Serial.printf("HostCamera: %s source, %ux%u, sensor at %u FPS, %u buffers\n",
+                  !traceFrames.empty() ? "capture trace" : recorded.empty() ? "synthetic" : "recorded",
+                  resolution[config->frame_size].width, resolution[config->frame_size].height,
+                  fps, (unsigned)config->fb_count);
+
+    running.store(true);
+    sensorThread = std::thread(sensorLoop, fps);
+    return ESP_OK;
+}
+
+esp_err_t esp_camera_deinit() {
+    if (!running.exchange(false)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    sensorThread.join();
+    return ESP_OK;
+}
+
+camera_fb_t* esp_camera_fb_get() {
+    std::unique_lock<std::mutex> lock(cameraLock);
+
+    HostFrameBuffer* newest = nullptr;
+    auto findNewest = [&newest]() {
+        newest = nullptr;
+        for (HostFrameBuffer& buffer : buffers) {
+            if (buffer.state == BufferState::READY && buffer.sequence != lastHandedOut &&
+                (!newest || (int32_t)(buffer.sequence - newest->sequence) > 0)) {
+                newest = &buffer;
+            }
+        }
+        return newest != nullptr;
+    };
+    if (!frameReady.wait_for(lock, std::chrono::milliseconds(HOST_CAMERA_FB_TIMEOUT_MS), findNewest)) {
+        Serial.println("HostCamera: Failed to get the frame on time!");
+        return nullptr;
+    }
+
+    // Grab-latest: anything older that nobody took is stale now
+    for (HostFrameBuffer& buffer : buffers) {
+        if (buffer.state == BufferState::READY && &buffer != newest) {
+            buffer.state = BufferState::FREE;
+        }
+    }
+    newest->state = BufferState::HELD;
+    lastHandedOut = newest->sequence;
+    bufferReleased.notify_all();
+    return &newest->fb;
+}
+
+void esp_camera_fb_return(camera_fb_t* fb) {
+    std::lock_guard<std::mutex> guard(cameraLock);
+    for (HostFrameBuffer& buffer : buffers) {
+        if (&buffer.fb == fb) {
+            buffer.state = BufferState::FREE;
+            bufferReleased.notify_all();
+            return;
+        }
+    }
+}
+
+sensor_t* esp_camera_sensor_get() {
+    return running.load() ? &sensor : nullptr;
+}
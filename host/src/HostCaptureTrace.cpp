@@ -0,0 +1,68 @@
+#include <Arduino.h>
+#include <esp_timer.h>
+#include <mutex>
+#include "HostCaptureTrace.h"
+#include "../../lib/CaptureTrace/CaptureTrace.h"
+
+static std::once_flag loadOnce;
+static HostCaptureTrace trace;
+static bool loaded = false;
+
+static void load() {
+    const char* path = getenv("HOST_CAPTURE_TRACE");
+    if (!path || !*path) {
+        return;
+    }
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        Serial.printf("HostCaptureTrace: Cannot open '%s'\n", path);
+        return;
+    }
+    uint8_t chunk[65536];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) {
+        trace.data.insert(trace.data.end(), chunk, chunk + n);
+    }
+    fclose(f);
+
+    CaptureTraceReader reader;
+    if (!reader.open(trace.data.data(), trace.data.size())) {
+        Serial.printf("HostCaptureTrace: '%s' is not a capture trace\n", path);
+        trace.data.clear();
+        return;
+    }
+    uint32_t frames = 0;
+    uint32_t blocks = 0;
+    int64_t last = 0;
+    CaptureTraceRecord record;
+    while (reader.next(record)) {
+        frames += record.kind == CAPTURE_TRACE_VIDEO;
+        blocks += record.kind == CAPTURE_TRACE_AUDIO;
+        last = record.micros > last ? record.micros : last;
+    }
+
+    const char* speed = getenv("HOST_CAPTURE_TRACE_SPEED");
+    trace.speed = speed && *speed ? atof(speed) : 1.0;
+    if (trace.speed < 0.0) {
+        trace.speed = 0.0;
+    }
+    trace.epochMicros = esp_timer_get_time();
+    loaded = true;
+
+    char mode[32] = "as fast as consumed";
+    if (trace.speed > 0.0) {
+        snprintf(mode, sizeof(mode), "at %.2fx", trace.speed);
+    }
+    Serial.printf("HostCaptureTrace: %s: %u frames, %u audio blocks, %.1f s%s, replay %s\n", path, frames, blocks,
+                  last / 1e6, reader.isTruncated() ? " (truncated)" : "", mode);
+}
+
+const HostCaptureTrace* hostCaptureTrace() {
+    std::call_once(loadOnce, load);
+    return loaded ? &trace : nullptr;
+}
+
+bool hostCaptureTraceRequested() {
+    const char* path = getenv("HOST_CAPTURE_TRACE");
+    return path && *path;
+}
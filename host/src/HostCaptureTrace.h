@@ -0,0 +1,28 @@
+#ifndef HOST_CAPTURE_TRACE_H
+#define HOST_CAPTURE_TRACE_H
+
+#include <stdint.h>
+#include <vector>
+
+// The capture trace named by HOST_CAPTURE_TRACE, shared by the camera and
+// I2S stand-ins so both replay the same recording on one timeline.
+//
+// HOST_CAPTURE_TRACE_SPEED scales the original cadence (default 1). 0 means
+// as fast as the firmware consumes: every frame and sample is delivered in
+// order as soon as it is asked for, nothing is dropped, so two runs see
+// identical input.
+
+struct HostCaptureTrace {
+    std::vector<uint8_t> data;
+    double speed;               // 0 = as fast as consumed
+    int64_t epochMicros;        // esp_timer time that trace time 0 maps to
+};
+
+// Loaded on first use. Returns nullptr when HOST_CAPTURE_TRACE is unset or
+// the file is not a readable capture trace (the reason is printed).
+const HostCaptureTrace* hostCaptureTrace();
+
+// True when HOST_CAPTURE_TRACE is set, whether or not it loaded
+bool hostCaptureTraceRequested();
+
+#endif // HOST_CAPTURE_TRACE_H
@@ -0,0 +1,234 @@
+#include <Arduino.h>
+#include <driver/i2s.h>
+#include <esp_timer.h>
+#include <math.h>
+#include <mutex>
+#include <vector>
+#include "../../lib/CaptureTrace/CaptureTrace.h"
+#include "HostCaptureTrace.h"
+
+// Stand-in for the PDM microphone behind the legacy I2S driver. Samples
+// "arrive" at the configured rate from the moment the driver is installed;
+// i2s_read() blocks until the requested samples exist, like a DMA read. A
+// reader that falls more than dma_buf_count * dma_buf_len samples behind
+// loses the oldest ones, as the DMA ring would overwrite them.
+//
+// The signal is the audio of HOST_CAPTURE_TRACE (on the same timeline as
+// its frames; at replay speed 0 reads return at once and nothing overruns),
+// HOST_AUDIO_FILE (raw signed 16-bit little-endian mono at the configured
+// rate, looped) or a 440 Hz tone over low-level noise.
+
+struct HostI2SPort {
+    bool installed;
+    uint32_t sampleRate;
+    uint64_t ringSamples;
+    int64_t startMicros;
+    double speed;               // Sample clock scale; 0 = as fast as read
+    uint64_t consumed;          // Samples handed to the reader (or dropped)
+    std::vector<int16_t> recording;
+};
+
+static std::mutex i2sLock;
+static HostI2SPort ports[I2S_NUM_MAX];
+
+static bool loadRecording(const char* path, std::vector<int16_t>& out) {
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        Serial.printf("HostI2S: Cannot open HOST_AUDIO_FILE '%s'\n", path);
+        return false;
+    }
+    uint8_t bytes[4096];
+    size_t n;
+    while ((n = fread(bytes, 1, sizeof(bytes), f)) > 1) {
+        for (size_t i = 0; i + 1 < n; i += 2) {
+            out.push_back((int16_t)(bytes[i] | (bytes[i + 1] << 8)));
+        }
+    }
+    fclose(f);
+    return !out.empty();
+}
+
+// Concatenate the trace's PCM blocks; returns the trace time the first
+// sample was captured at
+static int64_t loadTraceAudio(const HostCaptureTrace* trace, uint32_t sampleRate, std::vector<int16_t>& out) {
+    CaptureTraceReader reader;
+    if (!trace || !reader.open(trace->data.data(), trace->data.size())) {
+        return 0;
+    }
+    if (reader.getSampleRate() != sampleRate) {
+        Serial.printf("HostI2S: Capture trace was recorded at %u Hz, replaying at %u Hz\n",
+                      reader.getSampleRate(), sampleRate);
+    }
+    int64_t first = 0;
+    CaptureTraceRecord record;
+    while (reader.next(record)) {
+        if (record.kind != CAPTURE_TRACE_AUDIO) {
+            continue;
+        }
+        size_t samples = record.length / sizeof(int16_t);
+        if (out.empty()) {
+            // The record is stamped when the block was complete
+            first = record.micros - (int64_t)(samples * 1000000ULL / sampleRate);
+        }
+        for (size_t i = 0; i < samples; i++) {
+            out.push_back((int16_t)(record.payload[2 * i] | (record.payload[2 * i + 1] << 8)));
+        }
+    }
+    return first;
+}
+
+static uint64_t samplesProduced(const HostI2SPort& port) {
+    int64_t elapsed = esp_timer_get_time() - port.startMicros;
+    if (elapsed <= 0) {
+        return 0;
+    }
+    return (uint64_t)((double)elapsed * port.speed) * port.sampleRate / 1000000ULL;
+}
+
+static int16_t sampleAt(const HostI2SPort& port, uint64_t index) {
+    if (!port.recording.empty()) {
+        return port.recording[index % port.recording.size()];
+    }
+    uint32_t noise = (uint32_t)(index * 2654435761ULL);
+    noise ^= noise >> 13;
+    double t = (double)index / port.sampleRate;
+    return (int16_t)(3000.0 * sin(2.0 * M_PI * 440.0 * t) + (int)(noise % 401) - 200);
+}
+
+esp_err_t i2s_driver_install(i2s_port_t port, const i2s_config_t* config, int queueSize, void* queue) {
+    (void)queueSize;
+    (void)queue;
+    if (port >= I2S_NUM_MAX || !config || config->sample_rate == 0 ||
+        config->bits_per_sample != I2S_BITS_PER_SAMPLE_16BIT) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    std::lock_guard<std::mutex> guard(i2sLock);
+    HostI2SPort& p = ports[port];
+    if (p.installed) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    p.recording.clear();
+    p.startMicros = esp_timer_get_time();
+    p.speed = 1.0;
+    const char* path = getenv("HOST_AUDIO_FILE");
+    if (hostCaptureTraceRequested()) {
+        const HostCaptureTrace* trace = hostCaptureTrace();
+        int64_t first = loadTraceAudio(trace, config->sample_rate, p.recording);
+        if (p.recording.empty()) {
+            Serial.println("HostI2S: Capture trace has no audio");
+            return ESP_ERR_NOT_FOUND;
+        }
+        path = "capture trace";
+        p.speed = trace->speed;
+        if (p.speed > 0.0) {
+            p.startMicros = trace->epochMicros + (int64_t)(first / p.speed);
+        }
+    } else if (path && *path && !loadRecording(path, p.recording)) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    p.installed = true;
+    p.sampleRate = config->sample_rate;
+    p.ringSamples = (uint64_t)config->dma_buf_count * config->dma_buf_len;
+    p.consumed = 0;
+    Serial.printf("HostI2S: %s source at %u Hz\n", p.recording.empty() ? "synthetic" : path,
+                  p.sampleRate);
+    return ESP_OK;
+}
+
+esp_err_t i2s_driver_uninstall(i2s_port_t port) {
+    if (port >= I2S_NUM_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    std::lock_guard<std::mutex> guard(i2sLock);
+    if (!ports[port].installed) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    ports[port].installed = false;
+    return ESP_OK;
+}
+
+esp_err_t i2s_set_pin(i2s_port_t port, const i2s_pin_config_t* pins) {
+    (void)pins;
+    return port < I2S_NUM_MAX && ports[port].installed ? ESP_OK : ESP_ERR_INVALID_STATE;
+}
+
+esp_err_t i2s_zero_dma_buffer(i2s_port_t port) {
+    if (port >= I2S_NUM_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    std::lock_guard<std::mutex> guard(i2sLock);
+    HostI2SPort& p = ports[port];
+    if (!p.installed) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (p.speed > 0.0) {
+        p.consumed = samplesProduced(p);
+    }
+    return ESP_OK;
+}
+
+esp_err_t i2s_read(i2s_port_t port, void* dest, size_t size, size_t* bytesRead, TickType_t ticksToWait) {
+    *bytesRead = 0;
+    if (port >= I2S_NUM_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    std::unique_lock<std::mutex> lock(i2sLock);
+    HostI2SPort& p = ports[port];
+    if (!p.installed) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    size_t wanted = size / sizeof(int16_t);
+    if (!dest || wanted == 0) {
+        return ESP_OK;
+    }
+
+    int16_t* out = (int16_t*)dest;
+    if (p.speed <= 0.0) {
+        // Replay as fast as read: the next samples, immediately
+        for (size_t i = 0; i < wanted; i++) {
+            out[i] = sampleAt(p, p.consumed + i);
+        }
+        p.consumed += wanted;
+        *bytesRead = wanted * sizeof(int16_t);
+        return ESP_OK;
+    }
+
+    // Overrun: samples older than the DMA ring are gone
+    uint64_t produced = samplesProduced(p);
+    if (produced - p.consumed > p.ringSamples) {
+        p.consumed = produced - p.ringSamples;
+    }
+
+    // Wait until the last wanted sample has been clocked in (or the timeout)
+    uint64_t last = p.consumed + wanted;
+    int64_t readyAt = p.startMicros + (int64_t)((last * 1000000ULL + p.sampleRate - 1) / p.sampleRate / p.speed);
+    if (p.speed != 1.0) {
+        readyAt++;                              // Absorb rounding in the scaled clock
+    }
+    int64_t now = esp_timer_get_time();
+    int64_t wait = readyAt - now;
+    if (ticksToWait != portMAX_DELAY && wait > (int64_t)ticksToWait * portTICK_PERIOD_MS * 1000) {
+        wait = (int64_t)ticksToWait * portTICK_PERIOD_MS * 1000;
+    }
+    if (wait > 0) {
+        lock.unlock();
+        delayMicroseconds((uint32_t)wait);
+        lock.lock();
+        if (!p.installed) {
+            return ESP_ERR_INVALID_STATE;
+        }
+    }
+
+    produced = samplesProduced(p);
+    size_t count = produced - p.consumed < wanted ? (size_t)(produced - p.consumed) : wanted;
+    for (size_t i = 0; i < count; i++) {
+        out[i] = sampleAt(p, p.consumed + i);
+    }
+    p.consumed += count;
+    *bytesRead = count * sizeof(int16_t);
+    return ESP_OK;
+}
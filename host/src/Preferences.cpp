@@ -0,0 +1,109 @@
+#include <Preferences.h>
+#include <ctype.h>
+#include <map>
+#include <mutex>
+#include <set>
+
+extern char** environ;
+
+typedef std::map<std::string, std::string> Namespace;
+
+static std::mutex nvsLock;
+static std::map<std::string, Namespace> nvs;
+static std::set<std::string> seeded;
+
+static std::string upper(const std::string& s) {
+    std::string out = s;
+    for (char& c : out) {
+        c = (char)toupper((unsigned char)c);
+    }
+    return out;
+}
+
+static std::string lower(const std::string& s) {
+    std::string out = s;
+    for (char& c : out) {
+        c = (char)tolower((unsigned char)c);
+    }
+    return out;
+}
+
+// NVS_<NAMESPACE>_<KEY>=value -> namespace/key (key lower-cased)
+static void seed(const std::string& name) {
+    if (!seeded.insert(name).second) {
+        return;
+    }
+    std::string prefix = "NVS_" + upper(name) + "_";
+    for (char** env = environ; *env; env++) {
+        std::string entry = *env;
+        size_t equals = entry.find('=');
+        if (equals == std::string::npos || entry.compare(0, prefix.size(), prefix) != 0) {
+            continue;
+        }
+        std::string key = lower(entry.substr(prefix.size(), equals - prefix.size()));
+        nvs[name][key] = entry.substr(equals + 1);
+    }
+}
+
+bool Preferences::begin(const char* name, bool readOnly, const char* partition) {
+    (void)partition;
+    if (!name || !*name) {
+        return false;
+    }
+    std::lock_guard<std::mutex> guard(nvsLock);
+    _namespace = name;
+    _readOnly = readOnly;
+    _open = true;
+    seed(_namespace);
+    return true;
+}
+
+bool Preferences::isKey(const char* key) {
+    std::lock_guard<std::mutex> guard(nvsLock);
+    return _open && nvs[_namespace].count(key) != 0;
+}
+
+bool Preferences::remove(const char* key) {
+    std::lock_guard<std::mutex> guard(nvsLock);
+    if (!_open || _readOnly) {
+        return false;
+    }
+    return nvs[_namespace].erase(key) != 0;
+}
+
+bool Preferences::clear() {
+    std::lock_guard<std::mutex> guard(nvsLock);
+    if (!_open || _readOnly) {
+        return false;
+    }
+    nvs[_namespace].clear();
+    return true;
+}
+
+String Preferences::getString(const char* key, const String& defaultValue) {
+    std::lock_guard<std::mutex> guard(nvsLock);
+    if (!_open) {
+        return defaultValue;
+    }
+    Namespace& values = nvs[_namespace];
+    auto it = values.find(key);
+    return it == values.end() ? defaultValue : String(it->second);
+}
+
+size_t Preferences::putString(const char* key, const String& value) {
+    std::lock_guard<std::mutex> guard(nvsLock);
+    if (!_open || _readOnly) {
+        return 0;
+    }
+    nvs[_namespace][key] = value.c_str();
+    return value.length();
+}
+
+uint32_t Preferences::getUInt(const char* key, uint32_t defaultValue) {
+    String value = getString(key, String());
+    return value.length() ? (uint32_t)strtoul(value.c_str(), nullptr, 10) : defaultValue;
+}
+
+size_t Preferences::putUInt(const char* key, uint32_t value) {
+    return putString(key, String((unsigned long)value)) ? sizeof(value) : 0;
+}
@@ -0,0 +1,330 @@
+#include <WiFi.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+
+#define WIFI_CLIENT_CONNECT_TIMEOUT_MS  3000
+#define WIFI_DEFAULT_RSSI               -55
+
+WiFiClass WiFi;
+
+// ============================================================================
+// WiFiClass
+// ============================================================================
+
+String IPAddress::toString() const {
+    char text[16];
+    snprintf(text, sizeof(text), "%u.%u.%u.%u", (*this)[0], (*this)[1], (*this)[2], (*this)[3]);
+    return String(text);
+}
+
+WiFiClass::WiFiClass()
+    : _mode(WIFI_OFF)
+    , _status(WL_IDLE_STATUS)
+    , _callbackCount(0)
+{
+}
+
+int WiFiClass::onEvent(WiFiEventCb callback) {
+    if (_callbackCount >= sizeof(_callbacks) / sizeof(_callbacks[0])) {
+        return -1;
+    }
+    _callbacks[_callbackCount] = callback;
+    return _callbackCount++;
+}
+
+void WiFiClass::raise(WiFiEvent_t event) {
+    for (uint8_t i = 0; i < _callbackCount; i++) {
+        _callbacks[i](event);
+    }
+}
+
+wl_status_t WiFiClass::begin(const char* ssid, const char* password) {
+    (void)password;
+    _ssid = ssid ? ssid : "";
+    if (_status != WL_CONNECTED) {
+        _status = WL_CONNECTED;
+        raise(ARDUINO_EVENT_WIFI_STA_CONNECTED);
+        raise(ARDUINO_EVENT_WIFI_STA_GOT_IP);
+    }
+    return _status;
+}
+
+bool WiFiClass::disconnect(bool wifiOff) {
+    if (wifiOff) {
+        _mode = WIFI_OFF;
+    }
+    if (_status == WL_CONNECTED) {
+        _status = WL_DISCONNECTED;
+        raise(ARDUINO_EVENT_WIFI_STA_DISCONNECTED);
+    }
+    return true;
+}
+
+// The address the metrics endpoint would be scraped on: the interface used
+// to reach the outside world, or loopback when there is none
+IPAddress WiFiClass::localIP() {
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) {
+        return IPAddress(127, 0, 0, 1);
+    }
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(53);
+    inet_pton(AF_INET, "192.0.2.1", &addr.sin_addr);
+
+    IPAddress ip(127, 0, 0, 1);
+    socklen_t len = sizeof(addr);
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) == 0 &&
+        getsockname(fd, (struct sockaddr*)&addr, &len) == 0) {
+        uint32_t a = ntohl(addr.sin_addr.s_addr);
+        ip = IPAddress((uint8_t)(a >> 24), (uint8_t)(a >> 16), (uint8_t)(a >> 8), (uint8_t)a);
+    }
+    close(fd);
+    return ip;
+}
+
+int8_t WiFiClass::RSSI() {
+    if (_status != WL_CONNECTED) {
+        return 0;
+    }
+    const char* rssi = getenv("HOST_WIFI_RSSI");
+    return rssi ? (int8_t)atoi(rssi) : WIFI_DEFAULT_RSSI;
+}
+
+// ============================================================================
+// WiFiClient
+// ============================================================================
+
+struct WiFiClient::Socket {
+    int fd;
+
+    explicit Socket(int f) : fd(f) {}
+    ~Socket() {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+};
+
+WiFiClient::WiFiClient() {
+}
+
+WiFiClient::WiFiClient(int fd)
+    : _socket(std::make_shared<Socket>(fd))
+{
+}
+
+WiFiClient::~WiFiClient() {
+}
+
+int WiFiClient::fd() const {
+    return _socket ? _socket->fd : -1;
+}
+
+int WiFiClient::connect(const char* host, uint16_t port) {
+    return connect(host, port, WIFI_CLIENT_CONNECT_TIMEOUT_MS);
+}
+
+int WiFiClient::connect(const char* host, uint16_t port, int32_t timeoutMs) {
+    stop();
+
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo* result = nullptr;
+    char portText[8];
+    snprintf(portText, sizeof(portText), "%u", port);
+    if (getaddrinfo(host, portText, &hints, &result) != 0 || !result) {
+        return 0;
+    }
+
+    int fd = socket(result->ai_family, result->ai_socktype, result->ai_protocol);
+    if (fd < 0) {
+        freeaddrinfo(result);
+        return 0;
+    }
+
+    // Non-blocking connect so the timeout applies, then back to blocking
+    int flags = fcntl(fd, F_GETFL, 0);
+    fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+    int rc = ::connect(fd, result->ai_addr, result->ai_addrlen);
+    freeaddrinfo(result);
+    if (rc < 0 && errno == EINPROGRESS) {
+        struct pollfd pfd = { fd, POLLOUT, 0 };
+        int error = 0;
+        socklen_t len = sizeof(error);
+        if (poll(&pfd, 1, timeoutMs) == 1 && getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &len) == 0 &&
+            error == 0) {
+            rc = 0;
+        }
+    }
+    if (rc < 0) {
+        close(fd);
+        return 0;
+    }
+    fcntl(fd, F_SETFL, flags);
+
+    _socket = std::make_shared<Socket>(fd);
+    return 1;
+}
+
+void WiFiClient::stop() {
+    _socket.reset();
+}
+
+uint8_t WiFiClient::connected() {
+    int s = fd();
+    if (s < 0) {
+        return 0;
+    }
+    uint8_t c;
+    ssize_t n = recv(s, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+    if (n > 0) {
+        return 1;
+    }
+    if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+        stop();
+        return 0;
+    }
+    return 1;
+}
+
+size_t WiFiClient::write(uint8_t c) {
+    return write(&c, 1);
+}
+
+size_t WiFiClient::write(const uint8_t* buffer, size_t size) {
+    int s = fd();
+    if (s < 0) {
+        return 0;
+    }
+    size_t sent = 0;
+    while (sent < size) {
+        ssize_t n = send(s, buffer + sent, size - sent, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            stop();
+            break;
+        }
+        sent += (size_t)n;
+    }
+    return sent;
+}
+
+int WiFiClient::available() {
+    int s = fd();
+    if (s < 0) {
+        return 0;
+    }
+    int pending = 0;
+    if (ioctl(s, FIONREAD, &pending) < 0) {
+        return 0;
+    }
+    return pending;
+}
+
+int WiFiClient::read() {
+    uint8_t c;
+    return read(&c, 1) == 1 ? c : -1;
+}
+
+int WiFiClient::read(uint8_t* buffer, size_t size) {
+    int s = fd();
+    if (s < 0) {
+        return -1;
+    }
+    ssize_t n = recv(s, buffer, size, MSG_DONTWAIT);
+    if (n > 0) {
+        return (int)n;
+    }
+    if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+        stop();
+    }
+    return -1;
+}
+
+int WiFiClient::peek() {
+    int s = fd();
+    uint8_t c;
+    return s >= 0 && recv(s, &c, 1, MSG_PEEK | MSG_DONTWAIT) == 1 ? c : -1;
+}
+
+int WiFiClient::setNoDelay(bool noDelay) {
+    int value = noDelay ? 1 : 0;
+    return fd() >= 0 ? setsockopt(fd(), IPPROTO_TCP, TCP_NODELAY, &value, sizeof(value)) : -1;
+}
+
+// ============================================================================
+// WiFiServer
+// ============================================================================
+
+WiFiServer::WiFiServer(uint16_t port, uint8_t maxClients)
+    : _fd(-1)
+    , _port(port)
+    , _maxClients(maxClients)
+    , _noDelay(false)
+{
+}
+
+WiFiServer::~WiFiServer() {
+    end();
+}
+
+void WiFiServer::begin(uint16_t port) {
+    if (_fd >= 0) {
+        return;
+    }
+    if (port) {
+        _port = port;
+    }
+
+    _fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (_fd < 0) {
+        return;
+    }
+    int one = 1;
+    setsockopt(_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(_port);
+    if (bind(_fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(_fd, _maxClients) < 0) {
+        Serial.printf("WiFiServer: Cannot listen on port %u (%s)\n", _port, strerror(errno));
+        close(_fd);
+        _fd = -1;
+    }
+}
+
+void WiFiServer::end() {
+    if (_fd >= 0) {
+        close(_fd);
+        _fd = -1;
+    }
+}
+
+WiFiClient WiFiServer::available() {
+    if (_fd < 0) {
+        return WiFiClient();
+    }
+    int fd = ::accept(_fd, nullptr, nullptr);
+    if (fd < 0) {
+        return WiFiClient();
+    }
+    WiFiClient client(fd);
+    client.setNoDelay(_noDelay);
+    return client;
+}
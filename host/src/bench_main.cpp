@@ -0,0 +1,69 @@
+#include <Arduino.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <config.h>
+#include <PipelineBenchmarks.h>
+
+// Entry point for the host microbenchmarks (lib/Bench): the same benchmarks
+// the device serves on GET /bench, on the host HAL, as Google Benchmark JSON.
+// Firmware logging goes to stderr so stdout carries only the JSON.
+//
+// Usage:
+//   camera_bench [--benchmark_filter=SUBSTRING] [--benchmark_min_time=SECONDS]
+//                [--benchmark_out=FILE]
+//
+// Compare two runs with Google Benchmark's tools/compare.py:
+//   compare.py benchmarks base.json new.json
+
+class FilePrint : public Print {
+public:
+    explicit FilePrint(FILE* file) : _file(file) {}
+
+    size_t write(uint8_t c) override { return fputc(c, _file) == EOF ? 0 : 1; }
+    size_t write(const uint8_t* buffer, size_t size) override { return fwrite(buffer, 1, size, _file); }
+    using Print::write;
+
+private:
+    FILE* _file;
+};
+
+int main(int argc, char** argv) {
+    const char* filter = nullptr;
+    double minSeconds = BENCH_MIN_TIME_MS / 1000.0;
+    const char* outPath = nullptr;
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--benchmark_filter=", 19) == 0) filter = argv[i] + 19;
+        else if (strncmp(argv[i], "--benchmark_min_time=", 21) == 0) minSeconds = atof(argv[i] + 21);
+        else if (strncmp(argv[i], "--benchmark_out=", 16) == 0) outPath = argv[i] + 16;
+        else {
+            fprintf(stderr, "Usage: %s [--benchmark_filter=SUBSTRING] [--benchmark_min_time=SECONDS]\n"
+                            "       [--benchmark_out=FILE]\n",
+                    argv[0]);
+            return 2;
+        }
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    FILE* out = outPath ? fopen(outPath, "w") : fdopen(dup(STDOUT_FILENO), "w");
+    if (!out) {
+        fprintf(stderr, "Cannot write %s\n", outPath ? outPath : "stdout");
+        return 1;
+    }
+    dup2(STDERR_FILENO, STDOUT_FILENO);
+
+    FilePrint print(out);
+    BenchRunner runner(print, filter, (uint32_t)(minSeconds * 1000));
+    runner.begin(argv[0]);
+    PipelineBenchmarks::run(runner);
+    uint32_t count = runner.end();
+    fclose(out);
+
+    if (count == 0) {
+        fprintf(stderr, "No benchmarks match \"%s\"\n", filter ? filter : "");
+        return 1;
+    }
+    return 0;
+}
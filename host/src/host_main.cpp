@@ -0,0 +1,66 @@
+#include <Arduino.h>
+#include <Logger.h>
+#include <signal.h>
+#include <unistd.h>
+#include <atomic>
+
+// Entry point for the native build: does what the Arduino-ESP32 core does
+// (setup() then loop() forever on a "loopTask" pinned to core 1) and leaves
+// the rest of src/main.cpp untouched.
+//
+// Environment:
+//   NVS_<NAMESPACE>_<KEY>   Stored credentials (see Preferences.h); defaults
+//                           provision WiFi and rtmp://127.0.0.1:1935/live/test
+//   HOST_RUN_SECONDS        Exit after this long (default: run until Ctrl-C)
+//   HOST_CAPTURE_TRACE      Capture trace to replay (frames and audio)
+//   HOST_CAPTURE_TRACE_SPEED Replay speed (default 1, 0 = as fast as consumed)
+//   HOST_CAMERA_DIR         Directory of *.jpg frames instead of the pattern
+//   HOST_CAMERA_SENSOR_FPS  Sensor frame rate (default 60)
+//   HOST_AUDIO_FILE         Raw s16le mono PCM instead of the test tone
+//   HOST_WIFI_RSSI          Reported RSSI in dBm (default -55)
+
+void setup();
+void loop();
+
+static std::atomic<bool> stopRequested(false);
+
+static void onSignal(int) {
+    stopRequested.store(true);
+}
+
+static void loopTask(void*) {
+    setup();
+    for (;;) {
+        loop();
+    }
+}
+
+int main() {
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+    setvbuf(stdout, nullptr, _IOLBF, 0);
+
+    // Provisioned by default so setup() goes straight to WiFi and RTMP
+    setenv("NVS_WIFI_SSID", "host", 0);
+    setenv("NVS_WIFI_PASSWORD", "host", 0);
+    setenv("NVS_RTMP_URL", "rtmp://127.0.0.1:1935/live", 0);
+    setenv("NVS_RTMP_KEY", "test", 0);
+
+    const char* runSeconds = getenv("HOST_RUN_SECONDS");
+    uint32_t runMillis = runSeconds ? (uint32_t)(atof(runSeconds) * 1000) : 0;
+
+    xTaskCreatePinnedToCore(loopTask, "loopTask", 8192, nullptr, 1, nullptr, 1);
+
+    uint32_t start = millis();
+    while (!stopRequested.load() && (runMillis == 0 || millis() - start < runMillis)) {
+        delay(50);
+    }
+
+    // The firmware's tasks never return, so leave without running destructors
+    // under their feet
+    logger.flush();
+    Serial.printf("\nHost: Stopping after %.1f s\n", (millis() - start) / 1000.0);
+    fflush(stdout);
+    _exit(0);
+}
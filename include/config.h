@@ -3,20 +3,109 @@
 
 // Application Configuration
 
+// PSRAM budget (8 MB on the XIAO ESP32-S3 Sense). At the defaults below:
+//   STREAM_BUFFER_BYTES              3 MB   allocated at boot
+//   RECORDER_BUFFER_BYTES          1.5 MB   allocated at boot
+//   CAPTURE_TRACE_BUFFER_BYTES       1 MB   on the first "capture", kept
+//   RTMP_MIRROR_BUFFER_BYTES            0   per further destination
+//   FramePool copies              ~300 KB   at most FRAME_POOL_SIZE frames
+//   send queues, TLS records       240 KB   RTMP_SEND_QUEUE_BYTES + 16 KB per destination
+//   trace rings                    192 KB   TRACE_BUFFER_EVENTS x 24 bytes x 2 cores
+//   audio blocks                    70 KB   AUDIO_QUEUE_BLOCKS + 9 per destination, 2 KB each
+//   log ring                        40 KB   LOG_BUFFER_ENTRIES x ~160 bytes
+//   camera frame buffers            30 KB   CAMERA_FB_COUNT at QVGA
+// That is about 6.4 MB; the rest is for WiFi, lwIP and mbedTLS (large
+// mallocs go to PSRAM) and the 288 KB /bench borrows while it runs. Grow
+// one buffer only by shrinking another.
+
 // Camera Configuration
 #define CAMERA_FRAME_SIZE   FRAMESIZE_QVGA  // 320x240 for performance
 #define CAMERA_JPEG_QUALITY 12               // 0-63, lower means higher quality
 #define CAMERA_FB_COUNT     2                // Frame buffer count (double buffering)
+#define CAMERA_TARGET_FPS   30               // Capture rate (paced on absolute deadlines)
+
+// Rate control (adapts JPEG quality per frame so sizes track a byte budget)
+#define CAMERA_RATE_CONTROL_ENABLED true
+#define CAMERA_TARGET_FRAME_BYTES   8000     // ~1.9 Mbps at 30 FPS
+#define CAMERA_QUALITY_MIN          10       // Best quality the controller may choose
+#define CAMERA_QUALITY_MAX          40       // Worst quality the controller may choose
+#define CAMERA_RATE_CONTROL_TRACE   false    // Print "RC,<quality>,<bytes>" per frame for tools/rate_control_sim
+
+// On-Screen Display (camera name + timestamp burned into each JPEG)
+#define OSD_ENABLED         true
+#define OSD_POSITION_X      0                // Top-left corner, snapped to the MCU grid
+#define OSD_POSITION_Y      0
+#define OSD_SCALE           1                // Glyph scale: 1 for QVGA, 2 for VGA and up
+#define OSD_NTP_SERVER      "pool.ntp.org"
+#define OSD_TIMEZONE        "UTC0"           // POSIX TZ string
+
+// Latency probe (stamps sequence and capture time into each JPEG for tools/latency_probe)
+#define LATENCY_PROBE_ENABLED false          // Costs one extra frame copy per frame
+
+// Capture trace (raw frames + PCM recorded to PSRAM for replay on the host;
+// "capture" on serial starts it, GET /capture on the metrics port fetches it)
+#define CAPTURE_TRACE_ENABLED       true
+#define CAPTURE_TRACE_BUFFER_BYTES  (1024 * 1024)   // ~4 s of 8 KB frames at 30 FPS plus audio
 
 // Audio Configuration
 #define AUDIO_SAMPLE_RATE   16000            // 16kHz for voice
 #define AUDIO_BUFFER_SIZE   1024             // Samples per buffer
 #define AUDIO_CHANNELS      1                // Mono
 
+// Audio Feature Extraction (MFCC front end for sound event detection)
+#define AUDIO_MFCC_ENABLED      true
+#define AUDIO_MFCC_NUM_MEL      40           // Mel filterbank bands
+#define AUDIO_MFCC_NUM_COEFFS   13           // Cepstral coefficients per 10 ms frame
+
 // RTMP Configuration
 #define RTMP_CONNECT_TIMEOUT_MS  5000
-#define RTMP_KEEPALIVE_INTERVAL_MS 30000
-#define RTMP_MAX_RECONNECT_ATTEMPTS 5
+#define RTMP_KEEPALIVE_INTERVAL_MS 30000     // Acknowledgement sent when nothing else has been
+#define RTMP_MAX_RECONNECT_ATTEMPTS 5      // Backoff doubles this many times, then holds (retries never stop)
+#define RTMP_RECONNECT_BASE_MS   1000       // First retry after a drop, before jitter
+#define RTMP_CHUNK_SIZE          4096       // Announced with Set Chunk Size after the handshake
+#define RTMP_SOCKET_SNDBUF       32768      // SO_SNDBUF (Linux doubles it; lwIP keeps its own)
+#define RTMP_SEND_QUEUE_BYTES    65536      // Unsent bytes held for a slow link (0: writes block)
+#define RTMP_SEND_TIMEOUT_MS     2000       // A write that cannot be queued gives up after this
+#define RTMP_INTERLEAVE_BYTES    4096       // Unsent video an audio message may have to wait behind (plus one chunk)
+#define RTMP_INTERLEAVE_POLL_MS  5          // How often a destination feeds the link while a frame is going out
+#define RTMP_AGGREGATE_ENABLED   false      // Batch audio and data messages into Aggregate messages (type 22)
+#define RTMP_AGGREGATE_MAX_BYTES 8192       // Largest batch, sub-message tags included
+#define RTMP_AGGREGATE_MAX_MS    200        // Longest the first message in a batch waits
+#define RTMP_TLS_VERIFY_PEER     true       // rtmps://: check the server certificate (off for a self-signed stand-in)
+#define RTMP_AUDIO_ENABLED       true       // Stream the microphone (16-bit PCM)
+#define AUDIO_QUEUE_BLOCKS       8          // Audio blocks in flight to the stream task (64 ms each)
+
+// Store-and-forward: A/V held in PSRAM while the stream is down, sent late
+#define STREAM_BUFFER_BYTES      (3 * 1024 * 1024)  // ~11 s at 8 KB frames plus audio; 0 disables
+#define STREAM_BUFFER_CATCHUP_SPEED 2.0f    // Backlog goes out at up to this multiple of real time (0: unlimited)
+
+// Fan-out: the stream also goes to every further destination stored in NVS
+// (rtmp/url1 + key1, url2 + key2, ...), each with its own connection
+#define RTMP_MAX_DESTINATIONS    3          // Including the provisioned one
+#define RTMP_MIRROR_BUFFER_BYTES 0          // Store-and-forward for each further destination (0: none)
+#define RTMP_DESTINATION_AUDIO_BLOCKS 8     // Audio blocks a destination may fall behind before it drops them
+#define AV_MUX_WINDOW_MS         100        // Longest a message waits to go out in timestamp order (> one audio block)
+#define AV_MUX_DROP_LATE         false      // A message behind one already sent: drop it, or send it clamped
+
+// RTP output for on-site monitoring (RFC 2435 JPEG and L16 audio over UDP)
+// to the host:port stored in NVS (rtp/target) or RTP_DEFAULT_TARGET
+#define RTP_ENABLED              true       // Sends only once a target is set
+#define RTP_DEFAULT_TARGET       ""         // e.g. "192.168.1.20:5004": video there, audio 2 ports up
+#define RTP_PACKET_BYTES         1400       // Largest UDP payload (stays under a 1500-byte MTU)
+#define RTP_FEC_GROUP            0          // Video packets per XOR FEC packet (2-16; 0: no FEC)
+#define RTP_RTCP_INTERVAL_MS     1000       // Sender reports (timestamp to wall-clock mapping)
+
+// Local recording (FLV files with pre-roll; "record" on serial starts one)
+#define RECORDER_ENABLED         true
+#define RECORDER_STORAGE_SD      1          // XIAO Sense microSD slot (its CS is the LED pin)
+#define RECORDER_STORAGE_LITTLEFS 2         // The flash "spiffs" partition (~1.5 MB)
+#define RECORDER_STORAGE         RECORDER_STORAGE_SD
+#define RECORDER_BUFFER_BYTES    (1536 * 1024)  // Pre-roll plus slack for storage stalls (PSRAM)
+#define RECORDER_PRE_ROLL_MS     4000       // Kept before a trigger
+#define RECORDER_POST_ROLL_MS    10000      // Recording runs until this long after the last trigger
+#define RECORDER_BLOCK_BYTES     16384      // Storage write size (internal RAM; a multiple of 512)
+#define RECORDER_POLL_MS         50         // Writer task wake interval
+#define RECORDER_SD_FREQ_HZ      20000000
 
 // WiFi Configuration
 #define WIFI_CONNECT_TIMEOUT_MS 10000
@@ -29,6 +118,7 @@
 // NVS Namespaces
 #define NVS_NAMESPACE_WIFI  "wifi"
 #define NVS_NAMESPACE_RTMP  "rtmp"
+#define NVS_NAMESPACE_RTP   "rtp"
 
 // FreeRTOS Task Configuration
 #define TASK_CAMERA_STACK_SIZE    8192
@@ -47,8 +137,33 @@
 #define TASK_WIFI_PRIORITY        2
 #define TASK_WIFI_CORE            0          // Protocol CPU
 
-// Debug Configuration
+#define TASK_DESTINATION_STACK_SIZE 8192     // One per RTMP destination
+#define TASK_DESTINATION_PRIORITY 3
+#define TASK_DESTINATION_CORE     0          // Protocol CPU
+
+#define TASK_RECORDER_STACK_SIZE  4096
+#define TASK_RECORDER_PRIORITY    1          // Storage latency must not hold up the pipeline
+#define TASK_RECORDER_CORE        0
+
+#define TASK_LOG_STACK_SIZE       4096
+#define TASK_LOG_PRIORITY         1          // Below every pipeline task
+#define TASK_LOG_CORE             0
+
+// Debug Configuration (LOG_E/W/I/D in lib/Logger; lines above the level compile out)
 #define DEBUG_SERIAL_ENABLED  true
 #define DEBUG_LOG_LEVEL       3              // 0=None, 1=Error, 2=Warn, 3=Info, 4=Debug
+#define LOG_BUFFER_ENTRIES    256            // Deferred log records, ~160 bytes each (PSRAM)
+
+// Tracing (per-stage latency; send "trace" on serial for Chrome trace JSON)
+#define TRACE_ENABLED         true           // false compiles every trace point out
+#define TRACE_BUFFER_EVENTS   4096           // Per core, 24 bytes each (PSRAM)
+
+// Metrics (Prometheus text on http://<ip>:METRICS_PORT/metrics, trace JSON on /trace)
+#define METRICS_ENABLED       true
+#define METRICS_PORT          9100
+
+// Microbenchmarks (Google Benchmark JSON on http://<ip>:METRICS_PORT/bench)
+#define BENCH_ENABLED         true
+#define BENCH_MIN_TIME_MS     500            // Shortest timed run per benchmark
 
 #endif // CONFIG_H
@@ -31,6 +31,13 @@
 // Status LED
 #define LED_PIN             21
 
+// microSD slot on the Sense board (SPI). CS is the LED pin, so the LED is
+// left alone while the recorder uses the card.
+#define SD_PIN_CS           21
+#define SD_PIN_SCK          7
+#define SD_PIN_MISO         8
+#define SD_PIN_MOSI         9
+
 // I2S Configuration
 #define I2S_MIC_PORT        I2S_NUM_0
 #define I2S_MIC_SAMPLE_RATE 16000
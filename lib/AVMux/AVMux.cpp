@@ -0,0 +1,125 @@
+#include "AVMux.h"
+
+static bool before(uint32_t a, uint32_t b) {
+    return (int32_t)(a - b) < 0;
+}
+
+AVMux::AVMux()
+    : _count(0)
+    , _waiting{ 0, 0 }
+    , _lastArrival{ 0, 0 }
+    , _seen{ false, false }
+    , _windowMs(0)
+    , _policy(LatePolicy::CLAMP)
+    , _released(false)
+    , _lastReleased(0)
+    , _late(0)
+    , _evicted(0)
+    , _reordered(0)
+    , _maxDepth(0)
+{
+}
+
+MuxPush AVMux::push(const MuxMessage& message, uint32_t nowMs, uint8_t& depth, MuxMessage& evicted) {
+    depth = 0;
+    MuxMessage entry = message;
+    entry.arrivalMs = nowMs;
+
+    uint8_t type = slot(entry.type);
+    _seen[type] = true;
+    _lastArrival[type] = nowMs;
+
+    if (_released && before(entry.timestamp, _lastReleased)) {
+        _late++;
+        if (_policy == LatePolicy::DROP) {
+            return MuxPush::LATE;
+        }
+        entry.timestamp = _lastReleased;
+    }
+
+    // pop() lets the oldest go when full, but the caller may be holding it
+    // back: then the oldest of all, this one included, makes room
+    MuxPush result = MuxPush::QUEUED;
+    if (_count == AV_MUX_MAX_MESSAGES) {
+        _evicted++;
+        if (before(entry.timestamp, _messages[0].timestamp)) {
+            evicted = entry;
+            return MuxPush::FULL;
+        }
+        evicted = _messages[0];
+        _waiting[slot(evicted.type)]--;
+        _count--;
+        for (uint8_t i = 0; i < _count; i++) {
+            _messages[i] = _messages[i + 1];
+        }
+        result = MuxPush::FULL;
+    }
+
+    // After everything with the same or an earlier timestamp
+    uint8_t at = _count;
+    while (at > 0 && before(entry.timestamp, _messages[at - 1].timestamp)) {
+        _messages[at] = _messages[at - 1];
+        at--;
+    }
+    _messages[at] = entry;
+    _count++;
+    _waiting[type]++;
+
+    depth = _count - 1 - at;
+    if (depth > 0) {
+        _reordered++;
+        if (depth > _maxDepth) {
+            _maxDepth = depth;
+        }
+    }
+    return result;
+}
+
+// Nothing of the other type can still arrive with an earlier timestamp:
+// it has a later message waiting, or it is not flowing at all
+bool AVMux::otherCaughtUp(uint8_t type, uint32_t nowMs) const {
+    uint8_t other = type ^ 1;
+    return _waiting[other] > 0 || !_seen[other] || nowMs - _lastArrival[other] > _windowMs;
+}
+
+bool AVMux::due(uint32_t nowMs) const {
+    if (_count == 0) {
+        return false;
+    }
+    const MuxMessage& oldest = _messages[0];
+    return _count == AV_MUX_MAX_MESSAGES || nowMs - oldest.arrivalMs >= _windowMs ||
+           otherCaughtUp(slot(oldest.type), nowMs);
+}
+
+bool AVMux::peek(uint32_t nowMs, MuxMessage& message) const {
+    if (!due(nowMs)) {
+        return false;
+    }
+    message = _messages[0];
+    return true;
+}
+
+bool AVMux::pop(uint32_t nowMs, MuxMessage& message) {
+    if (!due(nowMs)) {
+        return false;
+    }
+
+    message = _messages[0];
+    uint8_t type = slot(message.type);
+    _count--;
+    for (uint8_t i = 0; i < _count; i++) {
+        _messages[i] = _messages[i + 1];
+    }
+    _waiting[type]--;
+    _released = true;
+    _lastReleased = message.timestamp;
+    return true;
+}
+
+uint32_t AVMux::nextDueMs(uint32_t nowMs) const {
+    if (_count == 0) {
+        return UINT32_MAX;
+    }
+    uint32_t waited = nowMs - _messages[0].arrivalMs;
+    return waited >= _windowMs ? 0 : _windowMs - waited;
+}
@@ -0,0 +1,107 @@
+#ifndef AV_MUX_H
+#define AV_MUX_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <StreamBuffer.h>
+
+// Puts audio and video messages back in timestamp order before they are
+// sent.
+//
+// The two streams are captured by separate tasks and reach a destination
+// by separate paths, and an audio block is only posted once all of it has
+// been recorded, so it arrives well after a frame with a later timestamp.
+// Ingests expect timestamps that never go backwards across the two, so
+// messages wait here, sorted by timestamp, and the oldest is let go when
+//   - the other stream has caught up with it (something of the other type
+//     is waiting behind it), or has been idle for a window (audio off), or
+//   - it has waited the window, or
+//   - the mux is full.
+// Each stream is assumed to arrive in its own order; only the interleaving
+// is fixed. A message older than one already let go is late, and is either
+// dropped or sent with the timestamp of the last one (setLatePolicy()).
+//
+// The caller may hold back a message that is due (a destination keeps audio
+// behind a frame still going out). If the mux fills meanwhile, push() makes
+// room by handing back the oldest message, which is not sent.
+//
+// The mux only orders: payloads stay where they are and owner is handed
+// back with each message, for the caller to send and release. Only one
+// task may use it.
+
+#define AV_MUX_MAX_MESSAGES     16
+
+enum class LatePolicy {
+    DROP,       // Leave it out
+    CLAMP       // Send it with the timestamp of the last message let go
+};
+
+enum class MuxPush {
+    QUEUED,     // Waiting to go out
+    LATE,       // Late and dropped (LatePolicy::DROP): the caller keeps it
+    FULL        // Queued, but the oldest message had to leave unsent: evicted
+};
+
+struct MuxMessage {
+    uint8_t type;               // STREAM_MESSAGE_AUDIO or STREAM_MESSAGE_VIDEO
+    uint32_t timestamp;         // Stream milliseconds
+    const uint8_t* data;
+    size_t length;
+    void* owner;                // Whatever keeps data alive
+    uint32_t arrivalMs;         // Set by push()
+};
+
+class AVMux {
+public:
+    AVMux();
+
+    // Longest a message waits for the other stream (0: no reordering, late
+    // messages are still caught)
+    void setWindow(uint32_t windowMs) { _windowMs = windowMs; }
+    void setLatePolicy(LatePolicy policy) { _policy = policy; }
+
+    // Take a message (see MuxPush). On FULL, evicted is the message dropped
+    // to make room, the oldest (which may be this one), for the caller to
+    // release. depth is how many waiting messages it went ahead of.
+    MuxPush push(const MuxMessage& message, uint32_t nowMs, uint8_t& depth, MuxMessage& evicted);
+
+    // Oldest message, once it may go (see above); peek() leaves it in
+    bool peek(uint32_t nowMs, MuxMessage& message) const;
+    bool pop(uint32_t nowMs, MuxMessage& message);
+
+    // Milliseconds until pop() lets the oldest message go on time alone
+    // (0 when it already may, UINT32_MAX when empty)
+    uint32_t nextDueMs(uint32_t nowMs) const;
+
+    bool isEmpty() const { return _count == 0; }
+    uint8_t getCount() const { return _count; }
+
+    // Statistics
+    uint32_t getLate() const { return _late; }
+    uint32_t getEvicted() const { return _evicted; }
+    uint32_t getReordered() const { return _reordered; }
+    uint8_t getMaxDepth() const { return _maxDepth; }
+
+private:
+    MuxMessage _messages[AV_MUX_MAX_MESSAGES];     // Sorted by timestamp
+    uint8_t _count;
+    uint8_t _waiting[2];        // Messages held per type (audio, video)
+    uint32_t _lastArrival[2];   // millis() of the last push per type
+    bool _seen[2];
+
+    uint32_t _windowMs;
+    LatePolicy _policy;
+    bool _released;             // Something has gone out
+    uint32_t _lastReleased;     // Its timestamp
+
+    uint32_t _late;
+    uint32_t _evicted;
+    uint32_t _reordered;
+    uint8_t _maxDepth;
+
+    static uint8_t slot(uint8_t type) { return type == STREAM_MESSAGE_VIDEO ? 1 : 0; }
+    bool otherCaughtUp(uint8_t type, uint32_t nowMs) const;
+    bool due(uint32_t nowMs) const;
+};
+
+#endif // AV_MUX_H
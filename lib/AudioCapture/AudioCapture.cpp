@@ -1,5 +1,6 @@
 #include <Arduino.h>
 #include "AudioCapture.h"
+#include <Logger.h>
 #include "../../include/pins.h"
 
 AudioCapture::AudioCapture()
@@ -36,22 +37,22 @@ bool AudioCapture::configureI2S() {
 }
 
 bool AudioCapture::begin() {
-    Serial.println("Audio: Initializing PDM microphone...");
+    LOG_I("Audio: Initializing PDM microphone...");
     
     if (!configureI2S()) {
-        Serial.println("Audio: I2S config failed");
+        LOG_E("Audio: I2S config failed");
         return false;
     }
     
     esp_err_t err = i2s_driver_install(I2S_MIC_PORT, &_i2sConfig, 0, NULL);
     if (err != ESP_OK) {
-        Serial.printf("Audio: Driver install failed (0x%x)\n", err);
+        LOG_E("Audio: Driver install failed (0x%x)", err);
         return false;
     }
     
     err = i2s_set_pin(I2S_MIC_PORT, &_pinConfig);
     if (err != ESP_OK) {
-        Serial.println("Audio: Pin config failed");
+        LOG_E("Audio: Pin config failed");
         i2s_driver_uninstall(I2S_MIC_PORT);
         return false;
     }
@@ -59,13 +60,13 @@ bool AudioCapture::begin() {
     // Clear DMA buffers
     i2s_zero_dma_buffer(I2S_MIC_PORT);
     
-    Serial.printf("Audio: Initialized at %d Hz\n", _sampleRate);
+    LOG_I("Audio: Initialized at %d Hz", _sampleRate);
     return true;
 }
 
 void AudioCapture::end() {
     i2s_driver_uninstall(I2S_MIC_PORT);
-    Serial.println("Audio: Deinitialized");
+    LOG_I("Audio: Deinitialized");
 }
 
 size_t AudioCapture::read(int16_t* buffer, size_t samples) {
@@ -78,22 +79,25 @@ size_t AudioCapture::read(int16_t* buffer, size_t samples) {
                              &bytesRead, portMAX_DELAY);
     
     if (err != ESP_OK) {
-        Serial.printf("Audio: Read error (0x%x)\n", err);
+        LOG_E("Audio: Read error (0x%x)", err);
         return 0;
     }
     
     // Apply software gain
     if (_gain != 1.0f) {
-        size_t samplesRead = bytesRead / sizeof(int16_t);
-        for (size_t i = 0; i < samplesRead; i++) {
-            int32_t sample = buffer[i] * _gain;
-            buffer[i] = constrain(sample, INT16_MIN, INT16_MAX);
-        }
+        applyGain(buffer, bytesRead / sizeof(int16_t), _gain);
     }
     
     return bytesRead / sizeof(int16_t);
 }
 
+void AudioCapture::applyGain(int16_t* samples, size_t count, float gain) {
+    for (size_t i = 0; i < count; i++) {
+        int32_t sample = samples[i] * gain;
+        samples[i] = constrain(sample, INT16_MIN, INT16_MAX);
+    }
+}
+
 bool AudioCapture::available() {
     size_t bytesAvailable = 0;
     esp_err_t err = i2s_read(I2S_MIC_PORT, nullptr, 0, &bytesAvailable, 0);
@@ -37,6 +37,9 @@ public:
     void setGain(float gain) { _gain = constrain(gain, 0.0f, 4.0f); }
     float getGain() { return _gain; }
     
+    // Scale samples in place by gain, saturating at the int16 range
+    static void applyGain(int16_t* samples, size_t count, float gain);
+    
 private:
     i2s_config_t _i2sConfig;
     i2s_pin_config_t _pinConfig;
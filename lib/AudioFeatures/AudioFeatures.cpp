@@ -0,0 +1,369 @@
+#include <Arduino.h>
+#include <math.h>
+#include "AudioFeatures.h"
+#include <Logger.h>
+
+#define MFCC_FFT_POINTS     (MFCC_FFT_SIZE / 2)     // Complex points in the packed FFT
+#define MFCC_PREEMPHASIS    31785                   // 0.97 in Q15
+#define MFCC_FFT_INPUT_BITS 21                      // Block peak below 2^21: no overflow in 256 points
+#define MFCC_Q30            (1 << 30)
+#define MFCC_LN2_Q15        22713                   // ln(2) in Q15
+#define MFCC_MEL_LOW_HZ     20.0f
+#define MFCC_MEL_HIGH_HZ    (AUDIO_SAMPLE_RATE / 2.0f)
+
+static inline int16_t saturate16(int32_t v) {
+    return v > INT16_MAX ? INT16_MAX : (v < INT16_MIN ? INT16_MIN : (int16_t)v);
+}
+
+static inline int32_t q30(double v) {
+    return (int32_t)llround(v * MFCC_Q30);
+}
+
+static inline float hzToMel(float hz) {
+    return 2595.0f * log10f(1.0f + hz / 700.0f);
+}
+
+static inline float melToHz(float mel) {
+    return 700.0f * (powf(10.0f, mel / 2595.0f) - 1.0f);
+}
+
+AudioFeatures::AudioFeatures()
+    : _pending(0),
+      _filled(0),
+      _lastSample(0),
+      _quantMultiplier(16384),
+      _quantZeroPoint(0),
+      _frameCount(0),
+      _lastHopMicros(0),
+      _maxHopMicros(0),
+      _totalHopMicros(0) {
+}
+
+bool AudioFeatures::begin() {
+    // Periodic Hann window
+    for (int n = 0; n < MFCC_FRAME_LENGTH; n++) {
+        float w = 0.5f - 0.5f * cosf(2.0f * (float)M_PI * n / MFCC_FRAME_LENGTH);
+        _window[n] = saturate16(lroundf(w * 32767.0f));
+    }
+
+    // Radix-2 twiddles for the 256-point complex FFT: W = cos - j sin
+    for (int k = 0; k < MFCC_FFT_POINTS / 2; k++) {
+        double a = 2.0 * M_PI * k / MFCC_FFT_POINTS;
+        _twiddle[2 * k] = q30(cos(a));
+        _twiddle[2 * k + 1] = q30(-sin(a));
+    }
+
+    // Twiddles for the real-FFT split step (512-point)
+    for (int k = 0; k < MFCC_NUM_BINS; k++) {
+        double a = M_PI * k / MFCC_FFT_POINTS;
+        _splitCos[k] = q30(cos(a));
+        _splitSin[k] = q30(sin(a));
+    }
+
+    // log2(1 + i/256) in Q16
+    for (int i = 0; i <= 256; i++) {
+        _log2Table[i] = (uint16_t)lroundf(log2f(1.0f + i / 256.0f) * 65535.0f);
+    }
+
+    buildMelFilterbank();
+
+    // Orthonormal DCT-II
+    for (int i = 0; i < AUDIO_MFCC_NUM_COEFFS; i++) {
+        float scale = sqrtf((i == 0 ? 1.0f : 2.0f) / AUDIO_MFCC_NUM_MEL);
+        for (int m = 0; m < AUDIO_MFCC_NUM_MEL; m++) {
+            float c = cosf((float)M_PI * i * (m + 0.5f) / AUDIO_MFCC_NUM_MEL);
+            _dct[i][m] = saturate16(lroundf(c * scale * 32767.0f));
+        }
+    }
+
+    reset();
+
+    LOG_I("AudioFeatures: %d mel bands, %d coeffs, %u bytes (%u scratch)",
+          AUDIO_MFCC_NUM_MEL, AUDIO_MFCC_NUM_COEFFS,
+          (unsigned)getTotalBytes(), (unsigned)getScratchBytes());
+    return true;
+}
+
+void AudioFeatures::reset() {
+    memset(_frame, 0, sizeof(_frame));
+    memset(_lastFrame, 0, sizeof(_lastFrame));
+    _pending = 0;
+    _filled = 0;
+    _lastSample = 0;
+}
+
+void AudioFeatures::onFrame(std::function<void(const int8_t*, size_t)> callback) {
+    _onFrameCallback = callback;
+}
+
+void AudioFeatures::setQuantization(float scale, int32_t zeroPoint) {
+    if (scale <= 0.0f) {
+        return;
+    }
+    // q = c_Q10 / (1024 * scale) + zp, applied as a Q24 multiply
+    _quantMultiplier = (int32_t)lroundf(16384.0f / scale);
+    _quantZeroPoint = zeroPoint;
+}
+
+float AudioFeatures::getAverageHopMicros() const {
+    return _frameCount ? (float)_totalHopMicros / _frameCount : 0.0f;
+}
+
+size_t AudioFeatures::getScratchBytes() {
+    return MFCC_FRAME_LENGTH * sizeof(int32_t)      // _frame
+         + MFCC_FFT_SIZE * sizeof(int32_t)          // _fft
+         + MFCC_NUM_BINS * sizeof(uint64_t)         // _power
+         + AUDIO_MFCC_NUM_MEL * sizeof(int32_t)     // _logMel
+         + AUDIO_MFCC_NUM_COEFFS * sizeof(int8_t);  // _lastFrame
+}
+
+size_t AudioFeatures::process(const int16_t* samples, size_t count) {
+    if (!samples) {
+        return 0;
+    }
+
+    size_t produced = 0;
+    while (count > 0) {
+        size_t take = min(count, (size_t)(MFCC_HOP_LENGTH - _pending));
+
+        // Append pre-emphasised samples to the ring (_filled is the write
+        // index), exactly: |x * 2^15 - 0.97 x'| stays below 2^31
+        for (size_t i = 0; i < take; i++) {
+            int16_t x = samples[i];
+            _frame[_filled] = (int32_t)x * 32768 - MFCC_PREEMPHASIS * (int32_t)_lastSample;
+            _lastSample = x;
+            if (++_filled == MFCC_FRAME_LENGTH) {
+                _filled = 0;
+            }
+        }
+
+        samples += take;
+        count -= take;
+        _pending += take;
+
+        if (_pending == MFCC_HOP_LENGTH) {
+            _pending = 0;
+            computeFrame();
+            produced++;
+        }
+    }
+
+    return produced;
+}
+
+void AudioFeatures::computeFrame() {
+    uint32_t start = micros();
+
+    int exponent = normaliseWindowed();
+    fft256();
+    int powerShift = powerSpectrum();
+    melLog(exponent, powerShift);
+    dctQuantise();
+
+    uint32_t elapsed = micros() - start;
+    _lastHopMicros = elapsed;
+    _totalHopMicros += elapsed;
+    if (elapsed > _maxHopMicros) {
+        _maxHopMicros = elapsed;
+    }
+    _frameCount++;
+
+    if (_onFrameCallback) {
+        _onFrameCallback(_lastFrame, AUDIO_MFCC_NUM_COEFFS);
+    }
+}
+
+// Window the last 400 samples into the FFT buffer (zero-padded to 512) and
+// scale the block so its peak sits just below 2^21, which the unscaled
+// 256-point FFT and the split can grow without overflowing. The packed real
+// input z[n] = x[2n] + j x[2n+1] is exactly the linear sample order.
+// Returns the applied left shift (negative for a right shift) of the Q30
+// windowed samples so the log stage can undo it.
+int AudioFeatures::normaliseWindowed() {
+    const size_t oldest = _filled;
+    const size_t firstRun = MFCC_FRAME_LENGTH - oldest;
+    uint32_t peak = 0;
+
+    // The Q30 products need 47 bits; only their top 31 are needed to find
+    // the peak, and the FFT input is taken from them in a second pass
+    for (size_t n = 0; n < firstRun; n++) {
+        int32_t v = (int32_t)(((int64_t)_frame[oldest + n] * _window[n]) >> 16);
+        peak |= (uint32_t)(v < 0 ? -v : v);
+    }
+    for (size_t n = firstRun; n < MFCC_FRAME_LENGTH; n++) {
+        int32_t v = (int32_t)(((int64_t)_frame[n - firstRun] * _window[n]) >> 16);
+        peak |= (uint32_t)(v < 0 ? -v : v);
+    }
+    memset(&_fft[MFCC_FRAME_LENGTH], 0, (MFCC_FFT_SIZE - MFCC_FRAME_LENGTH) * sizeof(int32_t));
+
+    // peak is an OR of magnitudes: its top bit bounds the true maximum
+    const int peakBits = (peak ? 32 - __builtin_clz(peak) : 0) + 16;
+    const int shift = MFCC_FFT_INPUT_BITS - peakBits;
+    const int down = -shift;
+    const int64_t half = down > 0 ? (int64_t)1 << (down - 1) : 0;
+    for (size_t n = 0; n < MFCC_FRAME_LENGTH; n++) {
+        size_t i = n < firstRun ? oldest + n : n - firstRun;
+        int64_t v = (int64_t)_frame[i] * _window[n];
+        _fft[n] = (int32_t)(down > 0 ? (v + half) >> down : v * ((int64_t)1 << shift));
+    }
+    return shift;
+}
+
+// In-place 256-point complex FFT, unscaled (the input leaves 8 bits of growth)
+void AudioFeatures::fft256() {
+    int32_t* x = _fft;
+
+    // Bit-reversal permutation
+    for (int i = 1, j = 0; i < MFCC_FFT_POINTS; i++) {
+        int bit = MFCC_FFT_POINTS >> 1;
+        for (; j & bit; bit >>= 1) {
+            j ^= bit;
+        }
+        j ^= bit;
+        if (i < j) {
+            int32_t tr = x[2 * i], ti = x[2 * i + 1];
+            x[2 * i] = x[2 * j];
+            x[2 * i + 1] = x[2 * j + 1];
+            x[2 * j] = tr;
+            x[2 * j + 1] = ti;
+        }
+    }
+
+    for (int len = 2; len <= MFCC_FFT_POINTS; len <<= 1) {
+        const int half = len >> 1;
+        const int step = MFCC_FFT_POINTS / len;
+        for (int i = 0; i < MFCC_FFT_POINTS; i += len) {
+            for (int j = 0; j < half; j++) {
+                const int32_t wr = _twiddle[2 * j * step];
+                const int32_t wi = _twiddle[2 * j * step + 1];
+                int32_t* a = &x[2 * (i + j)];
+                int32_t* b = &x[2 * (i + j + half)];
+                int32_t tr = (int32_t)(((int64_t)b[0] * wr - (int64_t)b[1] * wi + (1 << 29)) >> 30);
+                int32_t ti = (int32_t)(((int64_t)b[0] * wi + (int64_t)b[1] * wr + (1 << 29)) >> 30);
+                int32_t ar = a[0], ai = a[1];
+                a[0] = ar + tr;
+                a[1] = ai + ti;
+                b[0] = ar - tr;
+                b[1] = ai - ti;
+            }
+        }
+    }
+}
+
+// Recover the 512-point real spectrum from the packed 256-point result and
+// square it: X[k] = E[k] + W512^k * (-j) * O[k], computed here as 2 X[k] so
+// nothing is halved away. Returns the right shift the mel stage must apply
+// to the powers to keep its 64-bit sums from overflowing.
+int AudioFeatures::powerSpectrum() {
+    const int32_t* z = _fft;
+    uint64_t maxPower = 0;
+
+    for (int k = 0; k < MFCC_NUM_BINS; k++) {
+        const int a = k & (MFCC_FFT_POINTS - 1);
+        const int b = (MFCC_FFT_POINTS - k) & (MFCC_FFT_POINTS - 1);
+        const int64_t ar = z[2 * a], ai = z[2 * a + 1];
+        const int64_t br = z[2 * b], bi = z[2 * b + 1];
+
+        const int64_t er = ar + br;
+        const int64_t ei = ai - bi;
+        const int64_t or_ = ar - br;
+        const int64_t oi = ai + bi;
+
+        const int64_t c = _splitCos[k];
+        const int64_t s = _splitSin[k];
+        const int64_t xr = er + ((c * oi - s * or_ + (1 << 29)) >> 30);
+        const int64_t xi = ei - ((c * or_ + s * oi + (1 << 29)) >> 30);
+
+        // |2 X| < 2^30.7 for a 2^21 peak, so the sum of squares fits 63 bits
+        _power[k] = (uint64_t)(xr * xr) + (uint64_t)(xi * xi);
+        maxPower |= _power[k];
+    }
+
+    // Q15 weights over at most 64 bins add 21 bits
+    const int bits = maxPower ? 64 - __builtin_clzll(maxPower) : 0;
+    return bits + 21 > 64 ? bits + 21 - 64 : 0;
+}
+
+// Mel energies and natural log in Q10. The Q30 samples, normalising shift,
+// doubled spectrum and Q15 weights scale the energy by
+// 2^(60 + 2*exponent + 2 + 15 - powerShift) relative to the raw int16
+// signal; that offset is removed in the log domain.
+void AudioFeatures::melLog(int exponent, int powerShift) {
+    const int32_t offsetQ10 = (77 + 2 * exponent - powerShift) * 1024;
+
+    for (int m = 0; m < AUDIO_MFCC_NUM_MEL; m++) {
+        const MelBand& band = _bands[m];
+        const uint64_t* p = &_power[band.firstBin];
+        const uint16_t* w = &_melWeights[band.weightOffset];
+
+        uint64_t acc = 0;
+        for (int i = 0; i < band.numBins; i++) {
+            acc += (p[i] >> powerShift) * w[i];
+        }
+
+        int32_t log2Energy = log2Q10(acc + 1) - offsetQ10;
+        _logMel[m] = (int32_t)(((int64_t)log2Energy * MFCC_LN2_Q15) >> 15);
+    }
+}
+
+void AudioFeatures::dctQuantise() {
+    for (int i = 0; i < AUDIO_MFCC_NUM_COEFFS; i++) {
+        int64_t acc = 0;
+        for (int m = 0; m < AUDIO_MFCC_NUM_MEL; m++) {
+            acc += (int64_t)_logMel[m] * _dct[i][m];
+        }
+        int32_t cepstrum = (int32_t)(acc >> 15);   // Q10
+
+        int32_t q = (int32_t)(((int64_t)cepstrum * _quantMultiplier + (1 << 23)) >> 24) + _quantZeroPoint;
+        _lastFrame[i] = (int8_t)(q > 127 ? 127 : (q < -128 ? -128 : q));
+    }
+}
+
+int32_t AudioFeatures::log2Q10(uint64_t value) const {
+    const int e = 63 - __builtin_clzll(value);
+    uint32_t mantissa = e >= 16 ? (uint32_t)(value >> (e - 16)) : (uint32_t)(value << (16 - e));
+    uint32_t frac = mantissa - 65536;           // 16 fractional bits
+    uint32_t idx = frac >> 8;
+    uint32_t rem = frac & 0xFF;
+    uint32_t t = _log2Table[idx] + (((_log2Table[idx + 1] - _log2Table[idx]) * rem) >> 8);
+    return e * 1024 + (int32_t)(t >> 6);
+}
+
+// Triangular filters equally spaced on the mel scale, evaluated at the exact
+// bin frequencies so that narrow low-frequency bands still get energy
+void AudioFeatures::buildMelFilterbank() {
+    const float binHz = (float)AUDIO_SAMPLE_RATE / MFCC_FFT_SIZE;
+    const float melLow = hzToMel(MFCC_MEL_LOW_HZ);
+    const float melHigh = hzToMel(MFCC_MEL_HIGH_HZ);
+    const float melStep = (melHigh - melLow) / (AUDIO_MFCC_NUM_MEL + 1);
+
+    uint16_t offset = 0;
+    for (int m = 0; m < AUDIO_MFCC_NUM_MEL; m++) {
+        float lo = melToHz(melLow + m * melStep);
+        float center = melToHz(melLow + (m + 1) * melStep);
+        float hi = melToHz(melLow + (m + 2) * melStep);
+
+        int first = (int)ceilf(lo / binHz);
+        int last = min((int)floorf(hi / binHz), MFCC_NUM_BINS - 1);
+
+        MelBand& band = _bands[m];
+        band.firstBin = (uint16_t)first;
+        band.weightOffset = offset;
+        band.numBins = 0;
+
+        for (int k = first; k <= last; k++) {
+            float f = k * binHz;
+            float w = f <= center ? (f - lo) / (center - lo) : (hi - f) / (hi - center);
+            _melWeights[offset + band.numBins++] = (uint16_t)lroundf(max(w, 0.0f) * 32767.0f);
+        }
+
+        // Band narrower than a bin: fall back to the nearest bin
+        if (band.numBins == 0) {
+            band.firstBin = (uint16_t)min((int)lroundf(center / binHz), MFCC_NUM_BINS - 1);
+            _melWeights[offset] = 32767;
+            band.numBins = 1;
+        }
+
+        offset += band.numBins;
+    }
+}
@@ -0,0 +1,113 @@
+#ifndef AUDIO_FEATURES_H
+#define AUDIO_FEATURES_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <functional>
+#include "../../include/config.h"
+
+// Streaming MFCC front end for on-device sound event detection.
+//
+// Consumes 16 kHz mono PCM blocks of any length (as delivered by audioTask)
+// and emits one int8 MFCC frame per 10 ms hop:
+//
+//   pre-emphasis -> Hann window (25 ms) -> block-normalised 32-bit real FFT
+//   (512) -> power spectrum -> mel filterbank -> log -> DCT-II -> int8
+//
+// Everything on the per-hop path is integer arithmetic on fixed-size member
+// buffers; begin() builds the tables once and nothing is allocated afterwards.
+// The FFT is 32-bit with Q30 twiddles; against a double-precision MFCC of the
+// same definition every coefficient is within one int8 step
+// (test_audio_features). BM_Mfcc times one hop.
+
+#define MFCC_FRAME_LENGTH   400     // 25 ms @ 16 kHz
+#define MFCC_HOP_LENGTH     160     // 10 ms @ 16 kHz
+#define MFCC_FFT_SIZE       512
+#define MFCC_NUM_BINS       (MFCC_FFT_SIZE / 2 + 1)
+
+class AudioFeatures {
+public:
+    AudioFeatures();
+
+    // Build window, twiddle, filterbank and DCT tables
+    bool begin();
+
+    // Clear streaming state (e.g. after an audio dropout)
+    void reset();
+
+    // Feed PCM samples; invokes the frame callback once per completed hop
+    // and returns the number of frames produced
+    size_t process(const int16_t* samples, size_t count);
+
+    // Callback receives AUDIO_MFCC_NUM_COEFFS int8 coefficients per frame
+    void onFrame(std::function<void(const int8_t* mfcc, size_t count)> callback);
+
+    // Map Q10 cepstral values to the classifier's int8 input tensor
+    // (real = scale * (q - zeroPoint))
+    void setQuantization(float scale, int32_t zeroPoint);
+
+    // Most recent frame (valid once getFrameCount() > 0)
+    const int8_t* getLastFrame() const { return _lastFrame; }
+    uint32_t getFrameCount() const { return _frameCount; }
+
+    // Timing statistics for the per-hop computation
+    uint32_t getLastHopMicros() const { return _lastHopMicros; }
+    uint32_t getMaxHopMicros() const { return _maxHopMicros; }
+    float getAverageHopMicros() const;
+
+    // Bytes of working buffers touched on every hop, and total footprint
+    // including the constant tables built by begin()
+    static size_t getScratchBytes();
+    static size_t getTotalBytes() { return sizeof(AudioFeatures); }
+
+private:
+    struct MelBand {
+        uint16_t firstBin;
+        uint16_t numBins;
+        uint16_t weightOffset;
+    };
+
+    // Streaming state
+    int32_t _frame[MFCC_FRAME_LENGTH];          // Pre-emphasised, Q15
+    size_t _pending;            // Samples received since the last hop
+    size_t _filled;             // Valid samples in _frame (until warm)
+    int16_t _lastSample;        // Pre-emphasis memory
+
+    // Per-hop scratch
+    alignas(16) int32_t _fft[MFCC_FFT_SIZE];        // 256 interleaved complex values
+    uint64_t _power[MFCC_NUM_BINS];
+    int32_t _logMel[AUDIO_MFCC_NUM_MEL];
+    int8_t _lastFrame[AUDIO_MFCC_NUM_COEFFS];
+
+    // Constant tables (Q15 unless noted)
+    int16_t _window[MFCC_FRAME_LENGTH];
+    int32_t _twiddle[MFCC_FFT_SIZE / 2];            // 128 complex: cos, -sin (N=256), Q30
+    int32_t _splitCos[MFCC_NUM_BINS];               // cos(pi k / 256), Q30
+    int32_t _splitSin[MFCC_NUM_BINS];               // sin(pi k / 256), Q30
+    MelBand _bands[AUDIO_MFCC_NUM_MEL];
+    uint16_t _melWeights[2 * MFCC_NUM_BINS];
+    int16_t _dct[AUDIO_MFCC_NUM_COEFFS][AUDIO_MFCC_NUM_MEL];
+    uint16_t _log2Table[257];                       // log2(1 + i/256), Q16
+
+    int32_t _quantMultiplier;   // Q24 multiplier from Q10 cepstrum to int8 steps
+    int32_t _quantZeroPoint;
+
+    uint32_t _frameCount;
+    uint32_t _lastHopMicros;
+    uint32_t _maxHopMicros;
+    uint64_t _totalHopMicros;
+
+    std::function<void(const int8_t*, size_t)> _onFrameCallback;
+
+    void computeFrame();
+    int normaliseWindowed();
+    void fft256();
+    int powerSpectrum();
+    void melLog(int exponent, int powerShift);
+    void dctQuantise();
+
+    int32_t log2Q10(uint64_t value) const;
+    void buildMelFilterbank();
+};
+
+#endif // AUDIO_FEATURES_H
@@ -1,14 +1,15 @@
 #include "BLEProvisioning.h"
 #include "../../include/config.h"
+#include <Logger.h>
 
 // Server callbacks
 class BLEProvisioning::ServerCallbacks : public NimBLEServerCallbacks {
     void onConnect(NimBLEServer* pServer) {
-        Serial.println("BLE: Client connected");
+        LOG_I("BLE: Client connected");
     }
     
     void onDisconnect(NimBLEServer* pServer) {
-        Serial.println("BLE: Client disconnected");
+        LOG_I("BLE: Client disconnected");
         // Restart advertising
         pServer->startAdvertising();
     }
@@ -23,15 +24,15 @@ public:
         std::string uuid = pCharacteristic->getUUID().toString();
         std::string value = pCharacteristic->getValue();
         
-        Serial.printf("BLE: Received data for UUID: %s\n", uuid.c_str());
+        LOG_D("BLE: Received data for UUID: %s", uuid.c_str());
         
         if (uuid == WIFI_SSID_UUID) {
             _wifiSSID = String(value.c_str());
-            Serial.printf("BLE: WiFi SSID set: %s\n", _wifiSSID.c_str());
+            LOG_I("BLE: WiFi SSID set: %s", _wifiSSID.c_str());
         }
         else if (uuid == WIFI_PASS_UUID) {
             _wifiPass = String(value.c_str());
-            Serial.println("BLE: WiFi password set");
+            LOG_I("BLE: WiFi password set");
             
             // Save WiFi credentials when password is received
             if (_wifiSSID.length() > 0) {
@@ -41,11 +42,11 @@ public:
         }
         else if (uuid == RTMP_URL_UUID) {
             _rtmpURL = String(value.c_str());
-            Serial.printf("BLE: RTMP URL set: %s\n", _rtmpURL.c_str());
+            LOG_I("BLE: RTMP URL set: %s", _rtmpURL.c_str());
         }
         else if (uuid == RTMP_KEY_UUID) {
             _rtmpKey = String(value.c_str());
-            Serial.println("BLE: RTMP key set");
+            LOG_I("BLE: RTMP key set");
             
             // Save RTMP credentials when key is received
             if (_rtmpURL.length() > 0) {
@@ -81,7 +82,7 @@ BLEProvisioning::~BLEProvisioning() {
 }
 
 bool BLEProvisioning::begin(const char* deviceName) {
-    Serial.println("BLE: Initializing provisioning service...");
+    LOG_I("BLE: Initializing provisioning service...");
     
     // Check if already provisioned
     _provisioned = hasStoredCredentials();
@@ -138,7 +139,7 @@ bool BLEProvisioning::begin(const char* deviceName) {
     
     NimBLEDevice::startAdvertising();
     
-    Serial.printf("BLE: Advertising as '%s'\n", deviceName);
+    LOG_I("BLE: Advertising as '%s'", deviceName);
     updateStatus(_provisioned ? "already_provisioned" : "awaiting_config");
     
     return true;
@@ -149,7 +150,7 @@ void BLEProvisioning::end() {
         NimBLEDevice::deinit(true);
         _pServer = nullptr;
         _pService = nullptr;
-        Serial.println("BLE: Service stopped");
+        LOG_I("BLE: Service stopped");
     }
 }
 
@@ -179,12 +180,32 @@ bool BLEProvisioning::loadWiFiCredentials(String& ssid, String& password) {
     return false;
 }
 
-bool BLEProvisioning::loadRTMPCredentials(String& url, String& streamKey) {
+bool BLEProvisioning::loadRTMPCredentials(String& url, String& streamKey, uint8_t index) {
+    char urlKey[8] = "url";
+    char keyKey[8] = "key";
+    if (index > 0) {
+        snprintf(urlKey, sizeof(urlKey), "url%u", index);
+        snprintf(keyKey, sizeof(keyKey), "key%u", index);
+    }
+    
     _prefs.begin(NVS_NAMESPACE_RTMP, true);
     
-    if (_prefs.isKey("url") && _prefs.isKey("key")) {
-        url = _prefs.getString("url", "");
-        streamKey = _prefs.getString("key", "");
+    if (_prefs.isKey(urlKey) && _prefs.isKey(keyKey)) {
+        url = _prefs.getString(urlKey, "");
+        streamKey = _prefs.getString(keyKey, "");
+        _prefs.end();
+        return true;
+    }
+    
+    _prefs.end();
+    return false;
+}
+
+bool BLEProvisioning::loadRTPTarget(String& target) {
+    _prefs.begin(NVS_NAMESPACE_RTP, true);
+    
+    if (_prefs.isKey("target")) {
+        target = _prefs.getString("target", "");
         _prefs.end();
         return true;
     }
@@ -198,7 +219,7 @@ void BLEProvisioning::saveWiFiCredentials(const String& ssid, const String& pass
     _prefs.putString("ssid", ssid);
     _prefs.putString("password", password);
     _prefs.end();
-    Serial.println("BLE: WiFi credentials saved to NVS");
+    LOG_I("BLE: WiFi credentials saved to NVS");
 }
 
 void BLEProvisioning::saveRTMPCredentials(const String& url, const String& streamKey) {
@@ -206,7 +227,7 @@ void BLEProvisioning::saveRTMPCredentials(const String& url, const String& strea
     _prefs.putString("url", url);
     _prefs.putString("key", streamKey);
     _prefs.end();
-    Serial.println("BLE: RTMP credentials saved to NVS");
+    LOG_I("BLE: RTMP credentials saved to NVS");
 }
 
 void BLEProvisioning::clearCredentials() {
@@ -218,8 +239,12 @@ void BLEProvisioning::clearCredentials() {
     _prefs.clear();
     _prefs.end();
     
+    _prefs.begin(NVS_NAMESPACE_RTP, false);
+    _prefs.clear();
+    _prefs.end();
+    
     _provisioned = false;
-    Serial.println("BLE: All credentials cleared");
+    LOG_I("BLE: All credentials cleared");
 }
 
 void BLEProvisioning::updateStatus(const char* status) {
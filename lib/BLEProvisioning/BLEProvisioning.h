@@ -29,7 +29,12 @@ public:
     
     // Load stored credentials
     bool loadWiFiCredentials(String& ssid, String& password);
-    bool loadRTMPCredentials(String& url, String& streamKey);
+    // Destination 0 is the provisioned one; further destinations (url1/key1,
+    // url2/key2, ...) are only ever written to NVS directly
+    bool loadRTMPCredentials(String& url, String& streamKey, uint8_t index = 0);
+    // RTP monitoring target (rtp/target, "host:port"), also only written
+    // to NVS directly
+    bool loadRTPTarget(String& target);
     
     // Clear stored credentials (for reset)
     void clearCredentials();
@@ -0,0 +1,169 @@
+#include "Bench.h"
+#include <esp_timer.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_MAX_ITERATIONS    1000000000UL
+
+BenchState::BenchState(int64_t arg, uint32_t iterations)
+    : _arg(arg)
+    , _iterations(iterations)
+    , _remaining(iterations)
+    , _bytesPerIteration(0)
+    , _itemsPerIteration(0)
+    , _skipMessage(nullptr)
+    , _startMicros(0)
+    , _startCycles(0)
+    , _elapsedMicros(0)
+    , _elapsedCycles(0)
+    , _running(false)
+{
+}
+
+void BenchState::start() {
+    _running = true;
+    _startMicros = esp_timer_get_time();
+    _startCycles = ESP.getCycleCount();
+}
+
+void BenchState::stop() {
+    if (!_running) {
+        return;
+    }
+    uint32_t cycles = ESP.getCycleCount();
+    _elapsedMicros = esp_timer_get_time() - _startMicros;
+    _elapsedCycles = cycles - _startCycles;
+    _running = false;
+}
+
+BenchRunner::BenchRunner(Print& out, const char* filter, uint32_t minMillis)
+    : _out(out)
+    , _filter(filter && filter[0] ? filter : nullptr)
+    , _minMicros(minMillis * 1000)
+    , _count(0)
+    , _family(0)
+    , _lastName(nullptr)
+    , _familyInstance(0)
+{
+}
+
+void BenchRunner::begin(const char* executable) {
+    char date[32] = "";
+    time_t now = time(nullptr);
+    if (now > 1600000000) {     // Unset clocks start at 1970
+        struct tm utc;
+        gmtime_r(&now, &utc);
+        strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S+00:00", &utc);
+    }
+
+    _out.printf("{\n"
+                "  \"context\": {\n"
+                "    \"date\": \"%s\",\n"
+                "    \"executable\": \"%s\",\n"
+                "    \"num_cpus\": 2,\n"
+                "    \"mhz_per_cpu\": %u,\n"
+                "    \"cpu_scaling_enabled\": false,\n"
+                "    \"sdk_version\": \"%s\",\n"
+                "    \"library_build_type\": \"release\"\n"
+                "  },\n"
+                "  \"benchmarks\": [",
+                date, executable, (unsigned)ESP.getCpuFreqMHz(), ESP.getSdkVersion());
+}
+
+void BenchRunner::run(const char* name, BenchFunction function, int64_t arg) {
+    char fullName[64];
+    if (arg >= 0) {
+        snprintf(fullName, sizeof(fullName), "%s/%lld", name, (long long)arg);
+    } else {
+        snprintf(fullName, sizeof(fullName), "%s", name);
+    }
+    if (_filter && !strstr(fullName, _filter)) {
+        return;
+    }
+
+    if (!_lastName || strcmp(_lastName, name) != 0) {
+        if (_lastName) {
+            _family++;
+        }
+        _lastName = name;
+        _familyInstance = 0;
+    }
+
+    // Grow the iteration count until one run lasts the minimum time (as
+    // Google Benchmark does: aim 40% past it, at most 10x per step)
+    uint32_t iterations = 1;
+    const char* skipped = nullptr;
+    BenchState result(arg, 0);
+    for (;;) {
+        BenchState state(arg, iterations);
+        function(state);
+        if (state._skipMessage) {
+            skipped = state._skipMessage;
+            break;
+        }
+        result = state;
+        if (state._elapsedMicros >= (int64_t)_minMicros || iterations >= BENCH_MAX_ITERATIONS) {
+            break;
+        }
+        double multiplier = 10.0;
+        if (state._elapsedMicros > (int64_t)_minMicros / 10) {
+            multiplier = 1.4 * _minMicros / state._elapsedMicros;
+        }
+        double next = iterations * multiplier;
+        iterations = next >= BENCH_MAX_ITERATIONS ? BENCH_MAX_ITERATIONS
+                     : (next > iterations + 1 ? (uint32_t)next : iterations + 1);
+    }
+
+    _out.printf("%s\n    {\n"
+                "      \"name\": \"%s\",\n"
+                "      \"family_index\": %u,\n"
+                "      \"per_family_instance_index\": %u,\n"
+                "      \"run_name\": \"%s\",\n"
+                "      \"run_type\": \"iteration\",\n"
+                "      \"repetitions\": 1,\n"
+                "      \"repetition_index\": 0,\n"
+                "      \"threads\": 1,\n",
+                _count ? "," : "", fullName, _family, _familyInstance, fullName);
+    _familyInstance++;
+    _count++;
+
+    if (skipped) {
+        _out.printf("      \"error_occurred\": true,\n"
+                    "      \"error_message\": \"%s\",\n"
+                    "      \"iterations\": 0,\n"
+                    "      \"real_time\": 0,\n"
+                    "      \"cpu_time\": 0,\n"
+                    "      \"time_unit\": \"ns\"\n"
+                    "    }",
+                    skipped);
+        return;
+    }
+
+    double seconds = result._elapsedMicros / 1e6;
+    double nanos = result._elapsedMicros * 1000.0 / result._iterations;
+    // CCOUNT wraps every 2^32 cycles (~18 s at 240 MHz); derive from time past that
+    double cycles = result._elapsedMicros < 16000000
+                    ? (double)result._elapsedCycles
+                    : (double)result._elapsedMicros * ESP.getCpuFreqMHz();
+    _out.printf("      \"iterations\": %u,\n"
+                "      \"real_time\": %.3f,\n"
+                "      \"cpu_time\": %.3f,\n"
+                "      \"time_unit\": \"ns\",\n",
+                result._iterations, nanos, nanos);
+    if (result._bytesPerIteration && seconds > 0) {
+        _out.printf("      \"bytes_per_second\": %.1f,\n",
+                    result._bytesPerIteration * (double)result._iterations / seconds);
+    }
+    if (result._itemsPerIteration && seconds > 0) {
+        _out.printf("      \"items_per_second\": %.1f,\n",
+                    result._itemsPerIteration * (double)result._iterations / seconds);
+    }
+    _out.printf("      \"cycles\": %.1f\n"
+                "    }",
+                cycles / result._iterations);
+}
+
+uint32_t BenchRunner::end() {
+    _out.printf("\n  ]\n}\n");
+    return _count;
+}
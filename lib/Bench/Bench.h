@@ -0,0 +1,109 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <Arduino.h>
+#include <stdint.h>
+#include <stddef.h>
+
+// Microbenchmark harness that runs unchanged on the device and the host and
+// writes Google Benchmark's JSON format, so results from either can be kept
+// per release and diffed with benchmark's tools/compare.py.
+//
+// A benchmark is a function that loops while keepRunning() and does one
+// operation per iteration. The runner grows the iteration count until a run
+// lasts at least the minimum time, then reports that run: wall time per
+// iteration from esp_timer and CCOUNT cycles per iteration as a "cycles"
+// counter. There is no per-task CPU clock on the device, so cpu_time is the
+// wall time as well.
+//
+//   void benchFoo(BenchState& state) {
+//       while (state.keepRunning()) {
+//           foo(state.getArg());
+//       }
+//       state.setBytesPerIteration(state.getArg());
+//   }
+//
+//   BenchRunner runner(Serial, nullptr, 500);
+//   runner.begin("firmware");
+//   runner.run("BM_Foo", benchFoo, 1024);     // Reported as "BM_Foo/1024"
+//   runner.end();
+
+class BenchState {
+public:
+    BenchState(int64_t arg, uint32_t iterations);
+
+    // True once per iteration; the clock runs from the first call to the last
+    inline bool keepRunning() {
+        if (_remaining > 0) {
+            if (_remaining-- == _iterations) {
+                start();
+            }
+            return true;
+        }
+        stop();
+        return false;
+    }
+
+    int64_t getArg() const { return _arg; }
+
+    // Report throughput as bytes_per_second / items_per_second
+    void setBytesPerIteration(uint64_t bytes) { _bytesPerIteration = bytes; }
+    void setItemsPerIteration(uint64_t items) { _itemsPerIteration = items; }
+
+    // Mark the benchmark as not runnable here (reported as an error, not a
+    // result); return without looping after calling it
+    void skip(const char* message) { _skipMessage = message; }
+
+private:
+    friend class BenchRunner;
+
+    int64_t _arg;
+    uint32_t _iterations;
+    uint32_t _remaining;
+    uint64_t _bytesPerIteration;
+    uint64_t _itemsPerIteration;
+    const char* _skipMessage;
+
+    int64_t _startMicros;
+    uint32_t _startCycles;
+    int64_t _elapsedMicros;
+    uint32_t _elapsedCycles;
+    bool _running;
+
+    void start();
+    void stop();
+};
+
+typedef void (*BenchFunction)(BenchState& state);
+
+// Keep the compiler from discarding a result the benchmark does not use
+template <typename T>
+inline void benchDoNotOptimize(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+class BenchRunner {
+public:
+    // filter: run only benchmarks whose name contains it (nullptr for all)
+    BenchRunner(Print& out, const char* filter, uint32_t minMillis);
+
+    // Write the context object; executable names the build
+    void begin(const char* executable);
+
+    // Run one benchmark; arg < 0 means none (and no "/arg" in the name)
+    void run(const char* name, BenchFunction function, int64_t arg = -1);
+
+    // Close the JSON. Returns the number of benchmarks run.
+    uint32_t end();
+
+private:
+    Print& _out;
+    const char* _filter;
+    uint32_t _minMicros;
+    uint32_t _count;
+    uint32_t _family;
+    const char* _lastName;
+    uint32_t _familyInstance;
+};
+
+#endif // BENCH_H
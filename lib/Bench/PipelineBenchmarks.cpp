@@ -0,0 +1,375 @@
+#include "PipelineBenchmarks.h"
+#include "../../include/config.h"
+#include <WiFi.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <atomic>
+#include <math.h>
+#include <unistd.h>
+#include <AudioCapture.h>
+#include <AudioFeatures.h>
+#include <FlvRecorder.h>
+#include <FrameMailbox.h>
+#include <JpegOverlay.h>
+#include <RTMPClient.h>
+#include <SharedFrame.h>
+#include <StreamBuffer.h>
+#include <SyntheticJpeg.h>
+#include <vector>
+
+#define BENCH_SINK_PORT         19350
+#define BENCH_PAYLOAD_BYTES     32768
+#define BENCH_SINK_IDLE_POLLS   1000
+#define BENCH_RECORDER_RING     (256 * 1024)
+#define BENCH_OVERLAY_FRAMES    8
+
+// Stands in for the RTMP server: connects a transport over loopback to a
+// peer that a task reads and discards
+class BenchSink {
+public:
+    BenchSink() : _server(BENCH_SINK_PORT), _transport(nullptr), _draining(false), _drained(false) {}
+
+    bool open(RTMPTransport* transport) {
+        _server.begin();
+        if (!transport->connect("127.0.0.1", BENCH_SINK_PORT, 1000)) {
+            return false;
+        }
+        _transport = transport;
+        uint32_t start = millis();
+        while (!(_peer = _server.available())) {
+            if (millis() - start > 1000) {
+                _transport->close();
+                return false;
+            }
+            delay(1);
+        }
+        _draining.store(true);
+        xTaskCreatePinnedToCore(drainTask, "benchSink", 4096, this, 1, NULL, 0);
+        return true;
+    }
+
+    void close() {
+        if (_draining.exchange(false)) {
+            while (!_drained.load()) {
+                delay(1);
+            }
+        }
+        _transport->close();
+        _peer.stop();
+        _server.end();
+    }
+
+private:
+    WiFiServer _server;
+    RTMPTransport* _transport;
+    WiFiClient _peer;
+    std::atomic<bool> _draining;
+    std::atomic<bool> _drained;
+
+    static void drainTask(void* param) {
+        BenchSink* sink = (BenchSink*)param;
+        // A tick's nap lets a small send buffer fill, and then the
+        // benchmarks would time the sink; so it only naps once the sender
+        // has gone quiet
+        uint8_t buffer[1460];
+        uint32_t idle = 0;
+        while (sink->_draining.load()) {
+            if (sink->_peer.read(buffer, sizeof(buffer)) > 0) {
+                idle = 0;
+            } else if (++idle < BENCH_SINK_IDLE_POLLS) {
+                taskYIELD();
+            } else {
+                vTaskDelay(1);
+            }
+        }
+        sink->_drained.store(true);
+        vTaskDelete(NULL);
+    }
+};
+
+static BenchSink* sink = nullptr;
+static RTMPClient* rtmp = nullptr;     // Writes to the sink when there is one
+static uint8_t* payload = nullptr;
+
+static bool haveSink(BenchState& state) {
+    if (!sink) {
+        state.skip("no loopback connection for the RTMP benchmarks");
+        return false;
+    }
+    return true;
+}
+
+void PipelineBenchmarks::run(BenchRunner& runner) {
+    payload = (uint8_t*)ps_malloc(BENCH_PAYLOAD_BYTES);
+    if (!payload) {
+        return;
+    }
+    // Entropy-coded data looks random; the framing does not care
+    uint32_t seed = 1;
+    for (size_t i = 0; i < BENCH_PAYLOAD_BYTES; i++) {
+        seed = seed * 1103515245 + 12345;
+        payload[i] = (uint8_t)(seed >> 16);
+    }
+
+    // Streaming framing, but writes that wait instead of queueing so every
+    // iteration sends all of its bytes
+    rtmp = new RTMPClient();
+    rtmp->_chunkSize = RTMP_CHUNK_SIZE;
+    rtmp->_transport->setQueueCapacity(0);
+    sink = new BenchSink();
+    if (!sink->open(rtmp->_transport)) {
+        delete sink;
+        sink = nullptr;
+    }
+
+    runner.run("BM_RtmpChunkHeader", rtmpChunkHeader);
+    runner.run("BM_RtmpSendChunk", rtmpSendChunk, 128);
+    runner.run("BM_RtmpSendChunk", rtmpSendChunk, CAMERA_TARGET_FRAME_BYTES);
+    runner.run("BM_RtmpSendChunk", rtmpSendChunk, BENCH_PAYLOAD_BYTES);
+    runner.run("BM_Amf0Number", amf0Number);
+    runner.run("BM_Amf0String", amf0String);
+    runner.run("BM_Amf0ConnectCommand", amf0ConnectCommand);
+    runner.run("BM_AudioGain", audioGain, AUDIO_BUFFER_SIZE);
+    runner.run("BM_Mfcc", mfcc);
+    runner.run("BM_FrameHandoff", frameHandoff);
+    runner.run("BM_FlvVideoTag", flvVideoTag, CAMERA_TARGET_FRAME_BYTES);
+    runner.run("BM_FlvAudioTag", flvAudioTag, AUDIO_BUFFER_SIZE * sizeof(int16_t));
+    runner.run("BM_RecorderWrite", recorderWrite, CAMERA_TARGET_FRAME_BYTES);
+    runner.run("BM_RecorderWrite", recorderWrite, BENCH_PAYLOAD_BYTES);
+    runner.run("BM_JpegOverlay", jpegOverlay, 320);
+    runner.run("BM_JpegOverlay", jpegOverlay, 640);
+
+    if (sink) {
+        sink->close();
+        delete sink;
+        sink = nullptr;
+    }
+    delete rtmp;
+    rtmp = nullptr;
+    free(payload);
+    payload = nullptr;
+}
+
+void PipelineBenchmarks::rtmpChunkHeader(BenchState& state) {
+    uint8_t header[RTMP_CHUNK_HEADER_BYTES];
+    uint32_t timestamp = 0;
+    while (state.keepRunning()) {
+        rtmp->encodeChunkHeader(header, 6, timestamp++, CAMERA_TARGET_FRAME_BYTES, 0x09, 1);
+        benchDoNotOptimize(header);
+    }
+    state.setBytesPerIteration(12);
+}
+
+void PipelineBenchmarks::rtmpSendChunk(BenchState& state) {
+    if (!haveSink(state)) {
+        return;
+    }
+    size_t len = (size_t)state.getArg();
+    uint32_t timestamp = 0;
+    while (state.keepRunning()) {
+        rtmp->sendChunk(6, timestamp++, 0x09, payload, len);
+    }
+    state.setBytesPerIteration(len);
+}
+
+void PipelineBenchmarks::amf0Number(BenchState& state) {
+    uint8_t packet[16];
+    double value = 0.0;
+    while (state.keepRunning()) {
+        int pos = 0;
+        rtmp->writeAMFNumber(packet, pos, value);
+        value += 1.0;
+        benchDoNotOptimize(packet);
+    }
+}
+
+void PipelineBenchmarks::amf0String(BenchState& state) {
+    uint8_t packet[32];
+    String text("createStream");
+    while (state.keepRunning()) {
+        int pos = 0;
+        rtmp->writeAMFString(packet, pos, text);
+        benchDoNotOptimize(packet);
+    }
+}
+
+// The body sendConnect() builds, including its String temporaries
+void PipelineBenchmarks::amf0ConnectCommand(BenchState& state) {
+    String host("a.rtmp.youtube.com");
+    String app("live2");
+    uint8_t packet[1024];
+    while (state.keepRunning()) {
+        int pos = 0;
+        rtmp->writeAMFString(packet, pos, "connect");
+        rtmp->writeAMFNumber(packet, pos, 1.0);
+        rtmp->writeAMFObject(packet, pos);
+        rtmp->writeAMFPropertyString(packet, pos, "app", app);
+        rtmp->writeAMFPropertyString(packet, pos, "type", "nonprivate");
+        rtmp->writeAMFPropertyString(packet, pos, "flashVer", "FMLE/3.0");
+        rtmp->writeAMFPropertyString(packet, pos, "tcUrl", String("rtmp://") + host + "/" + app);
+        rtmp->writeAMFObjectEnd(packet, pos);
+        benchDoNotOptimize(packet);
+    }
+}
+
+void PipelineBenchmarks::audioGain(BenchState& state) {
+    size_t count = (size_t)state.getArg();
+    int16_t* samples = (int16_t*)malloc(count * sizeof(int16_t));
+    if (!samples) {
+        state.skip("out of memory");
+        return;
+    }
+    // A tone at half scale; alternating gains keep it from settling into
+    // permanent clipping
+    for (size_t i = 0; i < count; i++) {
+        samples[i] = (int16_t)(16384 * sinf(2.0f * (float)M_PI * 440.0f * i / AUDIO_SAMPLE_RATE));
+    }
+    bool up = true;
+    while (state.keepRunning()) {
+        AudioCapture::applyGain(samples, count, up ? 1.5f : 1.0f / 1.5f);
+        up = !up;
+        benchDoNotOptimize(samples);
+    }
+    state.setItemsPerIteration(count);
+    state.setBytesPerIteration(count * sizeof(int16_t));
+    free(samples);
+}
+
+// One hop per iteration, so the time is the per-frame cost audioTask pays
+// every 10 ms (the 160-sample copy into the ring included)
+void PipelineBenchmarks::mfcc(BenchState& state) {
+    AudioFeatures* features = new AudioFeatures();
+    int16_t* samples = (int16_t*)malloc(AUDIO_SAMPLE_RATE * sizeof(int16_t));
+    if (!features || !samples || !features->begin()) {
+        delete features;
+        free(samples);
+        state.skip("out of memory");
+        return;
+    }
+    for (size_t i = 0; i < AUDIO_SAMPLE_RATE; i++) {
+        float t = (float)i / AUDIO_SAMPLE_RATE;
+        samples[i] = (int16_t)(8000 * (sinf(2.0f * (float)M_PI * 440.0f * t) +
+                                       0.5f * sinf(2.0f * (float)M_PI * 3000.0f * t)));
+    }
+    size_t offset = 0;
+    while (state.keepRunning()) {
+        features->process(&samples[offset], MFCC_HOP_LENGTH);
+        offset = (offset + MFCC_HOP_LENGTH) % AUDIO_SAMPLE_RATE;
+    }
+    benchDoNotOptimize(features->getLastFrame()[0]);
+    state.setItemsPerIteration(1);
+    delete features;
+    free(samples);
+}
+
+static void returnNothing(camera_fb_t* fb) {
+    (void)fb;
+}
+
+// Camera task to stream task, minus the wait: wrap a driver frame, post it,
+// take it and drop the last reference
+void PipelineBenchmarks::frameHandoff(BenchState& state) {
+    FramePool pool(returnNothing);
+    FrameMailbox mailbox;
+    mailbox.setConsumer(xTaskGetCurrentTaskHandle());
+    camera_fb_t fb = {};
+    fb.buf = payload;
+    fb.len = CAMERA_TARGET_FRAME_BYTES;
+    fb.format = PIXFORMAT_JPEG;
+    while (state.keepRunning()) {
+        mailbox.post(pool.wrap(&fb));
+        SharedFrame* frame = mailbox.take(0);
+        if (frame) {
+            frame->release();
+        }
+    }
+    // Clear the notifications the posts left behind
+    ulTaskNotifyTake(pdTRUE, 0);
+    state.setItemsPerIteration(1);
+}
+
+void PipelineBenchmarks::flvVideoTag(BenchState& state) {
+    if (!haveSink(state)) {
+        return;
+    }
+    size_t len = (size_t)state.getArg();
+    uint32_t timestamp = 0;
+    while (state.keepRunning()) {
+        rtmp->sendVideoData(payload, len, timestamp);
+        timestamp += 33;
+    }
+    state.setBytesPerIteration(len);
+}
+
+void PipelineBenchmarks::flvAudioTag(BenchState& state) {
+    if (!haveSink(state)) {
+        return;
+    }
+    size_t len = (size_t)state.getArg();
+    uint32_t timestamp = 0;
+    while (state.keepRunning()) {
+        rtmp->sendAudioData(payload, len, timestamp);
+        timestamp += 64;
+    }
+    state.setBytesPerIteration(len);
+}
+
+// No writer task: each iteration pushes a frame and writes it out, so the
+// time is the copy into the ring plus the share of block writes
+void PipelineBenchmarks::recorderWrite(BenchState& state) {
+    FlvRecorder recorder;
+    if (!recorder.begin(BENCH_RECORDER_RING, 0, false)) {
+        state.skip("no recorder storage");
+        return;
+    }
+    size_t len = (size_t)state.getArg();
+    uint32_t timestamp = 0;
+    recorder.trigger(UINT32_MAX / 2);
+    while (state.keepRunning()) {
+        recorder.push(STREAM_MESSAGE_VIDEO, timestamp, payload, len);
+        recorder.service();
+        timestamp += 33;
+    }
+    recorder.stop();
+    recorder.service();
+    unlink(recorder.getPath());
+    state.setBytesPerIteration(len);
+}
+
+// The stream task's OSD pass on camera-like frames: scale 1 at QVGA and 2
+// at VGA, as OSD_SCALE suggests. A handful of frames in turn, since how the
+// scan ends decides whether the tail has to be walked.
+void PipelineBenchmarks::jpegOverlay(BenchState& state) {
+    uint16_t width = (uint16_t)state.getArg();
+    SyntheticJpeg camera;
+    camera.begin(width, width * 3 / 4, 12, true);
+    std::vector<uint8_t> frames[BENCH_OVERLAY_FRAMES];
+    size_t bytes = 0;
+    for (int i = 0; i < BENCH_OVERLAY_FRAMES; i++) {
+        if (!camera.capture(i, frames[i])) {
+            state.skip("out of memory");
+            return;
+        }
+        bytes = max(bytes, frames[i].size());
+    }
+    std::vector<uint8_t> out(JpegOverlay::maxOutputSize(bytes));
+
+    JpegOverlay overlay;
+    overlay.setPosition(OSD_POSITION_X, OSD_POSITION_Y);
+    overlay.setScale(width >= 640 ? 2 : 1);
+    overlay.setText("ESP32-CAM 2026-01-01 12:00:00");
+    uint32_t frame = 0;
+    bytes = 0;
+    while (state.keepRunning()) {
+        const std::vector<uint8_t>& jpeg = frames[frame++ % BENCH_OVERLAY_FRAMES];
+        size_t len = overlay.apply(jpeg.data(), jpeg.size(), out.data(), out.size());
+        benchDoNotOptimize(len);
+        bytes += jpeg.size();
+    }
+    if (overlay.getFramesFailed()) {
+        state.skip("overlay failed");
+        return;
+    }
+    state.setItemsPerIteration(1);
+    state.setBytesPerIteration(bytes / max(frame, 1u));
+}
@@ -0,0 +1,53 @@
+#ifndef PIPELINE_BENCHMARKS_H
+#define PIPELINE_BENCHMARKS_H
+
+#include "Bench.h"
+
+// Microbenchmarks of the streaming hot paths:
+//
+//   BM_RtmpChunkHeader       RTMPClient::encodeChunkHeader (type 0 header)
+//   BM_RtmpSendChunk/N       RTMPClient::sendChunk of an N-byte message in
+//                            RTMP_CHUNK_SIZE chunks
+//   BM_Amf0Number            AMF0 writers: one number
+//   BM_Amf0String            AMF0 writers: one short string
+//   BM_Amf0ConnectCommand    AMF0 writers: the connect command as sent
+//   BM_AudioGain/N           AudioCapture::applyGain over N samples
+//   BM_Mfcc                  AudioFeatures::process of one 10 ms hop of a
+//                            440 Hz + 3 kHz tone, i.e. one MFCC frame
+//   BM_FrameHandoff          FramePool::wrap, FrameMailbox post/take, release
+//   BM_FlvVideoTag/N         FLV video tag for an N-byte JPEG, chunked and sent
+//   BM_FlvAudioTag/N         FLV audio tag for N bytes of PCM, chunked and sent
+//   BM_RecorderWrite/N       FlvRecorder push and writer pass for an N-byte
+//                            JPEG, i.e. the sustained write rate of the
+//                            recorder storage (the file is deleted after)
+//   BM_JpegOverlay/W         JpegOverlay::apply of the OSD timestamp on a
+//                            W-pixel-wide 4:3 SyntheticJpeg frame (4:2:2,
+//                            box at the top left as OSD_POSITION_X/Y)
+//
+// The RTMP benchmarks write through the socket transport to a loopback TCP
+// connection whose far end a task drains, so they include the socket
+// writes they make in the stream task; they are reported as errors when no
+// loopback connection can be made.
+// They also count towards the rtmp_* metrics. Run them with the stream idle
+// for stable numbers.
+
+class PipelineBenchmarks {
+public:
+    static void run(BenchRunner& runner);
+
+private:
+    static void rtmpChunkHeader(BenchState& state);
+    static void rtmpSendChunk(BenchState& state);
+    static void amf0Number(BenchState& state);
+    static void amf0String(BenchState& state);
+    static void amf0ConnectCommand(BenchState& state);
+    static void audioGain(BenchState& state);
+    static void mfcc(BenchState& state);
+    static void frameHandoff(BenchState& state);
+    static void flvVideoTag(BenchState& state);
+    static void flvAudioTag(BenchState& state);
+    static void recorderWrite(BenchState& state);
+    static void jpegOverlay(BenchState& state);
+};
+
+#endif // PIPELINE_BENCHMARKS_H
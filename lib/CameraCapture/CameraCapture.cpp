@@ -1,5 +1,7 @@
 #include <Arduino.h>
 #include "CameraCapture.h"
+#include <Trace.h>
+#include <Logger.h>
 #include "../../include/pins.h"
 #include "../../include/config.h"
 
@@ -45,7 +47,7 @@ bool CameraCapture::configurePins() {
 }
 
 bool CameraCapture::begin() {
-    Serial.println("Camera: Initializing OV2640...");
+    LOG_I("Camera: Initializing OV2640...");
     
     // Configure camera pins
     configurePins();
@@ -53,14 +55,14 @@ bool CameraCapture::begin() {
     // Initialize camera
     esp_err_t err = esp_camera_init(&_config);
     if (err != ESP_OK) {
-        Serial.printf("Camera: Init failed with error 0x%x\n", err);
+        LOG_E("Camera: Init failed with error 0x%x", err);
         return false;
     }
     
     // Get sensor handle
     sensor_t* sensor = esp_camera_sensor_get();
     if (!sensor) {
-        Serial.println("Camera: Failed to get sensor");
+        LOG_E("Camera: Failed to get sensor");
         return false;
     }
     
@@ -88,7 +90,7 @@ bool CameraCapture::begin() {
     sensor->set_dcw(sensor, 1);            // 0 = disable, 1 = enable
     sensor->set_colorbar(sensor, 0);       // 0 = disable, 1 = enable
     
-    Serial.printf("Camera: Initialized successfully (PID: 0x%02x, VER: 0x%02x, MIDL: 0x%02x, MIDH: 0x%02x)\n",
+    LOG_I("Camera: Initialized successfully (PID: 0x%02x, VER: 0x%02x, MIDL: 0x%02x, MIDH: 0x%02x)",
                  sensor->id.PID, sensor->id.VER, sensor->id.MIDL, sensor->id.MIDH);
     
     _fpsStartTime = millis();
@@ -97,16 +99,17 @@ bool CameraCapture::begin() {
 
 void CameraCapture::end() {
     esp_camera_deinit();
-    Serial.println("Camera: Deinitialized");
+    LOG_I("Camera: Deinitialized");
 }
 
 camera_fb_t* CameraCapture::captureFrame() {
+    TRACE_SCOPE("camera.capture");
     uint32_t startTime = millis();
     
     camera_fb_t* fb = esp_camera_fb_get();
     
     if (!fb) {
-        Serial.println("Camera: Frame capture failed");
+        LOG_E("Camera: Frame capture failed");
         return nullptr;
     }
     
@@ -132,7 +135,7 @@ bool CameraCapture::setFrameSize(framesize_t size) {
     sensor_t* sensor = getSensor();
     if (sensor) {
         if (sensor->set_framesize(sensor, size) == 0) {
-            Serial.printf("Camera: Frame size changed to %d\n", size);
+            LOG_D("Camera: Frame size changed to %d", size);
             return true;
         }
     }
@@ -143,7 +146,8 @@ bool CameraCapture::setQuality(uint8_t quality) {
     sensor_t* sensor = getSensor();
     if (sensor) {
         if (sensor->set_quality(sensor, quality) == 0) {
-            Serial.printf("Camera: JPEG quality changed to %d\n", quality);
+            // Changes every few frames under rate control, so debug level only
+            LOG_D("Camera: JPEG quality changed to %d", quality);
             return true;
         }
     }
@@ -154,7 +158,7 @@ bool CameraCapture::setPixelFormat(pixformat_t format) {
     sensor_t* sensor = getSensor();
     if (sensor) {
         if (sensor->set_pixformat(sensor, format) == 0) {
-            Serial.printf("Camera: Pixel format changed to %d\n", format);
+            LOG_D("Camera: Pixel format changed to %d", format);
             return true;
         }
     }
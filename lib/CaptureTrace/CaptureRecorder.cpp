@@ -0,0 +1,153 @@
+#include "CaptureRecorder.h"
+#include <esp_timer.h>
+#include <Logger.h>
+
+CaptureRecorder captureRecorder;
+
+CaptureRecorder::CaptureRecorder()
+    : _buffer(nullptr)
+    , _capacity(0)
+    , _used(0)
+    , _lock(nullptr)
+    , _recording(false)
+    , _haveTime(false)
+    , _firstMicros(0)
+    , _lastMicros(0)
+    , _frames(0)
+    , _audioBlocks(0)
+{
+}
+
+CaptureRecorder::~CaptureRecorder() {
+    release();
+    if (_lock) {
+        vSemaphoreDelete(_lock);
+    }
+}
+
+bool CaptureRecorder::start(size_t capacity, uint32_t sampleRate) {
+    if (capacity < CAPTURE_TRACE_HEADER_SIZE + CAPTURE_TRACE_RECORD_SIZE) {
+        return false;
+    }
+    if (!_lock) {
+        _lock = xSemaphoreCreateMutex();
+        if (!_lock) {
+            return false;
+        }
+    }
+
+    stop();
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    if (_capacity != capacity) {
+        free(_buffer);
+        _buffer = (uint8_t*)ps_malloc(capacity);
+        _capacity = _buffer ? capacity : 0;
+    }
+    bool ok = _buffer != nullptr;
+    if (ok) {
+        CaptureTrace::writeHeader(_buffer, sampleRate);
+        _used = CAPTURE_TRACE_HEADER_SIZE;
+        _haveTime = false;
+        _frames = 0;
+        _audioBlocks = 0;
+        _recording.store(true);
+    }
+    xSemaphoreGive(_lock);
+
+    if (ok) {
+        LOG_I("Capture: Recording up to %u KB", (unsigned)(capacity / 1024));
+    } else {
+        LOG_E("Capture: Cannot allocate %u KB of PSRAM", (unsigned)(capacity / 1024));
+    }
+    return ok;
+}
+
+void CaptureRecorder::stop() {
+    if (_recording.exchange(false)) {
+        LOG_I("Capture: Stopped, %u frames and %u audio blocks in %u KB over %.1f s",
+                      _frames, _audioBlocks, (unsigned)(_used / 1024), getDurationMicros() / 1e6);
+    }
+}
+
+bool CaptureRecorder::append(uint8_t kind, uint8_t format, uint16_t width, uint16_t height, uint64_t micros,
+                             const uint8_t* payload, size_t length) {
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    if (!_recording.load()) {
+        xSemaphoreGive(_lock);
+        return false;
+    }
+    if (_capacity - _used < CAPTURE_TRACE_RECORD_SIZE + length) {
+        // Full: the trace ends with the last record that fitted
+        xSemaphoreGive(_lock);
+        stop();
+        return false;
+    }
+
+    if (!_haveTime) {
+        _firstMicros = micros;
+        _lastMicros = micros;
+        _haveTime = true;
+    }
+    int32_t delta = (int32_t)(int64_t)(micros - _lastMicros);
+    _lastMicros = micros;
+
+    CaptureTrace::writeRecord(_buffer + _used, kind, format, width, height, delta, (uint32_t)length);
+    memcpy(_buffer + _used + CAPTURE_TRACE_RECORD_SIZE, payload, length);
+    _used += CAPTURE_TRACE_RECORD_SIZE + length;
+    xSemaphoreGive(_lock);
+    return true;
+}
+
+void CaptureRecorder::recordFrame(const camera_fb_t* fb) {
+    if (!isRecording() || !fb) {
+        return;
+    }
+    uint64_t micros = (uint64_t)fb->timestamp.tv_sec * 1000000ULL + fb->timestamp.tv_usec;
+    if (append(CAPTURE_TRACE_VIDEO, (uint8_t)fb->format, (uint16_t)fb->width, (uint16_t)fb->height, micros,
+               fb->buf, fb->len)) {
+        _frames++;
+    }
+}
+
+void CaptureRecorder::recordAudio(const int16_t* samples, size_t count, uint64_t micros) {
+    if (!isRecording() || !samples) {
+        return;
+    }
+    // PCM is stored little-endian, which is the native order on both ends
+    if (append(CAPTURE_TRACE_AUDIO, 0, 0, 0, micros, (const uint8_t*)samples, count * sizeof(int16_t))) {
+        _audioBlocks++;
+    }
+}
+
+size_t CaptureRecorder::dump(Print& out) {
+    stop();
+    if (!_buffer) {
+        return 0;
+    }
+    // Nothing appends once stopped; taking the lock waits out an append in flight
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    size_t written = 0;
+    while (written < _used) {
+        size_t n = out.write(_buffer + written, _used - written);
+        if (n == 0) {
+            break;
+        }
+        written += n;
+    }
+    xSemaphoreGive(_lock);
+    return written;
+}
+
+void CaptureRecorder::release() {
+    stop();
+    if (_lock) {
+        xSemaphoreTake(_lock, portMAX_DELAY);
+    }
+    free(_buffer);
+    _buffer = nullptr;
+    _capacity = 0;
+    _used = 0;
+    if (_lock) {
+        xSemaphoreGive(_lock);
+    }
+}
@@ -0,0 +1,66 @@
+#ifndef CAPTURE_RECORDER_H
+#define CAPTURE_RECORDER_H
+
+#include <Arduino.h>
+#include <esp_camera.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <atomic>
+#include "CaptureTrace.h"
+
+// Records camera frames and audio blocks into a capture trace in PSRAM.
+//
+// start() allocates the buffer and arms recording; the camera and audio
+// tasks append as they capture, and recording stops by itself when the
+// buffer is full. The trace is fetched with dump() (GET /capture on the
+// metrics server), which stops recording first. Nothing is allocated until
+// the first start(), and while stopped each record call is one atomic load.
+
+class CaptureRecorder {
+public:
+    CaptureRecorder();
+    ~CaptureRecorder();
+
+    // Discard any previous trace and record into capacity bytes of PSRAM
+    bool start(size_t capacity, uint32_t sampleRate);
+    void stop();
+
+    bool isRecording() const { return _recording.load(std::memory_order_relaxed); }
+
+    // Frame as returned by the driver (its timestamp is the capture time)
+    void recordFrame(const camera_fb_t* fb);
+    // PCM block; micros is esp_timer time when the read completed
+    void recordAudio(const int16_t* samples, size_t count, uint64_t micros);
+
+    // Stop recording and write the trace. Returns bytes written.
+    size_t dump(Print& out);
+
+    // Free the buffer
+    void release();
+
+    size_t getBytes() const { return _used; }
+    size_t getCapacity() const { return _capacity; }
+    uint32_t getFrames() const { return _frames; }
+    uint32_t getAudioBlocks() const { return _audioBlocks; }
+    uint64_t getDurationMicros() const { return _haveTime ? _lastMicros - _firstMicros : 0; }
+
+private:
+    uint8_t* _buffer;
+    size_t _capacity;
+    size_t _used;
+    SemaphoreHandle_t _lock;
+    std::atomic<bool> _recording;
+
+    bool _haveTime;
+    uint64_t _firstMicros;
+    uint64_t _lastMicros;       // Capture time of the previous record
+    uint32_t _frames;
+    uint32_t _audioBlocks;
+
+    bool append(uint8_t kind, uint8_t format, uint16_t width, uint16_t height, uint64_t micros,
+                const uint8_t* payload, size_t length);
+};
+
+extern CaptureRecorder captureRecorder;
+
+#endif // CAPTURE_RECORDER_H
@@ -0,0 +1,107 @@
+#include "CaptureTrace.h"
+#include <string.h>
+
+static void put16(uint8_t* p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void put32(uint8_t* p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static uint16_t get16(const uint8_t* p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t get32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+void CaptureTrace::writeHeader(uint8_t* out, uint32_t sampleRate) {
+    memcpy(out, "CTRC", 4);
+    put16(out + 4, CAPTURE_TRACE_VERSION);
+    put16(out + 6, CAPTURE_TRACE_HEADER_SIZE);
+    put32(out + 8, sampleRate);
+    put32(out + 12, 0);
+}
+
+void CaptureTrace::writeRecord(uint8_t* out, uint8_t kind, uint8_t format, uint16_t width, uint16_t height,
+                               int32_t deltaMicros, uint32_t length) {
+    out[0] = kind;
+    out[1] = format;
+    put16(out + 2, width);
+    put16(out + 4, height);
+    put16(out + 6, 0);
+    put32(out + 8, (uint32_t)deltaMicros);
+    put32(out + 12, length);
+}
+
+CaptureTraceReader::CaptureTraceReader()
+    : _data(nullptr)
+    , _len(0)
+    , _offset(0)
+    , _firstRecord(0)
+    , _sampleRate(0)
+    , _micros(0)
+    , _truncated(false)
+{
+}
+
+bool CaptureTraceReader::open(const uint8_t* data, size_t len) {
+    _data = nullptr;
+    if (!data || len < CAPTURE_TRACE_HEADER_SIZE || memcmp(data, "CTRC", 4) != 0 ||
+        get16(data + 4) != CAPTURE_TRACE_VERSION) {
+        return false;
+    }
+    // A larger header is a compatible extension: skip what we do not know
+    uint16_t headerSize = get16(data + 6);
+    if (headerSize < CAPTURE_TRACE_HEADER_SIZE || headerSize > len) {
+        return false;
+    }
+
+    _data = data;
+    _len = len;
+    _firstRecord = headerSize;
+    _sampleRate = get32(data + 8);
+    rewind();
+    return true;
+}
+
+void CaptureTraceReader::rewind() {
+    _offset = _firstRecord;
+    _micros = 0;
+    _truncated = false;
+}
+
+bool CaptureTraceReader::next(CaptureTraceRecord& record) {
+    if (!_data || _offset >= _len) {
+        return false;
+    }
+    if (_len - _offset < CAPTURE_TRACE_RECORD_SIZE) {
+        _truncated = true;
+        return false;
+    }
+
+    const uint8_t* p = _data + _offset;
+    uint32_t length = get32(p + 12);
+    if (_len - _offset - CAPTURE_TRACE_RECORD_SIZE < length) {
+        _truncated = true;
+        return false;
+    }
+
+    // The first record's delta is its offset from the start of the trace (0)
+    _micros += (int32_t)get32(p + 8);
+    record.kind = p[0];
+    record.format = p[1];
+    record.width = get16(p + 2);
+    record.height = get16(p + 4);
+    record.micros = _micros;
+    record.length = length;
+    record.payload = p + CAPTURE_TRACE_RECORD_SIZE;
+    _offset += CAPTURE_TRACE_RECORD_SIZE + length;
+    return true;
+}
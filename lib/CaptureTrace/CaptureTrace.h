@@ -0,0 +1,77 @@
+#ifndef CAPTURE_TRACE_H
+#define CAPTURE_TRACE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Capture trace: the camera frames and microphone blocks a device actually
+// produced, with their capture times, so every pipeline change can be
+// measured on the same footage. CaptureRecorder writes them on the device;
+// the host HAL replays them behind esp_camera/i2s (HOST_CAPTURE_TRACE), and
+// host tools read them with CaptureTraceReader.
+//
+// File layout (little-endian):
+//   header   "CTRC"  version(2)  headerSize(2)  sampleRate(4)  reserved(4)
+//   records  kind(1)  format(1)  width(2)  height(2)  reserved(2)
+//            deltaMicros(4, signed)  length(4)  payload(length)
+//
+// deltaMicros is the capture time relative to the previous record. Frames
+// carry the driver's capture timestamp and audio blocks the time the read
+// completed, so records from the two tasks can be slightly out of time
+// order; the signed delta keeps both timelines exact. Frame payloads are
+// camera_fb_t buffers as delivered (JPEG at the quality in force then);
+// audio payloads are signed 16-bit mono PCM at sampleRate.
+
+#define CAPTURE_TRACE_VERSION       1
+#define CAPTURE_TRACE_HEADER_SIZE   16
+#define CAPTURE_TRACE_RECORD_SIZE   16
+
+#define CAPTURE_TRACE_VIDEO         1
+#define CAPTURE_TRACE_AUDIO         2
+
+struct CaptureTraceRecord {
+    uint8_t kind;               // CAPTURE_TRACE_VIDEO or CAPTURE_TRACE_AUDIO
+    uint8_t format;             // pixformat_t for frames, 0 for PCM
+    uint16_t width;             // Frames only
+    uint16_t height;
+    int64_t micros;             // Capture time since the first record
+    uint32_t length;
+    const uint8_t* payload;     // Points into the trace
+};
+
+class CaptureTrace {
+public:
+    // Serialise a file header / record header into out (CAPTURE_TRACE_*_SIZE bytes)
+    static void writeHeader(uint8_t* out, uint32_t sampleRate);
+    static void writeRecord(uint8_t* out, uint8_t kind, uint8_t format, uint16_t width, uint16_t height,
+                            int32_t deltaMicros, uint32_t length);
+};
+
+// Walks a trace held in memory. The data must outlive the reader.
+class CaptureTraceReader {
+public:
+    CaptureTraceReader();
+
+    // Check the header. Returns false if data is not a capture trace.
+    bool open(const uint8_t* data, size_t len);
+
+    // Next record in file order. Returns false at the end or at a truncated
+    // record (a recording cut off mid-write).
+    bool next(CaptureTraceRecord& record);
+
+    void rewind();
+
+    uint32_t getSampleRate() const { return _sampleRate; }
+    bool isTruncated() const { return _truncated; }
+
+private:
+    const uint8_t* _data;
+    size_t _len;
+    size_t _offset;
+    size_t _firstRecord;
+    uint32_t _sampleRate;
+    int64_t _micros;
+    bool _truncated;
+};
+
+#endif // CAPTURE_TRACE_H
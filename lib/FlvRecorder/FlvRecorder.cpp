@@ -0,0 +1,505 @@
+#include "FlvRecorder.h"
+#include "../../include/config.h"
+#include "../../include/pins.h"
+#include <Logger.h>
+#include <Metrics.h>
+#include <Trace.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#ifdef ESP_PLATFORM
+#include <esp_heap_caps.h>
+#include <SPI.h>
+#include <SD.h>
+#include <LittleFS.h>
+#endif
+
+// Block write time buckets (microseconds)
+static const uint32_t writeLatencyBounds[] = {
+    1000, 2000, 5000, 10000, 20000, 50000, 100000, 200000, 500000, 1000000
+};
+
+static Counter metricFiles("recorder_files_total", "Recordings written");
+static Counter metricBytesWritten("recorder_bytes_written_total", "Bytes written to recordings");
+static Counter metricDropped("recorder_dropped_total", "Messages lost because the recorder ring was full");
+static Histogram metricBlockWrite("recorder_block_write_seconds", "Time to write one block to storage",
+                                  writeLatencyBounds, sizeof(writeLatencyBounds) / sizeof(writeLatencyBounds[0]),
+                                  1e-6);
+
+// Mounts the storage; returns the directory files go in, or nullptr
+static const char* mountStorage() {
+#ifdef ESP_PLATFORM
+#if RECORDER_STORAGE == RECORDER_STORAGE_SD
+    SPI.begin(SD_PIN_SCK, SD_PIN_MISO, SD_PIN_MOSI, SD_PIN_CS);
+    if (!SD.begin(SD_PIN_CS, SPI, RECORDER_SD_FREQ_HZ, "/sd")) {
+        LOG_E("Recorder: No SD card");
+        return nullptr;
+    }
+    return "/sd";
+#else
+    if (!LittleFS.begin(true, "/littlefs", 4, "spiffs")) {
+        LOG_E("Recorder: Cannot mount LittleFS");
+        return nullptr;
+    }
+    return "/littlefs";
+#endif
+#else
+    // A directory stands in for the card
+    const char* directory = getenv("HOST_RECORDER_DIR");
+    if (!directory || !directory[0]) {
+        directory = "recordings";
+    }
+    mkdir(directory, 0755);
+    return directory;
+#endif
+}
+
+// ============================================================================
+// AMF0 (onMetaData only)
+// ============================================================================
+
+static void amfName(uint8_t* out, size_t& pos, const char* name) {
+    size_t len = strlen(name);
+    out[pos++] = (uint8_t)(len >> 8);
+    out[pos++] = (uint8_t)len;
+    memcpy(out + pos, name, len);
+    pos += len;
+}
+
+static void amfString(uint8_t* out, size_t& pos, const char* value) {
+    out[pos++] = 0x02;
+    amfName(out, pos, value);
+}
+
+static void amfNumber(uint8_t* out, size_t& pos, double value) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    out[pos++] = 0x00;
+    for (int shift = 56; shift >= 0; shift -= 8) {
+        out[pos++] = (uint8_t)(bits >> shift);
+    }
+}
+
+static void amfBoolean(uint8_t* out, size_t& pos, bool value) {
+    out[pos++] = 0x01;
+    out[pos++] = value ? 1 : 0;
+}
+
+static void writeBE24(uint8_t* out, uint32_t value) {
+    out[0] = (uint8_t)(value >> 16);
+    out[1] = (uint8_t)(value >> 8);
+    out[2] = (uint8_t)value;
+}
+
+static void writeBE32(uint8_t* out, uint32_t value) {
+    out[0] = (uint8_t)(value >> 24);
+    out[1] = (uint8_t)(value >> 16);
+    out[2] = (uint8_t)(value >> 8);
+    out[3] = (uint8_t)value;
+}
+
+// ============================================================================
+// Setup
+// ============================================================================
+
+FlvRecorder::FlvRecorder()
+    : _preRollMs(0)
+    , _lock(nullptr)
+    , _task(nullptr)
+    , _recording(false)
+    , _startRequested(false)
+    , _stopRequested(false)
+    , _stopAtMs(0)
+    , _directory(nullptr)
+    , _nextIndex(1)
+    , _fd(-1)
+    , _block(nullptr)
+    , _blockLen(0)
+    , _filePos(0)
+    , _durationOffset(0)
+    , _haveBase(false)
+    , _baseTimestamp(0)
+    , _lastTimestamp(0)
+    , _fileWriteMicros(0)
+    , _fileMaxWriteMicros(0)
+    , _width(0)
+    , _height(0)
+    , _frameRate(0.0f)
+    , _files(0)
+    , _bytesWritten(0)
+    , _dropped(0)
+    , _maxWriteMicros(0)
+{
+    _path[0] = '\0';
+}
+
+FlvRecorder::~FlvRecorder() {
+    if (_task) {
+        vTaskDelete(_task);
+    }
+    if (_fd >= 0) {
+        finishFile();
+    }
+    free(_block);
+    if (_lock) {
+        vSemaphoreDelete(_lock);
+    }
+}
+
+bool FlvRecorder::begin(size_t ringBytes, uint32_t preRollMs, bool startTask) {
+    _directory = mountStorage();
+    if (!_directory) {
+        return false;
+    }
+
+    // Blocks come from internal RAM: the SD driver would copy a PSRAM
+    // block through a bounce buffer
+#ifdef ESP_PLATFORM
+    _block = (uint8_t*)heap_caps_malloc(RECORDER_BLOCK_BYTES, MALLOC_CAP_INTERNAL | MALLOC_CAP_DMA);
+#else
+    _block = (uint8_t*)malloc(RECORDER_BLOCK_BYTES);
+#endif
+    _lock = xSemaphoreCreateMutex();
+    if (!_block || !_lock || !_ring.begin(ringBytes) || !_ring.isAllocated()) {
+        LOG_E("Recorder: Cannot allocate %u KB", (unsigned)(ringBytes / 1024));
+        _ring.end();
+        return false;
+    }
+    _preRollMs = preRollMs;
+
+    if (startTask && xTaskCreatePinnedToCore(writerTask, "recorder", TASK_RECORDER_STACK_SIZE, this,
+                                             TASK_RECORDER_PRIORITY, &_task, TASK_RECORDER_CORE) != pdPASS) {
+        LOG_E("Recorder: Cannot start the writer task");
+        _ring.end();
+        return false;
+    }
+
+    LOG_I("Recorder: %u KB ring, %u ms pre-roll, files in %s", (unsigned)(_ring.getCapacity() / 1024),
+          (unsigned)preRollMs, _directory);
+    return true;
+}
+
+void FlvRecorder::setVideoInfo(uint16_t width, uint16_t height, float frameRate) {
+    _width = width;
+    _height = height;
+    _frameRate = frameRate;
+}
+
+void FlvRecorder::writerTask(void* param) {
+    FlvRecorder* recorder = (FlvRecorder*)param;
+    while (true) {
+        recorder->service();
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(RECORDER_POLL_MS));
+    }
+}
+
+// ============================================================================
+// Ring (stream task side)
+// ============================================================================
+
+void FlvRecorder::push(uint8_t type, uint32_t timestamp, const uint8_t* data, size_t len) {
+    if (!_ring.canHold(len)) {
+        return;
+    }
+    TRACE_SCOPE_ARG("recorder.push", len);
+
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    bool recording = _recording.load(std::memory_order_relaxed);
+    StreamMessage oldest;
+
+    // Between recordings the ring only keeps the pre-roll
+    if (!recording) {
+        while (_ring.front(oldest) && (int32_t)(timestamp - oldest.timestamp) > (int32_t)_preRollMs) {
+            _ring.removeOldest();
+        }
+    }
+
+    // While recording the writer owns the records, so a full ring drops the
+    // new message instead of evicting
+    bool fits;
+    while (!(fits = _ring.append(type, timestamp, data, len)) && !recording && !_ring.isEmpty()) {
+        _ring.removeOldest();
+    }
+    xSemaphoreGive(_lock);
+
+    if (!fits) {
+        _dropped++;
+        metricDropped.inc();
+    }
+}
+
+void FlvRecorder::trigger(uint32_t postRollMs) {
+    if (!isEnabled()) {
+        return;
+    }
+    _stopAtMs.store(millis() + postRollMs, std::memory_order_relaxed);
+    _stopRequested.store(false, std::memory_order_relaxed);
+    if (!isRecording()) {
+        _startRequested.store(true, std::memory_order_relaxed);
+    }
+    if (_task) {
+        xTaskNotifyGive(_task);
+    }
+}
+
+void FlvRecorder::stop() {
+    _startRequested.store(false, std::memory_order_relaxed);
+    _stopRequested.store(true, std::memory_order_relaxed);
+    if (_task) {
+        xTaskNotifyGive(_task);
+    }
+}
+
+// ============================================================================
+// Writer
+// ============================================================================
+
+void FlvRecorder::service() {
+    if (!isEnabled()) {
+        return;
+    }
+    if (!isRecording()) {
+        if (!_startRequested.exchange(false)) {
+            return;
+        }
+        if (!openFile()) {
+            return;
+        }
+        xSemaphoreTake(_lock, portMAX_DELAY);
+        _recording.store(true, std::memory_order_relaxed);
+        xSemaphoreGive(_lock);
+    }
+
+    // Records stay put while recording: the stream task only appends, so
+    // each one can be read without holding the lock
+    for (;;) {
+        StreamMessage message;
+        xSemaphoreTake(_lock, portMAX_DELAY);
+        bool any = _ring.front(message);
+        xSemaphoreGive(_lock);
+        if (!any) {
+            break;
+        }
+
+        if (message.type == STREAM_MESSAGE_VIDEO) {
+            static const uint8_t videoTag = 0x11;   // Keyframe, JPEG
+            writeTag(9, message.timestamp, &videoTag, 1, message.data, message.length);
+        } else {
+            // Linear PCM little-endian (3), 16-bit, mono. The 2-bit rate
+            // field can only say 5.5, 11, 22 or 44 kHz, so 16 kHz cannot be
+            // tagged: it is left at 0 (5.5 kHz), the same byte RTMPClient
+            // sends, and the real rate is only in onMetaData's
+            // audiosamplerate. A reader that goes by the tag byte plays the
+            // audio at about a third of its speed.
+            static const uint8_t audioTag = 0x32;
+            writeTag(8, message.timestamp, &audioTag, 1, message.data, message.length);
+        }
+
+        xSemaphoreTake(_lock, portMAX_DELAY);
+        _ring.removeOldest();
+        xSemaphoreGive(_lock);
+
+        if (_fd < 0) {
+            return;         // Storage failed
+        }
+    }
+
+    if (_stopRequested.exchange(false) || (int32_t)(millis() - _stopAtMs.load(std::memory_order_relaxed)) >= 0) {
+        finishFile();
+    }
+}
+
+bool FlvRecorder::openFile() {
+    struct stat info;
+    do {
+        snprintf(_path, sizeof(_path), "%s/rec_%05u.flv", _directory, (unsigned)_nextIndex++);
+    } while (stat(_path, &info) == 0 && _nextIndex < 100000);
+
+    _fd = open(_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (_fd < 0) {
+        LOG_E("Recorder: Cannot create %s (%d)", _path, errno);
+        return false;
+    }
+    _blockLen = 0;
+    _filePos = 0;
+    _haveBase = false;
+    _lastTimestamp = 0;
+    _fileWriteMicros = 0;
+    _fileMaxWriteMicros = 0;
+
+    // Header: "FLV", version 1, audio and video, header size 9, then
+    // PreviousTagSize0
+    static const uint8_t header[13] = { 'F', 'L', 'V', 1, 0x05, 0, 0, 0, 9, 0, 0, 0, 0 };
+    emit(header, sizeof(header));
+    writeMetaData();
+    LOG_I("Recorder: Recording to %s", _path);
+    return true;
+}
+
+void FlvRecorder::writeMetaData() {
+    uint8_t body[320];
+    size_t pos = 0;
+    amfString(body, pos, "onMetaData");
+    body[pos++] = 0x08;     // ECMA array
+    uint32_t countPos = pos;
+    pos += 4;
+    uint32_t count = 0;
+
+    amfName(body, pos, "duration");
+    uint32_t durationPos = pos + 1;
+    amfNumber(body, pos, 0.0);      // Filled in by finishFile()
+    count++;
+    if (_width > 0) {
+        amfName(body, pos, "width");
+        amfNumber(body, pos, _width);
+        amfName(body, pos, "height");
+        amfNumber(body, pos, _height);
+        count += 2;
+    }
+    if (_frameRate > 0.0f) {
+        amfName(body, pos, "framerate");
+        amfNumber(body, pos, _frameRate);
+        count++;
+    }
+    amfName(body, pos, "videocodecid");
+    amfNumber(body, pos, 1);
+    amfName(body, pos, "audiocodecid");
+    amfNumber(body, pos, 3);
+    amfName(body, pos, "audiosamplerate");
+    amfNumber(body, pos, AUDIO_SAMPLE_RATE);
+    amfName(body, pos, "audiosamplesize");
+    amfNumber(body, pos, 16);
+    amfName(body, pos, "stereo");
+    amfBoolean(body, pos, AUDIO_CHANNELS > 1);
+    amfName(body, pos, "encoder");
+    amfString(body, pos, "AIStreamingCamera");
+    count += 6;
+    body[pos++] = 0x00;     // Object end
+    body[pos++] = 0x00;
+    body[pos++] = 0x09;
+    writeBE32(body + countPos, count);
+
+    _durationOffset = (uint32_t)_filePos + 11 + durationPos;
+    writeTag(18, 0, nullptr, 0, body, pos);
+    _haveBase = false;      // Media timestamps start at the first message
+}
+
+void FlvRecorder::writeTag(uint8_t tagType, uint32_t timestamp, const uint8_t* head, size_t headLen,
+                           const uint8_t* body, size_t bodyLen) {
+    if (tagType != 18) {
+        if (!_haveBase) {
+            _haveBase = true;
+            _baseTimestamp = timestamp;
+        }
+        int32_t relative = (int32_t)(timestamp - _baseTimestamp);
+        timestamp = relative > 0 ? (uint32_t)relative : 0;
+        _lastTimestamp = max(_lastTimestamp, timestamp);
+    }
+
+    uint32_t dataSize = (uint32_t)(headLen + bodyLen);
+    uint8_t tag[11];
+    tag[0] = tagType;
+    writeBE24(tag + 1, dataSize);
+    writeBE24(tag + 4, timestamp & 0xFFFFFF);
+    tag[7] = (uint8_t)(timestamp >> 24);    // Extended timestamp
+    writeBE24(tag + 8, 0);                  // Stream ID
+    emit(tag, sizeof(tag));
+    emit(head, headLen);
+    emit(body, bodyLen);
+
+    uint8_t previousSize[4];
+    writeBE32(previousSize, sizeof(tag) + dataSize);
+    emit(previousSize, sizeof(previousSize));
+}
+
+// Copies into the block, writing it out each time it fills
+void FlvRecorder::emit(const uint8_t* data, size_t len) {
+    while (len > 0 && _fd >= 0) {
+        size_t room = RECORDER_BLOCK_BYTES - _blockLen;
+        size_t take = min(len, room);
+        memcpy(_block + _blockLen, data, take);
+        _blockLen += take;
+        _filePos += take;
+        data += take;
+        len -= take;
+        if (_blockLen == RECORDER_BLOCK_BYTES && !writeBlock(RECORDER_BLOCK_BYTES)) {
+            abortFile();
+        }
+    }
+}
+
+bool FlvRecorder::writeBlock(size_t len) {
+    TRACE_SCOPE_ARG("recorder.write", len);
+    uint32_t start = micros();
+    size_t done = 0;
+    while (done < len) {
+        ssize_t written = write(_fd, _block + done, len - done);
+        if (written <= 0) {
+            LOG_E("Recorder: Write to %s failed (%d)", _path, errno);
+            return false;
+        }
+        done += (size_t)written;
+    }
+    uint32_t elapsed = micros() - start;
+    metricBlockWrite.observe(elapsed);
+    metricBytesWritten.inc((uint32_t)len);
+    _bytesWritten += len;
+    _fileWriteMicros += elapsed;
+    _fileMaxWriteMicros = max(_fileMaxWriteMicros, elapsed);
+    _maxWriteMicros = max(_maxWriteMicros, elapsed);
+    _blockLen = 0;
+    return true;
+}
+
+void FlvRecorder::finishFile() {
+    if (_blockLen > 0 && !writeBlock(_blockLen)) {
+        abortFile();
+        return;
+    }
+    close(_fd);
+    _fd = -1;
+
+    // The duration is only known now
+    int fd = open(_path, O_WRONLY);
+    if (fd >= 0) {
+        uint8_t duration[8];
+        double seconds = _lastTimestamp / 1000.0;
+        uint64_t bits;
+        memcpy(&bits, &seconds, sizeof(bits));
+        for (int i = 0; i < 8; i++) {
+            duration[i] = (uint8_t)(bits >> (56 - 8 * i));
+        }
+        if (lseek(fd, _durationOffset, SEEK_SET) == (off_t)_durationOffset) {
+            write(fd, duration, sizeof(duration));
+        }
+        close(fd);
+    }
+
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    _recording.store(false, std::memory_order_relaxed);
+    xSemaphoreGive(_lock);
+    _files++;
+    metricFiles.inc();
+
+    // Throughput counts only the time spent in write(), i.e. what the
+    // storage sustains rather than the stream's own bitrate
+    LOG_I("Recorder: %s closed, %.1f s, %u KB, %.0f KB/s while writing, slowest block %u us", _path,
+          _lastTimestamp / 1000.0, (unsigned)(_filePos / 1024),
+          _fileWriteMicros > 0 ? _filePos * 1e6 / 1024.0 / _fileWriteMicros : 0.0,
+          (unsigned)_fileMaxWriteMicros);
+}
+
+void FlvRecorder::abortFile() {
+    if (_fd >= 0) {
+        close(_fd);
+        _fd = -1;
+    }
+    _blockLen = 0;
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    _recording.store(false, std::memory_order_relaxed);
+    xSemaphoreGive(_lock);
+    LOG_E("Recorder: %s abandoned", _path);
+}
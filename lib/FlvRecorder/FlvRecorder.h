@@ -0,0 +1,112 @@
+#ifndef FLV_RECORDER_H
+#define FLV_RECORDER_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+#include <atomic>
+#include <MessageRing.h>
+
+// Records the stream to FLV files on an SD card or LittleFS, or in a
+// directory on the host (HOST_RECORDER_DIR).
+//
+// The stream task pushes every audio and video message into a PSRAM ring
+// that always holds the last pre-roll's worth. A trigger starts a file
+// with that pre-roll and keeps it open until the post-roll after the last
+// trigger, so an event recording includes what led up to it. The stream
+// task only ever copies into the ring. A low-priority writer task turns
+// the messages into FLV tags and writes them in whole RECORDER_BLOCK_BYTES
+// blocks, so a slow card makes the ring fill up (and then drops messages,
+// counted) instead of stalling capture.
+//
+// Files are rec_NNNNN.flv: the FLV header, an onMetaData tag whose duration
+// is filled in when the file is closed, then the tags. Video is tagged as
+// JPEG (codec 1) and audio as the PCM tag RTMPClient sends, whose rate field
+// cannot say 16 kHz (onMetaData carries the real rate).
+
+#define RECORDER_MAX_PATH   96
+
+class FlvRecorder {
+public:
+    FlvRecorder();
+    ~FlvRecorder();
+
+    // Mount the storage, allocate the ring and (unless startTask is false,
+    // for driving service() directly) start the writer task
+    bool begin(size_t ringBytes, uint32_t preRollMs, bool startTask = true);
+    bool isEnabled() const { return _ring.isAllocated(); }
+
+    // Written to onMetaData
+    void setVideoInfo(uint16_t width, uint16_t height, float frameRate);
+
+    // Copy one message (STREAM_MESSAGE_AUDIO/VIDEO type) into the ring.
+    // Never waits for storage.
+    void push(uint8_t type, uint32_t timestamp, const uint8_t* data, size_t len);
+
+    // Record from the pre-roll until postRollMs after the latest trigger
+    void trigger(uint32_t postRollMs);
+    // Close the current file with what has been pushed so far
+    void stop();
+    bool isRecording() const { return _recording.load(std::memory_order_relaxed); }
+
+    // Writer: opens and closes files and moves the ring to storage
+    void service();
+
+    // Statistics
+    uint32_t getFiles() const { return _files; }
+    uint64_t getBytesWritten() const { return _bytesWritten; }
+    uint32_t getDropped() const { return _dropped; }
+    uint32_t getMaxWriteMicros() const { return _maxWriteMicros; }
+    const char* getDirectory() const { return _directory; }
+    const char* getPath() const { return _path; }      // Latest file
+
+private:
+    MessageRing _ring;          // Under _lock
+    uint32_t _preRollMs;
+    SemaphoreHandle_t _lock;
+    TaskHandle_t _task;
+
+    // Trigger state, set from any task
+    std::atomic<bool> _recording;
+    std::atomic<bool> _startRequested;
+    std::atomic<bool> _stopRequested;
+    std::atomic<uint32_t> _stopAtMs;
+
+    // Current file (writer task only)
+    const char* _directory;
+    char _path[RECORDER_MAX_PATH];
+    uint32_t _nextIndex;
+    int _fd;
+    uint8_t* _block;
+    size_t _blockLen;
+    uint64_t _filePos;
+    uint32_t _durationOffset;   // File offset of the onMetaData duration
+    bool _haveBase;
+    uint32_t _baseTimestamp;
+    uint32_t _lastTimestamp;
+    uint64_t _fileWriteMicros;
+    uint32_t _fileMaxWriteMicros;
+
+    uint16_t _width;
+    uint16_t _height;
+    float _frameRate;
+
+    uint32_t _files;
+    uint64_t _bytesWritten;
+    uint32_t _dropped;
+    uint32_t _maxWriteMicros;
+
+    bool openFile();
+    void finishFile();
+    void abortFile();
+    void writeMetaData();
+    void writeTag(uint8_t tagType, uint32_t timestamp, const uint8_t* head, size_t headLen,
+                  const uint8_t* body, size_t bodyLen);
+    void emit(const uint8_t* data, size_t len);
+    bool writeBlock(size_t len);
+
+    static void writerTask(void* param);
+};
+
+#endif // FLV_RECORDER_H
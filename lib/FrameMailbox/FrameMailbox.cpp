@@ -0,0 +1,57 @@
+#include "FrameMailbox.h"
+
+FrameMailbox::FrameMailbox()
+    : _slot(nullptr)
+    , _consumer(NULL)
+    , _posted(0)
+    , _taken(0)
+    , _overwrites(0)
+{
+}
+
+FrameMailbox::~FrameMailbox() {
+    clear();
+}
+
+void FrameMailbox::post(SharedFrame* frame) {
+    if (!frame) {
+        return;
+    }
+
+    // acq_rel: the consumer sees the frame contents, and we see the old
+    // frame's state before releasing it
+    SharedFrame* superseded = _slot.exchange(frame, std::memory_order_acq_rel);
+    _posted.fetch_add(1, std::memory_order_relaxed);
+
+    if (superseded) {
+        superseded->release();
+        _overwrites.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    if (_consumer) {
+        xTaskNotifyGive(_consumer);
+    }
+}
+
+SharedFrame* FrameMailbox::take(uint32_t timeoutMs) {
+    SharedFrame* frame = _slot.exchange(nullptr, std::memory_order_acq_rel);
+
+    if (!frame && timeoutMs > 0) {
+        // A notification left over from a frame already taken on the fast
+        // path can wake us early with an empty slot; that reads as a timeout
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(timeoutMs));
+        frame = _slot.exchange(nullptr, std::memory_order_acq_rel);
+    }
+
+    if (frame) {
+        _taken.fetch_add(1, std::memory_order_relaxed);
+    }
+    return frame;
+}
+
+void FrameMailbox::clear() {
+    SharedFrame* frame = _slot.exchange(nullptr, std::memory_order_acq_rel);
+    if (frame) {
+        frame->release();
+    }
+}
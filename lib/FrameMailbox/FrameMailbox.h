@@ -0,0 +1,51 @@
+#ifndef FRAME_MAILBOX_H
+#define FRAME_MAILBOX_H
+
+#include <stdint.h>
+#include <atomic>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <SharedFrame.h>
+
+// Latest-value handoff of camera frames from one producer task to one
+// consumer task, across cores and without locks.
+//
+// The mailbox holds at most one frame. post() swaps the new frame in and
+// releases whatever the consumer had not picked up yet, so its buffer goes
+// back to the driver immediately and the consumer always gets the newest
+// frame. Together with the frame each side is working on, this is a triple
+// buffer. The consumer sleeps on its task notification until a frame arrives.
+
+class FrameMailbox {
+public:
+    FrameMailbox();
+    ~FrameMailbox();
+
+    // Task woken by post() (call from the consumer task before take())
+    void setConsumer(TaskHandle_t task) { _consumer = task; }
+
+    // Publish a frame, adopting the caller's reference
+    void post(SharedFrame* frame);
+
+    // Newest frame, waiting up to timeoutMs for one. The caller owns the
+    // returned reference; nullptr on timeout.
+    SharedFrame* take(uint32_t timeoutMs);
+
+    // Release any frame waiting in the mailbox
+    void clear();
+
+    // Statistics
+    uint32_t getPosted() const { return _posted.load(std::memory_order_relaxed); }
+    uint32_t getTaken() const { return _taken.load(std::memory_order_relaxed); }
+    uint32_t getOverwrites() const { return _overwrites.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<SharedFrame*> _slot;
+    TaskHandle_t _consumer;
+
+    std::atomic<uint32_t> _posted;
+    std::atomic<uint32_t> _taken;
+    std::atomic<uint32_t> _overwrites;     // Frames replaced before the consumer took them
+};
+
+#endif // FRAME_MAILBOX_H
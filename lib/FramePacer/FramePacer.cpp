@@ -0,0 +1,119 @@
+#include <Arduino.h>
+#include <esp_timer.h>
+#include "FramePacer.h"
+
+static uint64_t defaultClock() {
+    return (uint64_t)esp_timer_get_time();
+}
+
+// Sleep to the nearest tick: deadlines are absolute, so rounding here only
+// adds jitter, never drift
+static void defaultSleep(uint32_t micros) {
+    const uint32_t tickMicros = portTICK_PERIOD_MS * 1000;
+    TickType_t ticks = (micros + tickMicros / 2) / tickMicros;
+    if (ticks > 0) {
+        vTaskDelay(ticks);
+    }
+}
+
+FramePacer::FramePacer(ClockFunction clock, SleepFunction sleep)
+    : _clock(clock ? clock : defaultClock)
+    , _sleep(sleep ? sleep : defaultSleep)
+{
+    begin(30.0f);
+}
+
+void FramePacer::begin(float fps) {
+    _fpsMilli = fps > 0.001f ? (uint32_t)(fps * 1000.0f + 0.5f) : 1;
+    _started = false;
+    _start = 0;
+    _index = 0;
+    _lastWake = 0;
+    _lastDeadline = 0;
+    memset(_histogram, 0, sizeof(_histogram));
+    _maxJitter = 0;
+    _frames = 0;
+    _skipped = 0;
+}
+
+uint64_t FramePacer::deadline(uint64_t index) const {
+    return _start + index * 1000000000ULL / _fpsMilli;
+}
+
+uint32_t FramePacer::wait() {
+    uint64_t now = _clock();
+
+    // First call anchors the grid
+    if (!_started) {
+        _started = true;
+        _start = now;
+        _index = 0;
+        _lastWake = now;
+        _lastDeadline = now;
+        _frames++;
+        return 0;
+    }
+
+    _index++;
+    uint32_t skipped = 0;
+    uint64_t due = deadline(_index);
+
+    if (now < due) {
+        _sleep((uint32_t)(due - now));
+    } else {
+        // Behind schedule: jump to the most recent slot and run now. Slots
+        // missed entirely are dropped, so the loop never bursts to catch up.
+        uint64_t latest = (now - _start) * _fpsMilli / 1000000000ULL;
+        if (latest > _index) {
+            skipped = (uint32_t)(latest - _index);
+            _index = latest;
+            due = deadline(_index);
+        }
+    }
+
+    uint64_t wake = _clock();
+    int64_t interval = (int64_t)(wake - _lastWake);
+    int64_t scheduled = (int64_t)(due - _lastDeadline);
+    int64_t jitter = interval > scheduled ? interval - scheduled : scheduled - interval;
+    recordJitter(jitter > UINT32_MAX ? UINT32_MAX : (uint32_t)jitter);
+
+    _lastWake = wake;
+    _lastDeadline = due;
+    _frames++;
+    _skipped += skipped;
+    return skipped;
+}
+
+void FramePacer::recordJitter(uint32_t jitter) {
+    uint32_t bucket = jitter / FRAME_PACER_BUCKET_US;
+    if (bucket > FRAME_PACER_BUCKETS) {
+        bucket = FRAME_PACER_BUCKETS;
+    }
+    _histogram[bucket]++;
+    if (jitter > _maxJitter) {
+        _maxJitter = jitter;
+    }
+}
+
+uint32_t FramePacer::getJitterPercentile(float percentile) const {
+    uint32_t total = 0;
+    for (int i = 0; i <= FRAME_PACER_BUCKETS; i++) {
+        total += _histogram[i];
+    }
+    if (total == 0) {
+        return 0;
+    }
+
+    uint32_t rank = (uint32_t)(percentile / 100.0f * (float)total + 0.5f);
+    if (rank < 1) rank = 1;
+    if (rank > total) rank = total;
+
+    uint32_t seen = 0;
+    for (int i = 0; i < FRAME_PACER_BUCKETS; i++) {
+        seen += _histogram[i];
+        if (seen >= rank) {
+            return (uint32_t)(i + 1) * FRAME_PACER_BUCKET_US;
+        }
+    }
+    return _maxJitter;
+}
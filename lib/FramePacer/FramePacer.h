@@ -0,0 +1,69 @@
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Paces a capture loop on absolute deadlines.
+//
+// Deadline n is start + n / fps, computed exactly from the frame index, so
+// sleep granularity and time spent capturing never accumulate into drift.
+// When the loop falls behind by more than a period, the missed slots are
+// skipped rather than run back to back.
+//
+// The clock and sleep functions are injectable so the pacer can run against
+// a simulated clock.
+
+#define FRAME_PACER_BUCKETS         64
+#define FRAME_PACER_BUCKET_US       250     // Histogram covers 0-16 ms of jitter
+
+class FramePacer {
+public:
+    typedef uint64_t (*ClockFunction)();            // Monotonic microseconds
+    typedef void (*SleepFunction)(uint32_t micros);
+
+    FramePacer(ClockFunction clock = nullptr, SleepFunction sleep = nullptr);
+
+    // Target rate; clears statistics
+    void begin(float fps);
+
+    // Restart the deadline grid on the next wait() (e.g. after a pause)
+    void reset() { _started = false; }
+
+    // Sleep until the next deadline. Returns the number of slots skipped
+    // because the caller was more than a period late.
+    uint32_t wait();
+
+    float getTargetFps() const { return _fpsMilli / 1000.0f; }
+    uint64_t getPeriodMicros() const { return 1000000000ULL / _fpsMilli; }
+
+    // Frame-interval jitter: |actual interval - scheduled interval|
+    uint32_t getJitterPercentile(float percentile) const;   // Microseconds (bucket upper edge)
+    uint32_t getMaxJitterMicros() const { return _maxJitter; }
+
+    // Statistics
+    uint32_t getFrames() const { return _frames; }
+    uint32_t getSkipped() const { return _skipped; }
+    uint64_t getSlotIndex() const { return _index; }
+
+private:
+    ClockFunction _clock;
+    SleepFunction _sleep;
+
+    uint32_t _fpsMilli;         // Frame rate in mHz (exact for 30, 29.97, ...)
+    bool _started;
+    uint64_t _start;
+    uint64_t _index;            // Current slot on the grid
+    uint64_t _lastWake;
+    uint64_t _lastDeadline;
+
+    uint32_t _histogram[FRAME_PACER_BUCKETS + 1];   // Last bucket is overflow
+    uint32_t _maxJitter;
+    uint32_t _frames;
+    uint32_t _skipped;
+
+    uint64_t deadline(uint64_t index) const;
+    void recordJitter(uint32_t jitter);
+};
+
+#endif // FRAME_PACER_H
@@ -0,0 +1,565 @@
+#include <string.h>
+#include <math.h>
+#include "JpegCodec.h"
+
+const uint8_t kJpegZigzag[64] = {
+     0,  1,  8, 16,  9,  2,  3, 10,
+    17, 24, 32, 25, 18, 11,  4,  5,
+    12, 19, 26, 33, 40, 48, 41, 34,
+    27, 20, 13,  6,  7, 14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36,
+    29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46,
+    53, 60, 61, 54, 47, 55, 62, 63
+};
+
+static inline uint16_t readU16(const uint8_t* p) {
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+// Number of bits needed for |v| (JPEG magnitude category)
+static inline int magnitudeBits(int32_t v) {
+    uint32_t a = v < 0 ? -v : v;
+    return a ? 32 - __builtin_clz(a) : 0;
+}
+
+// ============================================================================
+// Huffman tables
+// ============================================================================
+
+void JpegHuffTable::build() {
+    uint16_t huffCode[256];
+    uint8_t huffSize[256];
+
+    memset(lookup, 0, sizeof(lookup));
+    memset(size, 0, sizeof(size));
+
+    uint16_t c = 0;
+    int k = 0;
+    for (int l = 1; l <= 16; l++) {
+        valPtr[l] = k;
+        minCode[l] = c;
+        for (int i = 0; i < bits[l]; i++) {
+            huffCode[k] = c++;
+            huffSize[k] = (uint8_t)l;
+            k++;
+        }
+        maxCode[l] = bits[l] ? (int32_t)c - 1 : -1;
+        c <<= 1;
+    }
+    maxCode[17] = INT32_MAX;
+
+    for (int i = 0; i < count; i++) {
+        uint8_t sym = vals[i];
+        code[sym] = huffCode[i];
+        size[sym] = huffSize[i];
+
+        if (huffSize[i] <= 9) {
+            int shift = 9 - huffSize[i];
+            uint16_t base = huffCode[i] << shift;
+            for (int j = 0; j < (1 << shift); j++) {
+                lookup[base + j] = (uint16_t)((huffSize[i] << 8) | sym);
+            }
+        }
+    }
+}
+
+static bool decodeSymbol(JpegBitReader& reader, const JpegHuffTable& table, uint8_t& sym) {
+    uint32_t bits = reader.peek(16);
+    uint16_t entry = table.lookup[bits >> 7];
+    if (entry) {
+        reader.skip(entry >> 8);
+        sym = entry & 0xFF;
+        return true;
+    }
+
+    for (int l = 10; l <= 16; l++) {
+        int32_t code = (int32_t)(bits >> (16 - l));
+        if (code <= table.maxCode[l]) {
+            reader.skip(l);
+            sym = table.vals[table.valPtr[l] + code - table.minCode[l]];
+            return true;
+        }
+    }
+    return false;
+}
+
+static inline int32_t extendSign(uint32_t v, int s) {
+    return v < (1u << (s - 1)) ? (int32_t)v - (1 << s) + 1 : (int32_t)v;
+}
+
+// ============================================================================
+// Header parsing
+// ============================================================================
+
+static bool parseDQT(const uint8_t* p, size_t len, JpegInfo& info) {
+    size_t i = 0;
+    while (i < len) {
+        uint8_t pq = p[i] >> 4;
+        uint8_t tq = p[i] & 0x0F;
+        i++;
+        if (tq > 3 || i + (pq ? 128 : 64) > len) {
+            return false;
+        }
+        for (int k = 0; k < 64; k++) {
+            info.quant[tq][k] = pq ? readU16(&p[i + 2 * k]) : p[i + k];
+        }
+        info.quantPresent[tq] = true;
+        info.quantPrecision[tq] = pq;
+        i += pq ? 128 : 64;
+    }
+    return true;
+}
+
+static bool parseDHT(const uint8_t* p, size_t len, JpegInfo& info) {
+    size_t i = 0;
+    while (i + 17 <= len) {
+        uint8_t tc = p[i] >> 4;
+        uint8_t th = p[i] & 0x0F;
+        if (tc > 1 || th > 3) {
+            return false;
+        }
+        JpegHuffTable& table = tc ? info.ac[th] : info.dc[th];
+        table.bits[0] = 0;
+        uint16_t total = 0;
+        for (int l = 1; l <= 16; l++) {
+            table.bits[l] = p[i + l];
+            total += table.bits[l];
+        }
+        i += 17;
+        if (total > 256 || i + total > len) {
+            return false;
+        }
+        memcpy(table.vals, &p[i], total);
+        table.count = total;
+        table.present = true;
+        table.build();
+        i += total;
+    }
+    return true;
+}
+
+static bool parseSOF(const uint8_t* p, size_t len, JpegInfo& info) {
+    if (len < 6 || p[0] != 8) {
+        return false;   // 8-bit precision only
+    }
+    info.height = readU16(&p[1]);
+    info.width = readU16(&p[3]);
+    info.numComponents = p[5];
+    if (info.numComponents == 0 || info.numComponents > JPEG_MAX_COMPONENTS ||
+        len < 6 + 3u * info.numComponents) {
+        return false;
+    }
+
+    info.hmax = info.vmax = 1;
+    for (int c = 0; c < info.numComponents; c++) {
+        JpegComponent& comp = info.components[c];
+        comp.id = p[6 + 3 * c];
+        comp.h = p[7 + 3 * c] >> 4;
+        comp.v = p[7 + 3 * c] & 0x0F;
+        comp.tq = p[8 + 3 * c] & 0x03;
+        if (comp.h == 0 || comp.v == 0) {
+            return false;
+        }
+        if (comp.h > info.hmax) info.hmax = comp.h;
+        if (comp.v > info.vmax) info.vmax = comp.v;
+    }
+
+    // A single-component scan is non-interleaved: one block per MCU
+    if (info.numComponents == 1) {
+        info.components[0].h = info.components[0].v = 1;
+        info.hmax = info.vmax = 1;
+    }
+
+    info.mcuWidth = 8 * info.hmax;
+    info.mcuHeight = 8 * info.vmax;
+    info.mcusX = (info.width + info.mcuWidth - 1) / info.mcuWidth;
+    info.mcusY = (info.height + info.mcuHeight - 1) / info.mcuHeight;
+
+    info.blocksPerMcu = 0;
+    for (int c = 0; c < info.numComponents; c++) {
+        info.blocksPerMcu += info.components[c].h * info.components[c].v;
+    }
+    return info.blocksPerMcu <= JPEG_MAX_BLOCKS_MCU;
+}
+
+static bool parseSOS(const uint8_t* p, size_t len, JpegInfo& info) {
+    uint8_t ns = p[0];
+    if (ns != info.numComponents || len < 4 + 2u * ns) {
+        return false;   // Single interleaved scan only
+    }
+    // Blocks are coded in scan order, so keep the components in that order
+    JpegComponent ordered[JPEG_MAX_COMPONENTS];
+    for (int i = 0; i < ns; i++) {
+        uint8_t id = p[1 + 2 * i];
+        uint8_t tables = p[2 + 2 * i];
+        bool found = false;
+        for (int c = 0; c < info.numComponents && !found; c++) {
+            if (info.components[c].id == id) {
+                ordered[i] = info.components[c];
+                ordered[i].td = (tables >> 4) & 0x03;
+                ordered[i].ta = tables & 0x03;
+                found = true;
+            }
+        }
+        if (!found) {
+            return false;
+        }
+    }
+    memcpy(info.components, ordered, ns * sizeof(JpegComponent));
+    const uint8_t* spectral = &p[1 + 2 * ns];
+    return spectral[0] == 0 && spectral[1] == 63 && spectral[2] == 0;
+}
+
+bool jpegParse(const uint8_t* data, size_t len, JpegInfo& info) {
+    memset(&info, 0, sizeof(info));
+
+    if (!data || len < 4 || data[0] != 0xFF || data[1] != JPEG_SOI) {
+        return false;
+    }
+
+    bool haveFrame = false;
+    size_t pos = 2;
+    while (pos + 4 <= len) {
+        if (data[pos] != 0xFF) {
+            return false;
+        }
+        uint8_t marker = data[pos + 1];
+        if (marker == 0xFF) {
+            pos++;      // Fill byte
+            continue;
+        }
+
+        uint16_t segLen = readU16(&data[pos + 2]);
+        if (segLen < 2 || pos + 2 + segLen > len) {
+            return false;
+        }
+        const uint8_t* seg = &data[pos + 4];
+        size_t bodyLen = segLen - 2;
+
+        switch (marker) {
+            case JPEG_DQT:
+                if (!parseDQT(seg, bodyLen, info)) return false;
+                break;
+            case JPEG_DHT:
+                if (!parseDHT(seg, bodyLen, info)) return false;
+                break;
+            case JPEG_SOF0:
+            case JPEG_SOF1:
+                if (!parseSOF(seg, bodyLen, info)) return false;
+                haveFrame = true;
+                break;
+            case JPEG_DRI:
+                if (bodyLen < 2) return false;
+                info.restartInterval = readU16(seg);
+                break;
+            case JPEG_SOS:
+                if (!haveFrame || !parseSOS(seg, bodyLen, info)) return false;
+                info.scanOffset = pos + 2 + segLen;
+                info.scanEnd = jpegFindScanEnd(data, len, info.scanOffset);
+                for (int c = 0; c < info.numComponents; c++) {
+                    const JpegComponent& comp = info.components[c];
+                    if (!info.quantPresent[comp.tq] || !info.dc[comp.td].present ||
+                        !info.ac[comp.ta].present) {
+                        return false;
+                    }
+                }
+                return true;
+            default:
+                // Progressive, lossless and arithmetic-coded frames are not supported
+                if (marker >= 0xC2 && marker <= 0xCF && marker != JPEG_DHT && marker != 0xC8 &&
+                    marker != 0xCC) {
+                    return false;
+                }
+                break;
+        }
+        pos += 2 + segLen;
+    }
+    return false;
+}
+
+size_t jpegFindScanEnd(const uint8_t* data, size_t len, size_t scanOffset) {
+    for (size_t i = scanOffset; i + 1 < len; i++) {
+        if (data[i] != 0xFF) {
+            continue;
+        }
+        uint8_t next = data[i + 1];
+        if (next != 0x00 && next != 0xFF && (next & 0xF8) != JPEG_RST0) {
+            return i;
+        }
+    }
+    return len;
+}
+
+// ============================================================================
+// Bit reader
+// ============================================================================
+
+void JpegBitReader::begin(const uint8_t* data, size_t len, size_t offset) {
+    _data = data;
+    _len = len;
+    _pos = offset;
+    _acc = 0;
+    _bits = 0;
+    _marker = 0;
+    _loadedCount = 0;
+}
+
+void JpegBitReader::fill() {
+    while (_bits <= 56 && !_marker) {
+        if (_pos >= _len) {
+            _marker = JPEG_EOI;     // Truncated frame: behave as if EOI followed
+            break;
+        }
+
+        uint8_t b = _data[_pos];
+        size_t at = _pos;
+        if (b == 0xFF) {
+            uint8_t next = _pos + 1 < _len ? _data[_pos + 1] : JPEG_EOI;
+            if (next == 0x00) {
+                _pos += 2;
+            } else if (next == 0xFF) {
+                _pos++;
+                continue;
+            } else {
+                _marker = next;
+                break;
+            }
+        } else {
+            _pos++;
+        }
+
+        _acc |= (uint64_t)b << (56 - _bits);
+        _bits += 8;
+        _loadedAt[_loadedCount++ & 7] = at;
+    }
+}
+
+uint32_t JpegBitReader::peek(int n) {
+    if (_bits < n) {
+        fill();
+    }
+    return (uint32_t)(_acc >> (64 - n));
+}
+
+uint32_t JpegBitReader::get(int n) {
+    if (n == 0) {
+        return 0;
+    }
+    uint32_t v = peek(n);
+    skip(n);
+    return v;
+}
+
+bool JpegBitReader::consumeRestart() {
+    // Anything left in the current byte is 1-padding
+    _acc = 0;
+    _bits = 0;
+    fill();
+    if (_marker < JPEG_RST0 || _marker > JPEG_RST0 + 7) {
+        return false;
+    }
+    _pos += 2;
+    _marker = 0;
+    return true;
+}
+
+void JpegBitReader::position(size_t& rawOffset, int& bitOffset) const {
+    if (_bits <= 0) {
+        rawOffset = _pos;
+        bitOffset = 0;
+        return;
+    }
+    int back = (_bits + 7) / 8 - 1;     // Loaded bytes after the current one
+    rawOffset = _loadedAt[(uint8_t)(_loadedCount - 1 - back) & 7];
+    bitOffset = (8 - (_bits & 7)) & 7;
+}
+
+// ============================================================================
+// Bit writer
+// ============================================================================
+
+void JpegBitWriter::begin(uint8_t* out, size_t capacity, size_t offset) {
+    _out = out;
+    _capacity = capacity;
+    _pos = offset;
+    _acc = 0;
+    _bits = 0;
+    _overflow = offset > capacity;
+}
+
+void JpegBitWriter::emitByte(uint8_t b) {
+    if (_pos + 2 > _capacity) {
+        _overflow = true;
+        return;
+    }
+    _out[_pos++] = b;
+    if (b == 0xFF) {
+        _out[_pos++] = 0x00;
+    }
+}
+
+void JpegBitWriter::put(uint32_t bits, int n) {
+    if (n <= 0) {
+        return;
+    }
+    _acc = (_acc << n) | (bits & ((1u << n) - 1));
+    _bits += n;
+    while (_bits >= 8) {
+        _bits -= 8;
+        emitByte((uint8_t)(_acc >> _bits));
+    }
+    _acc &= (1u << _bits) - 1;
+}
+
+void JpegBitWriter::flush() {
+    if (_bits > 0) {
+        put(0xFF, 8 - _bits);
+    }
+}
+
+void JpegBitWriter::putMarker(uint8_t marker) {
+    flush();
+    uint8_t bytes[2] = { 0xFF, marker };
+    putBytes(bytes, 2);
+}
+
+void JpegBitWriter::putBytes(const uint8_t* data, size_t len) {
+    if (_pos + len > _capacity) {
+        _overflow = true;
+        return;
+    }
+    memcpy(&_out[_pos], data, len);
+    _pos += len;
+}
+
+// ============================================================================
+// Block coding
+// ============================================================================
+
+bool jpegDecodeBlock(JpegBitReader& reader, const JpegHuffTable& dc, const JpegHuffTable& ac,
+                     int16_t& dcPred, int16_t coeffs[64]) {
+    memset(coeffs, 0, 64 * sizeof(int16_t));
+
+    uint8_t s;
+    if (!decodeSymbol(reader, dc, s) || s > 11) {
+        return false;
+    }
+    int32_t diff = s ? extendSign(reader.get(s), s) : 0;
+    dcPred = (int16_t)(dcPred + diff);
+    coeffs[0] = dcPred;
+
+    for (int k = 1; k < 64; k++) {
+        uint8_t sym;
+        if (!decodeSymbol(reader, ac, sym)) {
+            return false;
+        }
+        int run = sym >> 4;
+        int size = sym & 0x0F;
+        if (size == 0) {
+            if (run != 15) {
+                break;          // EOB
+            }
+            k += 15;            // ZRL
+            continue;
+        }
+        k += run;
+        if (k > 63) {
+            return false;
+        }
+        coeffs[k] = (int16_t)extendSign(reader.get(size), size);
+    }
+
+    // Running into a marker mid-block means the data is corrupt
+    return reader.bitsAvailable() >= 0;
+}
+
+bool jpegEncodeBlock(JpegBitWriter& writer, const JpegHuffTable& dc, const JpegHuffTable& ac,
+                     int16_t& dcPred, const int16_t coeffs[64], bool lossy) {
+    int32_t diff = coeffs[0] - dcPred;
+    int s = magnitudeBits(diff);
+    if (!dc.size[s]) {
+        return false;
+    }
+    dcPred = coeffs[0];
+    writer.put(dc.code[s], dc.size[s]);
+    writer.put(diff < 0 ? diff - 1 : diff, s);
+
+    int run = 0;
+    for (int k = 1; k < 64; k++) {
+        int32_t v = coeffs[k];
+        if (v == 0) {
+            run++;
+            continue;
+        }
+
+        int size = magnitudeBits(v);
+        while (run > 15) {
+            writer.put(ac.code[0xF0], ac.size[0xF0]);
+            run -= 16;
+        }
+        uint8_t sym = (uint8_t)((run << 4) | size);
+        if (size > 10 || !ac.size[sym]) {
+            if (!lossy) {
+                return false;
+            }
+            run++;
+            continue;
+        }
+        writer.put(ac.code[sym], ac.size[sym]);
+        writer.put(v < 0 ? v - 1 : v, size);
+        run = 0;
+    }
+
+    if (run > 0) {
+        writer.put(ac.code[0x00], ac.size[0x00]);
+    }
+    return true;
+}
+
+// ============================================================================
+// Forward DCT
+// ============================================================================
+
+void jpegForwardDCT(const uint8_t* pixels, size_t stride, const uint16_t quant[64],
+                    int16_t coeffs[64]) {
+    static float basis[8][8];       // basis[u][x] = C(u)/2 * cos((2x+1)u*pi/16)
+    static bool basisReady = false;
+    if (!basisReady) {
+        for (int u = 0; u < 8; u++) {
+            float cu = u == 0 ? (float)M_SQRT1_2 : 1.0f;
+            for (int x = 0; x < 8; x++) {
+                basis[u][x] = 0.5f * cu * cosf((2 * x + 1) * u * (float)M_PI / 16.0f);
+            }
+        }
+        basisReady = true;
+    }
+
+    float rows[8][8];
+    for (int y = 0; y < 8; y++) {
+        const uint8_t* row = pixels + y * stride;
+        for (int u = 0; u < 8; u++) {
+            float sum = 0.0f;
+            for (int x = 0; x < 8; x++) {
+                sum += basis[u][x] * ((int)row[x] - 128);
+            }
+            rows[y][u] = sum;
+        }
+    }
+
+    float natural[64];
+    for (int u = 0; u < 8; u++) {
+        for (int v = 0; v < 8; v++) {
+            float sum = 0.0f;
+            for (int y = 0; y < 8; y++) {
+                sum += basis[v][y] * rows[y][u];
+            }
+            natural[v * 8 + u] = sum;
+        }
+    }
+
+    for (int zz = 0; zz < 64; zz++) {
+        float q = natural[kJpegZigzag[zz]] / (quant[zz] ? quant[zz] : 1);
+        coeffs[zz] = (int16_t)lroundf(q);
+    }
+}
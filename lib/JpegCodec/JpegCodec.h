@@ -0,0 +1,165 @@
+#ifndef JPEG_CODEC_H
+#define JPEG_CODEC_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Baseline JPEG bitstream primitives for the OV2640's hardware JPEG output.
+//
+// This is not an image decoder: it parses headers, walks the entropy-coded
+// segment block by block (Huffman level only, no IDCT) and re-emits it. That
+// is enough to splice new blocks into a frame, strip or restore tables, and
+// packetise scan data without ever touching pixels.
+
+#define JPEG_MAX_COMPONENTS   3
+#define JPEG_MAX_BLOCKS_MCU   10
+
+// JPEG markers
+#define JPEG_SOI   0xD8
+#define JPEG_EOI   0xD9
+#define JPEG_SOF0  0xC0
+#define JPEG_SOF1  0xC1
+#define JPEG_DHT   0xC4
+#define JPEG_SOS   0xDA
+#define JPEG_DQT   0xDB
+#define JPEG_DRI   0xDD
+#define JPEG_COM   0xFE
+#define JPEG_RST0  0xD0
+#define JPEG_APP0  0xE0
+
+// Zigzag position -> natural (row-major) coefficient index
+extern const uint8_t kJpegZigzag[64];
+
+struct JpegHuffTable {
+    uint8_t bits[17];           // bits[n] = number of codes of length n
+    uint8_t vals[256];
+    uint16_t count;
+    bool present;
+
+    // Decoder: 9-bit fast lookup plus canonical fallback (JPEG F.2.2.3)
+    uint16_t lookup[512];       // (length << 8) | symbol, 0 when code > 9 bits
+    int32_t maxCode[18];
+    int32_t valPtr[17];
+    uint16_t minCode[17];
+
+    // Encoder: code and length per symbol (length 0 = symbol not in table)
+    uint16_t code[256];
+    uint8_t size[256];
+
+    void build();
+};
+
+struct JpegComponent {
+    uint8_t id;
+    uint8_t h;                  // Horizontal sampling factor
+    uint8_t v;                  // Vertical sampling factor
+    uint8_t tq;                 // Quantisation table index
+    uint8_t td;                 // DC Huffman table index (from SOS)
+    uint8_t ta;                 // AC Huffman table index (from SOS)
+};
+
+struct JpegInfo {
+    uint16_t width;
+    uint16_t height;
+    uint8_t numComponents;
+    JpegComponent components[JPEG_MAX_COMPONENTS];
+    uint8_t hmax;
+    uint8_t vmax;
+    uint16_t mcuWidth;          // Pixels
+    uint16_t mcuHeight;
+    uint16_t mcusX;
+    uint16_t mcusY;
+    uint8_t blocksPerMcu;
+    uint16_t restartInterval;   // MCUs between RST markers (0 = none)
+
+    uint16_t quant[4][64];      // Zigzag order, as stored in DQT
+    bool quantPresent[4];
+    uint8_t quantPrecision[4];  // 0 = 8-bit, 1 = 16-bit entries
+    JpegHuffTable dc[4];
+    JpegHuffTable ac[4];
+
+    size_t scanOffset;          // First byte of entropy-coded data
+    size_t scanEnd;             // Offset of the marker that ends the scan (EOI)
+};
+
+// Parse headers up to the start of scan. Tables are expected before SOS (the
+// OV2640 always writes them); returns false for progressive or malformed data.
+bool jpegParse(const uint8_t* data, size_t len, JpegInfo& info);
+
+// Locate the EOI marker after the scan (skips stuffed bytes and RST markers)
+size_t jpegFindScanEnd(const uint8_t* data, size_t len, size_t scanOffset);
+
+// Reads the entropy-coded segment, removing byte stuffing. Stops at the next
+// marker; bitsAvailable() then reports the real data bits still buffered.
+class JpegBitReader {
+public:
+    void begin(const uint8_t* data, size_t len, size_t offset);
+
+    uint32_t peek(int n);
+    void skip(int n) { _acc <<= n; _bits -= n; }
+    uint32_t get(int n);
+    int bitsAvailable() { fill(); return _bits; }
+
+    // Marker handling at restart boundaries
+    bool atMarker() const { return _marker != 0; }
+    uint8_t marker() const { return _marker; }
+    bool consumeRestart();      // Drop padding bits and an RSTn marker
+
+    // Raw-stream position of the next unread bit: byte offset and bit index
+    void position(size_t& rawOffset, int& bitOffset) const;
+    size_t rawOffset() const { return _pos; }
+
+private:
+    const uint8_t* _data;
+    size_t _len;
+    size_t _pos;                // Next raw byte to load
+    uint64_t _acc;              // Left-aligned bit accumulator
+    int _bits;
+    uint8_t _marker;
+    size_t _loadedAt[8];        // Raw offsets of the bytes in _acc (ring)
+    uint8_t _loadedCount;
+
+    void fill();
+};
+
+// Writes an entropy-coded segment with byte stuffing into a caller buffer
+class JpegBitWriter {
+public:
+    void begin(uint8_t* out, size_t capacity, size_t offset);
+
+    void put(uint32_t bits, int n);
+    void flush();                           // Pad the final byte with 1s
+    void putMarker(uint8_t marker);         // Flush, then 0xFF marker
+    void putBytes(const uint8_t* data, size_t len);
+
+    size_t length() const { return _pos; }
+    int bitOffset() const { return _bits; }  // Bits already in the next byte
+    bool overflowed() const { return _overflow; }
+
+private:
+    uint8_t* _out;
+    size_t _capacity;
+    size_t _pos;
+    uint32_t _acc;
+    int _bits;
+    bool _overflow;
+
+    void emitByte(uint8_t b);
+};
+
+// Decode one 8x8 block into zigzag-ordered coefficients. dcPred carries the
+// component's DC predictor (absolute DC of the previous block).
+bool jpegDecodeBlock(JpegBitReader& reader, const JpegHuffTable& dc, const JpegHuffTable& ac,
+                     int16_t& dcPred, int16_t coeffs[64]);
+
+// Encode one zigzag-ordered block. With lossy set, coefficients whose symbol
+// is missing from the table are dropped instead of failing (for synthesised
+// blocks; decoded blocks always re-encode exactly).
+bool jpegEncodeBlock(JpegBitWriter& writer, const JpegHuffTable& dc, const JpegHuffTable& ac,
+                     int16_t& dcPred, const int16_t coeffs[64], bool lossy = false);
+
+// Forward DCT of an 8x8 block of 8-bit samples, quantised with a zigzag table
+void jpegForwardDCT(const uint8_t* pixels, size_t stride, const uint16_t quant[64],
+                    int16_t coeffs[64]);
+
+#endif // JPEG_CODEC_H
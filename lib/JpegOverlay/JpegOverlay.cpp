@@ -0,0 +1,436 @@
+#include <Arduino.h>
+#include "JpegOverlay.h"
+
+#define OVERLAY_BACKGROUND  16      // Video-range black
+#define OVERLAY_FOREGROUND  235     // Video-range white
+#define GLYPH_WIDTH         5
+#define GLYPH_HEIGHT        7
+#define CELL_WIDTH          6
+#define CELL_HEIGHT         8
+
+// 5x7 glyphs for ASCII 0x20-0x5F, one byte per column, LSB at the top.
+// Lowercase letters are drawn with their uppercase glyphs.
+static const uint8_t kFont5x7[64][GLYPH_WIDTH] = {
+    {0x00, 0x00, 0x00, 0x00, 0x00},  // ' '
+    {0x00, 0x00, 0x5F, 0x00, 0x00},  // '!'
+    {0x00, 0x00, 0x00, 0x00, 0x00},  // '"'
+    {0x14, 0x7F, 0x14, 0x7F, 0x14},  // '#'
+    {0x00, 0x00, 0x00, 0x00, 0x00},  // '$'
+    {0x23, 0x13, 0x08, 0x64, 0x62},  // '%'
+    {0x00, 0x00, 0x00, 0x00, 0x00},  // '&'
+    {0x00, 0x00, 0x00, 0x00, 0x00},  // '''
+    {0x00, 0x1C, 0x22, 0x41, 0x00},  // '('
+    {0x00, 0x41, 0x22, 0x1C, 0x00},  // ')'
+    {0x00, 0x00, 0x00, 0x00, 0x00},  // '*'
+    {0x08, 0x08, 0x3E, 0x08, 0x08},  // '+'
+    {0x00, 0x50, 0x30, 0x00, 0x00},  // ','
+    {0x08, 0x08, 0x08, 0x08, 0x08},  // '-'
+    {0x00, 0x60, 0x60, 0x00, 0x00},  // '.'
+    {0x20, 0x10, 0x08, 0x04, 0x02},  // '/'
+    {0x3E, 0x51, 0x49, 0x45, 0x3E},  // '0'
+    {0x00, 0x42, 0x7F, 0x40, 0x00},  // '1'
+    {0x42, 0x61, 0x51, 0x49, 0x46},  // '2'
+    {0x21, 0x41, 0x45, 0x4B, 0x31},  // '3'
+    {0x18, 0x14, 0x12, 0x7F, 0x10},  // '4'
+    {0x27, 0x45, 0x45, 0x45, 0x39},  // '5'
+    {0x3C, 0x4A, 0x49, 0x49, 0x30},  // '6'
+    {0x01, 0x71, 0x09, 0x05, 0x03},  // '7'
+    {0x36, 0x49, 0x49, 0x49, 0x36},  // '8'
+    {0x06, 0x49, 0x49, 0x29, 0x1E},  // '9'
+    {0x00, 0x36, 0x36, 0x00, 0x00},  // ':'
+    {0x00, 0x00, 0x00, 0x00, 0x00},  // ';'
+    {0x00, 0x00, 0x00, 0x00, 0x00},  // '<'
+    {0x14, 0x14, 0x14, 0x14, 0x14},  // '='
+    {0x00, 0x00, 0x00, 0x00, 0x00},  // '>'
+    {0x00, 0x00, 0x00, 0x00, 0x00},  // '?'
+    {0x00, 0x00, 0x00, 0x00, 0x00},  // '@'
+    {0x7E, 0x11, 0x11, 0x11, 0x7E},  // 'A'
+    {0x7F, 0x49, 0x49, 0x49, 0x36},  // 'B'
+    {0x3E, 0x41, 0x41, 0x41, 0x22},  // 'C'
+    {0x7F, 0x41, 0x41, 0x22, 0x1C},  // 'D'
+    {0x7F, 0x49, 0x49, 0x49, 0x41},  // 'E'
+    {0x7F, 0x09, 0x09, 0x01, 0x01},  // 'F'
+    {0x3E, 0x41, 0x49, 0x49, 0x7A},  // 'G'
+    {0x7F, 0x08, 0x08, 0x08, 0x7F},  // 'H'
+    {0x00, 0x41, 0x7F, 0x41, 0x00},  // 'I'
+    {0x20, 0x40, 0x41, 0x3F, 0x01},  // 'J'
+    {0x7F, 0x08, 0x14, 0x22, 0x41},  // 'K'
+    {0x7F, 0x40, 0x40, 0x40, 0x40},  // 'L'
+    {0x7F, 0x02, 0x04, 0x02, 0x7F},  // 'M'
+    {0x7F, 0x04, 0x08, 0x10, 0x7F},  // 'N'
+    {0x3E, 0x41, 0x41, 0x41, 0x3E},  // 'O'
+    {0x7F, 0x09, 0x09, 0x09, 0x06},  // 'P'
+    {0x3E, 0x41, 0x51, 0x21, 0x5E},  // 'Q'
+    {0x7F, 0x09, 0x19, 0x29, 0x46},  // 'R'
+    {0x46, 0x49, 0x49, 0x49, 0x31},  // 'S'
+    {0x01, 0x01, 0x7F, 0x01, 0x01},  // 'T'
+    {0x3F, 0x40, 0x40, 0x40, 0x3F},  // 'U'
+    {0x1F, 0x20, 0x40, 0x20, 0x1F},  // 'V'
+    {0x7F, 0x20, 0x18, 0x20, 0x7F},  // 'W'
+    {0x63, 0x14, 0x08, 0x14, 0x63},  // 'X'
+    {0x03, 0x04, 0x78, 0x04, 0x03},  // 'Y'
+    {0x61, 0x51, 0x49, 0x45, 0x43},  // 'Z'
+    {0x00, 0x7F, 0x41, 0x41, 0x00},  // '['
+    {0x00, 0x00, 0x00, 0x00, 0x00},  // '\\'
+    {0x00, 0x41, 0x41, 0x7F, 0x00},  // ']'
+    {0x00, 0x00, 0x00, 0x00, 0x00},  // '^'
+    {0x40, 0x40, 0x40, 0x40, 0x40},  // '_'
+};
+
+static const uint8_t* glyphFor(char c) {
+    if (c >= 'a' && c <= 'z') {
+        c = c - 'a' + 'A';
+    }
+    if (c < 0x20 || c > 0x5F) {
+        c = ' ';
+    }
+    return kFont5x7[c - 0x20];
+}
+
+JpegOverlay::JpegOverlay()
+    : _x(0),
+      _y(0),
+      _scale(1),
+      _dirty(true),
+      _mcuCol0(0), _mcuCol1(0),
+      _mcuRow0(0), _mcuRow1(0),
+      _blocks(nullptr),
+      _blockCapacity(0),
+      _cachedWidth(0), _cachedHeight(0), _cachedMcuW(0), _cachedMcuH(0),
+      _cachedQuantHash(0),
+      _lastApplyMicros(0),
+      _framesProcessed(0),
+      _framesFailed(0) {
+    _text[0] = '\0';
+}
+
+JpegOverlay::~JpegOverlay() {
+    free(_blocks);
+}
+
+void JpegOverlay::setPosition(uint16_t x, uint16_t y) {
+    if (x != _x || y != _y) {
+        _x = x;
+        _y = y;
+        _dirty = true;
+    }
+}
+
+void JpegOverlay::setScale(uint8_t scale) {
+    scale = constrain(scale, 1, 4);
+    if (scale != _scale) {
+        _scale = scale;
+        _dirty = true;
+    }
+}
+
+void JpegOverlay::setText(const char* text) {
+    if (!text || strncmp(text, _text, JPEG_OVERLAY_MAX_TEXT) == 0) {
+        return;
+    }
+    strncpy(_text, text, JPEG_OVERLAY_MAX_TEXT);
+    _text[JPEG_OVERLAY_MAX_TEXT] = '\0';
+    _dirty = true;
+}
+
+size_t JpegOverlay::maxOutputSize(size_t inputLen) {
+    // Text blocks are busier than the background they replace; 16 KB covers a
+    // full-width box at scale 2 with worst-case byte stuffing
+    return inputLen + 16384;
+}
+
+size_t JpegOverlay::apply(const uint8_t* jpeg, size_t len, uint8_t* out, size_t outCapacity) {
+    uint32_t startTime = micros();
+    size_t outLen = 0;
+
+    bool ok = _text[0] && jpeg && out && jpegParse(jpeg, len, _info) && computeRegion();
+    if (ok && (_dirty || _info.width != _cachedWidth || _info.height != _cachedHeight ||
+               _info.mcuWidth != _cachedMcuW || _info.mcuHeight != _cachedMcuH ||
+               quantHash() != _cachedQuantHash)) {
+        ok = renderBlocks();
+    }
+    if (ok) {
+        ok = splice(jpeg, len, out, outCapacity, outLen);
+    }
+
+    _lastApplyMicros = micros() - startTime;
+    if (ok) {
+        _framesProcessed++;
+        return outLen;
+    }
+    _framesFailed++;
+    return 0;
+}
+
+bool JpegOverlay::computeRegion() {
+    const JpegInfo& info = _info;
+
+    // Luma must be the full-resolution component
+    if (info.components[0].h != info.hmax || info.components[0].v != info.vmax) {
+        return false;
+    }
+
+    size_t textWidth = (strlen(_text) * CELL_WIDTH + 2) * _scale;
+    size_t textHeight = CELL_HEIGHT * _scale;
+
+    _mcuCol0 = _x / info.mcuWidth;
+    _mcuRow0 = _y / info.mcuHeight;
+    if (_mcuCol0 >= info.mcusX || _mcuRow0 >= info.mcusY) {
+        return false;
+    }
+    _mcuCol1 = min((size_t)info.mcusX - 1, _mcuCol0 + (textWidth + info.mcuWidth - 1) / info.mcuWidth - 1);
+    _mcuRow1 = min((size_t)info.mcusY - 1, _mcuRow0 + (textHeight + info.mcuHeight - 1) / info.mcuHeight - 1);
+    return true;
+}
+
+uint32_t JpegOverlay::quantHash() const {
+    // FNV-1a over the quantisation tables the components use
+    uint32_t hash = 2166136261u;
+    for (int c = 0; c < _info.numComponents; c++) {
+        const uint16_t* q = _info.quant[_info.components[c].tq];
+        for (int k = 0; k < 64; k++) {
+            hash = (hash ^ q[k]) * 16777619u;
+        }
+    }
+    return hash;
+}
+
+bool JpegOverlay::inRegion(uint32_t mcu) const {
+    uint32_t row = mcu / _info.mcusX;
+    uint32_t col = mcu % _info.mcusX;
+    return row >= _mcuRow0 && row <= _mcuRow1 && col >= _mcuCol0 && col <= _mcuCol1;
+}
+
+// Draw the text box into a luma canvas covering the region and transform it
+// into quantised blocks in scan order. Chroma blocks stay zero (neutral grey).
+bool JpegOverlay::renderBlocks() {
+    const JpegInfo& info = _info;
+    const size_t cols = _mcuCol1 - _mcuCol0 + 1;
+    const size_t rows = _mcuRow1 - _mcuRow0 + 1;
+    const size_t width = cols * info.mcuWidth;
+    const size_t height = rows * info.mcuHeight;
+    const size_t blockCount = cols * rows * info.blocksPerMcu;
+
+    if (blockCount > _blockCapacity) {
+        void* blocks = realloc(_blocks, blockCount * sizeof(*_blocks));
+        if (!blocks) {
+            return false;
+        }
+        _blocks = (int16_t (*)[64])blocks;
+        _blockCapacity = blockCount;
+    }
+
+    uint8_t* canvas = (uint8_t*)malloc(width * height);
+    if (!canvas) {
+        return false;
+    }
+    memset(canvas, OVERLAY_BACKGROUND, width * height);
+
+    const size_t originX = _scale;
+    const size_t originY = (height - CELL_HEIGHT * _scale) / 2;
+    for (size_t i = 0; _text[i]; i++) {
+        const uint8_t* glyph = glyphFor(_text[i]);
+        for (int gx = 0; gx < GLYPH_WIDTH; gx++) {
+            for (int gy = 0; gy < GLYPH_HEIGHT; gy++) {
+                if (!(glyph[gx] & (1 << gy))) {
+                    continue;
+                }
+                size_t px = originX + (i * CELL_WIDTH + gx) * _scale;
+                size_t py = originY + gy * _scale;
+                for (int sy = 0; sy < _scale; sy++) {
+                    for (int sx = 0; sx < _scale; sx++) {
+                        if (px + sx < width && py + sy < height) {
+                            canvas[(py + sy) * width + px + sx] = OVERLAY_FOREGROUND;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    size_t b = 0;
+    for (size_t row = 0; row < rows; row++) {
+        for (size_t col = 0; col < cols; col++) {
+            for (int c = 0; c < info.numComponents; c++) {
+                const JpegComponent& comp = info.components[c];
+                for (int by = 0; by < comp.v; by++) {
+                    for (int bx = 0; bx < comp.h; bx++, b++) {
+                        if (c == 0) {
+                            size_t px = col * info.mcuWidth + bx * 8;
+                            size_t py = row * info.mcuHeight + by * 8;
+                            jpegForwardDCT(&canvas[py * width + px], width, info.quant[comp.tq], _blocks[b]);
+                        } else {
+                            memset(_blocks[b], 0, sizeof(_blocks[b]));
+                        }
+                    }
+                }
+            }
+        }
+    }
+    free(canvas);
+
+    _cachedWidth = info.width;
+    _cachedHeight = info.height;
+    _cachedMcuW = info.mcuWidth;
+    _cachedMcuH = info.mcuHeight;
+    _cachedQuantHash = quantHash();
+    _dirty = false;
+    return true;
+}
+
+bool JpegOverlay::splice(const uint8_t* jpeg, size_t len, uint8_t* out, size_t outCapacity, size_t& outLen) {
+    const JpegInfo& info = _info;
+    const uint32_t totalMcus = (uint32_t)info.mcusX * info.mcusY;
+    const uint32_t firstMcu = (uint32_t)_mcuRow0 * info.mcusX + _mcuCol0;
+    const uint32_t lastMcu = (uint32_t)_mcuRow1 * info.mcusX + _mcuCol1;
+    const uint16_t ri = info.restartInterval;
+
+    // One MCU past the box resyncs every predictor. With restart markers, run
+    // on to the next marker instead so the rest can be copied byte for byte.
+    uint32_t endMcu = lastMcu + 2;
+    if (ri) {
+        endMcu = ((lastMcu + 1) / ri + 1) * ri;
+    }
+    endMcu = min(endMcu, totalMcus);
+    const uint32_t regionCols = _mcuCol1 - _mcuCol0 + 1;
+
+    int16_t predIn[JPEG_MAX_COMPONENTS] = {0};
+    int16_t predOut[JPEG_MAX_COMPONENTS] = {0};
+    int16_t coeffs[64];
+
+    JpegBitReader reader;
+    reader.begin(jpeg, len, info.scanOffset);
+
+    // Prefix: walk the MCUs before the box only to find where it starts
+    for (uint32_t mcu = 0; mcu < firstMcu; mcu++) {
+        if (ri && mcu > 0 && mcu % ri == 0) {
+            if (!reader.consumeRestart()) return false;
+            memset(predIn, 0, sizeof(predIn));
+        }
+        for (int c = 0; c < info.numComponents; c++) {
+            const JpegComponent& comp = info.components[c];
+            for (int b = 0; b < comp.h * comp.v; b++) {
+                if (!jpegDecodeBlock(reader, info.dc[comp.td], info.ac[comp.ta], predIn[c], coeffs)) {
+                    return false;
+                }
+            }
+        }
+    }
+    memcpy(predOut, predIn, sizeof(predOut));
+
+    // Headers and prefix are byte-identical; the first partial byte goes
+    // through the bit writer so the band continues at the same bit
+    size_t rawOffset;
+    int bitOffset;
+    reader.position(rawOffset, bitOffset);
+    if (rawOffset > outCapacity) {
+        return false;
+    }
+    memcpy(out, jpeg, rawOffset);
+
+    JpegBitWriter writer;
+    writer.begin(out, outCapacity, rawOffset);
+    if (bitOffset) {
+        writer.put(jpeg[rawOffset] >> (8 - bitOffset), bitOffset);
+    }
+
+    // Band: re-emit at the Huffman level, patching the box and re-basing DC
+    for (uint32_t mcu = firstMcu; mcu < endMcu; mcu++) {
+        if (ri && mcu > 0 && mcu % ri == 0) {
+            if (!reader.consumeRestart()) return false;
+            writer.putMarker(JPEG_RST0 + ((mcu / ri - 1) & 7));
+            memset(predIn, 0, sizeof(predIn));
+            memset(predOut, 0, sizeof(predOut));
+        }
+
+        const bool patched = inRegion(mcu);
+        const uint32_t regionIndex = patched ?
+            ((mcu / info.mcusX - _mcuRow0) * regionCols + (mcu % info.mcusX - _mcuCol0)) : 0;
+        int blockIndex = 0;
+
+        for (int c = 0; c < info.numComponents; c++) {
+            const JpegComponent& comp = info.components[c];
+            const JpegHuffTable& dc = info.dc[comp.td];
+            const JpegHuffTable& ac = info.ac[comp.ta];
+            for (int b = 0; b < comp.h * comp.v; b++, blockIndex++) {
+                if (!jpegDecodeBlock(reader, dc, ac, predIn[c], coeffs)) {
+                    return false;
+                }
+                const int16_t* block = patched ?
+                    _blocks[regionIndex * info.blocksPerMcu + blockIndex] : coeffs;
+                if (!jpegEncodeBlock(writer, dc, ac, predOut[c], block, patched)) {
+                    return false;
+                }
+            }
+        }
+    }
+
+    size_t resume;
+    if (ri && endMcu < totalMcus) {
+        // Stopped on a restart boundary: everything after it is identical
+        if (!reader.consumeRestart()) return false;
+        writer.putMarker(JPEG_RST0 + ((endMcu / ri - 1) & 7));
+        resume = reader.rawOffset();
+    } else {
+        // Predictors agree again, so the remaining bits are unchanged and only
+        // need shifting to the new alignment. The source's 1-padding before
+        // EOI must not be carried along when the shift would push it into a
+        // byte of its own: that is when the last `shift` bits are padding.
+        // Only a trailing run of ones that long is ambiguous, and only then is
+        // the tail walked (on a copy of the reader) to find the last block.
+        int readerBit;
+        reader.position(rawOffset, readerBit);
+        const int shift = (writer.bitOffset() - readerBit) & 7;
+        int trailingOnes = 8;
+        if (info.scanEnd >= 2 && info.scanEnd <= len) {
+            uint8_t last = jpeg[info.scanEnd - 1];
+            if (last == 0x00 && jpeg[info.scanEnd - 2] == 0xFF) {
+                last = 0xFF;
+            }
+            trailingOnes = 0;
+            while (trailingOnes < 8 && (last >> trailingOnes) & 1) {
+                trailingOnes++;
+            }
+        }
+
+        int padding = 0;
+        if (shift > 0 && trailingOnes >= shift) {
+            JpegBitReader tail = reader;
+            for (uint32_t mcu = endMcu; mcu < totalMcus; mcu++) {
+                for (int c = 0; c < info.numComponents; c++) {
+                    const JpegComponent& comp = info.components[c];
+                    for (int b = 0; b < comp.h * comp.v; b++) {
+                        if (!jpegDecodeBlock(tail, info.dc[comp.td], info.ac[comp.ta], predIn[c], coeffs)) {
+                            return false;
+                        }
+                    }
+                }
+            }
+            padding = tail.bitsAvailable();
+        }
+
+        // Once the reader reaches EOI all that is left is buffered
+        for (;;) {
+            int available = reader.bitsAvailable();
+            if (reader.atMarker()) {
+                available -= padding;
+            }
+            if (available <= 0) {
+                break;
+            }
+            int n = min(available, 16);
+            writer.put(reader.get(n), n);
+        }
+        writer.flush();
+        resume = reader.rawOffset();
+    }
+    if (resume < len) {
+        writer.putBytes(jpeg + resume, len - resume);
+    }
+
+    if (writer.overflowed()) {
+        return false;
+    }
+    outLen = writer.length();
+    return true;
+}
@@ -0,0 +1,77 @@
+#ifndef JPEG_OVERLAY_H
+#define JPEG_OVERLAY_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <JpegCodec.h>
+
+#define JPEG_OVERLAY_MAX_TEXT   48
+
+// Burns a one-line text box (timestamp, camera name) into OV2640 JPEG frames
+// without decoding or re-encoding the picture.
+//
+// Only the MCUs under the box are replaced. Everything before them is copied
+// byte for byte; the band of MCU rows containing the box is re-emitted at the
+// Huffman level (untouched blocks keep their coefficients, the block after
+// each patched run gets its DC difference re-based); after that the rest of
+// the scan is copied bit-for-bit, shifted to the new alignment, or byte for
+// byte from the next restart marker. The box's DCT blocks are computed once
+// per text change and cached.
+class JpegOverlay {
+public:
+    JpegOverlay();
+    ~JpegOverlay();
+
+    // Top-left corner of the box in pixels (snapped down to the MCU grid)
+    void setPosition(uint16_t x, uint16_t y);
+
+    // Glyph scale: 1 = 5x7 font in 8-pixel rows (QVGA), 2 for VGA and up
+    void setScale(uint8_t scale);
+
+    // Text to burn in; re-rendered lazily on the next apply()
+    void setText(const char* text);
+
+    // Write the frame with the overlay spliced in to out. Returns the output
+    // length, or 0 if the frame could not be processed (send the original).
+    size_t apply(const uint8_t* jpeg, size_t len, uint8_t* out, size_t outCapacity);
+
+    // Output buffer size that is always sufficient for apply()
+    static size_t maxOutputSize(size_t inputLen);
+
+    // Statistics
+    uint32_t getLastApplyMicros() { return _lastApplyMicros; }
+    uint32_t getFramesProcessed() { return _framesProcessed; }
+    uint32_t getFramesFailed() { return _framesFailed; }
+
+private:
+    char _text[JPEG_OVERLAY_MAX_TEXT + 1];
+    uint16_t _x;
+    uint16_t _y;
+    uint8_t _scale;
+    bool _dirty;
+
+    // Region in MCU units, derived from the current frame geometry
+    uint16_t _mcuCol0, _mcuCol1;
+    uint16_t _mcuRow0, _mcuRow1;
+
+    // Cached coefficient blocks for the region (zigzag order, one per block of
+    // every MCU in raster order) and the key they were rendered for
+    int16_t (*_blocks)[64];
+    size_t _blockCapacity;
+    uint16_t _cachedWidth, _cachedHeight, _cachedMcuW, _cachedMcuH;
+    uint32_t _cachedQuantHash;
+
+    JpegInfo _info;
+
+    uint32_t _lastApplyMicros;
+    uint32_t _framesProcessed;
+    uint32_t _framesFailed;
+
+    bool computeRegion();
+    bool renderBlocks();
+    uint32_t quantHash() const;
+    bool inRegion(uint32_t mcu) const;
+    bool splice(const uint8_t* jpeg, size_t len, uint8_t* out, size_t outCapacity, size_t& outLen);
+};
+
+#endif // JPEG_OVERLAY_H
@@ -0,0 +1,101 @@
+#include <string.h>
+#include "LatencyProbe.h"
+
+static const uint8_t kMagic[4] = { 'L', 'T', 'C', 'Y' };
+
+static void put32(uint8_t* p, uint32_t v) {
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);
+    p[3] = (uint8_t)v;
+}
+
+static void put64(uint8_t* p, uint64_t v) {
+    put32(p, (uint32_t)(v >> 32));
+    put32(p + 4, (uint32_t)v);
+}
+
+static uint32_t get32(const uint8_t* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static uint64_t get64(const uint8_t* p) {
+    return ((uint64_t)get32(p) << 32) | get32(p + 4);
+}
+
+size_t LatencyProbe::stamp(const uint8_t* jpeg, size_t len, const LatencyStamp& stamp,
+                           uint8_t* out, size_t capacity) {
+    if (!jpeg || len < 4 || jpeg[0] != 0xFF || jpeg[1] != 0xD8) {
+        return 0;
+    }
+    if (!out || capacity < maxOutputSize(len)) {
+        return 0;
+    }
+
+    uint8_t* p = out;
+    *p++ = 0xFF;
+    *p++ = 0xD8;
+
+    *p++ = 0xFF;
+    *p++ = 0xFE;                                // COM
+    *p++ = (uint8_t)((LATENCY_PROBE_PAYLOAD + 2) >> 8);
+    *p++ = (uint8_t)(LATENCY_PROBE_PAYLOAD + 2);
+
+    memcpy(p, kMagic, 4);
+    p += 4;
+    *p++ = LATENCY_PROBE_VERSION;
+    *p++ = stamp.flags;
+    *p++ = 0;
+    *p++ = 0;
+    put32(p, stamp.sequence);
+    p += 4;
+    put64(p, stamp.captureMicros);
+    p += 8;
+    put64(p, stamp.sendMicros);
+    p += 8;
+    put64(p, stamp.wallMicros);
+    p += 8;
+
+    memcpy(p, jpeg + 2, len - 2);
+    return len + LATENCY_PROBE_SEGMENT;
+}
+
+bool LatencyProbe::parse(const uint8_t* jpeg, size_t len, LatencyStamp& stamp) {
+    if (!jpeg || len < 4 || jpeg[0] != 0xFF || jpeg[1] != 0xD8) {
+        return false;
+    }
+
+    size_t pos = 2;
+    while (pos + 4 <= len) {
+        if (jpeg[pos] != 0xFF) {
+            return false;
+        }
+        uint8_t marker = jpeg[pos + 1];
+        if (marker == 0xFF) {
+            pos++;                              // Fill byte
+            continue;
+        }
+        if (marker == 0xDA || marker == 0xD9) {
+            return false;                       // SOS/EOI: no stamp in the headers
+        }
+
+        size_t segment = ((size_t)jpeg[pos + 2] << 8) | jpeg[pos + 3];
+        if (segment < 2 || pos + 2 + segment > len) {
+            return false;
+        }
+
+        const uint8_t* payload = jpeg + pos + 4;
+        if (marker == 0xFE && segment - 2 >= LATENCY_PROBE_PAYLOAD &&
+            memcmp(payload, kMagic, 4) == 0 && payload[4] == LATENCY_PROBE_VERSION) {
+            stamp.flags = payload[5];
+            stamp.sequence = get32(payload + 8);
+            stamp.captureMicros = get64(payload + 12);
+            stamp.sendMicros = get64(payload + 20);
+            stamp.wallMicros = get64(payload + 28);
+            return true;
+        }
+
+        pos += 2 + segment;
+    }
+    return false;
+}
@@ -0,0 +1,54 @@
+#ifndef LATENCY_PROBE_H
+#define LATENCY_PROBE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Glass-to-glass latency stamps carried inside the JPEG frames themselves.
+//
+// stamp() copies a frame and inserts a COM segment straight after SOI with
+// the frame's capture sequence number and timestamps. Decoders ignore COM
+// segments, so stamped frames still play everywhere, and the stamp survives
+// any transport that delivers the JPEG intact. tools/latency_probe extracts
+// the stamps at the receiving end.
+//
+// Segment payload (big-endian):
+//   "LTCY"  version(1)  flags(1)  reserved(2)
+//   sequence(4)  captureMicros(8)  sendMicros(8)  wallMicros(8)
+//
+// captureMicros and sendMicros are on the device's monotonic clock
+// (esp_timer), so their difference is the on-device latency whether or not
+// the wall clock is set. wallMicros is the capture instant in UTC
+// microseconds, valid when LATENCY_FLAG_WALL_CLOCK is set (after NTP sync);
+// the receiver subtracts it from its own UTC clock for capture->ingest.
+
+#define LATENCY_PROBE_VERSION       1
+#define LATENCY_PROBE_PAYLOAD       36
+#define LATENCY_PROBE_SEGMENT       (4 + LATENCY_PROBE_PAYLOAD)     // Marker + length + payload
+
+#define LATENCY_FLAG_WALL_CLOCK     0x01
+
+struct LatencyStamp {
+    uint32_t sequence;
+    uint64_t captureMicros;     // Monotonic, at capture
+    uint64_t sendMicros;        // Monotonic, when the frame was handed to the transport
+    uint64_t wallMicros;        // UTC at capture (0 if unknown)
+    uint8_t flags;
+};
+
+class LatencyProbe {
+public:
+    // Copy jpeg into out with the stamp inserted after SOI. out needs
+    // len + LATENCY_PROBE_SEGMENT bytes. Returns the stamped length, or 0 if
+    // the input does not start with SOI or out is too small.
+    static size_t stamp(const uint8_t* jpeg, size_t len, const LatencyStamp& stamp,
+                        uint8_t* out, size_t capacity);
+
+    // Find a stamp in the header segments (before SOS). Returns false for
+    // unstamped or malformed frames.
+    static bool parse(const uint8_t* jpeg, size_t len, LatencyStamp& stamp);
+
+    static size_t maxOutputSize(size_t len) { return len + LATENCY_PROBE_SEGMENT; }
+};
+
+#endif // LATENCY_PROBE_H
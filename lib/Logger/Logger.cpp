@@ -0,0 +1,301 @@
+#include "Logger.h"
+#include <string.h>
+#include <Metrics.h>
+
+#define LOG_LINE_BYTES  256
+
+Logger logger;
+
+static Counter metricLogDropped("log_messages_dropped_total", "Log lines dropped because the ring was full");
+
+Logger::Logger()
+    : _slots(nullptr)
+    , _mask(0)
+    , _enqueue(0)
+    , _dequeue(0)
+    , _dropped(0)
+    , _reportedDropped(0)
+    , _task(NULL)
+{
+}
+
+bool Logger::begin(size_t entries) {
+    if (_slots) {
+        return true;
+    }
+
+    size_t size = 1;
+    while (size * 2 <= entries) {
+        size *= 2;
+    }
+    Slot* slots = (Slot*)ps_malloc(size * sizeof(Slot));
+    if (!slots) {
+        LOG_E("Log: Cannot allocate %u entries, logging synchronously", (unsigned)size);
+        return false;
+    }
+    memset((void*)slots, 0, size * sizeof(Slot));
+    for (size_t i = 0; i < size; i++) {
+        slots[i].sequence.store((uint32_t)i, std::memory_order_relaxed);
+    }
+    _mask = (uint32_t)(size - 1);
+
+    if (xTaskCreatePinnedToCore(flushTask, "log", TASK_LOG_STACK_SIZE, this, TASK_LOG_PRIORITY, &_task,
+                                TASK_LOG_CORE) != pdPASS) {
+        free(slots);
+        LOG_E("Log: Cannot start the flush task, logging synchronously");
+        return false;
+    }
+    // Publishing the ring switches callers over to it
+    std::atomic_thread_fence(std::memory_order_release);
+    _slots = slots;
+
+    LOG_I("Log: %u entries (%u KB PSRAM), level %d", (unsigned)size,
+          (unsigned)(size * sizeof(Slot) / 1024), DEBUG_LOG_LEVEL);
+    return true;
+}
+
+Logger::Slot* Logger::reserve(uint32_t& position) {
+    uint32_t pos = _enqueue.load(std::memory_order_relaxed);
+    for (;;) {
+        Slot* slot = &_slots[pos & _mask];
+        int32_t diff = (int32_t)(slot->sequence.load(std::memory_order_acquire) - pos);
+        if (diff == 0) {
+            if (_enqueue.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                position = pos;
+                return slot;
+            }
+        } else if (diff < 0) {
+            // Full: the flush task is behind, and waiting for it is what we avoid
+            _dropped.fetch_add(1, std::memory_order_relaxed);
+            metricLogDropped.inc();
+            return nullptr;
+        } else {
+            pos = _enqueue.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+bool Logger::drainOne() {
+    uint32_t pos = _dequeue.load(std::memory_order_relaxed);
+    for (;;) {
+        Slot* slot = &_slots[pos & _mask];
+        int32_t diff = (int32_t)(slot->sequence.load(std::memory_order_acquire) - (pos + 1));
+        if (diff == 0) {
+            if (_dequeue.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                // Copy out so the slot is free again before we wait on the console
+                LogRecord record = slot->record;
+                slot->sequence.store(pos + _mask + 1, std::memory_order_release);
+                write(record);
+                return true;
+            }
+        } else if (diff < 0) {
+            return false;
+        } else {
+            pos = _dequeue.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+void Logger::reportDropped() {
+    uint32_t dropped = _dropped.load(std::memory_order_relaxed);
+    uint32_t reported = _reportedDropped.exchange(dropped, std::memory_order_relaxed);
+    if (dropped != reported) {
+        LogRecord record;
+        fill(record, LOG_LEVEL_WARN, "Log: %u lines dropped (ring full)", dropped - reported);
+        write(record);
+    }
+}
+
+void Logger::flush() {
+    if (!_slots) {
+        return;
+    }
+    while (drainOne()) {
+    }
+    reportDropped();
+    Serial.flush();
+}
+
+void Logger::flushTask(void* param) {
+    Logger* self = (Logger*)param;
+    for (;;) {
+        vTaskDelay(pdMS_TO_TICKS(LOG_FLUSH_INTERVAL_MS));
+        while (self->drainOne()) {
+        }
+        self->reportDropped();
+    }
+}
+
+// ============================================================================
+// Arguments
+// ============================================================================
+
+void Logger::addSigned(LogRecord& record, int64_t value, uint8_t width) {
+    record.types[record.count] = LOG_ARG_SIGNED;
+    record.widths[record.count] = width;
+    record.args[record.count++].i = value;
+}
+
+void Logger::addUnsigned(LogRecord& record, uint64_t value, uint8_t width) {
+    record.types[record.count] = LOG_ARG_UNSIGNED;
+    record.widths[record.count] = width;
+    record.args[record.count++].u = value;
+}
+
+void Logger::add(LogRecord& record, double value) {
+    record.types[record.count] = LOG_ARG_DOUBLE;
+    record.widths[record.count] = sizeof(value);
+    record.args[record.count++].d = value;
+}
+
+void Logger::add(LogRecord& record, const void* value) {
+    record.types[record.count] = LOG_ARG_POINTER;
+    record.widths[record.count] = sizeof(value);
+    record.args[record.count++].p = value;
+}
+
+void Logger::add(LogRecord& record, const char* value) {
+    if (!value) {
+        value = "(null)";
+    }
+    // Once the text is full every further string reads the final terminator
+    size_t offset = record.textUsed < LOG_TEXT_BYTES ? record.textUsed : LOG_TEXT_BYTES - 1;
+    size_t room = LOG_TEXT_BYTES - offset;
+    size_t len = strnlen(value, room - 1);
+    memcpy(record.text + offset, value, len);
+    record.text[offset + len] = '\0';
+    record.textUsed = (uint8_t)(offset + len + 1);
+
+    record.types[record.count] = LOG_ARG_TEXT;
+    record.widths[record.count] = sizeof(value);
+    record.args[record.count++].u = offset;
+}
+
+// ============================================================================
+// Formatting
+// ============================================================================
+
+void Logger::write(const LogRecord& record) {
+    static const char levels[] = "NEWID";
+    char line[LOG_LINE_BYTES];
+    const size_t limit = sizeof(line) - 1;     // Room for the newline
+    size_t n = snprintf(line, limit, "%c (%u) ", levels[record.level <= LOG_LEVEL_DEBUG ? record.level : 0],
+                        (unsigned)record.timeMillis);
+    n = n < limit ? n : limit;
+    uint8_t next = 0;
+
+    // Each conversion is rebuilt with the length modifier that matches how
+    // its argument was stored and formatted on its own
+    for (const char* f = record.format; *f && n < limit;) {
+        if (*f != '%') {
+            line[n++] = *f++;
+            continue;
+        }
+        if (f[1] == '%') {
+            line[n++] = '%';
+            f += 2;
+            continue;
+        }
+
+        char spec[24];
+        size_t s = 0;
+        spec[s++] = *f++;
+        while (*f && strchr("-+ #0", *f) && s < 8) {
+            spec[s++] = *f++;
+        }
+        while (*f >= '0' && *f <= '9' && s < 12) {
+            spec[s++] = *f++;
+        }
+        if (*f == '.') {
+            spec[s++] = *f++;
+            while (*f >= '0' && *f <= '9' && s < 18) {
+                spec[s++] = *f++;
+            }
+        }
+        while (*f && strchr("hlLqjzt", *f)) {
+            f++;
+        }
+        char conversion = *f;
+        if (!conversion) {
+            break;
+        }
+        f++;
+
+        if (next >= record.count) {
+            line[n++] = '?';
+            continue;
+        }
+        uint8_t type = record.types[next];
+        uint8_t width = record.widths[next];
+        const auto& arg = record.args[next++];
+        int64_t asSigned = type == LOG_ARG_DOUBLE ? (int64_t)arg.d : arg.i;
+
+        // Integers narrower than 64 bits are read back at their own width,
+        // as printf would: a negative int under %x is ffffffff, not 16 f's,
+        // and a large unsigned under %d goes negative
+        uint64_t asUnsigned = (uint64_t)asSigned;
+        if ((type == LOG_ARG_SIGNED || type == LOG_ARG_UNSIGNED) && width < sizeof(uint64_t)) {
+            uint64_t mask = (1ULL << (width * 8)) - 1;
+            uint64_t sign = 1ULL << (width * 8 - 1);
+            asUnsigned &= mask;
+            asSigned = (int64_t)((asUnsigned ^ sign) - sign);
+        }
+        double asDouble = type == LOG_ARG_DOUBLE ? arg.d
+                        : (type == LOG_ARG_SIGNED ? (double)arg.i : (double)arg.u);
+
+        int written = 0;
+        switch (conversion) {
+            case 'd':
+            case 'i':
+                memcpy(spec + s, "lld", 4);
+                written = snprintf(line + n, limit - n, spec, (long long)asSigned);
+                break;
+            case 'u':
+            case 'x':
+            case 'X':
+            case 'o':
+                spec[s++] = 'l';
+                spec[s++] = 'l';
+                spec[s++] = conversion;
+                spec[s] = '\0';
+                written = snprintf(line + n, limit - n, spec, (unsigned long long)asUnsigned);
+                break;
+            case 'c':
+                spec[s++] = 'c';
+                spec[s] = '\0';
+                written = snprintf(line + n, limit - n, spec, (int)asSigned);
+                break;
+            case 'f':
+            case 'F':
+            case 'e':
+            case 'E':
+            case 'g':
+            case 'G':
+            case 'a':
+            case 'A':
+                spec[s++] = conversion;
+                spec[s] = '\0';
+                written = snprintf(line + n, limit - n, spec, asDouble);
+                break;
+            case 's':
+                spec[s++] = 's';
+                spec[s] = '\0';
+                written = snprintf(line + n, limit - n, spec, type == LOG_ARG_TEXT ? record.text + arg.u : "?");
+                break;
+            case 'p':
+                spec[s++] = 'p';
+                spec[s] = '\0';
+                written = snprintf(line + n, limit - n, spec, arg.p);
+                break;
+            default:
+                line[n++] = '?';
+                break;
+        }
+        if (written > 0) {
+            n += (size_t)written < limit - n ? (size_t)written : limit - n - 1;
+        }
+    }
+
+    line[n++] = '\n';
+    Serial.write((const uint8_t*)line, n);
+}
@@ -0,0 +1,189 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <Arduino.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "../../include/config.h"
+
+// Deferred logging: a call site never formats and never touches the UART.
+//
+// LOG_E/W/I/D record the format string's address (string literals live in
+// flash for the life of the firmware, so the pointer is the format id) and
+// the arguments as typed 64-bit values, with the byte width of each integer
+// as passed, into a slot of a bounded lock-free MPMC ring. String arguments are copied into the slot, truncated to fit,
+// because the caller's buffer may be gone by the time the line is printed.
+// A low-priority task drains the ring every LOG_FLUSH_INTERVAL_MS, formats
+// each record ("E (12345) Camera: Frame capture failed") and writes it to
+// Serial, so only that task ever waits on the console.
+//
+// When the ring is full the record is dropped and counted; the flush task
+// reports the count. Before begin() (early setup) lines are formatted and
+// written synchronously.
+//
+// Levels above DEBUG_LOG_LEVEL, and everything when DEBUG_SERIAL_ENABLED is
+// false, compile to nothing (arguments are not evaluated). Formats are still
+// checked by the compiler; the supported conversions are d i u x X o c s p
+// f F e E g G a A and %%, with flags, width and precision (not *). Do not
+// end formats with a newline.
+
+#define LOG_LEVEL_NONE      0
+#define LOG_LEVEL_ERROR     1
+#define LOG_LEVEL_WARN      2
+#define LOG_LEVEL_INFO      3
+#define LOG_LEVEL_DEBUG     4
+
+#define LOG_MAX_ARGS            8
+#define LOG_TEXT_BYTES          64      // Copied string arguments per record
+#define LOG_FLUSH_INTERVAL_MS   50
+
+enum LogArgType : uint8_t {
+    LOG_ARG_SIGNED,
+    LOG_ARG_UNSIGNED,
+    LOG_ARG_DOUBLE,
+    LOG_ARG_TEXT,       // Offset into the record's text
+    LOG_ARG_POINTER
+};
+
+struct LogRecord {
+    const char* format;
+    uint32_t timeMillis;
+    uint8_t level;
+    uint8_t count;
+    uint8_t textUsed;
+    uint8_t types[LOG_MAX_ARGS];
+    uint8_t widths[LOG_MAX_ARGS];       // sizeof() of integer arguments as passed
+    union {
+        int64_t i;
+        uint64_t u;
+        double d;
+        const void* p;
+    } args[LOG_MAX_ARGS];
+    char text[LOG_TEXT_BYTES];
+};
+
+class Logger {
+public:
+    Logger();
+
+    // Allocate the ring (rounded down to a power of two) and start the flush task
+    bool begin(size_t entries);
+
+    // Record a line. Use the LOG_* macros rather than calling this directly.
+    template <typename... Args>
+    void log(uint8_t level, const char* format, const Args&... args) {
+        if (!_slots) {
+            LogRecord record;
+            fill(record, level, format, args...);
+            write(record);
+            return;
+        }
+        uint32_t position;
+        Slot* slot = reserve(position);
+        if (slot) {
+            fill(slot->record, level, format, args...);
+            slot->sequence.store(position + 1, std::memory_order_release);
+        }
+    }
+
+    // Format and write everything recorded so far from the calling task
+    // (before a restart or exit)
+    void flush();
+
+    uint32_t getDropped() const { return _dropped.load(std::memory_order_relaxed); }
+
+private:
+    struct Slot {
+        std::atomic<uint32_t> sequence;     // Vyukov: position it is free/full for
+        LogRecord record;
+    };
+
+    Slot* _slots;
+    uint32_t _mask;
+    std::atomic<uint32_t> _enqueue;
+    std::atomic<uint32_t> _dequeue;
+    std::atomic<uint32_t> _dropped;
+    std::atomic<uint32_t> _reportedDropped;
+    TaskHandle_t _task;
+
+    // Claim the slot for the next record (nullptr, counted, when full);
+    // storing position + 1 in its sequence publishes it
+    Slot* reserve(uint32_t& position);
+    bool drainOne();
+    void reportDropped();
+    void write(const LogRecord& record);
+
+    static void flushTask(void* param);
+
+    template <typename... Args>
+    static void fill(LogRecord& record, uint8_t level, const char* format, const Args&... args) {
+        record.format = format;
+        record.timeMillis = millis();
+        record.level = level;
+        record.count = 0;
+        record.textUsed = 0;
+        pack(record, args...);
+    }
+
+    static void pack(LogRecord&) {}
+    template <typename T, typename... Rest>
+    static void pack(LogRecord& record, const T& first, const Rest&... rest) {
+        if (record.count < LOG_MAX_ARGS) {
+            add(record, first);
+        }
+        pack(record, rest...);
+    }
+
+    static void add(LogRecord& record, int value) { addSigned(record, value, sizeof(value)); }
+    static void add(LogRecord& record, long value) { addSigned(record, value, sizeof(value)); }
+    static void add(LogRecord& record, long long value) { addSigned(record, value, sizeof(value)); }
+    static void add(LogRecord& record, unsigned value) { addUnsigned(record, value, sizeof(value)); }
+    static void add(LogRecord& record, unsigned long value) { addUnsigned(record, value, sizeof(value)); }
+    static void add(LogRecord& record, unsigned long long value) { addUnsigned(record, value, sizeof(value)); }
+    static void add(LogRecord& record, double value);
+    static void add(LogRecord& record, const char* value);
+    static void add(LogRecord& record, const void* value);
+    static void addSigned(LogRecord& record, int64_t value, uint8_t width);
+    static void addUnsigned(LogRecord& record, uint64_t value, uint8_t width);
+};
+
+extern Logger logger;
+
+// Never called: lets the compiler check formats against their arguments
+static inline void logCheckFormat(const char* format, ...) __attribute__((format(printf, 1, 2)));
+static inline void logCheckFormat(const char* format, ...) { (void)format; }
+
+#define LOG_AT(level, format, ...) \
+    do { \
+        if (0) logCheckFormat(format, ##__VA_ARGS__); \
+        logger.log(level, format, ##__VA_ARGS__); \
+    } while (0)
+
+#if DEBUG_SERIAL_ENABLED && DEBUG_LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_E(format, ...) LOG_AT(LOG_LEVEL_ERROR, format, ##__VA_ARGS__)
+#else
+#define LOG_E(format, ...) do {} while (0)
+#endif
+
+#if DEBUG_SERIAL_ENABLED && DEBUG_LOG_LEVEL >= LOG_LEVEL_WARN
+#define LOG_W(format, ...) LOG_AT(LOG_LEVEL_WARN, format, ##__VA_ARGS__)
+#else
+#define LOG_W(format, ...) do {} while (0)
+#endif
+
+#if DEBUG_SERIAL_ENABLED && DEBUG_LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_I(format, ...) LOG_AT(LOG_LEVEL_INFO, format, ##__VA_ARGS__)
+#else
+#define LOG_I(format, ...) do {} while (0)
+#endif
+
+#if DEBUG_SERIAL_ENABLED && DEBUG_LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_D(format, ...) LOG_AT(LOG_LEVEL_DEBUG, format, ##__VA_ARGS__)
+#else
+#define LOG_D(format, ...) do {} while (0)
+#endif
+
+#endif // LOGGER_H
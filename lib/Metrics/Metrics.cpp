@@ -0,0 +1,328 @@
+#include <Arduino.h>
+#include <string.h>
+#include "Metrics.h"
+
+Metric* MetricsRegistry::_head = nullptr;
+SemaphoreHandle_t MetricsRegistry::_lock = nullptr;
+uint32_t MetricsRegistry::_sampleTimes[METRICS_RATE_SAMPLES];
+uint8_t MetricsRegistry::_sampleSlot = 0;
+uint32_t MetricsRegistry::_samplesTaken = 0;
+
+// ---------------------------------------------------------------------------
+// Metric
+
+Metric::Metric(const char* name, const char* help, const char* labels, MetricType type)
+    : _name(name)
+    , _help(help)
+    , _labels(labels)
+    , _type(type)
+    , _next(nullptr)
+{
+    MetricsRegistry::add(this);
+}
+
+Metric::~Metric() {
+    MetricsRegistry::remove(this);
+}
+
+size_t Metric::writeHeader(Print& out, const char* suffix, const char* type) {
+    size_t written = out.printf("# HELP %s%s %s\n", _name, suffix, _help);
+    written += out.printf("# TYPE %s%s %s\n", _name, suffix, type);
+    return written;
+}
+
+size_t Metric::writeName(Print& out, const char* suffix, const char* extraLabel) {
+    size_t written = out.print(_name);
+    written += out.print(suffix);
+    if (_labels || extraLabel) {
+        written += out.print('{');
+        if (_labels) {
+            written += out.print(_labels);
+        }
+        if (_labels && extraLabel) {
+            written += out.print(',');
+        }
+        if (extraLabel) {
+            written += out.print(extraLabel);
+        }
+        written += out.print('}');
+    }
+    return written;
+}
+
+// Rate gauges for a counter: <name without _total>_rate{window="10s"|"60s"}
+static size_t writeRateLines(Print& out, bool header, const char* name, const char* labels,
+                             double delta10, float seconds10, double delta60, float seconds60) {
+    int length = (int)strlen(name);
+    if (length > 6 && strcmp(name + length - 6, "_total") == 0) {
+        length -= 6;
+    }
+
+    size_t written = 0;
+    if (header) {
+        written += out.printf("# HELP %.*s_rate Per-second rate of %s\n", length, name, name);
+        written += out.printf("# TYPE %.*s_rate gauge\n", length, name);
+    }
+
+    const char* windows[2] = { "10s", "60s" };
+    double rates[2] = {
+        seconds10 > 0.0f ? delta10 / seconds10 : 0.0,
+        seconds60 > 0.0f ? delta60 / seconds60 : 0.0
+    };
+    for (int i = 0; i < 2; i++) {
+        written += out.printf("%.*s_rate{%s%swindow=\"%s\"} %.6g\n", length, name,
+                              labels ? labels : "", labels ? "," : "", windows[i], rates[i]);
+    }
+    return written;
+}
+
+// ---------------------------------------------------------------------------
+// Counter
+
+Counter::Counter(const char* name, const char* help, const char* labels)
+    : Metric(name, help, labels, MetricType::COUNTER)
+    , _total(0)
+{
+    memset(_samples, 0, sizeof(_samples));
+}
+
+void Counter::collect() {
+    uint64_t total = 0;
+    for (int i = 0; i < METRICS_MAX_CORES; i++) {
+        total += _shards[i].fold();
+    }
+    _total = total;
+}
+
+size_t Counter::write(Print& out, bool header, uint8_t, uint8_t, uint8_t, float, float) {
+    size_t written = header ? writeHeader(out, "", "counter") : 0;
+    written += writeName(out, "", nullptr);
+    written += out.printf(" %llu\n", (unsigned long long)_total);
+    return written;
+}
+
+size_t Counter::writeRates(Print& out, bool header, uint8_t newest, uint8_t older10, uint8_t older60,
+                           float seconds10, float seconds60) {
+    return writeRateLines(out, header, _name, _labels,
+                          (double)(_samples[newest] - _samples[older10]), seconds10,
+                          (double)(_samples[newest] - _samples[older60]), seconds60);
+}
+
+// ---------------------------------------------------------------------------
+// Gauge
+
+Gauge::Gauge(const char* name, const char* help, const char* labels)
+    : Metric(name, help, labels, MetricType::GAUGE)
+    , _value(0.0f)
+{
+}
+
+size_t Gauge::write(Print& out, bool header, uint8_t, uint8_t, uint8_t, float, float) {
+    size_t written = header ? writeHeader(out, "", "gauge") : 0;
+    written += writeName(out, "", nullptr);
+    written += out.printf(" %.6g\n", (double)value());
+    return written;
+}
+
+// ---------------------------------------------------------------------------
+// CallbackMetric
+
+CallbackMetric::CallbackMetric(const char* name, const char* help, MetricType type,
+                               std::function<double()> callback, const char* labels)
+    : Metric(name, help, labels, type)
+    , _callback(callback)
+    , _value(0.0)
+{
+    memset(_samples, 0, sizeof(_samples));
+}
+
+void CallbackMetric::collect() {
+    if (_callback) {
+        _value = _callback();
+    }
+}
+
+size_t CallbackMetric::write(Print& out, bool header, uint8_t, uint8_t, uint8_t, float, float) {
+    size_t written = header ? writeHeader(out, "", _type == MetricType::COUNTER ? "counter" : "gauge") : 0;
+    written += writeName(out, "", nullptr);
+    written += out.printf(" %.9g\n", _value);
+    return written;
+}
+
+size_t CallbackMetric::writeRates(Print& out, bool header, uint8_t newest, uint8_t older10, uint8_t older60,
+                                  float seconds10, float seconds60) {
+    if (_type != MetricType::COUNTER) {
+        return 0;
+    }
+    return writeRateLines(out, header, _name, _labels,
+                          _samples[newest] - _samples[older10], seconds10,
+                          _samples[newest] - _samples[older60], seconds60);
+}
+
+// ---------------------------------------------------------------------------
+// Histogram
+
+Histogram::Histogram(const char* name, const char* help, const uint32_t* bounds, uint8_t numBounds,
+                     double scale, const char* labels)
+    : Metric(name, help, labels, MetricType::HISTOGRAM)
+    , _numBounds(numBounds < MAX_BUCKETS ? numBounds : MAX_BUCKETS)
+    , _scale(scale)
+{
+    memcpy(_bounds, bounds, _numBounds * sizeof(uint32_t));
+}
+
+void Histogram::observe(uint32_t value) {
+    uint8_t bucket = 0;
+    while (bucket < _numBounds && value > _bounds[bucket]) {
+        bucket++;
+    }
+    _buckets[bucket].add(1);
+    _sum.add(value);
+}
+
+void Histogram::collect() {
+    for (int i = 0; i <= _numBounds; i++) {
+        _buckets[i].fold();
+    }
+    _sum.fold();
+}
+
+size_t Histogram::write(Print& out, bool header, uint8_t, uint8_t, uint8_t, float, float) {
+    size_t written = header ? writeHeader(out, "", "histogram") : 0;
+    char le[24];
+    uint64_t cumulative = 0;
+
+    for (int i = 0; i <= _numBounds; i++) {
+        cumulative += _buckets[i].total;
+        if (i < _numBounds) {
+            snprintf(le, sizeof(le), "le=\"%.6g\"", _bounds[i] * _scale);
+        } else {
+            snprintf(le, sizeof(le), "le=\"+Inf\"");
+        }
+        written += writeName(out, "_bucket", le);
+        written += out.printf(" %llu\n", (unsigned long long)cumulative);
+    }
+
+    written += writeName(out, "_sum", nullptr);
+    written += out.printf(" %.9g\n", (double)_sum.total * _scale);
+    written += writeName(out, "_count", nullptr);
+    written += out.printf(" %llu\n", (unsigned long long)cumulative);
+    return written;
+}
+
+// ---------------------------------------------------------------------------
+// MetricsRegistry
+
+void MetricsRegistry::add(Metric* metric) {
+    // Constructors run before the scheduler starts, one at a time; append so
+    // the exposition keeps declaration order
+    Metric** tail = &_head;
+    while (*tail) {
+        tail = &(*tail)->_next;
+    }
+    *tail = metric;
+}
+
+void MetricsRegistry::remove(Metric* metric) {
+    for (Metric** link = &_head; *link; link = &(*link)->_next) {
+        if (*link == metric) {
+            *link = metric->_next;
+            return;
+        }
+    }
+}
+
+bool MetricsRegistry::sameFamily(const Metric* a, const Metric* b) {
+    return a->_name == b->_name || strcmp(a->_name, b->_name) == 0;
+}
+
+bool MetricsRegistry::lock() {
+    // Created on first use; only the collector side (loop task) gets here
+    if (!_lock) {
+        _lock = xSemaphoreCreateMutex();
+        if (!_lock) {
+            return false;
+        }
+    }
+    return xSemaphoreTake(_lock, portMAX_DELAY) == pdTRUE;
+}
+
+void MetricsRegistry::unlock() {
+    xSemaphoreGive(_lock);
+}
+
+uint8_t MetricsRegistry::slotAgo(uint32_t seconds) {
+    uint32_t available = _samplesTaken > 0 ? _samplesTaken - 1 : 0;
+    if (seconds > available) {
+        seconds = available;
+    }
+    return (uint8_t)((_sampleSlot + METRICS_RATE_SAMPLES - seconds) % METRICS_RATE_SAMPLES);
+}
+
+void MetricsRegistry::tick() {
+    if (!lock()) {
+        return;
+    }
+
+    if (_samplesTaken > 0) {
+        _sampleSlot = (_sampleSlot + 1) % METRICS_RATE_SAMPLES;
+    }
+    _sampleTimes[_sampleSlot] = millis();
+    _samplesTaken++;
+
+    for (Metric* metric = _head; metric; metric = metric->_next) {
+        metric->collect();
+        metric->sample(_sampleSlot);
+    }
+
+    unlock();
+}
+
+size_t MetricsRegistry::write(Print& out) {
+    if (!lock()) {
+        return 0;
+    }
+
+    uint8_t older10 = slotAgo(10);
+    uint8_t older60 = slotAgo(60);
+    uint32_t newestTime = _sampleTimes[_sampleSlot];
+    float seconds10 = (newestTime - _sampleTimes[older10]) / 1000.0f;
+    float seconds60 = (newestTime - _sampleTimes[older60]) / 1000.0f;
+
+    for (Metric* metric = _head; metric; metric = metric->_next) {
+        metric->collect();
+    }
+
+    // A family is written where its first metric is registered: all of its
+    // series, then all of its rates
+    size_t written = 0;
+    for (Metric* first = _head; first; first = first->_next) {
+        bool seen = false;
+        for (Metric* earlier = _head; earlier != first && !seen; earlier = earlier->_next) {
+            seen = sameFamily(earlier, first);
+        }
+        if (seen) {
+            continue;
+        }
+
+        bool header = true;
+        for (Metric* metric = first; metric; metric = metric->_next) {
+            if (metric == first || sameFamily(metric, first)) {
+                written += metric->write(out, header, _sampleSlot, older10, older60, seconds10, seconds60);
+                header = false;
+            }
+        }
+        header = true;
+        for (Metric* metric = first; metric; metric = metric->_next) {
+            if (metric == first || sameFamily(metric, first)) {
+                size_t rates = metric->writeRates(out, header, _sampleSlot, older10, older60,
+                                                  seconds10, seconds60);
+                written += rates;
+                header = header && rates == 0;
+            }
+        }
+    }
+
+    unlock();
+    return written;
+}
@@ -0,0 +1,190 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <Arduino.h>
+#include <stdint.h>
+#include <atomic>
+#include <functional>
+
+// Metrics registry with Prometheus text exposition.
+//
+// Writers (any task, any core) only ever do relaxed 32-bit atomic adds or
+// stores: counters are split into one 32-bit shard per core, and the
+// collector folds the shard deltas into 64-bit totals. Xtensa has no
+// lock-free 64-bit atomics, so this keeps per-chunk updates to a handful of
+// cycles while totals never wrap, provided the registry is collected more
+// often than a shard can wrap (tick() runs every second).
+//
+// Metrics are usually globals; each one links itself into the registry on
+// construction, so registration does not depend on static init order.
+//
+// Every counter also gets 10 s and 60 s rate gauges (<name>_rate, without
+// the _total suffix) computed from the per-second samples taken by tick().
+//
+// Several metrics may share a name with different labels (one per RTMP
+// destination, say); the exposition writes them as one family. Metrics
+// created after startup must be created from the task that scrapes.
+
+#define METRICS_MAX_CORES       2
+#define METRICS_RATE_SAMPLES    61      // One per second, enough for the 60 s window
+
+enum class MetricType {
+    COUNTER,
+    GAUGE,
+    HISTOGRAM
+};
+
+// 32-bit atomic accumulator folded into a 64-bit total by the collector
+struct FoldedCounter {
+    std::atomic<uint32_t> raw;
+    uint32_t seen;
+    uint64_t total;
+
+    FoldedCounter() : raw(0), seen(0), total(0) {}
+    void add(uint32_t n) { raw.fetch_add(n, std::memory_order_relaxed); }
+    uint64_t fold() {
+        uint32_t now = raw.load(std::memory_order_relaxed);
+        total += (uint32_t)(now - seen);
+        seen = now;
+        return total;
+    }
+};
+
+class Metric {
+public:
+    Metric(const char* name, const char* help, const char* labels, MetricType type);
+    virtual ~Metric();
+
+    const char* getName() const { return _name; }
+    MetricType getType() const { return _type; }
+
+protected:
+    friend class MetricsRegistry;
+
+    const char* _name;
+    const char* _help;
+    const char* _labels;        // e.g. "dest=\"primary\"" or nullptr
+    MetricType _type;
+    Metric* _next;
+
+    // Collector side (called with the registry lock held). header is false
+    // for the second and later metrics of a family.
+    virtual void collect() = 0;
+    virtual void sample(uint8_t /*slot*/) {}
+    virtual size_t write(Print& out, bool header, uint8_t newest, uint8_t older10, uint8_t older60,
+                         float seconds10, float seconds60) = 0;
+    // The <name>_rate family, for counters
+    virtual size_t writeRates(Print& /*out*/, bool /*header*/, uint8_t /*newest*/, uint8_t /*older10*/,
+                              uint8_t /*older60*/, float /*seconds10*/, float /*seconds60*/) { return 0; }
+
+    size_t writeHeader(Print& out, const char* suffix, const char* type);
+    size_t writeName(Print& out, const char* suffix, const char* extraLabel);
+};
+
+// Monotonic 64-bit counter
+class Counter : public Metric {
+public:
+    Counter(const char* name, const char* help, const char* labels = nullptr);
+
+    void inc(uint32_t n = 1) { _shards[xPortGetCoreID()].add(n); }
+
+    // Folded total as of the last collection
+    uint64_t value() const { return _total; }
+
+protected:
+    FoldedCounter _shards[METRICS_MAX_CORES];
+    uint64_t _total;
+    uint64_t _samples[METRICS_RATE_SAMPLES];
+
+    void collect() override;
+    void sample(uint8_t slot) override { _samples[slot] = _total; }
+    size_t write(Print& out, bool header, uint8_t newest, uint8_t older10, uint8_t older60,
+                 float seconds10, float seconds60) override;
+    size_t writeRates(Print& out, bool header, uint8_t newest, uint8_t older10, uint8_t older60,
+                      float seconds10, float seconds60) override;
+};
+
+// Settable value
+class Gauge : public Metric {
+public:
+    Gauge(const char* name, const char* help, const char* labels = nullptr);
+
+    void set(float value) { _value.store(value, std::memory_order_relaxed); }
+    float value() const { return _value.load(std::memory_order_relaxed); }
+
+protected:
+    std::atomic<float> _value;
+
+    void collect() override {}
+    size_t write(Print& out, bool header, uint8_t, uint8_t, uint8_t, float, float) override;
+};
+
+// Value read at scrape time from existing state (heap, RSSI, module stats).
+// COUNTER callbacks must be monotonic; they get rate gauges like Counter.
+class CallbackMetric : public Metric {
+public:
+    CallbackMetric(const char* name, const char* help, MetricType type,
+                   std::function<double()> callback, const char* labels = nullptr);
+
+protected:
+    std::function<double()> _callback;
+    double _value;
+    double _samples[METRICS_RATE_SAMPLES];
+
+    void collect() override;
+    void sample(uint8_t slot) override { _samples[slot] = _value; }
+    size_t write(Print& out, bool header, uint8_t newest, uint8_t older10, uint8_t older60,
+                 float seconds10, float seconds60) override;
+    size_t writeRates(Print& out, bool header, uint8_t newest, uint8_t older10, uint8_t older60,
+                      float seconds10, float seconds60) override;
+};
+
+// Fixed-bucket histogram. Observations are integers in the histogram's unit
+// (bytes, microseconds); scale converts them to the exported base unit.
+class Histogram : public Metric {
+public:
+    static const uint8_t MAX_BUCKETS = 16;
+
+    Histogram(const char* name, const char* help, const uint32_t* bounds, uint8_t numBounds,
+              double scale = 1.0, const char* labels = nullptr);
+
+    void observe(uint32_t value);
+
+protected:
+    uint32_t _bounds[MAX_BUCKETS];
+    uint8_t _numBounds;
+    double _scale;
+    FoldedCounter _buckets[MAX_BUCKETS + 1];    // Last is +Inf
+    FoldedCounter _sum;
+
+    void collect() override;
+    size_t write(Print& out, bool header, uint8_t, uint8_t, uint8_t, float, float) override;
+};
+
+class MetricsRegistry {
+public:
+    // Fold counters and take the per-second rate sample (call about once a
+    // second; MetricsServer does this)
+    static void tick();
+
+    // Collect and write everything in Prometheus text format 0.0.4
+    static size_t write(Print& out);
+
+private:
+    friend class Metric;
+
+    static Metric* _head;
+    static SemaphoreHandle_t _lock;
+    static uint32_t _sampleTimes[METRICS_RATE_SAMPLES];   // millis() per sample slot
+    static uint8_t _sampleSlot;
+    static uint32_t _samplesTaken;
+
+    static void add(Metric* metric);
+    static void remove(Metric* metric);
+    static bool lock();
+    static void unlock();
+    static uint8_t slotAgo(uint32_t seconds);
+    static bool sameFamily(const Metric* a, const Metric* b);
+};
+
+#endif // METRICS_H
@@ -0,0 +1,158 @@
+#include "MetricsServer.h"
+#include "../../include/config.h"
+#include <Metrics.h>
+#include <Trace.h>
+#include <Logger.h>
+#include <CaptureRecorder.h>
+#include <PipelineBenchmarks.h>
+
+#define METRICS_REQUEST_TIMEOUT_MS  1000
+#define METRICS_MAX_LINE            128
+
+MetricsServer::MetricsServer()
+    : _server(nullptr)
+    , _port(0)
+    , _lastTick(0)
+    , _requests(0)
+{
+}
+
+void MetricsServer::begin(uint16_t port) {
+    if (_server) {
+        return;
+    }
+
+    _port = port;
+    _server = new WiFiServer(port);
+    _server->begin();
+    _server->setNoDelay(true);
+    LOG_I("Metrics: Serving http://%s:%u/metrics", WiFi.localIP().toString().c_str(), port);
+}
+
+void MetricsServer::end() {
+    if (_server) {
+        _server->end();
+        delete _server;
+        _server = nullptr;
+    }
+}
+
+void MetricsServer::handle() {
+    if (millis() - _lastTick >= 1000) {
+        _lastTick = millis();
+        MetricsRegistry::tick();
+    }
+
+    if (!_server) {
+        return;
+    }
+
+    WiFiClient client = _server->available();
+    if (!client) {
+        return;
+    }
+
+    char path[METRICS_MAX_LINE];
+    if (readRequestLine(client, path, sizeof(path))) {
+        serve(client, path);
+        _requests++;
+    }
+    client.stop();
+}
+
+// Reads "GET <path> HTTP/1.x" and discards the headers
+bool MetricsServer::readRequestLine(WiFiClient& client, char* path, size_t pathSize) {
+    char line[METRICS_MAX_LINE];
+    size_t length = 0;
+    bool haveRequest = false;
+    uint32_t start = millis();
+
+    while (client.connected() && millis() - start < METRICS_REQUEST_TIMEOUT_MS) {
+        int c = client.read();
+        if (c < 0) {
+            delay(1);
+            continue;
+        }
+        if (c == '\r') {
+            continue;
+        }
+        if (c != '\n') {
+            if (length < sizeof(line) - 1) {
+                line[length++] = (char)c;
+            }
+            continue;
+        }
+
+        line[length] = '\0';
+        if (length == 0) {
+            return haveRequest;     // Blank line ends the headers
+        }
+        if (!haveRequest) {
+            if (strncmp(line, "GET ", 4) != 0) {
+                return false;
+            }
+            const char* begin = line + 4;
+            const char* end = strchr(begin, ' ');
+            size_t n = end ? (size_t)(end - begin) : strlen(begin);
+            if (n >= pathSize) {
+                n = pathSize - 1;
+            }
+            memcpy(path, begin, n);
+            path[n] = '\0';
+            haveRequest = true;
+        }
+        length = 0;
+    }
+    return false;
+}
+
+void MetricsServer::serve(WiFiClient& client, const char* path) {
+    if (strcmp(path, "/metrics") == 0) {
+        client.print("HTTP/1.1 200 OK\r\n"
+                     "Content-Type: text/plain; version=0.0.4\r\n"
+                     "Connection: close\r\n\r\n");
+        MetricsRegistry::write(client);
+        return;
+    }
+
+#if TRACE_ENABLED
+    if (strcmp(path, "/trace") == 0) {
+        client.print("HTTP/1.1 200 OK\r\n"
+                     "Content-Type: application/json\r\n"
+                     "Connection: close\r\n\r\n");
+        tracer.dump(client);
+        return;
+    }
+#endif
+
+#if CAPTURE_TRACE_ENABLED
+    if (strcmp(path, "/capture") == 0 && captureRecorder.getBytes() > 0) {
+        client.print("HTTP/1.1 200 OK\r\n"
+                     "Content-Type: application/octet-stream\r\n"
+                     "Content-Disposition: attachment; filename=\"capture.ctrace\"\r\n"
+                     "Connection: close\r\n\r\n");
+        captureRecorder.dump(client);
+        return;
+    }
+#endif
+
+#if BENCH_ENABLED
+    // /bench or /bench?filter=<substring of the benchmark names>
+    if (strncmp(path, "/bench", 6) == 0 && (path[6] == '\0' || path[6] == '?')) {
+        const char* filter = strstr(path, "filter=");
+        client.print("HTTP/1.1 200 OK\r\n"
+                     "Content-Type: application/json\r\n"
+                     "Connection: close\r\n\r\n");
+        BenchRunner runner(client, filter ? filter + 7 : nullptr, BENCH_MIN_TIME_MS);
+        runner.begin("firmware");
+        PipelineBenchmarks::run(runner);
+        LOG_I("Bench: %u benchmarks run", runner.end());
+        return;
+    }
+#endif
+
+    client.print("HTTP/1.1 404 Not Found\r\n"
+                 "Content-Type: text/plain\r\n"
+                 "Connection: close\r\n\r\n"
+                 "Not found\n");
+}
@@ -0,0 +1,42 @@
+#ifndef METRICS_SERVER_H
+#define METRICS_SERVER_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+
+// Minimal HTTP endpoint for fleet scraping.
+//
+//   GET /metrics   Prometheus text format (MetricsRegistry)
+//   GET /trace     Chrome trace JSON (Tracer), when tracing is compiled in
+//   GET /capture   Capture trace (CaptureRecorder), once one has been recorded
+//   GET /bench     Run the microbenchmarks (PipelineBenchmarks) and return
+//                  Google Benchmark JSON; ?filter=<substring> selects some.
+//                  Blocks the loop task for several seconds.
+//
+// One request per connection, served synchronously from handle(), which also
+// ticks the registry once a second so counters are folded and rates sampled
+// even when nobody is scraping.
+
+class MetricsServer {
+public:
+    MetricsServer();
+
+    void begin(uint16_t port);
+    void end();
+
+    // Call from loop(): ticks the registry and serves at most one request
+    void handle();
+
+    uint32_t getRequests() const { return _requests; }
+
+private:
+    WiFiServer* _server;
+    uint16_t _port;
+    uint32_t _lastTick;
+    uint32_t _requests;
+
+    bool readRequestLine(WiFiClient& client, char* path, size_t pathSize);
+    void serve(WiFiClient& client, const char* path);
+};
+
+#endif // METRICS_SERVER_H
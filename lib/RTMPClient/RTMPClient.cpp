@@ -1,9 +1,58 @@
 #include "RTMPClient.h"
 #include "../../include/config.h"
+#include "SocketTransport.h"
+#include "TlsTransport.h"
+#include <Trace.h>
+#include <Metrics.h>
+#include <Logger.h>
+
+// Send latency buckets (microseconds)
+static const uint32_t sendLatencyBounds[] = {
+    1000, 2000, 5000, 10000, 20000, 33000, 50000, 100000, 200000, 500000
+};
+
+// Bytes ahead of an audio message (pending plus unsent in the socket)
+static const uint32_t audioWaitBounds[] = {
+    512, 1024, 2048, 4096, 8192, 16384, 32768, 65536, 131072
+};
+
+// Reconnect time buckets (milliseconds)
+static const uint32_t reconnectBounds[] = {
+    500, 1000, 2000, 5000, 10000, 20000, 30000, 60000, 120000, 300000
+};
+
+static Counter metricBytesSent("rtmp_bytes_sent_total", "Bytes written to the RTMP connection");
+static Counter metricChunksSent("rtmp_chunks_sent_total", "RTMP chunks written");
+static Counter metricFramesSent("rtmp_video_frames_sent_total", "Video messages sent");
+static Counter metricFramesDropped("rtmp_video_frames_dropped_total", "Video frames dropped by the RTMP client");
+static Counter metricFramesBackpressure("rtmp_video_frames_backpressure_total",
+                                        "Video frames skipped while the previous one was still being sent");
+static Histogram metricSendLatency("rtmp_video_send_seconds", "Time to write one video message",
+                                   sendLatencyBounds, sizeof(sendLatencyBounds) / sizeof(sendLatencyBounds[0]),
+                                   1e-6);
+static Counter metricInterleaved("rtmp_interleaved_messages_total",
+                                 "Audio and command messages sent between the chunks of a video message");
+static Histogram metricAudioWait("rtmp_audio_wait_bytes", "Bytes still to go out ahead of each audio message",
+                                 audioWaitBounds, sizeof(audioWaitBounds) / sizeof(audioWaitBounds[0]));
+static Counter metricAggregates("rtmp_aggregates_sent_total", "Aggregate messages sent");
+static Counter metricAggregated("rtmp_aggregated_messages_total", "Audio and data messages sent inside aggregates");
+static Counter metricBytesReceived("rtmp_bytes_received_total", "Bytes read from the RTMP connection");
+static Counter metricPingsAnswered("rtmp_pings_answered_total", "Server ping requests answered");
+static Counter metricAcksSent("rtmp_acknowledgements_sent_total", "Acknowledgements sent (window and keepalive)");
+static Counter metricReconnects("rtmp_reconnects_total", "Connections restored after a drop");
+static Counter metricReconnectAttempts("rtmp_reconnect_attempts_total", "Reconnects tried, successful or not");
+static Histogram metricReconnectTime("rtmp_reconnect_seconds", "Time from a drop to the first frame sent again",
+                                     reconnectBounds, sizeof(reconnectBounds) / sizeof(reconnectBounds[0]), 1e-3);
 
 RTMPClient::RTMPClient() 
-    : _state(RTMPState::DISCONNECTED),
+    : _transport(new SocketTransport()),
+      _transportSecure(false),
+      _state(RTMPState::DISCONNECTED),
       _serverPort(1935),
+      _secure(false),
+      _videoWidth(0),
+      _videoHeight(0),
+      _frameRate(0.0f),
       _bytesSent(0),
       _framesSent(0),
       _droppedFrames(0),
@@ -11,27 +60,68 @@ RTMPClient::RTMPClient()
       _streamId(0),
       _transactionId(1),
       _videoTimestamp(0),
-      _audioTimestamp(0) {
+      _audioTimestamp(0),
+      _chunkSize(RTMP_DEFAULT_CHUNK_SIZE),
+      _inHeaderLen(0),
+      _inChunk(nullptr),
+      _inChunkLeft(0),
+      _inChunkSize(RTMP_DEFAULT_CHUNK_SIZE),
+      _bytesReceived(0),
+      _ackWindow(0),
+      _lastAck(0),
+      _urlValid(false),
+      _autoReconnect(true),
+      _reconnectPending(false),
+      _reconnectAttempts(0),
+      _nextReconnect(0),
+      _recovering(false),
+      _droppedAt(0),
+      _reconnects(0),
+      _videoBody(nullptr),
+      _videoLength(0),
+      _videoOffset(0),
+      _videoMessageTimestamp(0),
+      _videoStart(0),
+      _aggregate(nullptr),
+      _aggregateCapacity(0),
+      _aggregateLen(0),
+      _aggregateCount(0),
+      _aggregateTimestamp(0),
+      _aggregateStart(0),
+      _aggregateMaxMs(0) {
+    memset(_inStreams, 0, sizeof(_inStreams));
 }
 
 RTMPClient::~RTMPClient() {
     disconnect();
+    delete _transport;
+    free(_aggregate);
 }
 
 bool RTMPClient::parseURL(const String& url) {
-    // Parse RTMP URL: rtmp://server:port/app/stream
+    // Parse RTMP URL: rtmp[s]://server:port/app/stream
     // Example: rtmp://a.rtmp.youtube.com/live2/xxxx-xxxx-xxxx-xxxx
     
-    if (!url.startsWith("rtmp://")) {
-        Serial.println("RTMP: Invalid URL scheme");
+    String remainder;
+    if (url.startsWith("rtmp://")) {
+        _secure = false;
+        remainder = url.substring(7);
+    } else if (url.startsWith("rtmps://")) {
+#if RTMP_TLS_AVAILABLE
+        _secure = true;
+        remainder = url.substring(8);
+#else
+        LOG_E("RTMP: rtmps:// needs TLS, and this build has no mbedTLS");
+        return false;
+#endif
+    } else {
+        LOG_E("RTMP: Invalid URL scheme");
         return false;
     }
     
-    String remainder = url.substring(7);  // Remove "rtmp://"
-    
     int slashPos = remainder.indexOf('/');
     if (slashPos == -1) {
-        Serial.println("RTMP: Invalid URL format");
+        LOG_E("RTMP: Invalid URL format");
         return false;
     }
     
@@ -45,7 +135,7 @@ bool RTMPClient::parseURL(const String& url) {
         _serverPort = hostPort.substring(colonPos + 1).toInt();
     } else {
         _serverHost = hostPort;
-        _serverPort = 1935;  // Default RTMP port
+        _serverPort = _secure ? 443 : 1935;  // Default RTMPS/RTMP port
     }
     
     // Parse app and stream name
@@ -58,69 +148,123 @@ bool RTMPClient::parseURL(const String& url) {
         _streamName = "";
     }
     
-    Serial.printf("RTMP: Parsed URL - Host: %s, Port: %d, App: %s, Stream: %s\n",
+    LOG_D("RTMP: Parsed URL - Host: %s, Port: %d, App: %s, Stream: %s",
                  _serverHost.c_str(), _serverPort, _appName.c_str(), _streamName.c_str());
     
     return true;
 }
 
 bool RTMPClient::connect(const String& url, const String& streamKey) {
-    Serial.println("RTMP: Connecting...");
+    LOG_I("RTMP: Connecting...");
     
     _streamKey = streamKey;
     
-    if (!parseURL(url)) {
+    _urlValid = parseURL(url);
+    if (!_urlValid) {
         setState(RTMPState::ERROR);
         return false;
     }
     
+    _reconnectAttempts = 0;
+    _reconnectPending = !open();
+    if (_reconnectPending) {
+        scheduleReconnect();
+    }
+    return !_reconnectPending;
+}
+
+// Connects to the parsed URL and starts publishing
+bool RTMPClient::open() {
     setState(RTMPState::CONNECTING);
+    _chunkSize = RTMP_DEFAULT_CHUNK_SIZE;
+    
+    // The TLS transport is kept across reconnects: it holds the session
+    // that makes the next handshake a short one
+    if (_secure != _transportSecure) {
+        delete _transport;
+#if RTMP_TLS_AVAILABLE
+        _transport = _secure ? (RTMPTransport*)new TlsTransport() : new SocketTransport();
+#else
+        _transport = new SocketTransport();
+#endif
+        _transportSecure = _secure;
+    }
+    _streamId = 0;
+    _transactionId = 1;
+    memset(_inStreams, 0, sizeof(_inStreams));
+    _inHeaderLen = 0;
+    _inChunk = nullptr;
+    _inChunkLeft = 0;
+    _inChunkSize = RTMP_DEFAULT_CHUNK_SIZE;
+    _bytesReceived = 0;
+    _ackWindow = 0;
+    _lastAck = 0;
     
     // Connect TCP socket
-    if (!_client.connect(_serverHost.c_str(), _serverPort)) {
-        Serial.println("RTMP: TCP connection failed");
+    if (!_transport->connect(_serverHost.c_str(), _serverPort, RTMP_CONNECT_TIMEOUT_MS)) {
+        LOG_E("RTMP: TCP connection failed");
         setState(RTMPState::ERROR);
         return false;
     }
     
-    Serial.println("RTMP: TCP connected");
+    LOG_I("RTMP: TCP connected");
     setState(RTMPState::HANDSHAKING);
     
     // Perform RTMP handshake
     if (!performHandshake()) {
-        Serial.println("RTMP: Handshake failed");
+        LOG_E("RTMP: Handshake failed");
         setState(RTMPState::ERROR);
         return false;
     }
     
-    Serial.println("RTMP: Handshake complete");
+    LOG_I("RTMP: Handshake complete");
+    
+    // Larger chunks mean fewer headers and far fewer slices per frame.
+    // Over TLS a chunk and its type 0 header (at its largest, with an
+    // extended timestamp) fill one record.
+    uint32_t chunkSize = RTMP_CHUNK_SIZE;
+    size_t record = _transport->recordSize();
+    if (record > RTMP_CHUNK_HEADER_BYTES && chunkSize + RTMP_CHUNK_HEADER_BYTES > record) {
+        chunkSize = record - RTMP_CHUNK_HEADER_BYTES;
+    }
+    if (!sendSetChunkSize(chunkSize)) {
+        LOG_E("RTMP: Set Chunk Size failed");
+        setState(RTMPState::ERROR);
+        return false;
+    }
     
     // Send connect command
     if (!sendConnect()) {
-        Serial.println("RTMP: Connect command failed");
+        LOG_E("RTMP: Connect command failed");
         setState(RTMPState::ERROR);
         return false;
     }
     
-    Serial.println("RTMP: Connected");
+    LOG_I("RTMP: Connected");
     
     // Create stream
     if (!sendCreateStream()) {
-        Serial.println("RTMP: CreateStream failed");
+        LOG_E("RTMP: CreateStream failed");
         setState(RTMPState::ERROR);
         return false;
     }
     
-    Serial.println("RTMP: Stream created");
+    LOG_I("RTMP: Stream created");
     
     // Publish stream
     if (!sendPublish()) {
-        Serial.println("RTMP: Publish failed");
+        LOG_E("RTMP: Publish failed");
         setState(RTMPState::ERROR);
         return false;
     }
     
-    Serial.println("RTMP: Now streaming!");
+    if (!sendFLVHeader()) {
+        LOG_E("RTMP: onMetaData failed");
+        setState(RTMPState::ERROR);
+        return false;
+    }
+    
+    LOG_I("RTMP: Now streaming!");
     setState(RTMPState::STREAMING);
     _lastKeepalive = millis();
     
@@ -128,16 +272,71 @@ bool RTMPClient::connect(const String& url, const String& streamKey) {
 }
 
 void RTMPClient::disconnect() {
-    if (_client.connected()) {
-        _client.stop();
+    if (_transport->connected()) {
+        flushAggregate();
+        _transport->flush(RTMP_SEND_TIMEOUT_MS);
+        _transport->close();
     }
+    abandonVideo();
+    _reconnectPending = false;
+    _recovering = false;
     setState(RTMPState::DISCONNECTED);
-    Serial.println("RTMP: Disconnected");
+    LOG_I("RTMP: Disconnected");
+}
+
+// A failed write can leave half a message on the wire, after which the
+// server misreads every chunk: the connection is dropped and a new one made
+void RTMPClient::connectionLost(const char* why) {
+    LOG_E("RTMP: %s", why);
+    _transport->close();
+    abandonVideo();
+    _aggregateLen = 0;
+    _aggregateCount = 0;
+    setState(RTMPState::DISCONNECTED);
+    if (!_recovering) {
+        _recovering = true;
+        _droppedAt = millis();
+    }
+    _reconnectPending = true;
+    _reconnectAttempts = 0;
+    scheduleReconnect();
+}
+
+// Exponential backoff with equal jitter (half the delay fixed, half random),
+// so cameras dropped by the same server restart do not all return at once
+void RTMPClient::scheduleReconnect() {
+    uint8_t doublings = min(_reconnectAttempts, (uint8_t)RTMP_MAX_RECONNECT_ATTEMPTS);
+    uint32_t delayMs = (uint32_t)RTMP_RECONNECT_BASE_MS << doublings;
+    _nextReconnect = millis() + delayMs / 2 + random(delayMs / 2 + 1);
+}
+
+void RTMPClient::attemptReconnect() {
+    _reconnectAttempts++;
+    metricReconnectAttempts.inc();
+    LOG_W("RTMP: Reconnect attempt %u", _reconnectAttempts);
+    
+    if (open()) {
+        _reconnectPending = false;
+        _reconnectAttempts = 0;
+        _reconnects++;
+        metricReconnects.inc();
+        if (_recovering) {
+            LOG_I("RTMP: Reconnected %u ms after the drop", (unsigned)(millis() - _droppedAt));
+        }
+        return;
+    }
+    
+    if (_reconnectAttempts == RTMP_MAX_RECONNECT_ATTEMPTS) {
+        LOG_E("RTMP: Still down after %u attempts, retrying every %u s or so", _reconnectAttempts,
+              (unsigned)(((uint32_t)RTMP_RECONNECT_BASE_MS << RTMP_MAX_RECONNECT_ATTEMPTS) / 1000));
+    }
+    scheduleReconnect();
 }
 
 bool RTMPClient::sendVideoFrame(camera_fb_t* fb, uint32_t timestamp) {
     if (!isConnected() || !fb) {
         _droppedFrames++;
+        metricFramesDropped.inc();
         return false;
     }
     
@@ -158,51 +357,59 @@ bool RTMPClient::sendAudioSamples(int16_t* samples, size_t count, uint32_t times
 
 void RTMPClient::handle() {
     if (!isConnected()) {
+        if (_reconnectPending && _autoReconnect && (int32_t)(millis() - _nextReconnect) >= 0) {
+            attemptReconnect();
+        }
+        return;
+    }
+    
+    // Replies, acknowledgements and pings from the server
+    if (!readInbound()) {
+        connectionLost("Connection lost");
         return;
     }
     
-    // Send keepalive ping
+    // Keepalive: an Acknowledgement of what has arrived so far. Either peer
+    // may send one at any time; User Control pings are the server's to send.
     uint32_t now = millis();
     if (now - _lastKeepalive >= RTMP_KEEPALIVE_INTERVAL_MS) {
         _lastKeepalive = now;
-        
-        // Send RTMP ping (Type 6 User Control Message)
-        uint8_t pingData[10];
-        pingData[0] = 0x02;  // Chunk stream ID 2
-        pingData[1] = 0x00;  // Timestamp
-        pingData[2] = 0x00;
-        pingData[3] = 0x00;
-        pingData[4] = 0x00;  // Message length
-        pingData[5] = 0x06;
-        pingData[6] = 0x04;  // Message type 4 (User Control)
-        pingData[7] = 0x00;  // Stream ID
-        pingData[8] = 0x00;
-        pingData[9] = 0x06;  // Ping event
-        
-        _client.write(pingData, 10);
-        Serial.println("RTMP: Keepalive ping sent");
+        if (!sendAcknowledgement()) {
+            connectionLost("Keepalive send failed");
+            return;
+        }
+        LOG_D("RTMP: Keepalive sent");
+    }
+    
+    // Push out whatever the socket could not take earlier, then more of
+    // the video message going out
+    _transport->flush(0);
+    if (!pumpVideo()) {
+        return;
+    }
+    
+    // A batch whose first message has waited long enough
+    if (_aggregateLen > 0 && millis() - _aggregateStart >= _aggregateMaxMs && !flushAggregate()) {
+        connectionLost("Aggregate send failed");
+        return;
     }
     
     // Check connection
-    if (!_client.connected()) {
-        Serial.println("RTMP: Connection lost");
-        setState(RTMPState::DISCONNECTED);
+    if (!_transport->connected()) {
+        connectionLost("Connection lost");
     }
 }
 
 void RTMPClient::setState(RTMPState newState) {
     if (_state != newState) {
         _state = newState;
-        Serial.printf("RTMP: State changed to %d\n", (int)newState);
+        LOG_D("RTMP: State changed to %d", (int)newState);
     }
 }
 
 bool RTMPClient::performHandshake() {
     // C0: Version (0x03)
     uint8_t c0 = 0x03;
-    if (_client.write(&c0, 1) != 1) {
-        return false;
-    }
     
     // C1: 1536 bytes (timestamp + zero + random data)
     uint8_t c1[1536];
@@ -223,62 +430,79 @@ bool RTMPClient::performHandshake() {
         c1[i] = random(0, 256);
     }
     
-    if (_client.write(c1, 1536) != 1536) {
+    TransportSlice c0c1[] = { { &c0, 1 }, { c1, sizeof(c1) } };
+    if (!_transport->writev(c0c1, 2)) {
         return false;
     }
     
     _bytesSent += 1537;
+    metricBytesSent.inc(1537);
     
     // Read S0
-    unsigned long startTime = millis();
-    while (_client.available() < 1) {
-        if (millis() - startTime > 5000) {
-            Serial.println("RTMP: Timeout waiting for S0");
-            return false;
-        }
-        delay(10);
-    }
-    
     uint8_t s0;
-    _client.read(&s0, 1);
+    if (!readExactly(&s0, 1, "S0")) {
+        return false;
+    }
     if (s0 != 0x03) {
-        Serial.printf("RTMP: Invalid S0 version: 0x%02X\n", s0);
+        LOG_E("RTMP: Invalid S0 version: 0x%02X", s0);
         return false;
     }
     
     // Read S1 (1536 bytes)
-    startTime = millis();
-    while (_client.available() < 1536) {
-        if (millis() - startTime > 5000) {
-            Serial.println("RTMP: Timeout waiting for S1");
-            return false;
-        }
-        delay(10);
-    }
-    
     uint8_t s1[1536];
-    _client.read(s1, 1536);
+    if (!readExactly(s1, sizeof(s1), "S1")) {
+        return false;
+    }
     
     // Send C2 (echo S1)
-    if (_client.write(s1, 1536) != 1536) {
+    if (!_transport->write(s1, sizeof(s1))) {
         return false;
     }
     
     _bytesSent += 1536;
+    metricBytesSent.inc(1536);
     
     // Read S2 (can ignore - it's echo of C1)
-    startTime = millis();
-    while (_client.available() < 1536) {
-        if (millis() - startTime > 5000) {
-            Serial.println("RTMP: Timeout waiting for S2");
+    uint8_t s2[1536];
+    return readExactly(s2, sizeof(s2), "S2");
+}
+
+bool RTMPClient::readExactly(uint8_t* buffer, size_t len, const char* what) {
+    size_t received = 0;
+    unsigned long startTime = millis();
+    while (received < len) {
+        int n = _transport->read(buffer + received, len - received);
+        if (n < 0) {
+            LOG_E("RTMP: Connection closed waiting for %s", what);
             return false;
         }
-        delay(10);
+        if (n == 0) {
+            if (millis() - startTime > RTMP_CONNECT_TIMEOUT_MS) {
+                LOG_E("RTMP: Timeout waiting for %s", what);
+                return false;
+            }
+            delay(10);
+        }
+        received += n;
     }
-    
-    uint8_t s2[1536];
-    _client.read(s2, 1536);
-    
+    _bytesReceived += len;
+    metricBytesReceived.inc(len);
+    return true;
+}
+
+// Protocol control message 1 on chunk stream 2; applies to every chunk we
+// send after it
+bool RTMPClient::sendSetChunkSize(uint32_t size) {
+    uint8_t payload[4];
+    payload[0] = (size >> 24) & 0x7F;  // Top bit must be zero
+    payload[1] = (size >> 16) & 0xFF;
+    payload[2] = (size >> 8) & 0xFF;
+    payload[3] = size & 0xFF;
+    if (!sendControl(0x01, payload, sizeof(payload))) {
+        return false;
+    }
+    _chunkSize = size;
+    LOG_D("RTMP: Chunk size %u", (unsigned)size);
     return true;
 }
 
@@ -298,7 +522,7 @@ bool RTMPClient::sendConnect() {
     writeAMFPropertyString(packet, pos, "app", _appName);
     writeAMFPropertyString(packet, pos, "type", "nonprivate");
     writeAMFPropertyString(packet, pos, "flashVer", "FMLE/3.0");
-    writeAMFPropertyString(packet, pos, "tcUrl", String("rtmp://") + _serverHost + "/" + _appName);
+    writeAMFPropertyString(packet, pos, "tcUrl", String(_secure ? "rtmps://" : "rtmp://") + _serverHost + "/" + _appName);
     writeAMFObjectEnd(packet, pos);
     
     // Send via chunk stream ID 3 (control channel)
@@ -324,16 +548,14 @@ bool RTMPClient::sendCreateStream() {
         return false;
     }
     
-    // Read response to get stream ID
+    // The replies so far (Window Acknowledgement Size, Set Chunk Size,
+    // _result) go through the inbound reader; the stream ID is taken to be
+    // 1, which is what servers hand the first stream
     delay(100);
-    if (_client.available() > 0) {
-        uint8_t response[128];
-        size_t len = _client.readBytes(response, min((int)_client.available(), 128));
-        // Parse stream ID from response (simplified - assumes it's 1)
-        _streamId = 1;
-    } else {
-        _streamId = 1;  // Default
+    if (!readInbound()) {
+        return false;
     }
+    _streamId = 1;
     
     return true;
 }
@@ -360,89 +582,438 @@ bool RTMPClient::sendPublish() {
     return sendChunk(4, 0, 0x14, packet, pos);
 }
 
+void RTMPClient::setVideoInfo(uint16_t width, uint16_t height, float frameRate) {
+    _videoWidth = width;
+    _videoHeight = height;
+    _frameRate = frameRate;
+}
+
 bool RTMPClient::sendFLVHeader() {
-    // TODO: Send FLV file header
-    return false;
+    // RTMP has no FLV file header. What stands in for it is the onMetaData
+    // the encoder sends after publish; @setDataFrame has the server keep it
+    // for players that join later.
+    uint8_t packet[512];
+    int pos = 0;
+    
+    writeAMFString(packet, pos, "@setDataFrame");
+    writeAMFString(packet, pos, "onMetaData");
+    writeAMFObject(packet, pos);
+    if (_videoWidth > 0) {
+        writeAMFProperty(packet, pos, "width", _videoWidth);
+        writeAMFProperty(packet, pos, "height", _videoHeight);
+    }
+    if (_frameRate > 0.0f) {
+        writeAMFProperty(packet, pos, "framerate", _frameRate);
+    }
+    writeAMFProperty(packet, pos, "videocodecid", 7);      // As the video tags declare
+#if RTMP_AUDIO_ENABLED
+    writeAMFProperty(packet, pos, "audiocodecid", 3);      // Linear PCM
+    writeAMFProperty(packet, pos, "audiosamplerate", AUDIO_SAMPLE_RATE);
+    writeAMFProperty(packet, pos, "audiosamplesize", 16);
+    writeAMFPropertyBool(packet, pos, "stereo", AUDIO_CHANNELS > 1);
+#endif
+    writeAMFPropertyString(packet, pos, "encoder", "AIStreamingCamera");
+    writeAMFObjectEnd(packet, pos);
+    
+    // Data message (AMF0) on the command chunk stream, or ahead of the
+    // first audio in an aggregate
+    if (_aggregateCapacity > 0) {
+        return aggregate(4, 0, 0x12, packet, pos, nullptr, 0);
+    }
+    return sendChunk(4, 0, 0x12, packet, pos);
 }
 
 bool RTMPClient::sendVideoData(const uint8_t* data, size_t len, uint32_t timestamp) {
-    // FLV Video Tag format for JPEG frames
-    // Since ESP32-CAM provides JPEG, we'll send as video frame
+    TRACE_SCOPE_ARG("rtmp.sendVideo", len);
+    uint32_t start = micros();
     
-    uint8_t* packet = (uint8_t*)malloc(len + 5);
-    if (!packet) {
-        Serial.println("RTMP: Failed to allocate video packet");
+    // The previous frame is still going out: the link is behind, and the
+    // next frame will be newer than this one
+    if (isSendingVideo() || (_transport->pending() > 0 && !_transport->flush(0))) {
         _droppedFrames++;
+        metricFramesDropped.inc();
+        metricFramesBackpressure.inc();
         return false;
     }
     
-    int pos = 0;
-    
-    // FLV VideoTagHeader
-    // Frame type (1 = keyframe, 2 = inter) + Codec ID (7 = AVC/H.264, but we use custom for JPEG)
-    // For JPEG streaming, we'll use a simplified approach
-    packet[pos++] = 0x17;  // Keyframe + AVC (we'll treat JPEG as keyframe)
-    
-    // AVC packet type (0 = sequence header, 1 = NALU)
-    packet[pos++] = 0x01;
-    
-    // Composition time (3 bytes, 0 for now)
-    packet[pos++] = 0x00;
-    packet[pos++] = 0x00;
-    packet[pos++] = 0x00;
-    
-    // Copy video data
-    memcpy(packet + pos, data, len);
-    pos += len;
+    // Batched audio is older than this frame: it goes first
+    if (!flushAggregate()) {
+        connectionLost("Aggregate send failed");
+        return false;
+    }
     
-    // Send via RTMP chunk stream 6 (video)
-    bool success = sendChunk(6, timestamp, 0x09, packet, pos);
+    uint8_t header[RTMP_VIDEO_TAG_HEADER_BYTES];
+    size_t headerLen = encodeVideoTagHeader(header);
     
-    free(packet);
+    // Send via RTMP chunk stream 6 (video); the JPEG goes out from the
+    // frame buffer itself
+    bool success = sendMessage(6, timestamp, 0x09, header, headerLen, data, len);
     
     if (success) {
-        _framesSent++;
-        _videoTimestamp = timestamp;
+        videoSent(timestamp, start);
     } else {
         _droppedFrames++;
+        metricFramesDropped.inc();
+        connectionLost("Video send failed");
     }
     
     return success;
 }
 
-bool RTMPClient::sendAudioData(const uint8_t* data, size_t len, uint32_t timestamp) {
-    // FLV Audio Tag format for PCM
+bool RTMPClient::beginVideoData(const uint8_t* data, size_t len, uint32_t timestamp) {
+    TRACE_SCOPE_ARG("rtmp.beginVideo", len);
+    
+    if (isSendingVideo() || (_transport->pending() > 0 && !_transport->flush(0))) {
+        _droppedFrames++;
+        metricFramesDropped.inc();
+        metricFramesBackpressure.inc();
+        return false;
+    }
     
-    uint8_t* packet = (uint8_t*)malloc(len + 1);
-    if (!packet) {
-        Serial.println("RTMP: Failed to allocate audio packet");
+    if (!flushAggregate()) {
+        connectionLost("Aggregate send failed");
         return false;
     }
     
+    _videoBody = data;
+    _videoLength = encodeVideoTagHeader(_videoHead) + len;
+    _videoOffset = 0;
+    _videoMessageTimestamp = timestamp;
+    _videoStart = micros();
+    
+    // The first chunks go out now, as far as the socket takes them
+    return pumpVideo();
+}
+
+size_t RTMPClient::encodeVideoTagHeader(uint8_t* header) {
+    // FLV Video Tag format for JPEG frames
+    // Since ESP32-CAM provides JPEG, we'll send as video frame
     int pos = 0;
     
+    // FLV VideoTagHeader
+    // Frame type (1 = keyframe, 2 = inter) + Codec ID (7 = AVC/H.264, but we use custom for JPEG)
+    // For JPEG streaming, we'll use a simplified approach
+    header[pos++] = 0x17;  // Keyframe + AVC (we'll treat JPEG as keyframe)
+    
+    // AVC packet type (0 = sequence header, 1 = NALU)
+    header[pos++] = 0x01;
+    
+    // Composition time (3 bytes, 0 for now)
+    header[pos++] = 0x00;
+    header[pos++] = 0x00;
+    header[pos++] = 0x00;
+    
+    return pos;
+}
+
+// Writes chunks of the interleaved video message while the link keeps up:
+// nothing waiting in the send queue and no more than RTMP_INTERLEAVE_BYTES
+// unsent in the socket. A chunk the socket only partly takes is finished
+// from the send queue before anything else, so other chunk streams always
+// come in at a chunk boundary. False once the connection has failed.
+bool RTMPClient::pumpVideo() {
+    // Type 3 header for continuation chunks on chunk stream 6
+    uint8_t contHeader[RTMP_CONT_HEADER_BYTES];
+    size_t contLen = encodeContinuationHeader(contHeader, 6, _videoMessageTimestamp);
+    const size_t headLen = RTMP_VIDEO_TAG_HEADER_BYTES;
+    
+    while (_videoBody) {
+        if ((_transport->pending() > 0 && !_transport->flush(0)) ||
+            _transport->unsent() > RTMP_INTERLEAVE_BYTES) {
+            return true;
+        }
+        
+        uint8_t header[RTMP_CHUNK_HEADER_BYTES];
+        TransportSlice slices[3];
+        int count = 0;
+        size_t headerLen = contLen;
+        if (_videoOffset == 0) {
+            headerLen = encodeChunkHeader(header, 6, _videoMessageTimestamp, _videoLength, 0x09, _streamId);
+            slices[count++] = { header, headerLen };
+        } else {
+            slices[count++] = { contHeader, contLen };
+        }
+        size_t end = min(_videoOffset + (size_t)_chunkSize, _videoLength);
+        if (_videoOffset < headLen) {
+            slices[count++] = { _videoHead + _videoOffset, min(end, headLen) - _videoOffset };
+        }
+        if (end > headLen) {
+            size_t from = max(_videoOffset, headLen);
+            slices[count++] = { _videoBody + (from - headLen), end - from };
+        }
+        
+        if (!_transport->writev(slices, count)) {
+            connectionLost("Video send failed");        // Counts the frame as dropped
+            return false;
+        }
+        
+        size_t bytes = headerLen + (end - _videoOffset);
+        _bytesSent += bytes;
+        metricBytesSent.inc(bytes);
+        metricChunksSent.inc();
+        _videoOffset = end;
+        
+        if (_videoOffset == _videoLength) {
+            _videoBody = nullptr;
+            videoSent(_videoMessageTimestamp, _videoStart);
+        }
+    }
+    return true;
+}
+
+void RTMPClient::videoSent(uint32_t timestamp, uint32_t start) {
+    _framesSent++;
+    _videoTimestamp = timestamp;
+    metricFramesSent.inc();
+    metricSendLatency.observe(micros() - start);
+    if (_recovering) {
+        _recovering = false;
+        metricReconnectTime.observe(millis() - _droppedAt);
+    }
+}
+
+// The caller may reuse the payload as soon as isSendingVideo() is false
+void RTMPClient::abandonVideo() {
+    if (_videoBody) {
+        _videoBody = nullptr;
+        _droppedFrames++;
+        metricFramesDropped.inc();
+    }
+}
+
+bool RTMPClient::sendAudioData(const uint8_t* data, size_t len, uint32_t timestamp) {
+    // FLV Audio Tag format for PCM
     // FLV AudioTagHeader
     // Format (3 = PCM) | Sample rate (3 = 44kHz) | Size (1 = 16-bit) | Type (1 = stereo, 0 = mono)
     // 0011 | 11 | 1 | 0 = 0x3E for 16-bit 44kHz PCM mono
     // For 16kHz: 0011 | 00 | 1 | 0 = 0x32
-    packet[pos++] = 0x32;  // PCM, 16kHz, 16-bit, mono
-    
-    // Copy audio data
-    memcpy(packet + pos, data, len);
-    pos += len;
+    uint8_t header = 0x32;  // PCM, 16kHz, 16-bit, mono
     
-    // Send via RTMP chunk stream 5 (audio)
-    bool success = sendChunk(5, timestamp, 0x08, packet, pos);
+    metricAudioWait.observe((uint32_t)(_transport->pending() + _transport->unsent()));
     
-    free(packet);
+    // Send via RTMP chunk stream 5 (audio), on its own or in the next aggregate
+    bool success = _aggregateCapacity > 0 ? aggregate(5, timestamp, 0x08, &header, 1, data, len)
+                                          : sendMessage(5, timestamp, 0x08, &header, 1, data, len);
     
     if (success) {
         _audioTimestamp = timestamp;
+    } else {
+        connectionLost("Audio send failed");
     }
     
     return success;
 }
 
+// Server Messages
+
+// Reads everything the server has sent. Only control messages are acted
+// on: Set Chunk Size to keep reading, Window Acknowledgement Size to
+// acknowledge, Abort, and User Control Ping Requests, which get a Ping
+// Response. Commands and anything else are read and skipped; the client
+// does not wait for replies. False once the connection has failed.
+bool RTMPClient::readInbound() {
+    uint8_t buffer[256];
+    for (;;) {
+        int n = _transport->read(buffer, sizeof(buffer));
+        if (n < 0) {
+            return false;
+        }
+        if (n == 0) {
+            break;
+        }
+        _bytesReceived += n;
+        metricBytesReceived.inc(n);
+        
+        const uint8_t* data = buffer;
+        while (data < buffer + n) {
+            if (!consumeInbound(data, buffer + n)) {
+                return false;
+            }
+        }
+    }
+    
+    if (_ackWindow > 0 && _bytesReceived - _lastAck >= _ackWindow) {
+        return sendAcknowledgement();
+    }
+    return true;
+}
+
+// Takes chunk header bytes one at a time until the header is complete,
+// then chunk data in runs
+bool RTMPClient::consumeInbound(const uint8_t*& data, const uint8_t* end) {
+    if (!_inChunk) {
+        _inHeader[_inHeaderLen++] = *data++;
+        if (_inHeaderLen < inboundHeaderLength()) {
+            return true;
+        }
+        // A message without data is complete with its header
+        InboundStream* empty = beginInboundChunk();
+        return !empty || inboundMessage(*empty);
+    }
+    
+    InboundStream& stream = *_inChunk;
+    size_t n = min((size_t)(end - data), (size_t)_inChunkLeft);
+    size_t offset = stream.length - stream.remaining;
+    if (offset < sizeof(stream.body)) {
+        memcpy(stream.body + offset, data, min(n, sizeof(stream.body) - offset));
+    }
+    data += n;
+    stream.remaining -= n;
+    _inChunkLeft -= n;
+    if (_inChunkLeft > 0) {
+        return true;
+    }
+    _inChunk = nullptr;
+    return stream.remaining > 0 || inboundMessage(stream);
+}
+
+// Bytes in the header being read, as far as the bytes so far tell
+size_t RTMPClient::inboundHeaderLength() {
+    static const size_t messageHeader[4] = { 11, 7, 3, 0 };
+    uint8_t format = _inHeader[0] >> 6;
+    uint8_t low = _inHeader[0] & 0x3F;
+    size_t basic = low == 0 ? 2 : (low == 1 ? 3 : 1);
+    if (_inHeaderLen < basic) {
+        return basic;
+    }
+    size_t length = basic + messageHeader[format];
+    if (_inHeaderLen < length) {
+        return length;
+    }
+    
+    // Timestamp 0xFFFFFF announces the extended field; type 3 chunks carry
+    // one when the chunk stream's last header did
+    bool extended;
+    if (format < 3) {
+        extended = _inHeader[basic] == 0xFF && _inHeader[basic + 1] == 0xFF && _inHeader[basic + 2] == 0xFF;
+    } else {
+        uint32_t chunkStreamId = low == 0 ? 64 + _inHeader[1] : (low == 1 ? 64 + _inHeader[1] + 256 * _inHeader[2] : low);
+        extended = inboundStream(chunkStreamId)->extended;
+    }
+    return length + (extended ? 4 : 0);
+}
+
+// The header is complete: start reading the chunk's data. Returns the
+// stream when its message has no data at all (already complete).
+RTMPClient::InboundStream* RTMPClient::beginInboundChunk() {
+    uint8_t format = _inHeader[0] >> 6;
+    uint8_t low = _inHeader[0] & 0x3F;
+    size_t basic = low == 0 ? 2 : (low == 1 ? 3 : 1);
+    uint32_t chunkStreamId = low == 0 ? 64 + _inHeader[1] : (low == 1 ? 64 + _inHeader[1] + 256 * _inHeader[2] : low);
+    InboundStream* stream = inboundStream(chunkStreamId);
+    const uint8_t* header = _inHeader + basic;
+    _inHeaderLen = 0;
+    
+    if (format < 3) {
+        stream->extended = header[0] == 0xFF && header[1] == 0xFF && header[2] == 0xFF;
+    }
+    if (format < 2) {
+        stream->length = ((uint32_t)header[3] << 16) | ((uint32_t)header[4] << 8) | header[5];
+        stream->type = header[6];
+    }
+    if (stream->remaining == 0) {
+        stream->remaining = stream->length;
+    }
+    
+    _inChunkLeft = min(_inChunkSize, stream->remaining);
+    if (_inChunkLeft == 0) {
+        return stream;
+    }
+    _inChunk = stream;
+    return nullptr;
+}
+
+// Chunk streams by ID; a server using more than RTMP_INBOUND_STREAMS at
+// once shares slots, which only matters for streams we ignore anyway
+RTMPClient::InboundStream* RTMPClient::inboundStream(uint32_t chunkStreamId) {
+    InboundStream* unused = nullptr;
+    for (int i = 0; i < RTMP_INBOUND_STREAMS; i++) {
+        if (_inStreams[i].used && _inStreams[i].chunkStreamId == chunkStreamId) {
+            return &_inStreams[i];
+        }
+        if (!_inStreams[i].used && !unused) {
+            unused = &_inStreams[i];
+        }
+    }
+    if (!unused) {
+        unused = &_inStreams[chunkStreamId % RTMP_INBOUND_STREAMS];
+    }
+    memset(unused, 0, sizeof(*unused));
+    unused->used = true;
+    unused->chunkStreamId = chunkStreamId;
+    return unused;
+}
+
+bool RTMPClient::inboundMessage(InboundStream& stream) {
+    const uint8_t* p = stream.body;
+    uint32_t value = ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+    
+    switch (stream.type) {
+        case 0x01:  // Set Chunk Size
+            if (stream.length >= 4 && (value & 0x7FFFFFFF) > 0) {
+                _inChunkSize = value & 0x7FFFFFFF;
+                LOG_D("RTMP: Server chunk size %u", (unsigned)_inChunkSize);
+            }
+            break;
+        case 0x02:  // Abort: drop the partial message on that chunk stream
+            if (stream.length >= 4) {
+                inboundStream(value)->remaining = 0;
+            }
+            break;
+        case 0x05:  // Window Acknowledgement Size
+            if (stream.length >= 4) {
+                _ackWindow = value;
+                LOG_D("RTMP: Server acknowledgement window %u", (unsigned)value);
+            }
+            break;
+        case 0x04:  // User Control: answer Ping Request (6) with Ping Response (7)
+            if (stream.length >= 6 && p[0] == 0x00 && p[1] == 0x06) {
+                uint8_t pong[6];
+                memcpy(pong, p, sizeof(pong));
+                pong[1] = 0x07;
+                if (!sendControl(0x04, pong, sizeof(pong))) {
+                    return false;
+                }
+                metricPingsAnswered.inc();
+            }
+            break;
+        default:
+            break;
+    }
+    return true;
+}
+
+// Acknowledgement (type 3): the number of bytes received so far
+bool RTMPClient::sendAcknowledgement() {
+    uint32_t sequence = (uint32_t)_bytesReceived;  // Wraps at 4 GB, as the spec has it
+    uint8_t payload[4];
+    payload[0] = (sequence >> 24) & 0xFF;
+    payload[1] = (sequence >> 16) & 0xFF;
+    payload[2] = (sequence >> 8) & 0xFF;
+    payload[3] = sequence & 0xFF;
+    if (!sendControl(0x03, payload, sizeof(payload))) {
+        return false;
+    }
+    _lastAck = _bytesReceived;
+    metricAcksSent.inc();
+    return true;
+}
+
+// Protocol control messages go on chunk stream 2 and message stream 0,
+// whatever stream is published; all of them fit one chunk
+bool RTMPClient::sendControl(uint8_t messageType, const uint8_t* payload, size_t len) {
+    uint8_t header[RTMP_CHUNK_HEADER_BYTES];
+    size_t headerLen = encodeChunkHeader(header, 2, 0, len, messageType, 0);
+    TransportSlice slices[2] = { { header, headerLen }, { payload, len } };
+    if (!_transport->writev(slices, 2)) {
+        return false;
+    }
+    _bytesSent += headerLen + len;
+    metricBytesSent.inc(headerLen + len);
+    metricChunksSent.inc();
+    return true;
+}
+
 // AMF Encoding Functions
 void RTMPClient::writeAMFString(uint8_t* buf, int& pos, const String& str) {
     buf[pos++] = 0x02;  // AMF0 String type
@@ -521,53 +1092,174 @@ void RTMPClient::writeAMFPropertyBool(uint8_t* buf, int& pos, const String& name
     writeAMFBoolean(buf, pos, value);
 }
 
-// RTMP Chunking
-bool RTMPClient::sendChunk(uint8_t chunkStreamId, uint32_t timestamp, uint8_t messageType, 
-                           const uint8_t* data, size_t len) {
-    // Write chunk header (Type 0 - full header)
-    if (!writeChunkHeader(chunkStreamId, timestamp, len, messageType, _streamId)) {
-        return false;
+// Aggregate Messages
+void RTMPClient::setAggregation(size_t maxBytes, uint32_t maxMs) {
+    _aggregateMaxMs = maxMs;
+    if (maxBytes == _aggregateCapacity) {
+        return;
+    }
+    flushAggregate();
+    free(_aggregate);
+    _aggregate = nullptr;
+    _aggregateCapacity = 0;
+    if (maxBytes > 0) {
+        _aggregate = (uint8_t*)ps_malloc(maxBytes);
+        if (!_aggregate) {
+            LOG_E("RTMP: Cannot allocate a %u byte aggregate, sending messages singly", (unsigned)maxBytes);
+            return;
+        }
+        _aggregateCapacity = maxBytes;
+    }
+}
+
+// Appends one message as an FLV tag: type, length, timestamp relative to
+// the first sub-message, stream ID 0 (the aggregate's applies), payload,
+// then the back-pointer (tag header plus payload). The batch goes out
+// first when the message would not fit or the batch is due; a message
+// that does not fit even an empty batch is sent on its own.
+bool RTMPClient::aggregate(uint8_t chunkStreamId, uint32_t timestamp, uint8_t messageType,
+                           const uint8_t* head, size_t headLen, const uint8_t* body, size_t bodyLen) {
+    size_t len = headLen + bodyLen;
+    size_t tagLen = RTMP_AGGREGATE_TAG_BYTES + len + RTMP_AGGREGATE_BACK_BYTES;
+    
+    if (_aggregateLen > 0 &&
+        (_aggregateLen + tagLen > _aggregateCapacity || millis() - _aggregateStart >= _aggregateMaxMs)) {
+        if (!flushAggregate()) {
+            return false;
+        }
+    }
+    if (tagLen > _aggregateCapacity) {
+        return sendMessage(chunkStreamId, timestamp, messageType, head, headLen, body, bodyLen);
     }
     
-    // Write data (chunk it if > 128 bytes)
-    const size_t chunkSize = 128;
-    size_t sent = 0;
+    if (_aggregateLen == 0) {
+        _aggregateTimestamp = timestamp;
+        _aggregateStart = millis();
+    }
+    int32_t offset = (int32_t)(timestamp - _aggregateTimestamp);
+    uint32_t relative = offset > 0 ? (uint32_t)offset : 0;
+    
+    uint8_t* tag = _aggregate + _aggregateLen;
+    tag[0] = messageType;
+    tag[1] = (len >> 16) & 0xFF;
+    tag[2] = (len >> 8) & 0xFF;
+    tag[3] = len & 0xFF;
+    tag[4] = (relative >> 16) & 0xFF;
+    tag[5] = (relative >> 8) & 0xFF;
+    tag[6] = relative & 0xFF;
+    tag[7] = (relative >> 24) & 0xFF;   // Timestamp extension
+    tag[8] = 0x00;                      // Stream ID
+    tag[9] = 0x00;
+    tag[10] = 0x00;
+    memcpy(tag + RTMP_AGGREGATE_TAG_BYTES, head, headLen);
+    if (bodyLen > 0) {
+        memcpy(tag + RTMP_AGGREGATE_TAG_BYTES + headLen, body, bodyLen);
+    }
     
-    while (sent < len) {
-        size_t toSend = min(len - sent, chunkSize);
-        
-        if (sent > 0) {
-            // Type 3 header for continuation chunks
-            uint8_t contHeader = 0xC0 | (chunkStreamId & 0x3F);
-            if (_client.write(&contHeader, 1) != 1) {
+    uint32_t back = RTMP_AGGREGATE_TAG_BYTES + len;
+    uint8_t* backPointer = tag + RTMP_AGGREGATE_TAG_BYTES + len;
+    backPointer[0] = (back >> 24) & 0xFF;
+    backPointer[1] = (back >> 16) & 0xFF;
+    backPointer[2] = (back >> 8) & 0xFF;
+    backPointer[3] = back & 0xFF;
+    
+    _aggregateLen += tagLen;
+    _aggregateCount++;
+    return true;
+}
+
+// Sends the batch as one message (type 22) on the audio chunk stream, which
+// carries most of what is batched. The caller drops the connection when
+// this fails.
+bool RTMPClient::flushAggregate() {
+    if (_aggregateLen == 0) {
+        return true;
+    }
+    TRACE_SCOPE_ARG("rtmp.aggregate", _aggregateCount);
+    bool success = sendMessage(5, _aggregateTimestamp, 0x16, _aggregate, _aggregateLen, nullptr, 0);
+    if (success) {
+        metricAggregates.inc();
+        metricAggregated.inc(_aggregateCount);
+    }
+    _aggregateLen = 0;
+    _aggregateCount = 0;
+    return success;
+}
+
+// RTMP Chunking
+bool RTMPClient::sendChunk(uint8_t chunkStreamId, uint32_t timestamp, uint8_t messageType, 
+                           const uint8_t* data, size_t len) {
+    return sendMessage(chunkStreamId, timestamp, messageType, data, len, nullptr, 0);
+}
+
+bool RTMPClient::sendMessage(uint8_t chunkStreamId, uint32_t timestamp, uint8_t messageType,
+                             const uint8_t* head, size_t headLen, const uint8_t* body, size_t bodyLen) {
+    size_t len = headLen + bodyLen;
+    uint8_t header[RTMP_CHUNK_HEADER_BYTES];
+    size_t headerLen = encodeChunkHeader(header, chunkStreamId, timestamp, len, messageType, _streamId);
+    
+    // Type 3 header for continuation chunks; every one is the same
+    uint8_t contHeader[RTMP_CONT_HEADER_BYTES];
+    size_t contLen = encodeContinuationHeader(contHeader, chunkStreamId, timestamp);
+    
+    TransportSlice slices[RTMP_GATHER_SLICES];
+    int count = 0;
+    slices[count++] = { header, headerLen };
+    
+    size_t offset = 0;
+    uint32_t chunks = 0;
+    do {
+        // A chunk is at most three slices: its header, the end of the head
+        // and the start of the body
+        if (count + 3 > RTMP_GATHER_SLICES) {
+            if (!_transport->writev(slices, count)) {
                 return false;
             }
-            _bytesSent++;
+            count = 0;
         }
-        
-        if (_client.write(data + sent, toSend) != toSend) {
-            return false;
+        if (offset > 0) {
+            slices[count++] = { contHeader, contLen };
         }
-        
-        _bytesSent += toSend;
-        sent += toSend;
+        size_t end = min(offset + (size_t)_chunkSize, len);
+        if (offset < headLen) {
+            slices[count++] = { head + offset, min(end, headLen) - offset };
+        }
+        if (end > headLen) {
+            size_t from = max(offset, headLen);
+            slices[count++] = { body + (from - headLen), end - from };
+        }
+        offset = end;
+        chunks++;
+    } while (offset < len);
+    
+    if (!_transport->writev(slices, count)) {
+        return false;
     }
     
+    size_t bytes = headerLen + (chunks - 1) * contLen + len;
+    _bytesSent += bytes;
+    if (_videoOffset > 0 && isSendingVideo()) {
+        metricInterleaved.inc();
+    }
+    metricBytesSent.inc(bytes);
+    metricChunksSent.inc(chunks);
     return true;
 }
 
-bool RTMPClient::writeChunkHeader(uint8_t chunkStreamId, uint32_t timestamp, 
-                                  size_t messageLength, uint8_t messageType, uint32_t streamId) {
-    uint8_t header[12];
-    int pos = 0;
+size_t RTMPClient::encodeChunkHeader(uint8_t* header, uint8_t chunkStreamId, uint32_t timestamp, 
+                                     size_t messageLength, uint8_t messageType, uint32_t streamId) {
+    size_t pos = 0;
     
     // Chunk basic header (Type 0)
     header[pos++] = chunkStreamId & 0x3F;
     
-    // Timestamp (3 bytes)
-    header[pos++] = (timestamp >> 16) & 0xFF;
-    header[pos++] = (timestamp >> 8) & 0xFF;
-    header[pos++] = timestamp & 0xFF;
+    // Timestamp (3 bytes); from 0xFFFFFF on (4.7 hours) the field holds
+    // 0xFFFFFF and the timestamp follows the header
+    bool extended = timestamp >= RTMP_EXTENDED_TIMESTAMP;
+    uint32_t field = extended ? RTMP_EXTENDED_TIMESTAMP : timestamp;
+    header[pos++] = (field >> 16) & 0xFF;
+    header[pos++] = (field >> 8) & 0xFF;
+    header[pos++] = field & 0xFF;
     
     // Message length (3 bytes)
     header[pos++] = (messageLength >> 16) & 0xFF;
@@ -583,10 +1275,27 @@ bool RTMPClient::writeChunkHeader(uint8_t chunkStreamId, uint32_t timestamp,
     header[pos++] = (streamId >> 16) & 0xFF;
     header[pos++] = (streamId >> 24) & 0xFF;
     
-    if (_client.write(header, pos) != pos) {
-        return false;
+    // Extended timestamp (4 bytes)
+    if (extended) {
+        header[pos++] = (timestamp >> 24) & 0xFF;
+        header[pos++] = (timestamp >> 16) & 0xFF;
+        header[pos++] = (timestamp >> 8) & 0xFF;
+        header[pos++] = timestamp & 0xFF;
     }
     
-    _bytesSent += pos;
-    return true;
+    return pos;
+}
+
+// Type 3 header for the chunks after a message's first. When the type 0
+// header had an extended timestamp every continuation repeats it.
+size_t RTMPClient::encodeContinuationHeader(uint8_t* header, uint8_t chunkStreamId, uint32_t timestamp) {
+    size_t pos = 0;
+    header[pos++] = 0xC0 | (chunkStreamId & 0x3F);
+    if (timestamp >= RTMP_EXTENDED_TIMESTAMP) {
+        header[pos++] = (timestamp >> 24) & 0xFF;
+        header[pos++] = (timestamp >> 16) & 0xFF;
+        header[pos++] = (timestamp >> 8) & 0xFF;
+        header[pos++] = timestamp & 0xFF;
+    }
+    return pos;
 }
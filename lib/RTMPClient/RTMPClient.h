@@ -1,9 +1,21 @@
 #ifndef RTMP_CLIENT_H
 #define RTMP_CLIENT_H
 
-#include <WiFiClient.h>
 #include <Arduino.h>
 #include "esp_camera.h"
+#include "RTMPTransport.h"
+
+#define RTMP_DEFAULT_CHUNK_SIZE     128     // Until we announce another
+#define RTMP_CHUNK_HEADER_BYTES     16      // Type 0 with an extended timestamp
+#define RTMP_CONT_HEADER_BYTES      5       // Type 3 with an extended timestamp
+#define RTMP_EXTENDED_TIMESTAMP     0xFFFFFF    // From here the timestamp goes in 4 more bytes
+#define RTMP_GATHER_SLICES          48      // Per transport write
+#define RTMP_VIDEO_TAG_HEADER_BYTES 5       // FLV VideoTagHeader in front of the JPEG
+#define RTMP_AGGREGATE_TAG_BYTES    11      // FLV tag header in front of each sub-message
+#define RTMP_AGGREGATE_BACK_BYTES   4       // Back-pointer after it
+#define RTMP_INBOUND_STREAMS        8       // Server chunk streams tracked at once
+#define RTMP_INBOUND_BODY_BYTES     16      // Kept of each inbound message (control messages fit)
+#define RTMP_INBOUND_HEADER_BYTES   18      // Largest chunk header: 3 + 11 + 4
 
 enum class RTMPState {
     DISCONNECTED,
@@ -31,29 +43,84 @@ public:
     // Send audio samples
     bool sendAudioSamples(int16_t* samples, size_t count, uint32_t timestamp);
     
+    // Encoded payloads (JPEG, PCM) from elsewhere than the capture path, such
+    // as a store-and-forward buffer; the caller checks isConnected()
+    bool sendVideoData(const uint8_t* data, size_t len, uint32_t timestamp);
+    bool sendAudioData(const uint8_t* data, size_t len, uint32_t timestamp);
+    
+    // Video interleaved with everything else: the message goes out a chunk
+    // at a time, from here and then from handle(), only as fast as the link
+    // takes it, and audio and control messages sent meanwhile go out between
+    // its chunks. They wait behind at most RTMP_INTERLEAVE_BYTES plus one
+    // chunk of video instead of the whole frame (but complete before it: a
+    // caller keeping timestamps in order holds newer audio back). data must stay valid until
+    // isSendingVideo() is false (a drop abandons the message). False when
+    // the frame is skipped because the previous one is still going out.
+    bool beginVideoData(const uint8_t* data, size_t len, uint32_t timestamp);
+    bool isSendingVideo() const { return _videoBody != nullptr; }
+    
+    // Nothing left over from earlier messages: the next one goes straight out
+    bool isWritable() {
+        return !isSendingVideo() && (_transport->pending() == 0 || _transport->flush(0));
+    }
+    
     // Connection management
     bool isConnected() { return _state == RTMPState::STREAMING; }
     RTMPState getState() { return _state; }
     
+    // Batch audio and data messages into Aggregate messages (type 22) of
+    // up to maxBytes. A batch goes out when the next message would not fit,
+    // once its first message has waited maxMs (from here or handle()), and
+    // before any video message, so the order across streams holds. Sub-
+    // message timestamps are relative to the first. 0 sends each on its own.
+    void setAggregation(size_t maxBytes, uint32_t maxMs);
+    
+    // Stream properties announced in onMetaData after publish
+    void setVideoInfo(uint16_t width, uint16_t height, float frameRate);
+    
+    // Reconnect after a drop or a failed connect, with backoff (from handle())
+    void setAutoReconnect(bool enable) { _autoReconnect = enable; }
+    uint32_t getReconnects() { return _reconnects; }
+    uint32_t getVideoTimestamp() { return _videoTimestamp; }
+    
     // Statistics
-    uint32_t getBytesSent() { return _bytesSent; }
+    uint64_t getBytesSent() { return _bytesSent; }
     uint32_t getFramesSent() { return _framesSent; }
     uint32_t getDroppedFrames() { return _droppedFrames; }
     
-    // Keepalive (call periodically)
+    // Keepalive, server messages, queued bytes and reconnects (call
+    // periodically, also while disconnected)
     void handle();
     
 private:
-    WiFiClient _client;
+    friend class PipelineBenchmarks;    // Drives the framing directly (lib/Bench)
+    
+    // What is known of a chunk stream the server sends on
+    struct InboundStream {
+        bool used;
+        uint32_t chunkStreamId;
+        uint8_t type;
+        bool extended;                  // Its chunks carry an extended timestamp
+        uint32_t length;
+        uint32_t remaining;             // Of the message being received
+        uint8_t body[RTMP_INBOUND_BODY_BYTES];
+    };
+    
+    RTMPTransport* _transport;
+    bool _transportSecure;
     RTMPState _state;
     
     String _serverHost;
     uint16_t _serverPort;
+    bool _secure;                       // rtmps://
     String _appName;
     String _streamName;
     String _streamKey;
+    uint16_t _videoWidth;
+    uint16_t _videoHeight;
+    float _frameRate;
     
-    uint32_t _bytesSent;
+    uint64_t _bytesSent;
     uint32_t _framesSent;
     uint32_t _droppedFrames;
     uint32_t _lastKeepalive;
@@ -61,19 +128,92 @@ private:
     uint32_t _transactionId;
     uint32_t _videoTimestamp;
     uint32_t _audioTimestamp;
+    uint32_t _chunkSize;
+    
+    // Server to client: read from handle() so replies and pings never back
+    // up in the socket (see readInbound())
+    InboundStream _inStreams[RTMP_INBOUND_STREAMS];
+    uint8_t _inHeader[RTMP_INBOUND_HEADER_BYTES];
+    size_t _inHeaderLen;
+    InboundStream* _inChunk;            // Chunk whose data is being read
+    uint32_t _inChunkLeft;
+    uint32_t _inChunkSize;
+    uint64_t _bytesReceived;
+    uint32_t _ackWindow;                // Window Acknowledgement Size from the server
+    uint64_t _lastAck;                  // _bytesReceived when we last acknowledged
+    
+    // Reconnects reuse the parsed URL and the transport (cached address,
+    // TLS session)
+    bool _urlValid;
+    bool _autoReconnect;
+    bool _reconnectPending;
+    uint8_t _reconnectAttempts;         // Failed since the drop
+    uint32_t _nextReconnect;            // millis() of the next attempt
+    bool _recovering;                   // Dropped, and no frame sent since
+    uint32_t _droppedAt;
+    uint32_t _reconnects;
+    
+    // Video message going out a chunk at a time (see beginVideoData())
+    const uint8_t* _videoBody;
+    size_t _videoLength;                // Message bytes, tag header included
+    size_t _videoOffset;                // Written so far
+    uint8_t _videoHead[RTMP_VIDEO_TAG_HEADER_BYTES];
+    uint32_t _videoMessageTimestamp;
+    uint32_t _videoStart;               // micros() when it began
+    
+    // Aggregate being filled: FLV tags, each followed by its back-pointer
+    uint8_t* _aggregate;
+    size_t _aggregateCapacity;
+    size_t _aggregateLen;
+    uint32_t _aggregateCount;
+    uint32_t _aggregateTimestamp;       // The first sub-message's
+    uint32_t _aggregateStart;           // millis() when it was added
+    uint32_t _aggregateMaxMs;
+    
+    bool open();
+    void connectionLost(const char* why);
+    void scheduleReconnect();
+    void attemptReconnect();
     
     // RTMP protocol implementation
     bool parseURL(const String& url);
     bool performHandshake();
+    bool readExactly(uint8_t* buffer, size_t len, const char* what);
+    bool sendSetChunkSize(uint32_t size);
     bool sendConnect();
     bool sendCreateStream();
     bool sendPublish();
     
-    // RTMP chunking
+    // Server messages
+    bool readInbound();
+    bool consumeInbound(const uint8_t*& data, const uint8_t* end);
+    size_t inboundHeaderLength();
+    InboundStream* beginInboundChunk();
+    InboundStream* inboundStream(uint32_t chunkStreamId);
+    bool inboundMessage(InboundStream& stream);
+    bool sendAcknowledgement();
+    bool sendControl(uint8_t messageType, const uint8_t* payload, size_t len);
+    
+    // RTMP chunking: a message is the head bytes followed by the body, cut
+    // into _chunkSize chunks and written as one gather
     bool sendChunk(uint8_t chunkType, uint32_t timestamp, uint8_t messageType, 
                    const uint8_t* data, size_t len);
-    bool writeChunkHeader(uint8_t chunkStreamId, uint32_t timestamp, 
-                          size_t messageLength, uint8_t messageType, uint32_t streamId);
+    bool sendMessage(uint8_t chunkStreamId, uint32_t timestamp, uint8_t messageType,
+                     const uint8_t* head, size_t headLen, const uint8_t* body, size_t bodyLen);
+    size_t encodeChunkHeader(uint8_t* header, uint8_t chunkStreamId, uint32_t timestamp, 
+                             size_t messageLength, uint8_t messageType, uint32_t streamId);
+    size_t encodeContinuationHeader(uint8_t* header, uint8_t chunkStreamId, uint32_t timestamp);
+    
+    // Aggregate messages
+    bool aggregate(uint8_t chunkStreamId, uint32_t timestamp, uint8_t messageType,
+                   const uint8_t* head, size_t headLen, const uint8_t* body, size_t bodyLen);
+    bool flushAggregate();
+    
+    // Video messages
+    size_t encodeVideoTagHeader(uint8_t* header);
+    bool pumpVideo();
+    void videoSent(uint32_t timestamp, uint32_t start);
+    void abandonVideo();
     
     // AMF encoding
     void writeAMFString(uint8_t* buf, int& pos, const String& str);
@@ -88,8 +228,6 @@ private:
     
     // FLV muxing
     bool sendFLVHeader();
-    bool sendVideoData(const uint8_t* data, size_t len, uint32_t timestamp);
-    bool sendAudioData(const uint8_t* data, size_t len, uint32_t timestamp);
     
     void setState(RTMPState newState);
 };
@@ -0,0 +1,61 @@
+#ifndef RTMP_TRANSPORT_H
+#define RTMP_TRANSPORT_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Byte stream under RTMPClient. Every write is a gather of slices that go
+// out in order as one call into the stack; a slice only has to stay valid
+// until the write returns, because whatever the socket cannot take yet is
+// copied.
+//
+// With a send queue (setQueueCapacity > 0) writes never wait on a slow
+// link: the unsent remainder is queued, pending() reports it, and later
+// writes or flush() push it out ahead of new data. A write that does not
+// fit in the queue waits up to the send timeout, like every write does
+// without a queue. A failed write closes the connection.
+
+struct TransportSlice {
+    const uint8_t* data;
+    size_t len;
+};
+
+class RTMPTransport {
+public:
+    virtual ~RTMPTransport() {}
+
+    virtual bool connect(const char* host, uint16_t port, uint32_t timeoutMs) = 0;
+    virtual void close() = 0;
+    virtual bool connected() = 0;
+
+    virtual bool writev(const TransportSlice* slices, int count) = 0;
+    bool write(const uint8_t* data, size_t len) {
+        TransportSlice slice = { data, len };
+        return writev(&slice, 1);
+    }
+
+    // Push queued bytes, waiting up to timeoutMs (0: only what the socket
+    // takes now). True when nothing is left.
+    virtual bool flush(uint32_t timeoutMs) = 0;
+
+    // Bytes accepted by write() that have not reached the socket yet
+    virtual size_t pending() = 0;
+
+    // Bytes the socket has taken but not put on the wire yet; 0 where the
+    // stack cannot tell
+    virtual size_t unsent() { return 0; }
+
+    // Reads never wait: 0 when nothing has arrived, -1 once closed
+    virtual int available() = 0;
+    virtual int read(uint8_t* buffer, size_t len) = 0;
+
+    // Largest plaintext the transport frames on its own (a TLS record), so
+    // RTMP chunks can be sized to fill one each; 0 when it does not frame
+    virtual size_t recordSize() { return 0; }
+
+    // 0 makes every write wait until the socket has taken all of it
+    virtual void setQueueCapacity(size_t bytes) = 0;
+    virtual void setSendTimeout(uint32_t timeoutMs) = 0;
+};
+
+#endif // RTMP_TRANSPORT_H
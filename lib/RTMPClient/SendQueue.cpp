@@ -0,0 +1,59 @@
+#include "SendQueue.h"
+#include <Arduino.h>
+#include <string.h>
+#include <Logger.h>
+
+SendQueue::SendQueue()
+    : _buffer(nullptr)
+    , _capacity(0)
+    , _head(0)
+    , _len(0)
+{
+}
+
+SendQueue::~SendQueue() {
+    free(_buffer);
+}
+
+void SendQueue::setCapacity(size_t bytes) {
+    if (_len > 0) {
+        return;
+    }
+    free(_buffer);
+    _buffer = nullptr;
+    _capacity = bytes;
+    _head = 0;
+}
+
+bool SendQueue::append(const uint8_t* data, size_t len) {
+    if (!fits(len)) {
+        return false;
+    }
+    if (!_buffer) {
+        _buffer = (uint8_t*)ps_malloc(_capacity);
+        if (!_buffer) {
+            LOG_E("Transport: Cannot allocate a %u byte send queue", (unsigned)_capacity);
+            return false;
+        }
+    }
+    if (_head + _len + len > _capacity) {
+        memmove(_buffer, _buffer + _head, _len);
+        _head = 0;
+    }
+    memcpy(_buffer + _head + _len, data, len);
+    _len += len;
+    return true;
+}
+
+void SendQueue::consume(size_t len) {
+    _head += len;
+    _len -= len;
+    if (_len == 0) {
+        _head = 0;
+    }
+}
+
+void SendQueue::clear() {
+    _head = 0;
+    _len = 0;
+}
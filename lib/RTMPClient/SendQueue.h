@@ -0,0 +1,36 @@
+#ifndef SEND_QUEUE_H
+#define SEND_QUEUE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Bytes a transport has accepted but could not hand to the stack yet. One
+// contiguous PSRAM block, allocated on first use: written from the front,
+// appended at the back, and compacted when the back runs out of room.
+class SendQueue {
+public:
+    SendQueue();
+    ~SendQueue();
+
+    // Only takes effect while empty
+    void setCapacity(size_t bytes);
+    size_t capacity() const { return _capacity; }
+
+    size_t size() const { return _len; }
+    bool fits(size_t len) const { return _len + len <= _capacity; }
+
+    // False when it does not fit or the block cannot be allocated
+    bool append(const uint8_t* data, size_t len);
+
+    const uint8_t* front() const { return _buffer + _head; }
+    void consume(size_t len);
+    void clear();
+
+private:
+    uint8_t* _buffer;
+    size_t _capacity;
+    size_t _head;
+    size_t _len;
+};
+
+#endif // SEND_QUEUE_H
@@ -0,0 +1,436 @@
+#include "SocketTransport.h"
+#include "../../include/config.h"
+#include <Arduino.h>
+#include <errno.h>
+#include <string.h>
+#include <Logger.h>
+#include <Metrics.h>
+#include <Trace.h>
+
+#ifdef ESP_PLATFORM
+#include <fcntl.h>
+#include <lwip/sockets.h>
+#include <lwip/netdb.h>
+#else
+#include <fcntl.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/ioctl.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#ifdef __linux__
+#include <linux/sockios.h>
+#endif
+#endif
+
+static Counter metricSocketWrites("rtmp_socket_writes_total", "Gather writes made on the RTMP socket");
+static Counter metricQueuedBytes("rtmp_send_queued_bytes_total", "Bytes the RTMP socket could not take at once");
+static Counter metricDnsLookups("rtmp_dns_lookups_total", "Server name lookups (connects to a cached address skip them)");
+
+// The few calls that differ between lwIP and a POSIX kernel
+static ssize_t gatherWrite(int fd, const struct iovec* iov, int count) {
+#ifdef ESP_PLATFORM
+    return lwip_writev(fd, iov, count);
+#else
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = (struct iovec*)iov;
+    msg.msg_iovlen = count;
+    return sendmsg(fd, &msg, MSG_NOSIGNAL);
+#endif
+}
+
+static ssize_t plainWrite(int fd, const uint8_t* data, size_t len) {
+#ifdef ESP_PLATFORM
+    return lwip_send(fd, data, len, 0);
+#else
+    return send(fd, data, len, MSG_NOSIGNAL);
+#endif
+}
+
+static int bytesReadable(int fd) {
+    int count = 0;
+#ifdef ESP_PLATFORM
+    if (lwip_ioctl(fd, FIONREAD, &count) < 0) {
+#else
+    if (ioctl(fd, FIONREAD, &count) < 0) {
+#endif
+        return -1;
+    }
+    return count;
+}
+
+static int bytesUnsent(int fd) {
+#ifdef SIOCOUTQNSD
+    int count = 0;
+    if (ioctl(fd, SIOCOUTQNSD, &count) < 0) {
+        return 0;
+    }
+    return count;
+#else
+    (void)fd;
+    return 0;
+#endif
+}
+
+static bool wouldBlock() {
+    return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+}
+
+SocketTransport::SocketTransport()
+    : _fd(-1)
+    , _sendTimeoutMs(RTMP_SEND_TIMEOUT_MS)
+    , _resolvedPort(0)
+    , _resolvedAddress(0)
+    , _resolvedStale(false)
+{
+    _resolvedHost[0] = '\0';
+    _queue.setCapacity(RTMP_SEND_QUEUE_BYTES);
+}
+
+SocketTransport::~SocketTransport() {
+    close();
+}
+
+bool SocketTransport::resolve(const char* host, uint16_t port, uint32_t& address) {
+    bool cached = _resolvedHost[0] != '\0' && port == _resolvedPort && strcmp(host, _resolvedHost) == 0;
+    if (cached && !_resolvedStale) {
+        address = _resolvedAddress;
+        return true;
+    }
+
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo* result = nullptr;
+    metricDnsLookups.inc();
+    if (getaddrinfo(host, nullptr, &hints, &result) != 0 || !result) {
+        if (cached) {
+            LOG_W("Transport: Cannot resolve %s, trying its last address", host);
+            address = _resolvedAddress;
+            return true;
+        }
+        LOG_E("Transport: Cannot resolve %s", host);
+        return false;
+    }
+    address = ((struct sockaddr_in*)result->ai_addr)->sin_addr.s_addr;
+    freeaddrinfo(result);
+
+    strncpy(_resolvedHost, host, sizeof(_resolvedHost) - 1);
+    _resolvedHost[sizeof(_resolvedHost) - 1] = '\0';
+    _resolvedPort = port;
+    _resolvedAddress = address;
+    _resolvedStale = false;
+    return true;
+}
+
+bool SocketTransport::connect(const char* host, uint16_t port, uint32_t timeoutMs) {
+    close();
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (!resolve(host, port, addr.sin_addr.s_addr)) {
+        return false;
+    }
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        LOG_E("Transport: socket() failed (%d)", errno);
+        return false;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+
+    int rc = ::connect(fd, (struct sockaddr*)&addr, sizeof(addr));
+    if (rc < 0 && errno == EINPROGRESS) {
+        fd_set writable;
+        FD_ZERO(&writable);
+        FD_SET(fd, &writable);
+        struct timeval tv = { (time_t)(timeoutMs / 1000), (suseconds_t)((timeoutMs % 1000) * 1000) };
+        int error = 0;
+        socklen_t len = sizeof(error);
+        if (select(fd + 1, NULL, &writable, NULL, &tv) == 1 &&
+            getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &len) == 0 && error == 0) {
+            rc = 0;
+        }
+    }
+    if (rc < 0) {
+        ::close(fd);
+        _resolvedStale = true;
+        LOG_E("Transport: Cannot connect to %s:%u", host, port);
+        return false;
+    }
+
+    _fd = fd;
+    _queue.clear();
+    tune();
+    return true;
+}
+
+void SocketTransport::tune() {
+    int one = 1;
+    if (setsockopt(_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)) < 0) {
+        LOG_W("Transport: TCP_NODELAY not set (%d)", errno);
+    }
+
+    // A small send buffer keeps frames out of the kernel, where they could
+    // no longer be dropped in favour of newer ones, and makes a slow link
+    // show up here as pending bytes
+    int sndbuf = RTMP_SOCKET_SNDBUF;
+    if (setsockopt(_fd, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf)) < 0) {
+        LOG_D("Transport: SO_SNDBUF not supported, using the stack default");
+        return;
+    }
+    socklen_t len = sizeof(sndbuf);
+    if (getsockopt(_fd, SOL_SOCKET, SO_SNDBUF, &sndbuf, &len) == 0) {
+        LOG_D("Transport: Send buffer %d bytes", sndbuf);
+    }
+}
+
+void SocketTransport::close() {
+    if (_fd >= 0) {
+        ::close(_fd);
+        _fd = -1;
+    }
+    _queue.clear();
+}
+
+bool SocketTransport::connected() {
+    if (_fd < 0) {
+        return false;
+    }
+    uint8_t c;
+    ssize_t n = recv(_fd, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+    if (n == 0 || (n < 0 && !wouldBlock())) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+// ============================================================================
+// Writing
+// ============================================================================
+
+bool SocketTransport::writev(const TransportSlice* slices, int count) {
+    if (_fd < 0) {
+        return false;
+    }
+
+    struct iovec iov[SOCKET_MAX_IOV];
+    int n = 0;
+    size_t used = 0;        // Bytes of _coalesce taken by this batch
+    int run = -1;           // Entry that is the open run in _coalesce
+
+    for (int i = 0; i < count; i++) {
+        const TransportSlice& slice = slices[i];
+        if (slice.len == 0) {
+            continue;
+        }
+
+        if (slice.len <= SOCKET_COALESCE_MAX_SLICE) {
+            if (used + slice.len > sizeof(_coalesce) || (run != n - 1 && n == SOCKET_MAX_IOV)) {
+                if (!sendBatch(iov, n)) {
+                    return false;
+                }
+                n = 0;
+                used = 0;
+                run = -1;
+            }
+            memcpy(_coalesce + used, slice.data, slice.len);
+            if (run >= 0 && run == n - 1) {
+                iov[run].iov_len += slice.len;
+            } else {
+                iov[n].iov_base = _coalesce + used;
+                iov[n].iov_len = slice.len;
+                run = n++;
+            }
+            used += slice.len;
+        } else {
+            if (n == SOCKET_MAX_IOV) {
+                if (!sendBatch(iov, n)) {
+                    return false;
+                }
+                n = 0;
+                used = 0;
+            }
+            iov[n].iov_base = (void*)slice.data;
+            iov[n].iov_len = slice.len;
+            n++;
+            run = -1;
+        }
+    }
+
+    return n == 0 || sendBatch(iov, n);
+}
+
+// Hands one batch to the socket; returns with it sent or queued, so the
+// coalescing buffer can be reused
+bool SocketTransport::sendBatch(struct iovec* iov, int count) {
+    size_t total = 0;
+    for (int i = 0; i < count; i++) {
+        total += iov[i].iov_len;
+    }
+    TRACE_SCOPE_ARG("transport.writev", total);
+
+    // Queued bytes go first; when they cannot, the batch waits behind them
+    if (_queue.size() > 0 && !drainQueue()) {
+        if (_fd < 0) {
+            return false;
+        }
+        if (_queue.fits(total)) {
+            return enqueue(iov, count);
+        }
+        if (!flush(_sendTimeoutMs)) {
+            return false;
+        }
+    }
+
+    uint32_t start = millis();
+    int first = 0;
+    while (first < count) {
+        ssize_t written = gatherWrite(_fd, iov + first, count - first);
+        metricSocketWrites.inc();
+        if (written < 0) {
+            if (!wouldBlock()) {
+                LOG_E("Transport: Write failed (%d)", errno);
+                close();
+                return false;
+            }
+            written = 0;
+        }
+
+        // Step past what the socket took
+        size_t left = (size_t)written;
+        while (first < count && left >= iov[first].iov_len) {
+            left -= iov[first].iov_len;
+            total -= iov[first].iov_len;
+            first++;
+        }
+        if (first == count) {
+            break;
+        }
+        iov[first].iov_base = (uint8_t*)iov[first].iov_base + left;
+        iov[first].iov_len -= left;
+        total -= left;
+
+        if (_queue.fits(total)) {
+            return enqueue(iov + first, count - first);
+        }
+        if (!waitWritable(start, _sendTimeoutMs)) {
+            LOG_E("Transport: Write timed out with %u bytes left", (unsigned)total);
+            close();
+            return false;
+        }
+    }
+    return true;
+}
+
+bool SocketTransport::enqueue(const struct iovec* iov, int count) {
+    for (int i = 0; i < count; i++) {
+        if (!_queue.append((const uint8_t*)iov[i].iov_base, iov[i].iov_len)) {
+            close();
+            return false;
+        }
+        metricQueuedBytes.inc(iov[i].iov_len);
+    }
+    return true;
+}
+
+// Writes queued bytes until the socket is full; true once the queue is empty
+bool SocketTransport::drainQueue() {
+    while (_queue.size() > 0) {
+        int written = writeSome(_queue.front(), _queue.size());
+        if (written <= 0) {
+            return false;
+        }
+        _queue.consume((size_t)written);
+    }
+    return true;
+}
+
+int SocketTransport::writeSome(const uint8_t* data, size_t len) {
+    if (_fd < 0) {
+        return -1;
+    }
+    ssize_t written = plainWrite(_fd, data, len);
+    metricSocketWrites.inc();
+    if (written < 0) {
+        if (wouldBlock()) {
+            return 0;
+        }
+        LOG_E("Transport: Write failed (%d)", errno);
+        close();
+        return -1;
+    }
+    return (int)written;
+}
+
+bool SocketTransport::flush(uint32_t timeoutMs) {
+    uint32_t start = millis();
+    while (_fd >= 0) {
+        if (drainQueue()) {
+            return true;
+        }
+        if (_fd < 0 || timeoutMs == 0 || !waitWritable(start, timeoutMs)) {
+            return false;
+        }
+    }
+    return false;
+}
+
+static bool waitFor(int fd, bool write, uint32_t start, uint32_t timeoutMs) {
+    uint32_t elapsed = millis() - start;
+    if (elapsed >= timeoutMs) {
+        return false;
+    }
+    uint32_t remaining = timeoutMs - elapsed;
+    fd_set set;
+    FD_ZERO(&set);
+    FD_SET(fd, &set);
+    struct timeval tv = { (time_t)(remaining / 1000), (suseconds_t)((remaining % 1000) * 1000) };
+    return select(fd + 1, write ? NULL : &set, write ? &set : NULL, NULL, &tv) == 1;
+}
+
+bool SocketTransport::waitWritable(uint32_t start, uint32_t timeoutMs) {
+    return _fd >= 0 && waitFor(_fd, true, start, timeoutMs);
+}
+
+bool SocketTransport::waitReadable(uint32_t start, uint32_t timeoutMs) {
+    return _fd >= 0 && waitFor(_fd, false, start, timeoutMs);
+}
+
+size_t SocketTransport::unsent() {
+    return _fd >= 0 ? (size_t)bytesUnsent(_fd) : 0;
+}
+
+// ============================================================================
+// Reading
+// ============================================================================
+
+int SocketTransport::available() {
+    if (_fd < 0) {
+        return -1;
+    }
+    return bytesReadable(_fd);
+}
+
+int SocketTransport::read(uint8_t* buffer, size_t len) {
+    if (_fd < 0) {
+        return -1;
+    }
+    ssize_t n = recv(_fd, buffer, len, MSG_DONTWAIT);
+    if (n > 0) {
+        return (int)n;
+    }
+    if (n == 0 || !wouldBlock()) {
+        close();
+        return -1;
+    }
+    return 0;
+}
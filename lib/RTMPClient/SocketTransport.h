@@ -0,0 +1,83 @@
+#ifndef SOCKET_TRANSPORT_H
+#define SOCKET_TRANSPORT_H
+
+#include "RTMPTransport.h"
+#include "SendQueue.h"
+
+struct iovec;
+
+#define SOCKET_MAX_IOV              32      // Slices per writev call
+#define SOCKET_COALESCE_BYTES       1436    // One TCP segment (lwIP's default MSS)
+#define SOCKET_COALESCE_MAX_SLICE   256     // Smaller slices are copied together
+
+// RTMPTransport on a BSD socket: lwIP's on the device, the kernel's on the
+// host. The socket is non-blocking with TCP_NODELAY set, so nothing waits
+// for an ACK before going out and waits happen here, in select(), with a
+// timeout. Runs of small slices (chunk headers, short chunks, commands) are
+// copied into segment-sized blocks while large ones are passed by
+// reference, so a message leaves in one writev of a few long entries.
+//
+// SO_SNDBUF is set to RTMP_SOCKET_SNDBUF, which also stops Linux from
+// growing the buffer to megabytes of stale video. lwIP does not support the
+// option (its send buffer is CONFIG_LWIP_TCP_SND_BUF_DEFAULT); that is
+// logged at debug level. Only the kernel reports how much of its buffer is
+// still unsent (SIOCOUTQNSD); lwIP's is small enough not to need it.
+//
+// The address a host name resolved to is kept and used for the next
+// connect to the same host and port, so a reconnect does not wait on DNS
+// (which a WiFi glitch often takes down with the link). It is looked up
+// again after a connect to it fails, and kept if that lookup fails.
+
+class SocketTransport : public RTMPTransport {
+public:
+    SocketTransport();
+    ~SocketTransport() override;
+
+    bool connect(const char* host, uint16_t port, uint32_t timeoutMs) override;
+    void close() override;
+    bool connected() override;
+
+    bool writev(const TransportSlice* slices, int count) override;
+    bool flush(uint32_t timeoutMs) override;
+    size_t pending() override { return _queue.size(); }
+    size_t unsent() override;
+
+    int available() override;
+    int read(uint8_t* buffer, size_t len) override;
+
+    void setQueueCapacity(size_t bytes) override { _queue.setCapacity(bytes); }
+    void setSendTimeout(uint32_t timeoutMs) override { _sendTimeoutMs = timeoutMs; }
+
+    // For a layer on top (TLS) that does its own reads and writes
+    int fd() const { return _fd; }
+    uint32_t sendTimeout() const { return _sendTimeoutMs; }
+
+    // One send that never waits: bytes taken, 0 when the socket is full,
+    // -1 once the connection has failed
+    int writeSome(const uint8_t* data, size_t len);
+
+    // Wait until the socket can take (or has) bytes, up to timeoutMs from start
+    bool waitWritable(uint32_t start, uint32_t timeoutMs);
+    bool waitReadable(uint32_t start, uint32_t timeoutMs);
+
+private:
+    int _fd;
+    uint32_t _sendTimeoutMs;
+    SendQueue _queue;
+
+    uint8_t _coalesce[SOCKET_COALESCE_BYTES];
+
+    // Last resolved address (IPv4, network order)
+    char _resolvedHost[64];
+    uint16_t _resolvedPort;
+    uint32_t _resolvedAddress;
+    bool _resolvedStale;            // A connect to it failed: look it up again
+
+    bool resolve(const char* host, uint16_t port, uint32_t& address);
+    bool sendBatch(struct iovec* iov, int count);
+    bool enqueue(const struct iovec* iov, int count);
+    bool drainQueue();
+    void tune();
+};
+
+#endif // SOCKET_TRANSPORT_H
@@ -0,0 +1,461 @@
+#include "TlsTransport.h"
+
+#if RTMP_TLS_AVAILABLE
+
+#include "../../include/config.h"
+#include <Arduino.h>
+#include <string.h>
+#include <mbedtls/net_sockets.h>
+#include <Logger.h>
+#include <Metrics.h>
+#include <Trace.h>
+
+#ifdef ESP_PLATFORM
+#include <esp_crt_bundle.h>
+#endif
+
+// Handshake time buckets (microseconds)
+static const uint32_t handshakeBounds[] = {
+    50000, 100000, 200000, 500000, 1000000, 2000000, 3000000, 5000000, 10000000
+};
+
+static Counter metricHandshakes("rtmp_tls_handshakes_total", "TLS handshakes completed");
+static Counter metricResumed("rtmp_tls_resumed_total", "TLS handshakes that resumed a cached session");
+static Histogram metricHandshakeTime("rtmp_tls_handshake_seconds", "Time from TCP connect to TLS established",
+                                     handshakeBounds, sizeof(handshakeBounds) / sizeof(handshakeBounds[0]),
+                                     1e-6);
+
+// AES and SHA-2 only: both run on the hardware engines under ESP-IDF.
+// ECDHE first for forward secrecy; plain RSA key exchange as a last resort.
+static const int tlsCiphersuites[] = {
+    MBEDTLS_TLS_ECDHE_ECDSA_WITH_AES_128_GCM_SHA256,
+    MBEDTLS_TLS_ECDHE_RSA_WITH_AES_128_GCM_SHA256,
+    MBEDTLS_TLS_ECDHE_ECDSA_WITH_AES_256_GCM_SHA384,
+    MBEDTLS_TLS_ECDHE_RSA_WITH_AES_256_GCM_SHA384,
+    MBEDTLS_TLS_ECDHE_ECDSA_WITH_AES_128_CBC_SHA256,
+    MBEDTLS_TLS_ECDHE_RSA_WITH_AES_128_CBC_SHA256,
+    MBEDTLS_TLS_RSA_WITH_AES_128_GCM_SHA256,
+    0
+};
+
+TlsTransport::TlsTransport()
+    : _ready(false)
+    , _open(false)
+    , _haveSession(false)
+    , _sessionPort(0)
+    , _record(nullptr)
+    , _recordCapacity(MBEDTLS_SSL_OUT_CONTENT_LEN)
+    , _recordLen(0)
+    , _inFlight(0)
+{
+    mbedtls_ssl_init(&_ssl);
+    mbedtls_ssl_config_init(&_conf);
+    mbedtls_entropy_init(&_entropy);
+    mbedtls_ctr_drbg_init(&_drbg);
+    mbedtls_x509_crt_init(&_caChain);
+    mbedtls_ssl_session_init(&_session);
+    _sessionHost[0] = '\0';
+    _queue.setCapacity(RTMP_SEND_QUEUE_BYTES);
+}
+
+TlsTransport::~TlsTransport() {
+    close();
+    mbedtls_ssl_session_free(&_session);
+    mbedtls_ssl_free(&_ssl);
+    mbedtls_ssl_config_free(&_conf);
+    mbedtls_x509_crt_free(&_caChain);
+    mbedtls_ctr_drbg_free(&_drbg);
+    mbedtls_entropy_free(&_entropy);
+    free(_record);
+}
+
+void TlsTransport::fail(const char* what, int ret) {
+    char text[96];
+    mbedtls_strerror(ret, text, sizeof(text));
+    LOG_E("TLS: %s failed: -0x%04X %s", what, (unsigned)-ret, text);
+    close();
+}
+
+bool TlsTransport::setup() {
+    if (_ready) {
+        return true;
+    }
+
+    int ret = mbedtls_ctr_drbg_seed(&_drbg, mbedtls_entropy_func, &_entropy,
+                                    (const unsigned char*)"rtmps", 5);
+    if (ret != 0) {
+        fail("RNG seed", ret);
+        return false;
+    }
+    ret = mbedtls_ssl_config_defaults(&_conf, MBEDTLS_SSL_IS_CLIENT, MBEDTLS_SSL_TRANSPORT_STREAM,
+                                      MBEDTLS_SSL_PRESET_DEFAULT);
+    if (ret != 0) {
+        fail("Config", ret);
+        return false;
+    }
+    mbedtls_ssl_conf_rng(&_conf, mbedtls_ctr_drbg_random, &_drbg);
+    mbedtls_ssl_conf_min_version(&_conf, MBEDTLS_SSL_MAJOR_VERSION_3, MBEDTLS_SSL_MINOR_VERSION_3);
+    mbedtls_ssl_conf_ciphersuites(&_conf, tlsCiphersuites);
+#if defined(MBEDTLS_SSL_SESSION_TICKETS)
+    mbedtls_ssl_conf_session_tickets(&_conf, MBEDTLS_SSL_SESSION_TICKETS_ENABLED);
+#endif
+
+#if RTMP_TLS_VERIFY_PEER
+#ifdef ESP_PLATFORM
+    if (esp_crt_bundle_attach(&_conf) != ESP_OK) {
+        LOG_E("TLS: Cannot attach the CA bundle");
+        return false;
+    }
+#else
+    const char* bundle = getenv("SSL_CERT_FILE");
+    ret = mbedtls_x509_crt_parse_file(&_caChain, bundle ? bundle : "/etc/ssl/certs/ca-certificates.crt");
+    if (ret < 0) {
+        fail("Loading CA certificates", ret);
+        return false;
+    }
+    mbedtls_ssl_conf_ca_chain(&_conf, &_caChain, NULL);
+#endif
+    mbedtls_ssl_conf_authmode(&_conf, MBEDTLS_SSL_VERIFY_REQUIRED);
+#else
+    mbedtls_ssl_conf_authmode(&_conf, MBEDTLS_SSL_VERIFY_NONE);
+#endif
+
+    ret = mbedtls_ssl_setup(&_ssl, &_conf);
+    if (ret != 0) {
+        fail("Setup", ret);
+        return false;
+    }
+    mbedtls_ssl_set_bio(&_ssl, this, bioSend, bioRecv, NULL);
+
+    _record = (uint8_t*)ps_malloc(MBEDTLS_SSL_OUT_CONTENT_LEN);
+    if (!_record) {
+        LOG_E("TLS: Cannot allocate the record buffer");
+        return false;
+    }
+    _ready = true;
+    return true;
+}
+
+// ============================================================================
+// Connection
+// ============================================================================
+
+bool TlsTransport::connect(const char* host, uint16_t port, uint32_t timeoutMs) {
+    close();
+    if (!setup()) {
+        return false;
+    }
+    uint32_t start = millis();
+    if (!_socket.connect(host, port, timeoutMs)) {
+        return false;
+    }
+
+    int ret = mbedtls_ssl_session_reset(&_ssl);
+    if (ret == 0) {
+        ret = mbedtls_ssl_set_hostname(&_ssl, host);
+    }
+    if (ret != 0) {
+        fail("Reset", ret);
+        return false;
+    }
+
+    bool offered = false;
+    if (_haveSession && _sessionPort == port && strcmp(_sessionHost, host) == 0) {
+        offered = mbedtls_ssl_set_session(&_ssl, &_session) == 0;
+    }
+
+    uint32_t handshakeStart = micros();
+    if (!handshake(start, timeoutMs, offered)) {
+        return false;
+    }
+    uint32_t elapsed = micros() - handshakeStart;
+
+    bool resumed = offered;
+    keepSession(host, port, resumed);
+
+    int payload = mbedtls_ssl_get_max_out_record_payload(&_ssl);
+    _recordCapacity = payload > 0 && payload < MBEDTLS_SSL_OUT_CONTENT_LEN ? (size_t)payload
+                                                                          : MBEDTLS_SSL_OUT_CONTENT_LEN;
+    _recordLen = 0;
+    _inFlight = 0;
+    _queue.clear();
+    _open = true;
+
+    metricHandshakes.inc();
+    if (resumed) {
+        metricResumed.inc();
+    }
+    metricHandshakeTime.observe(elapsed);
+    LOG_I("TLS: %s handshake in %u ms, %s, %u byte records", resumed ? "Resumed" : "Full",
+          (unsigned)(elapsed / 1000), mbedtls_ssl_get_ciphersuite(&_ssl), (unsigned)_recordCapacity);
+    return true;
+}
+
+bool TlsTransport::handshake(uint32_t start, uint32_t timeoutMs, bool offered) {
+    TRACE_SCOPE("tls.handshake");
+    int ret;
+    while ((ret = mbedtls_ssl_handshake(&_ssl)) != 0) {
+        bool ready;
+        if (ret == MBEDTLS_ERR_SSL_WANT_READ) {
+            ready = _socket.waitReadable(start, timeoutMs);
+        } else if (ret == MBEDTLS_ERR_SSL_WANT_WRITE) {
+            ready = _socket.waitWritable(start, timeoutMs);
+        } else {
+            if (ret == MBEDTLS_ERR_X509_CERT_VERIFY_FAILED) {
+                char text[160];
+                mbedtls_x509_crt_verify_info(text, sizeof(text), "", mbedtls_ssl_get_verify_result(&_ssl));
+                LOG_E("TLS: Certificate rejected: %s", text);
+            }
+            // A session the server no longer accepts must not be offered again
+            if (offered) {
+                _haveSession = false;
+            }
+            fail("Handshake", ret);
+            return false;
+        }
+        if (!ready) {
+            LOG_E("TLS: Handshake timed out");
+            close();
+            return false;
+        }
+    }
+    return true;
+}
+
+// Stores the negotiated session for the next connect. A server that
+// resumed echoes the session ID we offered; one that did not picks a new one.
+void TlsTransport::keepSession(const char* host, uint16_t port, bool& resumed) {
+    mbedtls_ssl_session fresh;
+    mbedtls_ssl_session_init(&fresh);
+    if (mbedtls_ssl_get_session(&_ssl, &fresh) != 0) {
+        mbedtls_ssl_session_free(&fresh);
+        _haveSession = false;
+        resumed = false;
+        return;
+    }
+
+    resumed = resumed && fresh.id_len > 0 && fresh.id_len == _session.id_len &&
+              memcmp(fresh.id, _session.id, fresh.id_len) == 0;
+
+    mbedtls_ssl_session_free(&_session);
+    _session = fresh;       // Takes over the copies fresh owns
+    _haveSession = true;
+    strncpy(_sessionHost, host, sizeof(_sessionHost) - 1);
+    _sessionHost[sizeof(_sessionHost) - 1] = '\0';
+    _sessionPort = port;
+}
+
+void TlsTransport::close() {
+    if (_open) {
+        // Best effort: the socket may be full or gone
+        mbedtls_ssl_close_notify(&_ssl);
+        _open = false;
+    }
+    _socket.close();
+    _queue.clear();
+    _recordLen = 0;
+    _inFlight = 0;
+}
+
+bool TlsTransport::connected() {
+    if (_open && !_socket.connected()) {
+        _open = false;
+        close();
+    }
+    return _open;
+}
+
+int TlsTransport::bioSend(void* ctx, const unsigned char* buf, size_t len) {
+    TlsTransport* self = (TlsTransport*)ctx;
+    int written = self->_socket.writeSome(buf, len);
+    if (written == 0) {
+        return MBEDTLS_ERR_SSL_WANT_WRITE;
+    }
+    return written > 0 ? written : MBEDTLS_ERR_NET_SEND_FAILED;
+}
+
+int TlsTransport::bioRecv(void* ctx, unsigned char* buf, size_t len) {
+    TlsTransport* self = (TlsTransport*)ctx;
+    int n = self->_socket.read(buf, len);
+    if (n == 0) {
+        return MBEDTLS_ERR_SSL_WANT_READ;
+    }
+    return n > 0 ? n : 0;   // 0 is end of stream to mbedTLS
+}
+
+// ============================================================================
+// Writing
+// ============================================================================
+
+bool TlsTransport::writev(const TransportSlice* slices, int count) {
+    if (!_open) {
+        return false;
+    }
+    for (int i = 0; i < count; i++) {
+        const uint8_t* data = slices[i].data;
+        size_t left = slices[i].len;
+
+        // Keep a slice that fits in one record out of the tail of this one
+        if (_recordLen > 0 && _recordLen + left > _recordCapacity && left <= _recordCapacity) {
+            if (!emit(_record, _recordLen)) {
+                return false;
+            }
+            _recordLen = 0;
+        }
+        while (left > 0) {
+            size_t n = min(left, _recordCapacity - _recordLen);
+            memcpy(_record + _recordLen, data, n);
+            _recordLen += n;
+            data += n;
+            left -= n;
+            if (_recordLen == _recordCapacity) {
+                if (!emit(_record, _recordLen)) {
+                    return false;
+                }
+                _recordLen = 0;
+            }
+        }
+    }
+    if (_recordLen > 0) {
+        bool ok = emit(_record, _recordLen);
+        _recordLen = 0;
+        return ok;
+    }
+    return true;
+}
+
+// One record: sent, or queued behind earlier ones, or waited for when the
+// queue cannot take it
+bool TlsTransport::emit(const uint8_t* data, size_t len) {
+    TRACE_SCOPE_ARG("tls.record", len);
+    uint32_t start = millis();
+    while (pending() > 0 && !drain()) {
+        if (!_open) {
+            return false;
+        }
+        if (_queue.append(data, len)) {
+            return true;
+        }
+        if (!_socket.waitWritable(start, _socket.sendTimeout())) {
+            LOG_E("TLS: Write timed out with %u bytes queued", (unsigned)pending());
+            close();
+            return false;
+        }
+    }
+    if (!_open || !sendRecord(data, len)) {
+        return false;
+    }
+    // Without a queue a write only returns once the socket has all of it
+    if (_inFlight > 0 && _queue.capacity() == 0 && !flush(_socket.sendTimeout())) {
+        if (_open) {
+            LOG_E("TLS: Write timed out");
+            close();
+        }
+        return false;
+    }
+    return true;
+}
+
+bool TlsTransport::sendRecord(const uint8_t* data, size_t len) {
+    int ret = mbedtls_ssl_write(&_ssl, data, len);
+    if (ret == MBEDTLS_ERR_SSL_WANT_WRITE) {
+        // Encrypted and partly sent: mbedTLS owns it now and finishes it on
+        // the next write call of the same length
+        _inFlight = len;
+        return true;
+    }
+    if (ret < 0) {
+        fail("Write", ret);
+        return false;
+    }
+    return true;
+}
+
+bool TlsTransport::finishInFlight() {
+    if (_inFlight == 0) {
+        return true;
+    }
+    int ret = mbedtls_ssl_write(&_ssl, _record, _inFlight);
+    if (ret == MBEDTLS_ERR_SSL_WANT_WRITE) {
+        return false;
+    }
+    if (ret < 0) {
+        fail("Write", ret);
+        return false;
+    }
+    _inFlight = 0;
+    return true;
+}
+
+// Sends what is in flight and queued until the socket is full; true once
+// nothing is left. Queued plaintext is cut into full records again.
+bool TlsTransport::drain() {
+    if (!finishInFlight()) {
+        return false;
+    }
+    while (_queue.size() > 0) {
+        size_t len = min(_queue.size(), _recordCapacity);
+        int ret = mbedtls_ssl_write(&_ssl, _queue.front(), len);
+        if (ret == MBEDTLS_ERR_SSL_WANT_WRITE) {
+            _queue.consume(len);
+            _inFlight = len;
+            return false;
+        }
+        if (ret < 0) {
+            fail("Write", ret);
+            return false;
+        }
+        _queue.consume((size_t)ret);
+    }
+    return true;
+}
+
+bool TlsTransport::flush(uint32_t timeoutMs) {
+    uint32_t start = millis();
+    while (_open) {
+        if (drain()) {
+            return true;
+        }
+        if (!_open || timeoutMs == 0 || !_socket.waitWritable(start, timeoutMs)) {
+            return false;
+        }
+    }
+    return false;
+}
+
+// ============================================================================
+// Reading
+// ============================================================================
+
+int TlsTransport::available() {
+    if (!_open) {
+        return -1;
+    }
+    size_t buffered = mbedtls_ssl_get_bytes_avail(&_ssl);
+    if (buffered > 0) {
+        return (int)buffered;
+    }
+    // Undecrypted bytes: at least one record has started to arrive
+    return _socket.available() > 0 ? 1 : 0;
+}
+
+int TlsTransport::read(uint8_t* buffer, size_t len) {
+    if (!_open) {
+        return -1;
+    }
+    int ret = mbedtls_ssl_read(&_ssl, buffer, len);
+    if (ret > 0) {
+        return ret;
+    }
+    if (ret == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE) {
+        return 0;
+    }
+    if (ret == 0 || ret == MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY) {
+        close();
+    } else {
+        fail("Read", ret);
+    }
+    return -1;
+}
+
+#endif // RTMP_TLS_AVAILABLE
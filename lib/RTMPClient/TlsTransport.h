@@ -0,0 +1,97 @@
+#ifndef TLS_TRANSPORT_H
+#define TLS_TRANSPORT_H
+
+#include "SocketTransport.h"
+
+// mbedTLS comes with ESP-IDF; the host build uses it when CMake finds it
+#if defined(ESP_PLATFORM) || defined(HOST_HAVE_MBEDTLS)
+#define RTMP_TLS_AVAILABLE 1
+#else
+#define RTMP_TLS_AVAILABLE 0
+#endif
+
+#if RTMP_TLS_AVAILABLE
+
+#include <mbedtls/ssl.h>
+#include <mbedtls/entropy.h>
+#include <mbedtls/ctr_drbg.h>
+#include <mbedtls/x509_crt.h>
+
+// RTMPTransport for rtmps://: TLS 1.2 (mbedTLS) over a SocketTransport.
+//
+// The last session negotiated is kept for the life of the transport and
+// offered on the next connect to the same host and port, by ticket when
+// the server issued one and by session ID otherwise, so a reconnect skips
+// the key exchange and certificate check. Only AES-GCM/CBC suites with
+// SHA-2 are offered; ESP-IDF runs those on the S3's AES and SHA engines.
+//
+// Writes are cut into records of recordSize() bytes. A slice that does not
+// fit in what is left of the current record starts the next one, so with
+// the chunk size RTMPClient derives from recordSize() each record carries
+// one RTMP chunk. Records the socket cannot take wait in the send queue as
+// plaintext, as with SocketTransport.
+//
+// Certificates are checked when RTMP_TLS_VERIFY_PEER is set: against
+// ESP-IDF's CA bundle on the device, against SSL_CERT_FILE (or the system
+// bundle) on the host.
+
+class TlsTransport : public RTMPTransport {
+public:
+    TlsTransport();
+    ~TlsTransport() override;
+
+    bool connect(const char* host, uint16_t port, uint32_t timeoutMs) override;
+    void close() override;
+    bool connected() override;
+
+    bool writev(const TransportSlice* slices, int count) override;
+    bool flush(uint32_t timeoutMs) override;
+    size_t pending() override { return _queue.size() + _inFlight; }
+    size_t unsent() override { return _socket.unsent(); }
+
+    int available() override;
+    int read(uint8_t* buffer, size_t len) override;
+
+    size_t recordSize() override { return _recordCapacity; }
+    void setQueueCapacity(size_t bytes) override { _queue.setCapacity(bytes); }
+    void setSendTimeout(uint32_t timeoutMs) override { _socket.setSendTimeout(timeoutMs); }
+
+private:
+    SocketTransport _socket;
+    bool _ready;                // Contexts set up (first connect)
+    bool _open;                 // Handshake done
+
+    mbedtls_ssl_context _ssl;
+    mbedtls_ssl_config _conf;
+    mbedtls_entropy_context _entropy;
+    mbedtls_ctr_drbg_context _drbg;
+    mbedtls_x509_crt _caChain;
+
+    mbedtls_ssl_session _session;
+    bool _haveSession;
+    char _sessionHost[64];
+    uint16_t _sessionPort;
+
+    uint8_t* _record;           // Plaintext being gathered into one record
+    size_t _recordCapacity;
+    size_t _recordLen;
+    size_t _inFlight;           // Plaintext of a record the socket has only partly taken
+    SendQueue _queue;
+
+    bool setup();
+    bool handshake(uint32_t start, uint32_t timeoutMs, bool offered);
+    void keepSession(const char* host, uint16_t port, bool& resumed);
+
+    bool emit(const uint8_t* data, size_t len);
+    bool sendRecord(const uint8_t* data, size_t len);
+    bool finishInFlight();
+    bool drain();
+    void fail(const char* what, int ret);
+
+    static int bioSend(void* ctx, const unsigned char* buf, size_t len);
+    static int bioRecv(void* ctx, unsigned char* buf, size_t len);
+};
+
+#endif // RTMP_TLS_AVAILABLE
+
+#endif // TLS_TRANSPORT_H
@@ -0,0 +1,359 @@
+#include "RTMPFanout.h"
+#include <Logger.h>
+#include <Trace.h>
+
+// Messages a message went ahead of in the mux
+static const uint32_t muxDepthBounds[] = { 0, 1, 2, 3, 4, 6, 8, 12 };
+
+// Time held in the mux (milliseconds)
+static const uint32_t muxLatencyBounds[] = { 1, 5, 10, 20, 33, 50, 66, 80, 100, 150 };
+
+static const char* formatLabels(char* labels, uint8_t index) {
+    snprintf(labels, RTMP_DESTINATION_LABELS_MAX, "dest=\"%u\"", index);
+    return labels;
+}
+
+// ============================================================================
+// Destination
+// ============================================================================
+
+RTMPDestination::RTMPDestination(uint8_t index, const String& url, const String& streamKey,
+                                 ReleaseFunction releaseAudio)
+    : _index(index)
+    , _url(url)
+    , _streamKey(streamKey)
+    , _releaseAudio(releaseAudio)
+    , _audio(NULL)
+    , _task(NULL)
+    , _started(false)
+    , _offset(0)
+    , _epoch(0)
+    , _latest(0)
+    , _framesLost(0)
+    , _audioDropped(0)
+    , _payloadBytes(0)
+    , _metricPayloadBytes("rtmp_destination_payload_bytes_total", "Audio and video payload bytes sent",
+                          formatLabels(_labels, index))
+    , _metricFramesSent("rtmp_destination_frames_sent_total", "Video messages sent", _labels)
+    , _metricAudioDropped("rtmp_destination_audio_dropped_total", "Audio blocks this destination lost",
+                          _labels)
+    , _metricFramesDropped("rtmp_destination_frames_dropped_total", "Frames this destination skipped or lost",
+                           MetricType::COUNTER, [this]() { return (double)getFramesDropped(); }, _labels)
+    , _metricConnected("rtmp_destination_connected", "1 while publishing", MetricType::GAUGE,
+                       [this]() { return _client.isConnected() ? 1.0 : 0.0; }, _labels)
+    , _metricBufferBytes("stream_buffer_bytes", "Payload bytes held for store-and-forward", MetricType::GAUGE,
+                         [this]() { return (double)_buffer.getBytes(); }, _labels)
+    , _metricBufferBacklog("stream_buffer_backlog_seconds", "Media time held for store-and-forward",
+                           MetricType::GAUGE, [this]() { return _buffer.getBacklogMs() / 1000.0; }, _labels)
+    , _metricMuxDepth("av_mux_reorder_depth", "Waiting messages each message went ahead of", muxDepthBounds,
+                      sizeof(muxDepthBounds) / sizeof(muxDepthBounds[0]), 1.0, _labels)
+    , _metricMuxLatency("av_mux_added_latency_seconds", "Time a message waited to go out in timestamp order",
+                        muxLatencyBounds, sizeof(muxLatencyBounds) / sizeof(muxLatencyBounds[0]), 1e-3, _labels)
+    , _metricMuxLate("av_mux_late_total", "Messages behind one already sent (dropped or clamped)",
+                     MetricType::COUNTER, [this]() { return (double)_mux.getLate(); }, _labels)
+    , _metricMuxEvicted("av_mux_evicted_total", "Messages dropped unsent to make room in a full mux",
+                        MetricType::COUNTER, [this]() { return (double)_mux.getEvicted(); }, _labels)
+{
+}
+
+RTMPDestination::~RTMPDestination() {
+    if (_task) {
+        vTaskDelete(_task);
+    }
+    if (_audio) {
+        FanoutAudio audio;
+        while (xQueueReceive(_audio, &audio, 0) == pdTRUE) {
+            _releaseAudio(audio.owner);
+        }
+        vQueueDelete(_audio);
+    }
+    MuxMessage message;
+    while (_mux.pop(UINT32_MAX, message)) {
+        release(message);
+    }
+}
+
+bool RTMPDestination::start(size_t bufferBytes) {
+    _buffer.begin(bufferBytes);
+    _buffer.setCatchUpSpeed(STREAM_BUFFER_CATCHUP_SPEED);
+    _mux.setWindow(AV_MUX_WINDOW_MS);
+    _mux.setLatePolicy(AV_MUX_DROP_LATE ? LatePolicy::DROP : LatePolicy::CLAMP);
+    _client.setAggregation(RTMP_AGGREGATE_ENABLED ? RTMP_AGGREGATE_MAX_BYTES : 0, RTMP_AGGREGATE_MAX_MS);
+
+    _audio = xQueueCreate(RTMP_DESTINATION_AUDIO_BLOCKS, sizeof(FanoutAudio));
+    if (!_audio) {
+        return false;
+    }
+
+    char name[16];
+    snprintf(name, sizeof(name), "RTMPDest%u", _index);
+    if (xTaskCreatePinnedToCore(task, name, TASK_DESTINATION_STACK_SIZE, this, TASK_DESTINATION_PRIORITY,
+                                &_task, TASK_DESTINATION_CORE) != pdPASS) {
+        LOG_E("RTMP[%u]: Cannot start the destination task", _index);
+        return false;
+    }
+    _video.setConsumer(_task);
+    return true;
+}
+
+void RTMPDestination::postAudio(const FanoutAudio& audio) {
+    if (xQueueSend(_audio, &audio, 0) != pdTRUE) {
+        _audioDropped.fetch_add(1, std::memory_order_relaxed);
+        _metricAudioDropped.inc();
+        _releaseAudio(audio.owner);
+        return;
+    }
+    xTaskNotifyGive(_task);
+}
+
+uint32_t RTMPDestination::getFramesDropped() {
+    return _video.getOverwrites() + _client.getDroppedFrames() + _framesLost;
+}
+
+void RTMPDestination::task(void* param) {
+    ((RTMPDestination*)param)->run();
+}
+
+void RTMPDestination::run() {
+    LOG_I("RTMP[%u]: Destination started", _index);
+
+    // A failed first attempt is retried from handle(), with backoff
+    _client.connect(_url, _streamKey);
+
+    while (true) {
+        if (!_client.isConnected()) {
+            _buffer.resetPacing();
+            _client.handle();
+        }
+
+        // Newest frame (audio blocks wake this early); while one is still
+        // going out, back soon to give the link its next chunks, and in any
+        // case when the mux's oldest message is due. Due audio held behind
+        // that frame (see drainMux()) cannot go before the link has taken
+        // more of it, so it does not cut the poll short.
+        uint32_t waitMs = _client.isSendingVideo() ? RTMP_INTERLEAVE_POLL_MS : 100;
+        uint32_t dueMs = _mux.nextDueMs(millis());
+        if (dueMs > 0 || !_client.isSendingVideo()) {
+            waitMs = min(waitMs, dueMs);
+        }
+        FrameRef frame(_video.take(waitMs));
+        if (frame && _client.isSendingVideo()) {
+            // The link is still on an earlier frame: skip this one rather
+            // than queue it behind the audio that waits for that frame
+            lost(STREAM_MESSAGE_VIDEO);
+            frame.reset();
+        }
+        if (frame) {
+            camera_fb_t* fb = frame->fb();
+            uint32_t captureMs = (uint32_t)((uint64_t)fb->timestamp.tv_sec * 1000 + fb->timestamp.tv_usec / 1000);
+            MuxMessage message = { STREAM_MESSAGE_VIDEO, streamTime(captureMs), fb->buf, fb->len, frame.take(), 0 };
+            mux(message);
+        }
+
+        FanoutAudio audio;
+        while (xQueueReceive(_audio, &audio, 0) == pdTRUE) {
+            MuxMessage message = { STREAM_MESSAGE_AUDIO, streamTime(audio.captureMs), audio.data, audio.length,
+                                   audio.owner, 0 };
+            mux(message);
+        }
+
+        // What has waited out the window since
+        drainMux();
+
+        if (_client.isConnected()) {
+            forwardHeld();
+
+            // Keepalive, queued bytes and the next video chunks
+            _client.handle();
+        }
+
+        if (!_client.isSendingVideo()) {
+            _sending.reset();       // Sent, or abandoned with the connection
+            drainMux();             // Audio that waited for it
+        }
+    }
+}
+
+// Stream time follows the capture clock, from 0 at the first message.
+// Without store-and-forward it is rebased after each reconnect to carry on
+// just after the last timestamp sent, rather than jump the length of the
+// outage; with it, the held messages fill the gap with their own times.
+uint32_t RTMPDestination::streamTime(uint32_t captureMs) {
+    if (!_started || (!_buffer.isEnabled() && _epoch != _client.getReconnects())) {
+        _offset = captureMs - (_started ? _latest + 1000 / CAMERA_TARGET_FPS : 0);
+        _epoch = _client.getReconnects();
+        _started = true;
+    }
+    int32_t time = (int32_t)(captureMs - _offset);
+    uint32_t clamped = time > 0 ? (uint32_t)time : 0;   // Audio from just before the first frame
+    _latest = max(_latest, clamped);
+    return clamped;
+}
+
+void RTMPDestination::mux(const MuxMessage& message) {
+    uint8_t depth;
+    MuxMessage evicted;
+    switch (_mux.push(message, millis(), depth, evicted)) {
+        case MuxPush::LATE:             // AV_MUX_DROP_LATE
+            lost(message.type);
+            release(message);
+            return;
+        case MuxPush::FULL:             // Audio held behind a long frame filled it
+            lost(evicted.type);
+            release(evicted);
+            break;
+        case MuxPush::QUEUED:
+            break;
+    }
+    _metricMuxDepth.observe(depth);
+    drainMux();
+}
+
+// Everything the mux lets go, in timestamp order, to the client or the
+// store-and-forward buffer. Audio waits while a frame is still going out:
+// sent between its chunks it would arrive first, ahead of an older
+// timestamp.
+void RTMPDestination::drainMux() {
+    MuxMessage message;
+    uint32_t now = millis();
+    while (_mux.peek(now, message)) {
+        if (message.type == STREAM_MESSAGE_AUDIO && _client.isSendingVideo()) {
+            break;
+        }
+        _mux.pop(now, message);
+        _metricMuxLatency.observe(now - message.arrivalMs);
+        if (message.type == STREAM_MESSAGE_VIDEO) {
+            FrameRef frame((SharedFrame*)message.owner);
+            sendOrHoldFrame(frame, message.timestamp);
+        } else {
+            sendOrHold(STREAM_MESSAGE_AUDIO, message.timestamp, message.data, message.length);
+            _releaseAudio(message.owner);
+        }
+    }
+}
+
+void RTMPDestination::release(const MuxMessage& message) {
+    if (message.type == STREAM_MESSAGE_VIDEO) {
+        FrameRef frame((SharedFrame*)message.owner);    // Dropped at the end of the scope
+    } else {
+        _releaseAudio(message.owner);
+    }
+}
+
+void RTMPDestination::lost(uint8_t type) {
+    if (type == STREAM_MESSAGE_VIDEO) {
+        _framesLost++;
+    } else {
+        _audioDropped.fetch_add(1, std::memory_order_relaxed);
+        _metricAudioDropped.inc();
+    }
+}
+
+bool RTMPDestination::send(uint8_t type, uint32_t timestamp, const uint8_t* data, size_t len) {
+    bool sent = type == STREAM_MESSAGE_VIDEO ? _client.sendVideoData(data, len, timestamp)
+                                              : _client.sendAudioData(data, len, timestamp);
+    if (sent) {
+        countSent(type, len);
+    }
+    return sent;
+}
+
+void RTMPDestination::countSent(uint8_t type, size_t len) {
+    _payloadBytes += len;
+    _metricPayloadBytes.inc((uint32_t)len);
+    if (type == STREAM_MESSAGE_VIDEO) {
+        _metricFramesSent.inc();
+    }
+}
+
+// Live when nothing is held back; otherwise behind the backlog, in order
+void RTMPDestination::sendOrHold(uint8_t type, uint32_t timestamp, const uint8_t* data, size_t len) {
+    if (_client.isConnected() && _buffer.isEmpty()) {
+        send(type, timestamp, data, len);
+    } else if (!_buffer.push(type, timestamp, data, len)) {
+        lost(type);
+    }
+}
+
+// A live frame goes out interleaved with the audio, straight from the
+// frame, which is kept until the client has written all of it
+void RTMPDestination::sendOrHoldFrame(FrameRef& frame, uint32_t timestamp) {
+    camera_fb_t* fb = frame->fb();
+    if (!_client.isConnected() || !_buffer.isEmpty()) {
+        sendOrHold(STREAM_MESSAGE_VIDEO, timestamp, fb->buf, fb->len);
+    } else if (_client.beginVideoData(fb->buf, fb->len, timestamp)) {
+        countSent(STREAM_MESSAGE_VIDEO, fb->len);
+        _sending = std::move(frame);
+    }
+}
+
+// Send the backlog as fast as the catch-up pacing and the socket allow
+void RTMPDestination::forwardHeld() {
+    StreamMessage message;
+    while (_client.isConnected() && _client.isWritable() && _buffer.due(millis(), message)) {
+        if (!send(message.type, message.timestamp, message.data, message.length)) {
+            break;          // Connection dropped: the message stays for the next one
+        }
+        _buffer.pop();
+    }
+}
+
+// ============================================================================
+// Fanout
+// ============================================================================
+
+RTMPFanout::RTMPFanout(RTMPDestination::ReleaseFunction releaseAudio)
+    : _count(0)
+    , _releaseAudio(releaseAudio)
+    , _width(0)
+    , _height(0)
+    , _frameRate(0.0f)
+{
+}
+
+void RTMPFanout::setVideoInfo(uint16_t width, uint16_t height, float frameRate) {
+    _width = width;
+    _height = height;
+    _frameRate = frameRate;
+}
+
+RTMPDestination* RTMPFanout::add(const String& url, const String& streamKey, size_t bufferBytes) {
+    uint8_t count = getCount();
+    if (count == RTMP_MAX_DESTINATIONS) {
+        LOG_W("RTMP: Only %u destinations, %s ignored", RTMP_MAX_DESTINATIONS, url.c_str());
+        return nullptr;
+    }
+
+    RTMPDestination* destination = new RTMPDestination(count, url, streamKey, _releaseAudio);
+    destination->setVideoInfo(_width, _height, _frameRate);
+    if (!destination->start(bufferBytes)) {
+        delete destination;
+        return nullptr;
+    }
+
+    // Published last: the stream task may already be posting
+    _destinations[count] = destination;
+    _count.store(count + 1, std::memory_order_release);
+    return destination;
+}
+
+void RTMPFanout::postVideo(const FrameRef& frame) {
+    TRACE_SCOPE("fanout.video");
+    uint8_t count = getCount();
+    for (uint8_t i = 0; i < count; i++) {
+        if (_destinations[i]->accepts()) {
+            _destinations[i]->postVideo(frame.share());
+        }
+    }
+}
+
+void RTMPFanout::postAudio(uint8_t count, uint32_t captureMs, const uint8_t* data, size_t length, void* owner) {
+    FanoutAudio audio = { captureMs, data, length, owner };
+    for (uint8_t i = 0; i < count; i++) {
+        if (_destinations[i]->accepts()) {
+            _destinations[i]->postAudio(audio);
+        } else {
+            _releaseAudio(owner);
+        }
+    }
+}
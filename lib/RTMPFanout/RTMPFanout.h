@@ -0,0 +1,173 @@
+#ifndef RTMP_FANOUT_H
+#define RTMP_FANOUT_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/queue.h>
+#include <atomic>
+#include <RTMPClient.h>
+#include <StreamBuffer.h>
+#include <SharedFrame.h>
+#include <FrameMailbox.h>
+#include <AVMux.h>
+#include <Metrics.h>
+#include "../../include/config.h"
+
+// Publishes one capture to several RTMP servers at once.
+//
+// Each destination is a publish session with its own task and RTMPClient
+// (socket, send queue, reconnect backoff) and, optionally, its own
+// store-and-forward buffer. A destination that is slow, down or blocked in
+// a connect attempt only ever loses its own frames.
+//
+// The stream task posts each message once. Every destination gets a
+// reference to the same SharedFrame through its own FrameMailbox. The
+// newest frame wins, so a destination that falls behind skips frames
+// instead of queueing them or holding on to camera buffers. Audio blocks
+// go by reference through a short queue per destination; when that queue
+// is full the block is dropped for that destination only. Payloads are
+// not copied on the way; a client's send queue only keeps what its socket
+// has not taken yet. A live frame is written a chunk at a time with the
+// audio in between (RTMPClient::beginVideoData()), and the destination
+// keeps its reference until the last chunk is out.
+//
+// Each destination puts the two streams back in timestamp order (AVMux)
+// before they reach its client, sending or holding them from there.
+//
+// Destination 0 is the provisioned one. Destinations are numbered in the
+// order they are added, and the number is the dest label on their metrics.
+
+#define RTMP_DESTINATION_LABELS_MAX     16
+
+// Audio as posted to the destinations: owner is released through the
+// fanout's release function once per destination
+struct FanoutAudio {
+    uint32_t captureMs;
+    const uint8_t* data;
+    size_t length;
+    void* owner;
+};
+
+class RTMPDestination {
+public:
+    typedef void (*ReleaseFunction)(void* owner);
+
+    RTMPDestination(uint8_t index, const String& url, const String& streamKey, ReleaseFunction releaseAudio);
+    ~RTMPDestination();
+
+    // Allocate the store-and-forward buffer (0: none) and start the task,
+    // which connects and from then on reconnects by itself
+    bool start(size_t bufferBytes);
+
+    void setVideoInfo(uint16_t width, uint16_t height, float frameRate) {
+        _client.setVideoInfo(width, height, frameRate);
+    }
+
+    // Worth posting to: streaming, or able to hold messages until it is
+    // again (read from the stream task, so only a hint)
+    bool accepts() { return _client.isConnected() || _buffer.isEnabled(); }
+
+    // Adopt one frame reference
+    void postVideo(SharedFrame* frame) { _video.post(frame); }
+    // Adopt one reference on audio.owner; released at once if the queue is full
+    void postAudio(const FanoutAudio& audio);
+
+    uint8_t getIndex() const { return _index; }
+    bool isConnected() { return _client.isConnected(); }
+    uint32_t getReconnects() { return _client.getReconnects(); }
+    StreamBuffer& getBuffer() { return _buffer; }
+    const AVMux& getMux() const { return _mux; }
+
+    // Statistics
+    uint32_t getFramesSent() { return _client.getFramesSent(); }
+    uint32_t getFramesDropped();        // Skipped, refused by the client, or lost while down
+    uint32_t getAudioDropped() const { return _audioDropped.load(std::memory_order_relaxed); }
+    uint64_t getPayloadBytes() const { return _payloadBytes; }
+
+private:
+    uint8_t _index;
+    char _labels[RTMP_DESTINATION_LABELS_MAX];
+    String _url;
+    String _streamKey;
+    ReleaseFunction _releaseAudio;
+
+    RTMPClient _client;
+    StreamBuffer _buffer;
+    FrameMailbox _video;
+    FrameRef _sending;                  // Live frame the client is still writing
+    QueueHandle_t _audio;
+    AVMux _mux;                         // Video owners are SharedFrame references
+    TaskHandle_t _task;
+
+    // Stream time (see streamTime())
+    bool _started;
+    uint32_t _offset;
+    uint32_t _epoch;
+    uint32_t _latest;
+
+    uint32_t _framesLost;
+    std::atomic<uint32_t> _audioDropped;  // Stream task (queue full) and ours (evicted)
+    uint64_t _payloadBytes;
+
+    Counter _metricPayloadBytes;
+    Counter _metricFramesSent;
+    Counter _metricAudioDropped;
+    CallbackMetric _metricFramesDropped;
+    CallbackMetric _metricConnected;
+    CallbackMetric _metricBufferBytes;
+    CallbackMetric _metricBufferBacklog;
+    Histogram _metricMuxDepth;
+    Histogram _metricMuxLatency;
+    CallbackMetric _metricMuxLate;
+    CallbackMetric _metricMuxEvicted;
+
+    void run();
+    uint32_t streamTime(uint32_t captureMs);
+    void mux(const MuxMessage& message);
+    void drainMux();
+    void release(const MuxMessage& message);
+    void lost(uint8_t type);
+    void sendOrHold(uint8_t type, uint32_t timestamp, const uint8_t* data, size_t len);
+    void sendOrHoldFrame(FrameRef& frame, uint32_t timestamp);
+    void forwardHeld();
+    bool send(uint8_t type, uint32_t timestamp, const uint8_t* data, size_t len);
+    void countSent(uint8_t type, size_t len);
+
+    static void task(void* param);
+};
+
+class RTMPFanout {
+public:
+    explicit RTMPFanout(RTMPDestination::ReleaseFunction releaseAudio);
+
+    // Passed to destinations added afterwards (onMetaData)
+    void setVideoInfo(uint16_t width, uint16_t height, float frameRate);
+
+    // Start publishing to one more server; nullptr when RTMP_MAX_DESTINATIONS
+    // are running or its task cannot start. Call from the loop task.
+    RTMPDestination* add(const String& url, const String& streamKey, size_t bufferBytes);
+
+    uint8_t getCount() const { return _count.load(std::memory_order_acquire); }
+    RTMPDestination* get(uint8_t index) { return index < getCount() ? _destinations[index] : nullptr; }
+
+    // One reference to frame for every destination that takes it (the
+    // caller keeps its own)
+    void postVideo(const FrameRef& frame);
+
+    // Goes to the first count destinations: read getCount() once and give
+    // owner that many references. Each one is released exactly once, at
+    // once for a destination that does not take the block. (A destination
+    // added in between gets the next block.)
+    void postAudio(uint8_t count, uint32_t captureMs, const uint8_t* data, size_t length, void* owner);
+
+private:
+    RTMPDestination* _destinations[RTMP_MAX_DESTINATIONS];
+    std::atomic<uint8_t> _count;
+    RTMPDestination::ReleaseFunction _releaseAudio;
+    uint16_t _width;
+    uint16_t _height;
+    float _frameRate;
+};
+
+#endif // RTMP_FANOUT_H
@@ -0,0 +1,584 @@
+#include "RTPSender.h"
+#include <errno.h>
+#include <string.h>
+#include <sys/time.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <Logger.h>
+#include <Metrics.h>
+#include <Trace.h>
+
+#ifdef ESP_PLATFORM
+#include <fcntl.h>
+#include <lwip/sockets.h>
+#include <lwip/netdb.h>
+#else
+#include <fcntl.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#endif
+
+static Counter metricVideoPackets("rtp_packets_sent_total", "RTP packets sent", "media=\"video\"");
+static Counter metricAudioPackets("rtp_packets_sent_total", "RTP packets sent", "media=\"audio\"");
+static Counter metricFecPackets("rtp_packets_sent_total", "RTP packets sent", "media=\"fec\"");
+static Counter metricBytesSent("rtp_bytes_sent_total", "UDP payload bytes sent for RTP and RTCP");
+static Counter metricFramesSent("rtp_frames_sent_total", "JPEG frames sent over RTP");
+static Counter metricFramesSkipped("rtp_frames_skipped_total", "Frames RFC 2435 cannot carry");
+static Counter metricSendFailures("rtp_send_failures_total", "Packets the network stack refused with an error");
+static Counter metricPacketsDropped("rtp_packets_dropped_total", "Packets dropped because the network stack had no buffer free");
+static Counter metricReports("rtp_receiver_reports_total", "RTCP receiver report blocks read");
+
+// RFC 2435 receivers decode with the ITU T.81 Annex K.3 tables
+static const uint8_t kLumaDcBits[16] = { 0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0 };
+static const uint8_t kChromaDcBits[16] = { 0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0 };
+static const uint8_t kDcVals[12] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 };
+
+static const uint8_t kLumaAcBits[16] = { 0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7D };
+static const uint8_t kLumaAcVals[162] = {
+    0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+    0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xA1, 0x08, 0x23, 0x42, 0xB1, 0xC1, 0x15, 0x52, 0xD1, 0xF0,
+    0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0A, 0x16, 0x17, 0x18, 0x19, 0x1A, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2A, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+    0x4A, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5A, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+    0x6A, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+    0x8A, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A, 0xA2, 0xA3, 0xA4, 0xA5, 0xA6, 0xA7,
+    0xA8, 0xA9, 0xAA, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA, 0xC2, 0xC3, 0xC4, 0xC5,
+    0xC6, 0xC7, 0xC8, 0xC9, 0xCA, 0xD2, 0xD3, 0xD4, 0xD5, 0xD6, 0xD7, 0xD8, 0xD9, 0xDA, 0xE1, 0xE2,
+    0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA, 0xF1, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8,
+    0xF9, 0xFA
+};
+
+static const uint8_t kChromaAcBits[16] = { 0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77 };
+static const uint8_t kChromaAcVals[162] = {
+    0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71,
+    0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xA1, 0xB1, 0xC1, 0x09, 0x23, 0x33, 0x52, 0xF0,
+    0x15, 0x62, 0x72, 0xD1, 0x0A, 0x16, 0x24, 0x34, 0xE1, 0x25, 0xF1, 0x17, 0x18, 0x19, 0x1A, 0x26,
+    0x27, 0x28, 0x29, 0x2A, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+    0x49, 0x4A, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5A, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+    0x69, 0x6A, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+    0x88, 0x89, 0x8A, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A, 0xA2, 0xA3, 0xA4, 0xA5,
+    0xA6, 0xA7, 0xA8, 0xA9, 0xAA, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA, 0xC2, 0xC3,
+    0xC4, 0xC5, 0xC6, 0xC7, 0xC8, 0xC9, 0xCA, 0xD2, 0xD3, 0xD4, 0xD5, 0xD6, 0xD7, 0xD8, 0xD9, 0xDA,
+    0xE2, 0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8,
+    0xF9, 0xFA
+};
+
+static bool isTable(const JpegHuffTable& table, const uint8_t* bits, const uint8_t* vals, uint16_t count) {
+    return table.present && table.count == count && memcmp(&table.bits[1], bits, 16) == 0 &&
+           memcmp(table.vals, vals, count) == 0;
+}
+
+static void put16(uint8_t* p, uint32_t value) {
+    p[0] = (value >> 8) & 0xFF;
+    p[1] = value & 0xFF;
+}
+
+static void put32(uint8_t* p, uint32_t value) {
+    p[0] = (value >> 24) & 0xFF;
+    p[1] = (value >> 16) & 0xFF;
+    p[2] = (value >> 8) & 0xFF;
+    p[3] = value & 0xFF;
+}
+
+static uint32_t get32(const uint8_t* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static uint32_t random32() {
+    return (((uint32_t)random(0x10000) << 16) | (uint32_t)random(0x10000)) ^ (uint32_t)esp_timer_get_time();
+}
+
+// Wall-clock time as a 64-bit NTP timestamp
+static uint64_t ntpNow() {
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    uint64_t seconds = (uint64_t)now.tv_sec + 2208988800ULL;
+    uint64_t fraction = ((uint64_t)now.tv_usec << 32) / 1000000;
+    return (seconds << 32) | fraction;
+}
+
+static void resetStream(RtpStream& stream, uint32_t clockRate, uint16_t port) {
+    memset(&stream, 0, sizeof(stream));
+    stream.ssrc = random32();
+    stream.sequence = (uint16_t)random32();
+    stream.clockRate = clockRate;
+    stream.timestampOffset = random32();
+    stream.port = port;
+}
+
+// RTP time of a capture-clock instant
+static uint32_t rtpTime(const RtpStream& stream, uint64_t micros) {
+    return stream.timestampOffset + (uint32_t)(micros * stream.clockRate / 1000000);
+}
+
+RTPSender::RTPSender()
+    : _rtpSocket(-1)
+    , _rtcpSocket(-1)
+    , _address(0)
+    , _maxPayload(RTP_PACKET_BYTES - RTP_HEADER_BYTES)
+    , _lastReportMs(0)
+    , _reportSent(false)
+    , _audioStarted(false)
+    , _nextAudioTimestamp(0)
+    , _fecGroup(0)
+    , _fecCount(0)
+    , _fecBase(0)
+    , _fecBits{ 0, 0 }
+    , _fecTimestamp(0)
+    , _fecLength(0)
+    , _fecProtected(0)
+    , _framesSent(0)
+    , _framesSkipped(0)
+    , _sendFailures(0)
+    , _packetsDropped(0)
+    , _metricVideoLost("rtp_remote_fraction_lost", "Fraction of packets lost, from the last receiver report",
+                       MetricType::GAUGE, [this]() { return (double)_video.fractionLost; }, "media=\"video\"")
+    , _metricAudioLost("rtp_remote_fraction_lost", "Fraction of packets lost, from the last receiver report",
+                       MetricType::GAUGE, [this]() { return (double)_audio.fractionLost; }, "media=\"audio\"")
+    , _metricVideoJitter("rtp_remote_jitter_seconds", "Interarrival jitter the receiver reports",
+                         MetricType::GAUGE, [this]() { return _video.jitterMs / 1000.0; }, "media=\"video\"")
+    , _metricAudioJitter("rtp_remote_jitter_seconds", "Interarrival jitter the receiver reports",
+                         MetricType::GAUGE, [this]() { return _audio.jitterMs / 1000.0; }, "media=\"audio\"")
+    , _metricVideoRtt("rtp_round_trip_seconds", "Round-trip time from the last receiver report",
+                      MetricType::GAUGE, [this]() { return _video.rttMs / 1000.0; }, "media=\"video\"")
+    , _metricAudioRtt("rtp_round_trip_seconds", "Round-trip time from the last receiver report",
+                      MetricType::GAUGE, [this]() { return _audio.rttMs / 1000.0; }, "media=\"audio\"")
+{
+    _cname[0] = '\0';
+    memset(&_video, 0, sizeof(_video));
+    memset(&_audio, 0, sizeof(_audio));
+    memset(&_fec, 0, sizeof(_fec));
+}
+
+RTPSender::~RTPSender() {
+    end();
+}
+
+bool RTPSender::begin(const String& target, const char* cname, uint8_t fecGroup) {
+    end();
+
+    int colon = target.lastIndexOf(':');
+    long port = colon > 0 ? target.substring(colon + 1).toInt() : 0;
+    if (port <= 0 || port > 65532) {
+        LOG_E("RTP: Target \"%s\" is not host:port", target.c_str());
+        return false;
+    }
+    if (port & 1) {
+        LOG_W("RTP: Port %ld is odd; RTP uses the even port and RTCP the one above", port);
+    }
+    String host = target.substring(0, colon);
+
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    struct addrinfo* result = nullptr;
+    if (getaddrinfo(host.c_str(), nullptr, &hints, &result) != 0 || !result) {
+        LOG_E("RTP: Cannot resolve %s", host.c_str());
+        return false;
+    }
+    _address = ((struct sockaddr_in*)result->ai_addr)->sin_addr.s_addr;
+    freeaddrinfo(result);
+
+    _rtpSocket = socket(AF_INET, SOCK_DGRAM, 0);
+    _rtcpSocket = socket(AF_INET, SOCK_DGRAM, 0);
+    if (_rtpSocket < 0 || _rtcpSocket < 0) {
+        LOG_E("RTP: socket() failed (%d)", errno);
+        end();
+        return false;
+    }
+    fcntl(_rtpSocket, F_SETFL, fcntl(_rtpSocket, F_GETFL, 0) | O_NONBLOCK);
+    fcntl(_rtcpSocket, F_SETFL, fcntl(_rtcpSocket, F_GETFL, 0) | O_NONBLOCK);
+
+    strncpy(_cname, cname, RTP_CNAME_MAX);
+    _cname[RTP_CNAME_MAX] = '\0';
+    resetStream(_video, RTP_VIDEO_CLOCK, (uint16_t)port);
+    resetStream(_audio, AUDIO_SAMPLE_RATE, (uint16_t)port + 2);
+    resetStream(_fec, RTP_VIDEO_CLOCK, (uint16_t)port);
+    _reportSent = false;
+    _audioStarted = false;
+    _fecGroup = fecGroup > RTP_FEC_MAX_GROUP ? RTP_FEC_MAX_GROUP : (fecGroup < 2 ? 0 : fecGroup);
+    _fecCount = 0;
+
+    LOG_I("RTP: Sending to %s:%ld (video %ld, audio %ld%s)", host.c_str(), port, port, port + 2,
+          _fecGroup ? ", XOR FEC" : "");
+    return true;
+}
+
+void RTPSender::end() {
+    if (_rtpSocket >= 0) {
+        ::close(_rtpSocket);
+        _rtpSocket = -1;
+    }
+    if (_rtcpSocket >= 0) {
+        ::close(_rtcpSocket);
+        _rtcpSocket = -1;
+    }
+}
+
+// ============================================================================
+// Video
+// ============================================================================
+
+// The RFC 2435 type for this frame (0: 4:2:2, 1: 4:2:0, plus 64 with
+// restart markers), or false when it has none
+bool RTPSender::describe(const uint8_t* jpeg, size_t len, uint8_t& type) {
+    if (!jpegParse(jpeg, len, _info) || _info.numComponents != 3) {
+        return false;
+    }
+    const JpegComponent& y = _info.components[0];
+    const JpegComponent& cb = _info.components[1];
+    const JpegComponent& cr = _info.components[2];
+    if (y.h != 2 || (y.v != 1 && y.v != 2) || cb.h != 1 || cb.v != 1 || cr.h != 1 || cr.v != 1) {
+        return false;
+    }
+    if (cb.tq != cr.tq || _info.quantPrecision[y.tq] != 0 || _info.quantPrecision[cb.tq] != 0) {
+        return false;
+    }
+    if (!isTable(_info.dc[y.td], kLumaDcBits, kDcVals, sizeof(kDcVals)) ||
+        !isTable(_info.ac[y.ta], kLumaAcBits, kLumaAcVals, sizeof(kLumaAcVals))) {
+        return false;
+    }
+    for (int c = 1; c < 3; c++) {
+        const JpegComponent& chroma = _info.components[c];
+        if (!isTable(_info.dc[chroma.td], kChromaDcBits, kDcVals, sizeof(kDcVals)) ||
+            !isTable(_info.ac[chroma.ta], kChromaAcBits, kChromaAcVals, sizeof(kChromaAcVals))) {
+            return false;
+        }
+    }
+    if (_info.width % 8 != 0 || _info.height % 8 != 0 || _info.width > 2040 || _info.height > 2040) {
+        return false;
+    }
+    type = (y.v == 2 ? 1 : 0) + (_info.restartInterval ? 64 : 0);
+    return true;
+}
+
+bool RTPSender::sendVideo(const uint8_t* jpeg, size_t len, uint32_t captureMs) {
+    if (!isEnabled()) {
+        return false;
+    }
+    TRACE_SCOPE_ARG("rtp.sendVideo", len);
+    service();
+
+    uint8_t type;
+    if (!describe(jpeg, len, type)) {
+        if (_framesSkipped++ == 0) {
+            LOG_W("RTP: Frame is not baseline YCbCr 4:2:2/4:2:0 with the standard tables, skipping such frames");
+        }
+        metricFramesSkipped.inc();
+        return false;
+    }
+
+    const uint8_t* scan = jpeg + _info.scanOffset;
+    size_t scanLen = _info.scanEnd - _info.scanOffset;
+    uint32_t timestamp = rtpTime(_video, (uint64_t)captureMs * 1000);
+    size_t room = _maxPayload - (_fecGroup ? RTP_FEC_HEADER_BYTES : 0);
+
+    uint8_t head[RTP_JPEG_HEADER_BYTES + RTP_JPEG_RESTART_BYTES + RTP_JPEG_QUANT_BYTES];
+    head[0] = 0;                                // Type-specific: progressive
+    head[4] = type;
+    head[5] = 255;                              // Q: tables in-band, every frame
+    head[6] = _info.width / 8;
+    head[7] = _info.height / 8;
+
+    bool sent = true;
+    size_t offset = 0;
+    while (offset < scanLen) {
+        head[1] = (offset >> 16) & 0xFF;        // Fragment offset
+        head[2] = (offset >> 8) & 0xFF;
+        head[3] = offset & 0xFF;
+        size_t headLen = RTP_JPEG_HEADER_BYTES;
+        if (_info.restartInterval) {
+            // Packets are not cut at restart intervals: F and L set, count all ones
+            put16(head + headLen, _info.restartInterval);
+            put16(head + headLen + 2, 0xFFFF);
+            headLen += RTP_JPEG_RESTART_BYTES;
+        }
+        if (offset == 0) {
+            uint8_t* quant = head + headLen;
+            quant[0] = 0;                       // MBZ
+            quant[1] = 0;                       // 8-bit tables
+            put16(quant + 2, 2 * 64);
+            const uint16_t* luma = _info.quant[_info.components[0].tq];
+            const uint16_t* chroma = _info.quant[_info.components[1].tq];
+            for (int k = 0; k < 64; k++) {
+                quant[4 + k] = (uint8_t)luma[k];
+                quant[4 + 64 + k] = (uint8_t)chroma[k];
+            }
+            headLen += RTP_JPEG_QUANT_BYTES;
+        }
+
+        size_t take = scanLen - offset;
+        if (take > room - headLen) {
+            take = room - headLen;
+        }
+        bool last = offset + take == scanLen;
+        sent &= sendPacket(_video, RTP_VIDEO_PAYLOAD_TYPE, timestamp, last, head, headLen, scan + offset, take);
+        offset += take;
+    }
+    // A frame's packets are only ever protected together
+    flushFec();
+
+    _framesSent++;
+    metricFramesSent.inc();
+    return sent;
+}
+
+// ============================================================================
+// Audio
+// ============================================================================
+
+bool RTPSender::sendAudio(const int16_t* pcm, size_t samples, uint32_t captureMs) {
+    if (!isEnabled() || samples == 0) {
+        return false;
+    }
+    TRACE_SCOPE_ARG("rtp.sendAudio", samples);
+    service();
+
+    // Blocks follow each other sample for sample; the capture time only
+    // takes over when it is half a block or more away (a gap in capture)
+    uint32_t timestamp = rtpTime(_audio, (uint64_t)captureMs * 1000);
+    int32_t drift = (int32_t)(timestamp - _nextAudioTimestamp);
+    if (_audioStarted && drift < (int32_t)samples / 2 && drift > -(int32_t)samples / 2) {
+        timestamp = _nextAudioTimestamp;
+    }
+    _audioStarted = true;
+    _nextAudioTimestamp = timestamp + samples;
+
+    size_t perPacket = _maxPayload / sizeof(int16_t);
+    size_t packets = (samples + perPacket - 1) / perPacket;
+    perPacket = (samples + packets - 1) / packets;
+
+    bool sent = true;
+    for (size_t first = 0; first < samples; first += perPacket) {
+        size_t count = samples - first < perPacket ? samples - first : perPacket;
+        for (size_t i = 0; i < count; i++) {
+            put16(&_audioPacket[2 * i], (uint16_t)pcm[first + i]);
+        }
+        sent &= sendPacket(_audio, RTP_AUDIO_PAYLOAD_TYPE, timestamp + first, false, nullptr, 0, _audioPacket,
+                           count * sizeof(int16_t));
+    }
+    return sent;
+}
+
+// ============================================================================
+// Packets
+// ============================================================================
+
+bool RTPSender::sendPacket(RtpStream& stream, uint8_t payloadType, uint32_t timestamp, bool marker,
+                           const uint8_t* head, size_t headLen, const uint8_t* body, size_t bodyLen) {
+    uint8_t packet[RTP_HEADER_BYTES + RTP_JPEG_HEADER_BYTES + RTP_JPEG_RESTART_BYTES + RTP_JPEG_QUANT_BYTES];
+    packet[0] = 0x80;                           // Version 2, no padding, extension or CSRCs
+    packet[1] = (marker ? 0x80 : 0x00) | payloadType;
+    put16(packet + 2, stream.sequence);
+    put32(packet + 4, timestamp);
+    put32(packet + 8, stream.ssrc);
+    if (headLen > 0) {
+        memcpy(packet + RTP_HEADER_BYTES, head, headLen);
+    }
+
+    stream.sequence++;
+    stream.lastTimestamp = timestamp;
+    stream.packets++;
+    stream.octets += headLen + bodyLen;
+    if (&stream == &_video && _fecGroup) {
+        protect(packet, head, headLen, body, bodyLen);
+    }
+
+    if (!transmit(_rtpSocket, stream.port, packet, RTP_HEADER_BYTES + headLen, body, bodyLen)) {
+        return false;
+    }
+    if (&stream == &_video) {
+        metricVideoPackets.inc();
+    } else if (&stream == &_audio) {
+        metricAudioPackets.inc();
+    } else {
+        metricFecPackets.inc();
+    }
+    return true;
+}
+
+bool RTPSender::transmit(int fd, uint16_t port, const void* head, size_t headLen, const void* body,
+                         size_t bodyLen) {
+    struct sockaddr_in to;
+    memset(&to, 0, sizeof(to));
+    to.sin_family = AF_INET;
+    to.sin_port = htons(port);
+    to.sin_addr.s_addr = _address;
+
+    struct iovec iov[2];
+    iov[0].iov_base = (void*)head;
+    iov[0].iov_len = headLen;
+    iov[1].iov_base = (void*)body;
+    iov[1].iov_len = bodyLen;
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_name = &to;
+    msg.msg_namelen = sizeof(to);
+    msg.msg_iov = iov;
+    msg.msg_iovlen = bodyLen > 0 ? 2 : 1;
+
+    if (sendmsg(fd, &msg, 0) >= 0) {
+        metricBytesSent.inc(headLen + bodyLen);
+        return true;
+    }
+
+    // lwIP reports ENOMEM when it is out of packet buffers. Waiting for the
+    // WiFi driver to drain them would hold up the stream task for a tick per
+    // packet, so the packet is dropped: to the receiver it is one more loss.
+    if (errno == ENOMEM || errno == ENOBUFS || errno == EAGAIN || errno == EWOULDBLOCK) {
+        _packetsDropped++;
+        metricPacketsDropped.inc();
+    } else {
+        _sendFailures++;
+        metricSendFailures.inc();
+    }
+    return false;
+}
+
+// ============================================================================
+// Forward error correction (RFC 5109, level 0)
+// ============================================================================
+
+// Add one video packet to the run: its header fields and payload (all
+// after the 12-byte RTP header) are XORed into the FEC packet
+void RTPSender::protect(const uint8_t* rtpHeader, const uint8_t* head, size_t headLen, const uint8_t* body,
+                        size_t bodyLen) {
+    if (_fecCount == 0) {
+        _fecBase = ((uint16_t)rtpHeader[2] << 8) | rtpHeader[3];
+        _fecBits[0] = 0;
+        _fecBits[1] = 0;
+        _fecTimestamp = 0;
+        _fecLength = 0;
+        _fecProtected = 0;
+        memset(_fecPayload, 0, sizeof(_fecPayload));
+    }
+    _fecBits[0] ^= rtpHeader[0];
+    _fecBits[1] ^= rtpHeader[1];
+    _fecTimestamp ^= get32(rtpHeader + 4);
+    _fecLength ^= (uint16_t)(headLen + bodyLen);
+    for (size_t i = 0; i < headLen; i++) {
+        _fecPayload[i] ^= head[i];
+    }
+    for (size_t i = 0; i < bodyLen; i++) {
+        _fecPayload[headLen + i] ^= body[i];
+    }
+    if (headLen + bodyLen > _fecProtected) {
+        _fecProtected = headLen + bodyLen;
+    }
+
+    if (++_fecCount == _fecGroup) {
+        flushFec();
+    }
+}
+
+void RTPSender::flushFec() {
+    if (_fecCount == 0) {
+        return;
+    }
+    uint8_t header[RTP_FEC_HEADER_BYTES];
+    header[0] = _fecBits[0] & 0x3F;             // E and L clear: P, X and CC recovery
+    header[1] = _fecBits[1];                    // M and PT recovery
+    put16(header + 2, _fecBase);
+    put32(header + 4, _fecTimestamp);
+    put16(header + 8, _fecLength);
+    put16(header + 10, _fecProtected);
+    put16(header + 12, (0xFFFF << (16 - _fecCount)) & 0xFFFF);     // SN base + 0 .. count - 1
+    _fecCount = 0;
+    sendPacket(_fec, RTP_FEC_PAYLOAD_TYPE, _video.lastTimestamp, false, header, sizeof(header), _fecPayload,
+               _fecProtected);
+}
+
+// ============================================================================
+// RTCP
+// ============================================================================
+
+void RTPSender::service() {
+    readReports();
+    if (!_reportSent || millis() - _lastReportMs >= RTP_RTCP_INTERVAL_MS) {
+        _reportSent = true;
+        _lastReportMs = millis();
+        sendReport(_video);
+        sendReport(_audio);
+    }
+}
+
+// Sender report and SDES with the CNAME, as one compound packet
+void RTPSender::sendReport(RtpStream& stream) {
+    uint8_t packet[28 + 12 + RTP_CNAME_MAX + 4];
+    uint64_t ntp = ntpNow();
+    uint32_t now = rtpTime(stream, (uint64_t)esp_timer_get_time());
+
+    packet[0] = 0x80;                           // No report blocks
+    packet[1] = 200;                            // SR
+    put16(packet + 2, 6);
+    put32(packet + 4, stream.ssrc);
+    put32(packet + 8, (uint32_t)(ntp >> 32));
+    put32(packet + 12, (uint32_t)ntp);
+    put32(packet + 16, now);
+    put32(packet + 20, stream.packets);
+    put32(packet + 24, stream.octets);
+
+    uint8_t* sdes = packet + 28;
+    size_t nameLen = strlen(_cname);
+    size_t items = 2 + nameLen + 1;             // CNAME item and the end marker
+    size_t words = (4 + items + 3) / 4;
+    memset(sdes, 0, words * 4 + 4);
+    sdes[0] = 0x81;                             // One chunk
+    sdes[1] = 202;                              // SDES
+    put16(sdes + 2, words);
+    put32(sdes + 4, stream.ssrc);
+    sdes[8] = 1;                                // CNAME
+    sdes[9] = (uint8_t)nameLen;
+    memcpy(sdes + 10, _cname, nameLen);
+
+    transmit(_rtcpSocket, stream.port + 1, packet, 28 + 4 + words * 4, nullptr, 0);
+}
+
+// Report blocks about our streams, from receiver or sender reports
+void RTPSender::readReports() {
+    uint8_t packet[RTP_PACKET_BYTES];
+    while (true) {
+        ssize_t len = recv(_rtcpSocket, packet, sizeof(packet), 0);
+        if (len <= 0) {
+            return;
+        }
+        uint32_t middle = (uint32_t)(ntpNow() >> 16);
+        size_t pos = 0;
+        while (pos + 8 <= (size_t)len) {
+            uint8_t count = packet[pos] & 0x1F;
+            uint8_t type = packet[pos + 1];
+            size_t size = 4 + 4 * (((size_t)packet[pos + 2] << 8) | packet[pos + 3]);
+            if ((packet[pos] & 0xC0) != 0x80 || pos + size > (size_t)len) {
+                break;
+            }
+            size_t blocks = type == 201 ? 8 : (type == 200 ? 28 : size);
+            for (uint8_t i = 0; i < count && pos + blocks + 24 <= pos + size; i++, blocks += 24) {
+                const uint8_t* block = packet + pos + blocks;
+                uint32_t ssrc = get32(block);
+                RtpStream* stream = ssrc == _video.ssrc ? &_video : (ssrc == _audio.ssrc ? &_audio : nullptr);
+                if (!stream) {
+                    continue;
+                }
+                uint32_t lost = get32(block + 4);
+                uint32_t lastReport = get32(block + 16);
+                uint32_t delay = get32(block + 20);
+                stream->reported = true;
+                stream->fractionLost = (lost >> 24) / 256.0f;
+                stream->cumulativeLost = lost & 0xFFFFFF;
+                stream->jitterMs = get32(block + 12) * 1000.0f / stream->clockRate;
+                if (lastReport != 0) {
+                    // 1/65536 s units
+                    stream->rttMs = (uint32_t)(middle - lastReport - delay) * 1000.0f / 65536.0f;
+                }
+                metricReports.inc();
+            }
+            pos += size;
+        }
+    }
+}
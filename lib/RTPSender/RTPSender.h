@@ -0,0 +1,157 @@
+#ifndef RTP_SENDER_H
+#define RTP_SENDER_H
+
+#include <Arduino.h>
+#include <JpegCodec.h>
+#include <Metrics.h>
+#include "../../include/config.h"
+
+// Low-latency monitoring output: the stream as RTP over UDP, next to the
+// RTMP destinations. Nothing waits for the receiver, so a lost packet costs
+// one frame instead of stalling everything behind it.
+//
+// Video is JPEG as RFC 2435 carries it: only the entropy-coded scan of each
+// frame goes out, cut into packets that are gathered straight from the
+// frame buffer behind the RTP and JPEG headers. The first packet of a frame
+// also carries both quantisation tables (Q 255: they change whenever rate
+// control changes the quality); the receiver rebuilds the other headers from
+// the type, the size and the standard Huffman tables. Frames RFC 2435
+// cannot describe (not 4:2:2 or 4:2:0 YCbCr, other Huffman tables, sizes
+// that are not whole blocks or over 2040 pixels) are counted and skipped.
+// Audio is L16: 16-bit big-endian PCM at AUDIO_SAMPLE_RATE, mono, under a
+// dynamic payload type.
+//
+// Ports follow the RTP convention from the target port P: video on P and
+// its RTCP on P+1, audio on P+2 and P+3. Each RTCP port gets a sender report
+// with the CNAME every RTP_RTCP_INTERVAL_MS. It ties the capture clock the
+// RTP timestamps count on to wall-clock time, which a receiver needs to line
+// the two streams up and to measure latency. Receiver reports sent back are
+// read for loss, jitter and round-trip time; they are only read when there
+// is something to send, so the round trip can be up to a frame interval long.
+//
+// With a FEC group size set, each run of that many video packets, and the
+// last packets of every frame, is followed by an RFC 5109 XOR FEC packet
+// (level 0, its own SSRC and RTP_FEC_PAYLOAD_TYPE, on the video port), from
+// which a receiver rebuilds any one packet of the run that went missing.
+//
+// Sockets are non-blocking. A packet the stack has no buffer for is dropped
+// at once and counted, so a congested link never delays the stream task.
+// Only one task (the stream task) may call the senders.
+
+#define RTP_HEADER_BYTES            12
+#define RTP_JPEG_HEADER_BYTES       8       // Main JPEG header, every packet
+#define RTP_JPEG_RESTART_BYTES      4       // Restart marker header, types 64-127
+#define RTP_JPEG_QUANT_BYTES        (4 + 2 * 64)    // Quantisation table header and two 8-bit tables
+#define RTP_FEC_HEADER_BYTES        (10 + 4)        // FEC header and a level 0 header with a 16-bit mask
+#define RTP_FEC_MAX_GROUP           16
+
+#define RTP_VIDEO_PAYLOAD_TYPE      26      // JPEG (static, 90 kHz)
+#define RTP_AUDIO_PAYLOAD_TYPE      96      // L16/AUDIO_SAMPLE_RATE/1 (dynamic)
+#define RTP_FEC_PAYLOAD_TYPE        127     // ulpfec/90000 (dynamic)
+#define RTP_VIDEO_CLOCK             90000
+
+#define RTP_CNAME_MAX               32
+
+struct RtpStream {
+    uint32_t ssrc;
+    uint16_t sequence;          // Next to send
+    uint32_t clockRate;
+    uint32_t timestampOffset;   // Random start, per RFC 3550
+    uint32_t lastTimestamp;
+    uint16_t port;              // RTP port at the target (RTCP is the next one)
+    uint32_t packets;
+    uint32_t octets;            // Payload bytes
+
+    // From the latest receiver report
+    bool reported;
+    float fractionLost;
+    uint32_t cumulativeLost;
+    float jitterMs;
+    float rttMs;
+};
+
+class RTPSender {
+public:
+    RTPSender();
+    ~RTPSender();
+
+    // Start sending to "host:port" (even port; see above). fecGroup is the
+    // number of video packets per FEC packet: 0 for none, 2 to
+    // RTP_FEC_MAX_GROUP. False when the target is unusable.
+    bool begin(const String& target, const char* cname, uint8_t fecGroup);
+    void end();
+    bool isEnabled() const { return _rtpSocket >= 0; }
+
+    // One JPEG frame; timestamps are capture milliseconds, as for RTMP
+    bool sendVideo(const uint8_t* jpeg, size_t len, uint32_t captureMs);
+    // One block of native-endian PCM
+    bool sendAudio(const int16_t* pcm, size_t samples, uint32_t captureMs);
+
+    const RtpStream& getVideo() const { return _video; }
+    const RtpStream& getAudio() const { return _audio; }
+
+    // Statistics
+    uint32_t getFramesSent() const { return _framesSent; }
+    uint32_t getFramesSkipped() const { return _framesSkipped; }
+    uint32_t getSendFailures() const { return _sendFailures; }
+    uint32_t getPacketsDropped() const { return _packetsDropped; }   // No buffer free
+    uint32_t getFecPackets() const { return _fec.packets; }
+
+private:
+    int _rtpSocket;
+    int _rtcpSocket;
+    uint32_t _address;          // Network order
+    char _cname[RTP_CNAME_MAX + 1];
+    size_t _maxPayload;         // After the RTP header
+
+    RtpStream _video;
+    RtpStream _audio;
+    RtpStream _fec;
+    uint32_t _lastReportMs;
+    bool _reportSent;
+
+    // Audio timestamps run on from block to block while capture keeps up
+    bool _audioStarted;
+    uint32_t _nextAudioTimestamp;
+    uint8_t _audioPacket[RTP_PACKET_BYTES];
+
+    // FEC run being built: XOR of the protected packets
+    uint8_t _fecGroup;
+    uint8_t _fecCount;
+    uint16_t _fecBase;
+    uint8_t _fecBits[2];        // P, X, CC, M and PT
+    uint32_t _fecTimestamp;
+    uint16_t _fecLength;
+    size_t _fecProtected;       // Longest payload so far
+    uint8_t _fecPayload[RTP_PACKET_BYTES];
+
+    JpegInfo _info;             // Last frame's headers
+
+    uint32_t _framesSent;
+    uint32_t _framesSkipped;
+    uint32_t _sendFailures;
+    uint32_t _packetsDropped;
+
+    // What the receiver last reported
+    CallbackMetric _metricVideoLost;
+    CallbackMetric _metricAudioLost;
+    CallbackMetric _metricVideoJitter;
+    CallbackMetric _metricAudioJitter;
+    CallbackMetric _metricVideoRtt;
+    CallbackMetric _metricAudioRtt;
+
+    bool describe(const uint8_t* jpeg, size_t len, uint8_t& type);
+    bool sendPacket(RtpStream& stream, uint8_t payloadType, uint32_t timestamp, bool marker,
+                    const uint8_t* head, size_t headLen, const uint8_t* body, size_t bodyLen);
+    bool transmit(int fd, uint16_t port, const void* head, size_t headLen, const void* body, size_t bodyLen);
+
+    void protect(const uint8_t* rtpHeader, const uint8_t* head, size_t headLen, const uint8_t* body,
+                 size_t bodyLen);
+    void flushFec();
+
+    void service();
+    void sendReport(RtpStream& stream);
+    void readReports();
+};
+
+#endif // RTP_SENDER_H
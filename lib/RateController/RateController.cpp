@@ -0,0 +1,185 @@
+#include <math.h>
+#include "RateController.h"
+
+// Slope limits and the OV2640's typical value (size roughly halves every
+// 12 quality steps)
+static const float kSlopeDefault = 0.058f;
+static const float kSlopeMin = 0.02f;
+static const float kSlopeMax = 0.25f;
+
+// Slope fit: least squares over quality steps with exponential forgetting,
+// seeded with the default slope as if it had been seen over this many unit
+// steps. The prior matters because the loop is closed: quality goes up right
+// after big frames, so scene changes leak into the observations.
+static const float kSlopeForget = 0.99f;
+static const float kSlopePrior = 16.0f;
+
+// Single observations are clamped around the current estimate (symmetrically,
+// so the clamp itself does not bias the fit)
+static const float kSlopeMaxError = 0.1f;
+
+// Smoothing for the complexity estimate, and how far (in ln bytes) a frame
+// may land from the prediction and still count as a steady scene
+static const float kComplexityRate = 0.5f;
+static const float kSteadyLogError = 0.15f;
+
+// Bucket: overshoot is paid back over this many frames, and the bucket is
+// clamped so a long quiet scene cannot bank unlimited credit
+static const int32_t kPaybackFrames = 8;
+static const int32_t kMaxCreditFrames = 2;
+static const int32_t kMaxDebtFrames = 8;
+
+// Largest quality change per frame: up quickly to absorb bursts, down slowly
+// to avoid oscillating. The dead band keeps frame-to-frame noise from
+// touching the sensor register.
+static const int kMaxStepUp = 4;
+static const int kMaxStepDown = 2;
+static const float kDeadBand = 0.75f;
+
+RateController::RateController()
+    : _target(0)
+    , _minQuality(0)
+    , _maxQuality(63)
+    , _quality(12)
+    , _latency(1)
+    , _head(0)
+    , _slope(kSlopeDefault)
+    , _slopeSxx(kSlopePrior)
+    , _slopeSxy(kSlopePrior * kSlopeDefault)
+    , _logComplexity(0.0f)
+    , _lastLogSize(0.0f)
+    , _lastSurprise(0.0f)
+    , _lastFrameQuality(0)
+    , _primed(false)
+    , _bucket(0)
+    , _frameCount(0)
+    , _qualityChanges(0)
+    , _peakBytes(0)
+    , _totalBytes(0)
+{
+    for (int i = 0; i < RATE_CONTROL_HISTORY; i++) {
+        _history[i] = _quality;
+    }
+}
+
+void RateController::begin(uint32_t targetBytes, uint8_t minQuality, uint8_t maxQuality,
+                           uint8_t initialQuality) {
+    _target = targetBytes > 0 ? targetBytes : 1;
+    _minQuality = minQuality;
+    _maxQuality = maxQuality > minQuality ? maxQuality : minQuality;
+    _quality = initialQuality < _minQuality ? _minQuality :
+               (initialQuality > _maxQuality ? _maxQuality : initialQuality);
+
+    for (int i = 0; i < RATE_CONTROL_HISTORY; i++) {
+        _history[i] = _quality;
+    }
+    _head = 0;
+    _slope = kSlopeDefault;
+    _slopeSxx = kSlopePrior;
+    _slopeSxy = kSlopePrior * kSlopeDefault;
+    _primed = false;
+    _bucket = 0;
+    _frameCount = 0;
+    _qualityChanges = 0;
+    _peakBytes = 0;
+    _totalBytes = 0;
+}
+
+void RateController::setLatency(uint8_t frames) {
+    _latency = frames < RATE_CONTROL_HISTORY ? frames : RATE_CONTROL_HISTORY - 1;
+}
+
+uint8_t RateController::frameQuality() const {
+    return _history[(_head + RATE_CONTROL_HISTORY - _latency) % RATE_CONTROL_HISTORY];
+}
+
+uint8_t RateController::update(size_t frameBytes) {
+    if (frameBytes == 0) {
+        return _quality;
+    }
+
+    uint8_t q = frameQuality();
+    float logSize = logf((float)frameBytes);
+
+    // Two frames at different qualities give a slope measurement, weighted
+    // by the step squared (larger steps are less confounded by noise). Steps
+    // taken in reaction to an unexpected frame are skipped: the next frame
+    // regresses to the scene's usual size whatever the quality, which would
+    // read as a steep slope.
+    if (_primed && q != _lastFrameQuality && fabsf(_lastSurprise) < kSteadyLogError) {
+        float dq = (float)q - (float)_lastFrameQuality;
+        float observed = (_lastLogSize - logSize) / dq;
+        if (observed < _slope - kSlopeMaxError) observed = _slope - kSlopeMaxError;
+        if (observed > _slope + kSlopeMaxError) observed = _slope + kSlopeMaxError;
+        _slopeSxx = kSlopeForget * _slopeSxx + dq * dq;
+        _slopeSxy = kSlopeForget * _slopeSxy + dq * dq * observed;
+        _slope = _slopeSxy / _slopeSxx;
+        if (_slope < kSlopeMin) _slope = kSlopeMin;
+        if (_slope > kSlopeMax) _slope = kSlopeMax;
+    }
+
+    // Complexity is what this frame would have been at quality 0
+    float logComplexity = logSize + _slope * (float)q;
+    if (_primed) {
+        _lastSurprise = logComplexity - _logComplexity;
+        _logComplexity += kComplexityRate * _lastSurprise;
+    } else {
+        _lastSurprise = 0.0f;
+        _logComplexity = logComplexity;
+    }
+    _lastLogSize = logSize;
+    _lastFrameQuality = q;
+    _primed = true;
+
+    int32_t target = (int32_t)_target;
+    _bucket += (int32_t)frameBytes - target;
+    if (_bucket < -kMaxCreditFrames * target) _bucket = -kMaxCreditFrames * target;
+    if (_bucket > kMaxDebtFrames * target) _bucket = kMaxDebtFrames * target;
+
+    uint8_t next = chooseQuality();
+    if (next != _quality) {
+        _quality = next;
+        _qualityChanges++;
+    }
+    _head = (_head + 1) % RATE_CONTROL_HISTORY;
+    _history[_head] = _quality;
+
+    _frameCount++;
+    _totalBytes += frameBytes;
+    if (frameBytes > _peakBytes) {
+        _peakBytes = frameBytes;
+    }
+
+    return _quality;
+}
+
+uint8_t RateController::chooseQuality() const {
+    // Aim below the budget while paying back earlier overshoot
+    float budget = (float)_target - (float)_bucket / (float)kPaybackFrames;
+    float lowest = (float)_target / 4.0f;
+    float highest = (float)_target * 2.0f;
+    if (budget < lowest) budget = lowest;
+    if (budget > highest) budget = highest;
+
+    float desired = (_logComplexity - logf(budget)) / _slope;
+
+    int q = _quality;
+    if (fabsf(desired - (float)q) > kDeadBand) {
+        int step = (int)lroundf(desired) - q;
+        if (step > kMaxStepUp) step = kMaxStepUp;
+        if (step < -kMaxStepDown) step = -kMaxStepDown;
+        q += step;
+    }
+
+    if (q < _minQuality) q = _minQuality;
+    if (q > _maxQuality) q = _maxQuality;
+    return (uint8_t)q;
+}
+
+float RateController::getComplexity() const {
+    return _primed ? expf(_logComplexity) : 0.0f;
+}
+
+float RateController::getAverageFrameBytes() const {
+    return _frameCount > 0 ? (float)_totalBytes / (float)_frameCount : 0.0f;
+}
@@ -0,0 +1,82 @@
+#ifndef RATE_CONTROLLER_H
+#define RATE_CONTROLLER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Per-frame JPEG quality controller that keeps frame sizes near a byte budget.
+//
+// Frame size is modelled as size = C * exp(-k * q), where q is the OV2640
+// quality setting (0-63, higher = smaller), C tracks scene complexity and k
+// the size/quality slope. Every captured frame updates C; consecutive frames
+// taken at different qualities refine k. The next quality is the one the
+// model predicts will hit the target, corrected by a leaky bucket of bytes
+// sent over budget so bursts are paid back over the following frames.
+//
+// Quality is raised quickly (smaller frames) and lowered gradually, and the controller accounts for the frame of latency between setting the
+// sensor register and seeing its effect in fb->len.
+
+#define RATE_CONTROL_HISTORY    4
+
+class RateController {
+public:
+    RateController();
+
+    // Byte budget per frame, allowed quality range and starting quality
+    void begin(uint32_t targetBytes, uint8_t minQuality, uint8_t maxQuality,
+               uint8_t initialQuality);
+
+    void setTarget(uint32_t targetBytes) { _target = targetBytes; }
+
+    // Frames between setQuality() and the first frame captured with it
+    void setLatency(uint8_t frames);
+
+    // Feed the size of each captured frame; returns the quality to apply.
+    // Only call CameraCapture::setQuality() when this differs from the last.
+    uint8_t update(size_t frameBytes);
+
+    // State
+    uint8_t getQuality() const { return _quality; }
+    uint32_t getTarget() const { return _target; }
+    float getSlope() const { return _slope; }
+    float getComplexity() const;            // Predicted bytes at quality 0
+    int32_t getBucket() const { return _bucket; }
+
+    // Statistics
+    uint32_t getFrameCount() const { return _frameCount; }
+    uint32_t getQualityChanges() const { return _qualityChanges; }
+    uint32_t getPeakFrameBytes() const { return _peakBytes; }
+    float getAverageFrameBytes() const;
+
+private:
+    uint32_t _target;
+    uint8_t _minQuality;
+    uint8_t _maxQuality;
+    uint8_t _quality;
+    uint8_t _latency;
+
+    // Qualities applied for the most recent frames (ring, newest at _head)
+    uint8_t _history[RATE_CONTROL_HISTORY];
+    uint8_t _head;
+
+    float _slope;               // k: d ln(size) / d quality (negated)
+    float _slopeSxx;            // Weighted least-squares sums for k
+    float _slopeSxy;
+    float _logComplexity;       // ln C
+    float _lastLogSize;
+    float _lastSurprise;        // ln(size) error of the last frame vs the model
+    uint8_t _lastFrameQuality;
+    bool _primed;
+
+    int32_t _bucket;            // Bytes sent above budget (negative = credit)
+
+    uint32_t _frameCount;
+    uint32_t _qualityChanges;
+    uint32_t _peakBytes;
+    uint64_t _totalBytes;
+
+    uint8_t frameQuality() const;
+    uint8_t chooseQuality() const;
+};
+
+#endif // RATE_CONTROLLER_H
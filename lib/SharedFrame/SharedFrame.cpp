@@ -0,0 +1,195 @@
+#include <Arduino.h>
+#include "SharedFrame.h"
+
+// ============================================================================
+// SharedFrame
+// ============================================================================
+
+void SharedFrame::retain() {
+    _refs.fetch_add(1, std::memory_order_relaxed);
+}
+
+void SharedFrame::release() {
+    // acq_rel: every consumer's reads of the buffer happen before the recycle
+    if (_refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        _pool->recycle(this);
+    }
+}
+
+// ============================================================================
+// FrameRef
+// ============================================================================
+
+FrameRef::FrameRef(const FrameRef& other) : _frame(other._frame) {
+    if (_frame) {
+        _frame->retain();
+    }
+}
+
+FrameRef& FrameRef::operator=(const FrameRef& other) {
+    if (this != &other) {
+        if (other._frame) {
+            other._frame->retain();
+        }
+        reset();
+        _frame = other._frame;
+    }
+    return *this;
+}
+
+FrameRef& FrameRef::operator=(FrameRef&& other) {
+    if (this != &other) {
+        reset();
+        _frame = other._frame;
+        other._frame = nullptr;
+    }
+    return *this;
+}
+
+void FrameRef::reset() {
+    if (_frame) {
+        _frame->release();
+        _frame = nullptr;
+    }
+}
+
+SharedFrame* FrameRef::share() const {
+    if (_frame) {
+        _frame->retain();
+    }
+    return _frame;
+}
+
+SharedFrame* FrameRef::take() {
+    SharedFrame* frame = _frame;
+    _frame = nullptr;
+    return frame;
+}
+
+// ============================================================================
+// FramePool
+// ============================================================================
+
+FramePool::FramePool(ReturnFunction returnFrame)
+    : _returnFrame(returnFrame)
+    , _live(0)
+    , _liveCopies(0)
+    , _wrapped(0)
+    , _returned(0)
+    , _copies(0)
+    , _failures(0)
+{
+    for (int i = 0; i < FRAME_POOL_SIZE; i++) {
+        memset(&_slots[i]._view, 0, sizeof(_slots[i]._view));
+        _slots[i]._driverFrame = nullptr;
+        _slots[i]._pool = this;
+        _slots[i]._sequence = 0;
+        _slots[i]._refs.store(0, std::memory_order_relaxed);
+        _slots[i]._inUse.store(false, std::memory_order_relaxed);
+    }
+}
+
+SharedFrame* FramePool::acquireSlot() {
+    for (int i = 0; i < FRAME_POOL_SIZE; i++) {
+        bool expected = false;
+        if (!_slots[i]._inUse.load(std::memory_order_relaxed) &&
+            _slots[i]._inUse.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+            return &_slots[i];
+        }
+    }
+    _failures.fetch_add(1, std::memory_order_relaxed);
+    return nullptr;
+}
+
+SharedFrame* FramePool::wrap(camera_fb_t* fb) {
+    if (!fb) {
+        return nullptr;
+    }
+
+    SharedFrame* frame = acquireSlot();
+    if (!frame) {
+        _returnFrame(fb);
+        return nullptr;
+    }
+
+    frame->_view = *fb;
+    frame->_driverFrame = fb;
+    frame->_sequence = _wrapped.fetch_add(1, std::memory_order_relaxed);
+    frame->_refs.store(1, std::memory_order_relaxed);
+
+    _live.fetch_add(1, std::memory_order_relaxed);
+    return frame;
+}
+
+SharedFrame* FramePool::copy(const SharedFrame* source) {
+    if (!source) {
+        return nullptr;
+    }
+
+    SharedFrame* frame = allocate(source, source->_view.len);
+    if (frame) {
+        memcpy(frame->_view.buf, source->_view.buf, source->_view.len);
+        frame->_view.len = source->_view.len;
+    }
+    return frame;
+}
+
+SharedFrame* FramePool::allocate(const SharedFrame* source, size_t capacity) {
+    if (!source) {
+        return nullptr;
+    }
+
+    uint8_t* buffer = (uint8_t*)ps_malloc(capacity);
+    if (!buffer) {
+        _failures.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    SharedFrame* frame = acquireSlot();
+    if (!frame) {
+        free(buffer);
+        return nullptr;
+    }
+
+    frame->_view = source->_view;
+    frame->_view.buf = buffer;
+    frame->_view.len = 0;
+    frame->_driverFrame = nullptr;
+    frame->_sequence = source->_sequence;
+    frame->_refs.store(1, std::memory_order_relaxed);
+
+    _copies.fetch_add(1, std::memory_order_relaxed);
+    _live.fetch_add(1, std::memory_order_relaxed);
+    _liveCopies.fetch_add(1, std::memory_order_relaxed);
+    return frame;
+}
+
+SharedFrame* FramePool::detach(SharedFrame* frame) {
+    if (!frame || frame->isCopy()) {
+        return frame;
+    }
+
+    SharedFrame* copied = copy(frame);
+    if (copied) {
+        frame->release();
+    }
+    return copied;
+}
+
+void FramePool::recycle(SharedFrame* frame) {
+    if (frame->_driverFrame) {
+        _returnFrame(frame->_driverFrame);
+        _returned.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        free(frame->_view.buf);
+        _liveCopies.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    frame->_driverFrame = nullptr;
+    frame->_view.buf = nullptr;
+    frame->_view.len = 0;
+    _live.fetch_sub(1, std::memory_order_relaxed);
+
+    // Publish the cleared slot to the next acquireSlot()
+    frame->_inUse.store(false, std::memory_order_release);
+}
@@ -0,0 +1,138 @@
+#ifndef SHARED_FRAME_H
+#define SHARED_FRAME_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include "esp_camera.h"
+
+// Reference-counted camera frames for fanning one capture out to several
+// consumers (streaming, recording, inference, viewers) without copying.
+//
+// A SharedFrame wraps a driver frame buffer and returns it to the driver when
+// the last reference is dropped, on whichever core that happens. Consumers
+// that need to hold a frame for long (pre-roll, slow uploads) detach() it
+// into a private PSRAM copy so the driver gets its buffer back early.
+//
+// Frames live in a fixed pool of slots, so retaining and releasing never
+// allocates or locks. Raw SharedFrame pointers carry one reference each and
+// can go through FreeRTOS queues; FrameRef is the RAII holder for code.
+
+#define FRAME_POOL_SIZE     20      // Driver buffers in flight plus PSRAM copies (up to five per RTMP destination)
+
+class FramePool;
+
+class SharedFrame {
+public:
+    // Frame as the rest of the firmware sees it (buf points at the driver
+    // buffer or the PSRAM copy)
+    camera_fb_t* fb() { return &_view; }
+    const uint8_t* data() const { return _view.buf; }
+    size_t length() const { return _view.len; }
+
+    // True for PSRAM copies, false while backed by the driver buffer
+    bool isCopy() const { return _driverFrame == nullptr; }
+    uint32_t refs() const { return _refs.load(std::memory_order_relaxed); }
+
+    // Capture order, assigned by wrap() and kept by copies; gaps mean frames
+    // were dropped downstream
+    uint32_t sequence() const { return _sequence; }
+
+    // Add or drop a reference (the last release recycles the frame)
+    void retain();
+    void release();
+
+private:
+    friend class FramePool;
+
+    camera_fb_t _view;
+    camera_fb_t* _driverFrame;
+    FramePool* _pool;
+    uint32_t _sequence;
+    std::atomic<uint32_t> _refs;
+    std::atomic<bool> _inUse;
+};
+
+// Owns one reference; copying retains, destruction releases
+class FrameRef {
+public:
+    FrameRef() : _frame(nullptr) {}
+    explicit FrameRef(SharedFrame* frame) : _frame(frame) {}   // Adopts a reference
+    FrameRef(const FrameRef& other);
+    FrameRef(FrameRef&& other) : _frame(other._frame) { other._frame = nullptr; }
+    ~FrameRef() { reset(); }
+
+    FrameRef& operator=(const FrameRef& other);
+    FrameRef& operator=(FrameRef&& other);
+
+    SharedFrame* get() const { return _frame; }
+    SharedFrame* operator->() const { return _frame; }
+    explicit operator bool() const { return _frame != nullptr; }
+
+    // Drop the reference now
+    void reset();
+
+    // New reference for a queue or another task (caller must release it)
+    SharedFrame* share() const;
+
+    // Hand this reference to the caller and empty the holder
+    SharedFrame* take();
+
+private:
+    SharedFrame* _frame;
+};
+
+class FramePool {
+public:
+    // Called with the driver frame when its last reference drops
+    typedef void (*ReturnFunction)(camera_fb_t* fb);
+
+    explicit FramePool(ReturnFunction returnFrame = esp_camera_fb_return);
+
+    // Take ownership of a driver frame; returns it with one reference. If the
+    // pool is exhausted the frame goes straight back to the driver and
+    // nullptr is returned.
+    SharedFrame* wrap(camera_fb_t* fb);
+
+    // New PSRAM copy of a frame, with one reference (nullptr if out of
+    // memory or slots)
+    SharedFrame* copy(const SharedFrame* frame);
+
+    // New PSRAM frame with room for capacity bytes and the same description
+    // (timestamp, size, sequence) as frame, for a derived version such as
+    // the OSD output. The caller fills fb()->buf and sets fb()->len.
+    SharedFrame* allocate(const SharedFrame* frame, size_t capacity);
+
+    // Trade a reference on a driver-backed frame for a private PSRAM copy.
+    // Copies are returned as they are. On failure the caller keeps its
+    // original reference and nullptr is returned.
+    SharedFrame* detach(SharedFrame* frame);
+
+    // Leak accounting: frames and copies currently referenced
+    uint32_t getLiveFrames() const { return _live.load(std::memory_order_relaxed); }
+    uint32_t getLiveCopies() const { return _liveCopies.load(std::memory_order_relaxed); }
+
+    // Statistics
+    uint32_t getWrapped() const { return _wrapped.load(std::memory_order_relaxed); }
+    uint32_t getReturned() const { return _returned.load(std::memory_order_relaxed); }
+    uint32_t getCopies() const { return _copies.load(std::memory_order_relaxed); }
+    uint32_t getFailures() const { return _failures.load(std::memory_order_relaxed); }
+
+private:
+    friend class SharedFrame;
+
+    SharedFrame _slots[FRAME_POOL_SIZE];
+    ReturnFunction _returnFrame;
+
+    std::atomic<uint32_t> _live;
+    std::atomic<uint32_t> _liveCopies;
+    std::atomic<uint32_t> _wrapped;
+    std::atomic<uint32_t> _returned;
+    std::atomic<uint32_t> _copies;
+    std::atomic<uint32_t> _failures;    // Pool exhausted or PSRAM allocation failed
+
+    SharedFrame* acquireSlot();
+    void recycle(SharedFrame* frame);
+};
+
+#endif // SHARED_FRAME_H
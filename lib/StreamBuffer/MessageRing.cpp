@@ -0,0 +1,121 @@
+#include "MessageRing.h"
+#include <Arduino.h>
+#include <string.h>
+
+struct RecordHeader {
+    uint32_t length;
+    uint32_t timestamp;
+    uint8_t type;
+    uint8_t reserved[3];
+};
+
+// Records start on 4-byte boundaries
+static size_t recordSize(size_t length) {
+    return (sizeof(RecordHeader) + length + 3) & ~(size_t)3;
+}
+
+MessageRing::MessageRing()
+    : _buffer(nullptr)
+    , _capacity(0)
+    , _head(0)
+    , _tail(0)
+    , _end(0)
+    , _wrapped(false)
+    , _count(0)
+    , _bytes(0)
+{
+}
+
+MessageRing::~MessageRing() {
+    free(_buffer);
+}
+
+bool MessageRing::begin(size_t capacity) {
+    end();
+    capacity &= ~(size_t)3;
+    if (capacity == 0) {
+        return true;
+    }
+    _buffer = (uint8_t*)ps_malloc(capacity);
+    if (!_buffer) {
+        return false;
+    }
+    _capacity = capacity;
+    return true;
+}
+
+void MessageRing::end() {
+    free(_buffer);
+    _buffer = nullptr;
+    _capacity = 0;
+    _head = _tail = _end = 0;
+    _wrapped = false;
+    _count = 0;
+    _bytes = 0;
+}
+
+bool MessageRing::canHold(size_t length) const {
+    return _buffer && recordSize(length) <= _capacity;
+}
+
+bool MessageRing::append(uint8_t type, uint32_t timestamp, const uint8_t* data, size_t length) {
+    size_t size = recordSize(length);
+    if (!_buffer) {
+        return false;
+    }
+    if (_count == 0) {
+        _head = _tail = _end = 0;
+        _wrapped = false;
+    }
+
+    // The gap is either after the tail (up to the end of the block, or up
+    // to the head once wrapped) or, by wrapping now, before the head
+    if (!_wrapped) {
+        if (_capacity - _tail < size) {
+            if (_head < size) {
+                return false;
+            }
+            _end = _tail;
+            _tail = 0;
+            _wrapped = true;
+        }
+    } else if (_head - _tail < size) {
+        return false;
+    }
+
+    RecordHeader* header = (RecordHeader*)(_buffer + _tail);
+    header->length = (uint32_t)length;
+    header->timestamp = timestamp;
+    header->type = type;
+    memcpy(_buffer + _tail + sizeof(RecordHeader), data, length);
+    _tail += size;
+    _count++;
+    _bytes += length;
+    return true;
+}
+
+bool MessageRing::front(StreamMessage& message) const {
+    if (_count == 0) {
+        return false;
+    }
+    const RecordHeader* header = (const RecordHeader*)(_buffer + _head);
+    message.type = header->type;
+    message.timestamp = header->timestamp;
+    message.data = _buffer + _head + sizeof(RecordHeader);
+    message.length = header->length;
+    return true;
+}
+
+void MessageRing::removeOldest() {
+    if (_count == 0) {
+        return;
+    }
+    const RecordHeader* header = (const RecordHeader*)(_buffer + _head);
+    _bytes -= header->length;
+    _head += recordSize(header->length);
+    _count--;
+    if (_wrapped && _head == _end) {
+        _head = 0;
+        _wrapped = false;
+    }
+}
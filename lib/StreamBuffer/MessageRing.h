@@ -0,0 +1,64 @@
+#ifndef MESSAGE_RING_H
+#define MESSAGE_RING_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// First-in first-out ring of timestamped audio and video messages in one
+// PSRAM block, shared by StreamBuffer (store-and-forward) and FlvRecorder
+// (pre-roll and write-behind).
+//
+// Messages are stored contiguously (a record that does not fit before the
+// end of the block starts again at the front), so readers use each payload
+// in place until it is removed. The ring never evicts by itself: append()
+// fails when there is no gap and the owner decides whether to make room
+// with removeOldest() or to drop the new message. There is no locking;
+// each owner says which tasks may touch its ring.
+
+#define STREAM_MESSAGE_AUDIO    8       // RTMP message / FLV tag types
+#define STREAM_MESSAGE_VIDEO    9
+
+struct StreamMessage {
+    uint8_t type;
+    uint32_t timestamp;         // Stream milliseconds
+    const uint8_t* data;        // Points into the ring until removed
+    size_t length;
+};
+
+class MessageRing {
+public:
+    MessageRing();
+    ~MessageRing();
+
+    // Allocate capacity bytes of PSRAM, dropping anything held (0 frees it)
+    bool begin(size_t capacity);
+    void end();
+    bool isAllocated() const { return _buffer != nullptr; }
+
+    // A message of this length fits in the ring once it is empty
+    bool canHold(size_t length) const;
+
+    // Copy a message in if there is a contiguous gap for it right now
+    bool append(uint8_t type, uint32_t timestamp, const uint8_t* data, size_t length);
+
+    // Oldest message; false when empty
+    bool front(StreamMessage& message) const;
+    void removeOldest();
+
+    bool isEmpty() const { return _count == 0; }
+    uint32_t getCount() const { return _count; }
+    size_t getBytes() const { return _bytes; }
+    size_t getCapacity() const { return _capacity; }
+
+private:
+    uint8_t* _buffer;
+    size_t _capacity;
+    size_t _head;               // Oldest record
+    size_t _tail;               // Next record goes here
+    size_t _end;                // While wrapped: where the records before the front end
+    bool _wrapped;              // Tail has started again at the front
+    uint32_t _count;
+    size_t _bytes;              // Payload bytes held
+};
+
+#endif // MESSAGE_RING_H
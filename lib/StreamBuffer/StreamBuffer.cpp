@@ -0,0 +1,94 @@
+#include "StreamBuffer.h"
+#include <Arduino.h>
+#include <Logger.h>
+#include <Metrics.h>
+
+static Counter metricStored("stream_buffer_stored_total", "Messages held back while the stream was down or catching up");
+static Counter metricForwarded("stream_buffer_forwarded_total", "Held messages sent after all");
+static Counter metricForwardedBytes("stream_buffer_forwarded_bytes_total", "Payload bytes of held messages sent after all");
+static Counter metricEvicted("stream_buffer_evicted_total", "Held messages overwritten before they could be sent");
+static Counter metricEvictedBytes("stream_buffer_evicted_bytes_total", "Payload bytes of held messages overwritten");
+
+StreamBuffer::StreamBuffer()
+    : _newestTimestamp(0)
+    , _speed(0.0f)
+    , _pacing(false)
+    , _paceStartMs(0)
+    , _paceStartTimestamp(0)
+    , _stored(0)
+    , _forwarded(0)
+    , _evicted(0)
+{
+}
+
+bool StreamBuffer::begin(size_t capacity) {
+    _pacing = false;
+    if (!_ring.begin(capacity)) {
+        LOG_E("StreamBuffer: Cannot allocate %u KB", (unsigned)(capacity / 1024));
+        return false;
+    }
+    if (!_ring.isAllocated()) {
+        return true;
+    }
+    LOG_I("StreamBuffer: %u KB for store-and-forward", (unsigned)(capacity / 1024));
+    return true;
+}
+
+bool StreamBuffer::push(uint8_t type, uint32_t timestamp, const uint8_t* data, size_t length) {
+    if (!_ring.canHold(length)) {
+        return false;
+    }
+
+    // Evict from the front until there is a contiguous gap
+    StreamMessage oldest;
+    while (!_ring.append(type, timestamp, data, length) && _ring.front(oldest)) {
+        _evicted++;
+        metricEvicted.inc();
+        metricEvictedBytes.inc(oldest.length);
+        _ring.removeOldest();
+    }
+    _newestTimestamp = timestamp;
+    _stored++;
+    metricStored.inc();
+    return true;
+}
+
+bool StreamBuffer::due(uint32_t nowMs, StreamMessage& message) {
+    if (!_ring.front(message)) {
+        _pacing = false;
+        return false;
+    }
+
+    // Media time may run ahead of wall time by the catch-up speed, counted
+    // from the first message of this drain
+    if (!_pacing) {
+        _pacing = true;
+        _paceStartMs = nowMs;
+        _paceStartTimestamp = message.timestamp;
+    }
+    int32_t mediaMs = (int32_t)(message.timestamp - _paceStartTimestamp);
+    if (_speed > 0.0f && mediaMs > 0 && (float)mediaMs > (float)(nowMs - _paceStartMs) * _speed) {
+        return false;
+    }
+    return true;
+}
+
+void StreamBuffer::pop() {
+    StreamMessage message;
+    if (!_ring.front(message)) {
+        return;
+    }
+    _forwarded++;
+    metricForwarded.inc();
+    metricForwardedBytes.inc(message.length);
+    _ring.removeOldest();
+}
+
+uint32_t StreamBuffer::getBacklogMs() const {
+    StreamMessage oldest;
+    if (!_ring.front(oldest)) {
+        return 0;
+    }
+    int32_t span = (int32_t)(_newestTimestamp - oldest.timestamp);
+    return span > 0 ? (uint32_t)span : 0;
+}
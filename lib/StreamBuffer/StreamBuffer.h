@@ -0,0 +1,73 @@
+#ifndef STREAM_BUFFER_H
+#define STREAM_BUFFER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "MessageRing.h"
+
+// Store-and-forward ring for encoded audio and video messages, one per
+// RTMP destination (RTMPFanout).
+//
+// While the destination's connection is down (or still catching up) its
+// task pushes what it would have sent, with its original timestamp, into
+// one PSRAM block. When the ring is full the oldest messages are evicted,
+// so it always holds the most recent window. After a reconnect the backlog
+// is sent oldest first, paced at up to setCatchUpSpeed() times real time so
+// the uplink is not flooded, while new messages queue behind it until it
+// has caught up with live.
+//
+// The messages live in a MessageRing, so the sender reads each payload in
+// place until pop(). Each ring belongs to its destination's task, the only
+// one that pushes, sends and pops, so there is no locking. The health log
+// and the metrics page read the getters from other tasks; those figures
+// are only approximate while the destination is changing the ring.
+
+class StreamBuffer {
+public:
+    StreamBuffer();
+
+    // Allocate capacity bytes of PSRAM (0 leaves store-and-forward off)
+    bool begin(size_t capacity);
+    bool isEnabled() const { return _ring.isAllocated(); }
+
+    // Backlog drains at up to this multiple of real time (0: unlimited)
+    void setCatchUpSpeed(float speed) { _speed = speed; }
+
+    // Copy a message in, evicting the oldest ones to make room. False when
+    // it cannot be held at all (disabled, or larger than the ring).
+    bool push(uint8_t type, uint32_t timestamp, const uint8_t* data, size_t length);
+
+    // Oldest message, if the catch-up pacing lets it go at nowMs
+    bool due(uint32_t nowMs, StreamMessage& message);
+    // Remove the message due() returned, once it has been sent
+    void pop();
+
+    // Start the pacing clock again with the next due() (after a drop)
+    void resetPacing() { _pacing = false; }
+
+    bool isEmpty() const { return _ring.isEmpty(); }
+    uint32_t getCount() const { return _ring.getCount(); }
+    size_t getBytes() const { return _ring.getBytes(); }
+    size_t getCapacity() const { return _ring.getCapacity(); }
+    uint32_t getBacklogMs() const;      // Newest minus oldest timestamp
+
+    // Statistics
+    uint32_t getStored() const { return _stored; }
+    uint32_t getForwarded() const { return _forwarded; }
+    uint32_t getEvicted() const { return _evicted; }
+
+private:
+    MessageRing _ring;
+    uint32_t _newestTimestamp;
+
+    float _speed;
+    bool _pacing;
+    uint32_t _paceStartMs;
+    uint32_t _paceStartTimestamp;
+
+    uint32_t _stored;
+    uint32_t _forwarded;
+    uint32_t _evicted;
+};
+
+#endif // STREAM_BUFFER_H
@@ -0,0 +1,232 @@
+#include <string.h>
+#include <math.h>
+#include <JpegCodec.h>
+#include "SyntheticJpeg.h"
+
+// ITU T.81 Annex K.1 luminance quantisation table (natural order)
+static const uint8_t kLumaQuant[64] = {
+    16, 11, 10, 16,  24,  40,  51,  61,
+    12, 12, 14, 19,  26,  58,  60,  55,
+    14, 13, 16, 24,  40,  57,  69,  56,
+    14, 17, 22, 29,  51,  87,  80,  62,
+    18, 22, 37, 56,  68, 109, 103,  77,
+    24, 35, 55, 64,  81, 104, 113,  92,
+    49, 64, 78, 87, 103, 121, 120, 101,
+    72, 92, 95, 98, 112, 100, 103,  99
+};
+
+// Annex K.3 luminance Huffman tables
+static const uint8_t kDcBits[16] = { 0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0 };
+static const uint8_t kDcVals[12] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 };
+static const uint8_t kAcBits[16] = { 0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7D };
+static const uint8_t kAcVals[162] = {
+    0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+    0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xA1, 0x08, 0x23, 0x42, 0xB1, 0xC1, 0x15, 0x52, 0xD1, 0xF0,
+    0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0A, 0x16, 0x17, 0x18, 0x19, 0x1A, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2A, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+    0x4A, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5A, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+    0x6A, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+    0x8A, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A, 0xA2, 0xA3, 0xA4, 0xA5, 0xA6, 0xA7,
+    0xA8, 0xA9, 0xAA, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA, 0xC2, 0xC3, 0xC4, 0xC5,
+    0xC6, 0xC7, 0xC8, 0xC9, 0xCA, 0xD2, 0xD3, 0xD4, 0xD5, 0xD6, 0xD7, 0xD8, 0xD9, 0xDA, 0xE1, 0xE2,
+    0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA, 0xF1, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8,
+    0xF9, 0xFA
+};
+
+static JpegHuffTable dcTable;
+static JpegHuffTable acTable;
+static bool tablesReady = false;
+
+static void buildTable(JpegHuffTable& table, const uint8_t* bits, const uint8_t* vals, uint16_t count) {
+    memset(&table, 0, sizeof(table));
+    memcpy(table.bits + 1, bits, 16);
+    memcpy(table.vals, vals, count);
+    table.count = count;
+    table.present = true;
+    table.build();
+}
+
+static void putMarkerSegment(std::vector<uint8_t>& out, uint8_t marker, const uint8_t* data, size_t len) {
+    out.push_back(0xFF);
+    out.push_back(marker);
+    out.push_back((uint8_t)((len + 2) >> 8));
+    out.push_back((uint8_t)(len + 2));
+    out.insert(out.end(), data, data + len);
+}
+
+SyntheticJpeg::SyntheticJpeg()
+    : _width(0)
+    , _height(0)
+    , _quality(0)
+    , _colour(false)
+    , _restartInterval(0)
+{
+    if (!tablesReady) {
+        buildTable(dcTable, kDcBits, kDcVals, sizeof(kDcVals));
+        buildTable(acTable, kAcBits, kAcVals, sizeof(kAcVals));
+        tablesReady = true;
+    }
+    begin(320, 240, 12);
+}
+
+void SyntheticJpeg::begin(uint16_t width, uint16_t height, uint8_t quality, bool colour) {
+    const int mcuWidth = colour ? 16 : 8;
+    _colour = colour;
+    _width = (uint16_t)((width + mcuWidth - 1) & ~(mcuWidth - 1));
+    _height = (uint16_t)((height + 7) & ~7);
+    _pixels.assign((size_t)_width * _height, 0);
+    for (int c = 0; c < 2; c++) {
+        _chroma[c].assign(colour ? (size_t)(_width / 2) * _height : 0, 128);
+    }
+    setQuality(quality);
+}
+
+void SyntheticJpeg::setQuality(uint8_t quality) {
+    _quality = quality > 63 ? 63 : quality;
+
+    // Map the sensor's 0-63 scale onto IJG quality, then scale Annex K
+    int ijg = 100 - _quality * 3 / 2;
+    if (ijg < 5) ijg = 5;
+    if (ijg > 95) ijg = 95;
+    int scale = ijg < 50 ? 5000 / ijg : 200 - ijg * 2;
+
+    for (int i = 0; i < 64; i++) {
+        int q = (kLumaQuant[kJpegZigzag[i]] * scale + 50) / 100;
+        _quant[i] = (uint16_t)(q < 1 ? 1 : (q > 255 ? 255 : q));
+    }
+}
+
+// Diagonal bars drifting across a gradient, a bouncing bright square and a
+// little noise, so both detail and motion change from frame to frame
+void SyntheticJpeg::render(uint32_t frameIndex) {
+    uint32_t noise = frameIndex * 2654435761u + 1;
+    int boxSize = _height / 4;
+    int travelX = _width - boxSize;
+    int travelY = _height - boxSize;
+    int phaseX = (int)(frameIndex * 3 % (uint32_t)(2 * travelX));
+    int phaseY = (int)(frameIndex * 2 % (uint32_t)(2 * travelY));
+    int boxX = phaseX < travelX ? phaseX : 2 * travelX - phaseX;
+    int boxY = phaseY < travelY ? phaseY : 2 * travelY - phaseY;
+
+    for (int y = 0; y < _height; y++) {
+        uint8_t* row = &_pixels[(size_t)y * _width];
+        for (int x = 0; x < _width; x++) {
+            int value = (x * 160) / _width + 40;
+            if (((x + y + (int)frameIndex * 2) / 12) % 4 == 0) {
+                value += 50;
+            }
+            if (x >= boxX && x < boxX + boxSize && y >= boxY && y < boxY + boxSize) {
+                value = 230;
+            }
+            noise = noise * 1664525u + 1013904223u;
+            value += (int)(noise >> 29) - 4;
+            row[x] = (uint8_t)(value < 0 ? 0 : (value > 255 ? 255 : value));
+        }
+    }
+
+    // Colour: blue towards the bottom, red towards the right, and an orange
+    // box, all mild enough to stay well inside the gamut
+    if (_colour) {
+        const int chromaWidth = _width / 2;
+        for (int y = 0; y < _height; y++) {
+            uint8_t* cb = &_chroma[0][(size_t)y * chromaWidth];
+            uint8_t* cr = &_chroma[1][(size_t)y * chromaWidth];
+            for (int x = 0; x < chromaWidth; x++) {
+                bool inBox = x * 2 >= boxX && x * 2 < boxX + boxSize && y >= boxY && y < boxY + boxSize;
+                cb[x] = (uint8_t)(inBox ? 90 : 108 + (y * 40) / _height);
+                cr[x] = (uint8_t)(inBox ? 170 : 108 + (x * 40) / chromaWidth);
+            }
+        }
+    }
+}
+
+bool SyntheticJpeg::capture(uint32_t frameIndex, std::vector<uint8_t>& out) {
+    render(frameIndex);
+
+    out.clear();
+    out.push_back(0xFF);
+    out.push_back(JPEG_SOI);
+
+    uint8_t dqt[65];
+    dqt[0] = 0x00;                              // 8-bit, table 0
+    for (int i = 0; i < 64; i++) {
+        dqt[1 + i] = (uint8_t)_quant[i];
+    }
+    putMarkerSegment(out, JPEG_DQT, dqt, sizeof(dqt));
+
+    const uint8_t components = _colour ? 3 : 1;
+    uint8_t sof[6 + 3 * 3] = {
+        8, (uint8_t)(_height >> 8), (uint8_t)_height, (uint8_t)(_width >> 8), (uint8_t)_width,
+        components
+    };
+    for (int c = 0; c < components; c++) {
+        sof[6 + c * 3] = (uint8_t)(c + 1);
+        sof[7 + c * 3] = (c == 0 && _colour) ? 0x21 : 0x11;
+        sof[8 + c * 3] = 0;
+    }
+    putMarkerSegment(out, JPEG_SOF0, sof, 6 + components * 3);
+
+    uint8_t dht[1 + 16 + 162];
+    dht[0] = 0x00;                              // DC table 0
+    memcpy(dht + 1, kDcBits, 16);
+    memcpy(dht + 17, kDcVals, sizeof(kDcVals));
+    putMarkerSegment(out, JPEG_DHT, dht, 17 + sizeof(kDcVals));
+    dht[0] = 0x10;                              // AC table 0
+    memcpy(dht + 1, kAcBits, 16);
+    memcpy(dht + 17, kAcVals, sizeof(kAcVals));
+    putMarkerSegment(out, JPEG_DHT, dht, 17 + sizeof(kAcVals));
+
+    if (_restartInterval) {
+        uint8_t dri[2] = { (uint8_t)(_restartInterval >> 8), (uint8_t)_restartInterval };
+        putMarkerSegment(out, JPEG_DRI, dri, sizeof(dri));
+    }
+
+    uint8_t sos[1 + 3 * 2 + 3] = { components };
+    for (int c = 0; c < components; c++) {
+        sos[1 + c * 2] = (uint8_t)(c + 1);
+        sos[2 + c * 2] = 0x00;
+    }
+    sos[1 + components * 2] = 0;                // Ss, Se, Ah/Al
+    sos[2 + components * 2] = 63;
+    sos[3 + components * 2] = 0;
+    putMarkerSegment(out, JPEG_SOS, sos, 4 + components * 2);
+
+    // Worst case is well under 2 bytes per pixel at these quantiser settings
+    size_t headerLength = out.size();
+    out.resize(headerLength + (size_t)_width * _height * 2 + 64);
+
+    JpegBitWriter writer;
+    writer.begin(out.data(), out.size(), headerLength);
+    const int mcuWidth = _colour ? 16 : 8;
+    const size_t chromaWidth = _width / 2;
+    int16_t dcPred[3] = {0};
+    int16_t coeffs[64];
+    uint32_t mcu = 0;
+    for (int by = 0; by < _height; by += 8) {
+        for (int bx = 0; bx < _width; bx += mcuWidth, mcu++) {
+            if (_restartInterval && mcu > 0 && mcu % _restartInterval == 0) {
+                writer.putMarker(JPEG_RST0 + ((mcu / _restartInterval - 1) & 7));
+                memset(dcPred, 0, sizeof(dcPred));
+            }
+            for (int x = bx; x < bx + mcuWidth; x += 8) {
+                jpegForwardDCT(&_pixels[(size_t)by * _width + x], _width, _quant, coeffs);
+                if (!jpegEncodeBlock(writer, dcTable, acTable, dcPred[0], coeffs, true)) {
+                    return false;
+                }
+            }
+            for (int c = 1; c < components; c++) {
+                jpegForwardDCT(&_chroma[c - 1][by * chromaWidth + bx / 2], chromaWidth, _quant, coeffs);
+                if (!jpegEncodeBlock(writer, dcTable, acTable, dcPred[c], coeffs, true)) {
+                    return false;
+                }
+            }
+        }
+    }
+    writer.putMarker(JPEG_EOI);
+    if (writer.overflowed()) {
+        return false;
+    }
+
+    out.resize(writer.length());
+    return true;
+}
@@ -0,0 +1,46 @@
+#ifndef SYNTHETIC_JPEG_H
+#define SYNTHETIC_JPEG_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+// Stand-in for the camera: renders a moving test pattern and encodes it as a
+// baseline JPEG with the Annex K luminance tables, using the JpegCodec block
+// primitives. Frame sizes vary with the pattern and the quality, much like
+// the OV2640's output, so the host HAL, tools, tests and benchmarks can run
+// without hardware. Greyscale by default; colour frames are YCbCr 4:2:2 like
+// the OV2640's, with every component on the one set of tables.
+
+class SyntheticJpeg {
+public:
+    SyntheticJpeg();
+
+    // Dimensions are rounded up to whole MCUs (8x8, or 16x8 in colour).
+    // Quality is on the OV2640 scale: 0-63, lower is better.
+    void begin(uint16_t width, uint16_t height, uint8_t quality, bool colour = false);
+    void setQuality(uint8_t quality);
+
+    // MCUs between RSTn markers, written with a DRI segment; 0 for none
+    void setRestartInterval(uint16_t mcus) { _restartInterval = mcus; }
+
+    // Render and encode frame n of the pattern; returns false on failure
+    bool capture(uint32_t frameIndex, std::vector<uint8_t>& out);
+
+    uint16_t getWidth() const { return _width; }
+    uint16_t getHeight() const { return _height; }
+
+private:
+    uint16_t _width;
+    uint16_t _height;
+    uint8_t _quality;
+    bool _colour;
+    uint16_t _restartInterval;
+    uint16_t _quant[64];        // Zigzag order
+    std::vector<uint8_t> _pixels;
+    std::vector<uint8_t> _chroma[2];    // Cb, Cr at half width
+
+    void render(uint32_t frameIndex);
+};
+
+#endif // SYNTHETIC_JPEG_H
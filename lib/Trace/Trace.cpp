@@ -0,0 +1,210 @@
+#include <Arduino.h>
+#include <esp_timer.h>
+#include "Trace.h"
+#include <Logger.h>
+
+Tracer tracer;
+
+// Anchors are written at least this often; the cycle counter wraps every
+// ~18 s at 240 MHz and offsets are resolved as signed 32-bit differences
+#define TRACE_ANCHOR_INTERVAL_MS    1000
+#define TRACE_MAX_TASKS             16
+
+Tracer::Tracer()
+    : _mask(0)
+    , _anchorInterval(0)
+    , _enabled(false)
+{
+    for (int i = 0; i < TRACE_MAX_CORES; i++) {
+        _rings[i].events = nullptr;
+        _rings[i].next.store(0, std::memory_order_relaxed);
+        _rings[i].anchorCycles = 0;
+        _rings[i].anchorMicros = 0;
+    }
+}
+
+bool Tracer::begin(size_t eventsPerCore) {
+    if (_rings[0].events) {
+        return true;
+    }
+
+    size_t size = 1;
+    while (size * 2 <= eventsPerCore) {
+        size *= 2;
+    }
+
+    for (int i = 0; i < TRACE_MAX_CORES; i++) {
+        _rings[i].events = (TraceEvent*)ps_malloc(size * sizeof(TraceEvent));
+        if (!_rings[i].events) {
+            LOG_E("Trace: Failed to allocate ring buffer");
+            for (int j = 0; j < i; j++) {
+                free(_rings[j].events);
+                _rings[j].events = nullptr;
+            }
+            return false;
+        }
+        memset(_rings[i].events, 0, size * sizeof(TraceEvent));
+    }
+
+    _mask = size - 1;
+    _anchorInterval = ESP.getCpuFreqMHz() * 1000 * TRACE_ANCHOR_INTERVAL_MS;
+    _enabled.store(true, std::memory_order_relaxed);
+
+    LOG_I("Trace: %u events per core (%u KB PSRAM)", (unsigned)size,
+                  (unsigned)(TRACE_MAX_CORES * size * sizeof(TraceEvent) / 1024));
+    return true;
+}
+
+void Tracer::record(uint8_t phase, const char* name, uint32_t cycles, uint32_t value, uint32_t arg) {
+    if (!_enabled.load(std::memory_order_relaxed)) {
+        return;
+    }
+
+    Ring& ring = _rings[xPortGetCoreID()];
+
+    // Cheap check on the current count; a span's start may predate the anchor
+    if (Tracer::now() - ring.anchorCycles > _anchorInterval) {
+        writeAnchor(ring, Tracer::now());
+    }
+
+    // The reservation is atomic so a task preempting another on this core
+    // (or an ISR) gets its own slot
+    uint32_t slot = ring.next.fetch_add(1, std::memory_order_relaxed) & _mask;
+    TraceEvent& event = ring.events[slot];
+    event.cycles = cycles;
+    event.value = value;
+    event.arg = arg;
+    event.name = name;
+    event.task = xTaskGetCurrentTaskHandle();
+    event.phase = phase;
+}
+
+void Tracer::writeAnchor(Ring& ring, uint32_t cycles) {
+    uint64_t micros = (uint64_t)esp_timer_get_time();
+    ring.anchorCycles = cycles;
+    ring.anchorMicros = micros;
+
+    uint32_t slot = ring.next.fetch_add(1, std::memory_order_relaxed) & _mask;
+    TraceEvent& event = ring.events[slot];
+    event.cycles = cycles;
+    event.value = (uint32_t)micros;
+    event.arg = (uint32_t)(micros >> 32);
+    event.name = "anchor";
+    event.task = nullptr;
+    event.phase = 'A';
+}
+
+void Tracer::clear() {
+    bool wasEnabled = _enabled.exchange(false);
+    delay(2);
+    for (int i = 0; i < TRACE_MAX_CORES; i++) {
+        _rings[i].next.store(0, std::memory_order_relaxed);
+        _rings[i].anchorCycles = 0;
+        _rings[i].anchorMicros = 0;
+    }
+    _enabled.store(wasEnabled);
+}
+
+uint32_t Tracer::getRecorded() const {
+    uint32_t total = 0;
+    for (int i = 0; i < TRACE_MAX_CORES; i++) {
+        total += _rings[i].next.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+size_t Tracer::dump(Print& out) {
+    if (!_rings[0].events) {
+        return out.print("{\"traceEvents\":[]}\n");
+    }
+
+    // Pause recording and give in-flight record() calls time to finish
+    bool wasEnabled = _enabled.exchange(false);
+    delay(2);
+
+    float cyclesPerMicro = (float)ESP.getCpuFreqMHz();
+    void* tasks[TRACE_MAX_TASKS];
+    int numTasks = 0;
+    bool first = true;
+
+    size_t written = out.print("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+    for (int core = 0; core < TRACE_MAX_CORES; core++) {
+        Ring& ring = _rings[core];
+        uint32_t next = ring.next.load(std::memory_order_relaxed);
+        uint32_t count = next < _mask + 1 ? next : _mask + 1;
+        uint32_t oldest = next - count;
+
+        // Events older than the first surviving anchor are placed relative
+        // to it, or to the latest anchor if the ring has overwritten them all
+        // (signed offsets reach ~9 s either way)
+        uint32_t anchorCycles = ring.anchorCycles;
+        uint64_t anchorMicros = ring.anchorMicros;
+        for (uint32_t i = oldest; i != next; i++) {
+            const TraceEvent& event = ring.events[i & _mask];
+            if (event.phase == 'A') {
+                anchorCycles = event.cycles;
+                anchorMicros = ((uint64_t)event.arg << 32) | event.value;
+                break;
+            }
+        }
+
+        for (uint32_t i = oldest; i != next; i++) {
+            const TraceEvent& event = ring.events[i & _mask];
+            if (event.phase == 'A') {
+                anchorCycles = event.cycles;
+                anchorMicros = ((uint64_t)event.arg << 32) | event.value;
+                continue;
+            }
+
+            double ts = (double)anchorMicros +
+                        (double)(int32_t)(event.cycles - anchorCycles) / cyclesPerMicro;
+            uint32_t tid = (uint32_t)(uintptr_t)event.task;
+
+            if (!first) {
+                written += out.print(",\n");
+            }
+            first = false;
+
+            switch (event.phase) {
+                case 'X':
+                    written += out.printf("{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+                                          "\"pid\":1,\"tid\":%u,\"args\":{\"core\":%d,\"arg\":%u}}",
+                                          event.name, ts, event.value / cyclesPerMicro, tid, core,
+                                          event.arg);
+                    break;
+                case 'C':
+                    written += out.printf("{\"name\":\"%s\",\"ph\":\"C\",\"ts\":%.3f,\"pid\":1,"
+                                          "\"args\":{\"value\":%u}}",
+                                          event.name, ts, event.value);
+                    break;
+                default:
+                    written += out.printf("{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,"
+                                          "\"pid\":1,\"tid\":%u,\"args\":{\"core\":%d,\"arg\":%u}}",
+                                          event.name, ts, tid, core, event.arg);
+                    break;
+            }
+
+            bool known = false;
+            for (int t = 0; t < numTasks; t++) {
+                known = known || tasks[t] == event.task;
+            }
+            if (!known && numTasks < TRACE_MAX_TASKS) {
+                tasks[numTasks++] = event.task;
+            }
+        }
+    }
+
+    // Name the tracks (tasks are long-lived, so their handles are still valid)
+    for (int t = 0; t < numTasks; t++) {
+        written += out.printf("%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,"
+                              "\"args\":{\"name\":\"%s\"}}",
+                              first ? "" : ",\n", (uint32_t)(uintptr_t)tasks[t],
+                              pcTaskGetName((TaskHandle_t)tasks[t]));
+        first = false;
+    }
+
+    written += out.print("\n]}\n");
+    _enabled.store(wasEnabled);
+    return written;
+}
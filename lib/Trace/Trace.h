@@ -0,0 +1,102 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <Arduino.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include "../../include/config.h"
+
+// Lightweight per-stage latency tracing, exported as Chrome trace JSON
+// (chrome://tracing, ui.perfetto.dev).
+//
+// Each core records into its own ring buffer in PSRAM: an event is a CCOUNT
+// read, an atomic slot reservation and a 24-byte store, with no locks and no
+// allocation. The cores' cycle counters are not synchronised, so each ring
+// periodically records an anchor pairing CCOUNT with esp_timer time, and the
+// dump uses those to put both cores on one timeline.
+//
+// All TRACE_* macros compile to nothing when TRACE_ENABLED is false.
+
+#define TRACE_MAX_CORES     2
+
+struct TraceEvent {
+    uint32_t cycles;            // CCOUNT (start of span)
+    uint32_t value;             // Span duration in cycles, counter value, anchor time low word
+    uint32_t arg;               // Free argument (bytes, sequence number), anchor time high word
+    const char* name;           // String literal
+    void* task;                 // Recording task
+    uint8_t phase;              // 'X' span, 'i' instant, 'C' counter, 'A' anchor
+};
+
+class Tracer {
+public:
+    Tracer();
+
+    // Allocate the rings (eventsPerCore is rounded down to a power of two)
+    bool begin(size_t eventsPerCore);
+
+    void setEnabled(bool enabled) { _enabled.store(enabled, std::memory_order_relaxed); }
+    bool isEnabled() const { return _enabled.load(std::memory_order_relaxed); }
+
+    void record(uint8_t phase, const char* name, uint32_t cycles, uint32_t value, uint32_t arg);
+
+    // Write the rings as Chrome trace JSON. Recording is paused meanwhile.
+    size_t dump(Print& out);
+
+    // Drop all recorded events
+    void clear();
+
+    uint32_t getRecorded() const;
+
+    static inline uint32_t now() { return ESP.getCycleCount(); }
+
+private:
+    struct Ring {
+        TraceEvent* events;
+        std::atomic<uint32_t> next;     // Total events reserved (slot = next & mask)
+        uint32_t anchorCycles;          // Latest anchor, kept in case the ring
+        uint64_t anchorMicros;          // has already overwritten its event
+    };
+
+    Ring _rings[TRACE_MAX_CORES];
+    uint32_t _mask;
+    uint32_t _anchorInterval;           // Cycles between anchors
+    std::atomic<bool> _enabled;
+
+    void writeAnchor(Ring& ring, uint32_t cycles);
+};
+
+extern Tracer tracer;
+
+// Records a span from construction to destruction
+class TraceScope {
+public:
+    TraceScope(const char* name, uint32_t arg) : _name(name), _arg(arg), _start(Tracer::now()) {}
+    ~TraceScope() {
+        uint32_t end = Tracer::now();
+        tracer.record('X', _name, _start, end - _start, _arg);
+    }
+
+private:
+    const char* _name;
+    uint32_t _arg;
+    uint32_t _start;
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+
+#if TRACE_ENABLED
+#define TRACE_SCOPE(name)               TraceScope TRACE_CONCAT(_traceScope, __LINE__)(name, 0)
+#define TRACE_SCOPE_ARG(name, arg)      TraceScope TRACE_CONCAT(_traceScope, __LINE__)(name, (uint32_t)(arg))
+#define TRACE_INSTANT(name, arg)        tracer.record('i', name, Tracer::now(), 0, (uint32_t)(arg))
+#define TRACE_COUNTER(name, value)      tracer.record('C', name, Tracer::now(), (uint32_t)(value), 0)
+#else
+#define TRACE_SCOPE(name)               do {} while (0)
+#define TRACE_SCOPE_ARG(name, arg)      do {} while (0)
+#define TRACE_INSTANT(name, arg)        do {} while (0)
+#define TRACE_COUNTER(name, value)      do {} while (0)
+#endif
+
+#endif // TRACE_H
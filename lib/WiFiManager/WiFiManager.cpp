@@ -1,5 +1,6 @@
 #include "WiFiManager.h"
 #include "../../include/config.h"
+#include <Logger.h>
 
 WiFiManager* WiFiManager::_instance = nullptr;
 
@@ -19,7 +20,7 @@ bool WiFiManager::connect(const String& ssid, const String& password, uint32_t t
     _password = password;
     _reconnectAttempts = 0;
     
-    Serial.printf("WiFi: Connecting to '%s'...\n", ssid.c_str());
+    LOG_I("WiFi: Connecting to '%s'...", ssid.c_str());
     setState(WiFiState::CONNECTING);
     
     // Disconnect if already connected
@@ -40,7 +41,7 @@ bool WiFiManager::connect(const String& ssid, const String& password, uint32_t t
     
     if (WiFi.status() == WL_CONNECTED) {
         setState(WiFiState::CONNECTED);
-        Serial.printf("WiFi: Connected! IP: %s, RSSI: %d dBm\n", 
+        LOG_I("WiFi: Connected! IP: %s, RSSI: %d dBm", 
                      WiFi.localIP().toString().c_str(), WiFi.RSSI());
         
         if (_onConnectedCallback) {
@@ -49,13 +50,13 @@ bool WiFiManager::connect(const String& ssid, const String& password, uint32_t t
         return true;
     } else {
         setState(WiFiState::FAILED);
-        Serial.printf("WiFi: Connection failed (status: %d)\n", WiFi.status());
+        LOG_E("WiFi: Connection failed (status: %d)", WiFi.status());
         return false;
     }
 }
 
 void WiFiManager::disconnect() {
-    Serial.println("WiFi: Disconnecting...");
+    LOG_I("WiFi: Disconnecting...");
     _autoReconnect = false;
     WiFi.disconnect();
     setState(WiFiState::DISCONNECTED);
@@ -86,11 +87,11 @@ void WiFiManager::handle() {
             _reconnectAttempts++;
             
             if (_reconnectAttempts <= WIFI_MAX_RECONNECT_ATTEMPTS) {
-                Serial.printf("WiFi: Reconnect attempt %d/%d...\n", 
+                LOG_W("WiFi: Reconnect attempt %d/%d...", 
                              _reconnectAttempts, WIFI_MAX_RECONNECT_ATTEMPTS);
                 attemptConnection();
             } else {
-                Serial.println("WiFi: Max reconnect attempts reached");
+                LOG_E("WiFi: Max reconnect attempts reached");
                 setState(WiFiState::FAILED);
                 _autoReconnect = false;  // Stop trying
             }
@@ -135,19 +136,19 @@ void WiFiManager::WiFiEvent(WiFiEvent_t event) {
     
     switch (event) {
         case ARDUINO_EVENT_WIFI_STA_CONNECTED:
-            Serial.println("WiFi: Station connected to AP");
+            LOG_I("WiFi: Station connected to AP");
             break;
             
         case ARDUINO_EVENT_WIFI_STA_GOT_IP:
             _instance->setState(WiFiState::CONNECTED);
-            Serial.printf("WiFi: Got IP: %s\n", WiFi.localIP().toString().c_str());
+            LOG_I("WiFi: Got IP: %s", WiFi.localIP().toString().c_str());
             if (_instance->_onConnectedCallback) {
                 _instance->_onConnectedCallback();
             }
             break;
             
         case ARDUINO_EVENT_WIFI_STA_DISCONNECTED:
-            Serial.println("WiFi: Disconnected from AP");
+            LOG_W("WiFi: Disconnected from AP");
             _instance->setState(WiFiState::DISCONNECTED);
             if (_instance->_onDisconnectedCallback) {
                 _instance->_onDisconnectedCallback();
@@ -155,7 +156,7 @@ void WiFiManager::WiFiEvent(WiFiEvent_t event) {
             break;
             
         case ARDUINO_EVENT_WIFI_STA_LOST_IP:
-            Serial.println("WiFi: Lost IP address");
+            LOG_W("WiFi: Lost IP address");
             break;
             
         default:
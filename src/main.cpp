@@ -5,7 +5,25 @@
 #include <WiFiManager.h>
 #include <CameraCapture.h>
 #include <AudioCapture.h>
-#include <RTMPClient.h>
+#include <AudioFeatures.h>
+#include <JpegOverlay.h>
+#include <LatencyProbe.h>
+#include <CaptureRecorder.h>
+#include <RateController.h>
+#include <SharedFrame.h>
+#include <FrameMailbox.h>
+#include <FramePacer.h>
+#include <Logger.h>
+#include <Trace.h>
+#include <Metrics.h>
+#include <MetricsServer.h>
+#include <RTMPFanout.h>
+#include <StreamBuffer.h>
+#include <FlvRecorder.h>
+#include <RTPSender.h>
+#include <time.h>
+#include <sys/time.h>
+#include <esp_timer.h>
 
 // ============================================================================
 // State Machine
@@ -30,7 +48,15 @@ BLEProvisioning bleProvisioning;
 WiFiManager wifiManager;
 CameraCapture camera;
 AudioCapture audio;
-RTMPClient rtmpClient;
+AudioFeatures audioFeatures;
+JpegOverlay osd;
+RateController rateController;
+FramePool framePool;
+FrameMailbox videoMailbox;
+FramePacer cameraPacer;
+FlvRecorder recorder;
+RTPSender rtp;
+MetricsServer metricsServer;
 
 // Credentials
 String wifiSSID, wifiPassword;
@@ -41,13 +67,84 @@ TaskHandle_t cameraTaskHandle = NULL;
 TaskHandle_t audioTaskHandle = NULL;
 TaskHandle_t streamTaskHandle = NULL;
 
-// Shared data queues
-QueueHandle_t videoFrameQueue = NULL;
+// Audio blocks go from the audio task to the stream task through
+// audioBufferQueue, are shared by the RTMP destinations, and come back
+// through audioFreeQueue when the last one is done (pool in PSRAM)
+struct AudioBlock {
+    uint32_t captureMs;         // esp_timer time of the first sample
+    size_t samples;
+    std::atomic<uint32_t> refs;
+    int16_t pcm[AUDIO_BUFFER_SIZE];
+};
+
+// Enough that destinations with full queues cannot starve the others
+#define AUDIO_POOL_BLOCKS   (AUDIO_QUEUE_BLOCKS + RTMP_MAX_DESTINATIONS * (RTMP_DESTINATION_AUDIO_BLOCKS + 1))
+
 QueueHandle_t audioBufferQueue = NULL;
+QueueHandle_t audioFreeQueue = NULL;
+
+void releaseAudioBlock(void* owner) {
+    AudioBlock* block = (AudioBlock*)owner;
+    if (block->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        xQueueSend(audioFreeQueue, &block, 0);
+    }
+}
+
+RTMPFanout fanout(releaseAudioBlock);
+
+// ============================================================================
+// Metrics
+// ============================================================================
+
+// Frame size buckets (bytes)
+static const uint32_t frameSizeBounds[] = {
+    2048, 4096, 6144, 8192, 12288, 16384, 24576, 32768, 49152, 65536
+};
+
+Counter metricFramesCaptured("camera_frames_captured_total", "Frames captured");
+Counter metricAudioBlocksDropped("audio_blocks_dropped_total", "Audio blocks lost because the stream task was behind");
+Histogram metricFrameBytes("camera_frame_bytes", "Captured JPEG frame size",
+                           frameSizeBounds, sizeof(frameSizeBounds) / sizeof(frameSizeBounds[0]));
+
+// Existing module statistics, read at scrape time
+CallbackMetric metricCaptureFps("camera_capture_fps", "Measured capture frame rate", MetricType::GAUGE,
+                                []() { return (double)camera.getFrameRate(); });
+CallbackMetric metricQuality("camera_jpeg_quality", "Current JPEG quality (lower is better)", MetricType::GAUGE,
+                             []() { return (double)rateController.getQuality(); });
+CallbackMetric metricPacerSkipped("camera_pacer_skipped_total", "Capture slots skipped by the pacer",
+                                  MetricType::COUNTER, []() { return (double)cameraPacer.getSkipped(); });
+CallbackMetric metricMailboxOverwrites("video_mailbox_overwrites_total", "Frames replaced before the stream task took them",
+                                       MetricType::COUNTER, []() { return (double)videoMailbox.getOverwrites(); });
+CallbackMetric metricFramesLive("frame_pool_live", "Frames held in the pool", MetricType::GAUGE,
+                                []() { return (double)framePool.getLiveFrames(); });
+CallbackMetric metricFramePoolFailures("frame_pool_failures_total", "Frames dropped because the pool was full",
+                                       MetricType::COUNTER, []() { return (double)framePool.getFailures(); });
+CallbackMetric metricAudioQueue("audio_queue_depth", "Audio buffers waiting for the stream task", MetricType::GAUGE,
+                                []() { return audioBufferQueue ? (double)uxQueueMessagesWaiting(audioBufferQueue) : 0.0; });
+CallbackMetric metricRecording("recorder_active", "1 while a recording is open", MetricType::GAUGE,
+                               []() { return recorder.isRecording() ? 1.0 : 0.0; });
+CallbackMetric metricHeapFree("heap_free_bytes", "Free internal heap", MetricType::GAUGE,
+                              []() { return (double)ESP.getFreeHeap(); });
+CallbackMetric metricHeapMin("heap_min_free_bytes", "Lowest free internal heap since boot", MetricType::GAUGE,
+                             []() { return (double)ESP.getMinFreeHeap(); });
+CallbackMetric metricPsramFree("psram_free_bytes", "Free PSRAM", MetricType::GAUGE,
+                               []() { return (double)ESP.getFreePsram(); });
+CallbackMetric metricRssi("wifi_rssi_dbm", "WiFi signal strength", MetricType::GAUGE,
+                          []() { return (double)wifiManager.getRSSI(); });
+CallbackMetric metricUptime("uptime_seconds", "Time since boot", MetricType::GAUGE,
+                            []() { return millis() / 1000.0; });
+
+String getDeviceName() {
+    return String(BLE_DEVICE_NAME) + "-" + String((uint32_t)ESP.getEfuseMac(), HEX);
+}
 
 // LED control
 void setLED(bool on) {
+#if RECORDER_ENABLED && RECORDER_STORAGE == RECORDER_STORAGE_SD
+    (void)on;           // The LED pin is the SD card's chip select
+#else
     digitalWrite(LED_PIN, on ? HIGH : LOW);
+#endif
 }
 
 void blinkLED(uint8_t count, uint16_t delayMs = 200) {
@@ -59,33 +156,193 @@ void blinkLED(uint8_t count, uint16_t delayMs = 200) {
     }
 }
 
+// ============================================================================
+// On-Screen Display
+// ============================================================================
+
+// Burn the camera name and wall-clock time (uptime until NTP has synced) into
+// the frame. The overlaid copy, a pool frame the destinations share,
+// replaces frame; on failure frame is left as it is.
+void applyOSD(FrameRef& frame) {
+    TRACE_SCOPE("osd.apply");
+    size_t capacity = JpegOverlay::maxOutputSize(frame->length());
+    FrameRef output(framePool.allocate(frame.get(), capacity));
+    if (!output) {
+        return;
+    }
+    
+    static String deviceName = getDeviceName();
+    char text[JPEG_OVERLAY_MAX_TEXT + 1];
+    time_t now = time(NULL);
+    struct tm local;
+    localtime_r(&now, &local);
+    
+    if (local.tm_year + 1900 >= 2024) {
+        snprintf(text, sizeof(text), "%s %04d-%02d-%02d %02d:%02d:%02d", deviceName.c_str(),
+                 local.tm_year + 1900, local.tm_mon + 1, local.tm_mday,
+                 local.tm_hour, local.tm_min, local.tm_sec);
+    } else {
+        uint32_t up = millis() / 1000;
+        snprintf(text, sizeof(text), "%s UP %02u:%02u:%02u", deviceName.c_str(),
+                 up / 3600, (up / 60) % 60, up % 60);
+    }
+    osd.setText(text);
+    
+    size_t len = osd.apply(frame->data(), frame->length(), output->fb()->buf, capacity);
+    if (len == 0) {
+        return;     // Unparseable frame: send it untouched
+    }
+    
+    output->fb()->len = len;
+    frame = std::move(output);
+}
+
+// ============================================================================
+// Latency Probe
+// ============================================================================
+
+// Stamp the frame's capture sequence and timestamps into a COM segment. The
+// stamped copy replaces frame; on failure frame is left as it is.
+void applyLatencyStamp(FrameRef& frame) {
+    size_t capacity = LatencyProbe::maxOutputSize(frame->length());
+    FrameRef output(framePool.allocate(frame.get(), capacity));
+    if (!output) {
+        return;
+    }
+    
+    // The driver timestamps frames with esp_timer at capture
+    camera_fb_t* fb = frame->fb();
+    LatencyStamp stamp;
+    stamp.sequence = frame->sequence();
+    stamp.captureMicros = (uint64_t)fb->timestamp.tv_sec * 1000000ULL + fb->timestamp.tv_usec;
+    stamp.sendMicros = (uint64_t)esp_timer_get_time();
+    stamp.wallMicros = 0;
+    stamp.flags = 0;
+    
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    if (now.tv_sec > 1704067200) {  // Wall clock set (after 2024-01-01)
+        uint64_t wallNow = (uint64_t)now.tv_sec * 1000000ULL + now.tv_usec;
+        stamp.wallMicros = wallNow - (stamp.sendMicros - stamp.captureMicros);
+        stamp.flags |= LATENCY_FLAG_WALL_CLOCK;
+    }
+    
+    size_t len = LatencyProbe::stamp(fb->buf, fb->len, stamp, output->fb()->buf, capacity);
+    if (len == 0) {
+        return;
+    }
+    
+    output->fb()->len = len;
+    frame = std::move(output);
+}
+
+// ============================================================================
+// Serial Console
+// ============================================================================
+
+// "trace" dumps the trace rings as Chrome trace JSON (save the output from
+// the opening brace to a .json file and load it in ui.perfetto.dev).
+// "capture" records a capture trace until the buffer is full ("capture stop"
+// ends it early); fetch it from http://<ip>:METRICS_PORT/capture.
+void handleSerialCommands() {
+    static String line;
+    
+    while (Serial.available()) {
+        char c = Serial.read();
+        if (c != '\n' && c != '\r') {
+            if (line.length() < 32) {
+                line += c;
+            }
+            continue;
+        }
+        
+        line.trim();
+        if (line == "trace") {
+#if TRACE_ENABLED
+            tracer.dump(Serial);
+#else
+            LOG_W("Trace: Disabled (TRACE_ENABLED is false)");
+#endif
+        } else if (line == "capture") {
+#if CAPTURE_TRACE_ENABLED
+            captureRecorder.start(CAPTURE_TRACE_BUFFER_BYTES, AUDIO_SAMPLE_RATE);
+#else
+            LOG_W("Capture: Disabled (CAPTURE_TRACE_ENABLED is false)");
+#endif
+        } else if (line == "capture stop") {
+            captureRecorder.stop();
+        } else if (line == "record") {
+#if RECORDER_ENABLED
+            recorder.trigger(RECORDER_POST_ROLL_MS);
+#else
+            LOG_W("Recorder: Disabled (RECORDER_ENABLED is false)");
+#endif
+        } else if (line == "record stop") {
+            recorder.stop();
+        }
+        line = "";
+    }
+}
+
 // ============================================================================
 // FreeRTOS Tasks
 // ============================================================================
 
 // Camera capture task (Core 1 - App CPU)
 void cameraTask(void* parameter) {
-    Serial.println("Task: Camera task started");
+    LOG_I("Task: Camera task started");
+    
+    uint8_t quality = CAMERA_JPEG_QUALITY;
     
     while (true) {
         if (currentState == AppState::STREAMING) {
+            // Sleep to the next frame deadline (late slots are skipped)
+            {
+                TRACE_SCOPE("camera.pace");
+                cameraPacer.wait();
+            }
+            
             camera_fb_t* fb = camera.captureFrame();
             
             if (fb) {
-                // Send frame to streaming queue
-                xQueueSend(videoFrameQueue, &fb, 0);  // Non-blocking
+                metricFramesCaptured.inc();
+                metricFrameBytes.observe(fb->len);
+                
+#if CAPTURE_TRACE_ENABLED
+                // Before rate control and OSD: the trace holds what the sensor delivered
+                captureRecorder.recordFrame(fb);
+#endif
+                
+#if CAMERA_RATE_CONTROL_TRACE
+                LOG_I("RC,%u,%u", quality, fb->len);
+#endif
                 
-                // Note: Frame will be released by streaming task
+#if CAMERA_RATE_CONTROL_ENABLED
+                // Steer JPEG quality towards the per-frame byte budget
+                uint8_t nextQuality = rateController.update(fb->len);
+                if (nextQuality != quality && camera.setQuality(nextQuality)) {
+                    quality = nextQuality;
+                }
+#endif
+                
+                // Hand the newest frame to the streaming task; a frame it has
+                // not picked up yet goes straight back to the driver
+                SharedFrame* frame = framePool.wrap(fb);
+                if (frame) {
+                    TRACE_INSTANT("frame.post", frame->length());
+                    videoMailbox.post(frame);
+                }
             }
+        } else {
+            cameraPacer.reset();
+            vTaskDelay(pdMS_TO_TICKS(100));
         }
-        
-        vTaskDelay(pdMS_TO_TICKS(33));  // ~30 FPS
     }
 }
 
 // Audio capture task (Core 1 - App CPU)
 void audioTask(void* parameter) {
-    Serial.println("Task: Audio task started");
+    LOG_I("Task: Audio task started");
     
     const size_t bufferSize = AUDIO_BUFFER_SIZE;
     int16_t* audioBuffer = (int16_t*)malloc(bufferSize * sizeof(int16_t));
@@ -95,44 +352,95 @@ void audioTask(void* parameter) {
             size_t samplesRead = audio.read(audioBuffer, bufferSize);
             
             if (samplesRead > 0) {
-                // Send to streaming task (simplified - needs proper queue handling)
-                // TODO: Implement audio queue with timestamp synchronization
+#if CAPTURE_TRACE_ENABLED
+                captureRecorder.recordAudio(audioBuffer, samplesRead, esp_timer_get_time());
+#endif
+                
+#if AUDIO_MFCC_ENABLED
+                // Extract MFCC frames for on-device sound event detection
+                audioFeatures.process(audioBuffer, samplesRead);
+#endif
+                
+#if RTMP_AUDIO_ENABLED
+                // The read returns when the block is full: it started one
+                // block's duration ago
+                AudioBlock* block = NULL;
+                if (xQueueReceive(audioFreeQueue, &block, 0) == pdTRUE) {
+                    block->captureMs = (uint32_t)(esp_timer_get_time() / 1000) -
+                                       (uint32_t)(samplesRead * 1000 / AUDIO_SAMPLE_RATE);
+                    block->samples = samplesRead;
+                    memcpy(block->pcm, audioBuffer, samplesRead * sizeof(int16_t));
+                    if (xQueueSend(audioBufferQueue, &block, 0) != pdTRUE) {
+                        // The hand-off queue is shallower than the pool:
+                        // the stream task is behind, so the block goes
+                        // back rather than out of circulation
+                        xQueueSend(audioFreeQueue, &block, 0);
+                        metricAudioBlocksDropped.inc();
+                    } else if (streamTaskHandle) {
+                        xTaskNotifyGive(streamTaskHandle);
+                    }
+                } else {
+                    metricAudioBlocksDropped.inc();
+                }
+#endif
             }
+            // No delay: the blocking I2S read paces this loop at the sample clock
+        } else {
+            vTaskDelay(pdMS_TO_TICKS(64));
         }
-        
-        vTaskDelay(pdMS_TO_TICKS(64));  // 16kHz / 1024 samples ≈ 64ms
     }
     
     free(audioBuffer);
 }
 
-// RTMP streaming task (Core 0 - Protocol CPU)
+// Stream task (Core 0 - Protocol CPU): overlays each frame, then hands it
+// and the audio to the recorder and, by reference, to every RTMP
+// destination. Sending, holding and reconnecting happen in the
+// destinations' own tasks. The RTP output, which never waits, sends from
+// here.
 void streamTask(void* parameter) {
-    Serial.println("Task: Streaming task started");
+    LOG_I("Task: Streaming task started");
     
-    camera_fb_t* fb = NULL;
-    uint32_t frameTimestamp = 0;
+    videoMailbox.setConsumer(xTaskGetCurrentTaskHandle());
     
     while (true) {
-        if (currentState == AppState::STREAMING && rtmpClient.isConnected()) {
-            // Get frame from queue
-            if (xQueueReceive(videoFrameQueue, &fb, pdMS_TO_TICKS(100)) == pdTRUE) {
-                // Send frame to RTMP server
-                bool sent = rtmpClient.sendVideoFrame(fb, frameTimestamp);
-                
-                if (sent) {
-                    frameTimestamp += 33;  // 30 FPS = 33ms per frame
-                }
-                
-                // Release frame buffer
-                camera.releaseFrame(fb);
-            }
+        if (currentState != AppState::STREAMING) {
+            vTaskDelay(pdMS_TO_TICKS(100));
+            continue;
+        }
+        
+        // Get the newest frame (audio blocks wake this early)
+        FrameRef frame(videoMailbox.take(100));
+        if (frame) {
+            TRACE_INSTANT("frame.take", frame->length());
+#if OSD_ENABLED
+            applyOSD(frame);
+#endif
+#if LATENCY_PROBE_ENABLED
+            applyLatencyStamp(frame);
+#endif
             
-            // Handle RTMP keepalive
-            rtmpClient.handle();
+            // Timestamps stay on the capture clock; each destination (and
+            // the recorder) counts from its own first message
+            camera_fb_t* fb = frame->fb();
+            uint32_t captureMs = (uint32_t)((uint64_t)fb->timestamp.tv_sec * 1000 + fb->timestamp.tv_usec / 1000);
+            recorder.push(STREAM_MESSAGE_VIDEO, captureMs, fb->buf, fb->len);
+            fanout.postVideo(frame);
+            rtp.sendVideo(fb->buf, fb->len, captureMs);
+        }
+        
+        AudioBlock* block = NULL;
+        while (xQueueReceive(audioBufferQueue, &block, 0) == pdTRUE) {
+            const uint8_t* pcm = (const uint8_t*)block->pcm;
+            size_t len = block->samples * sizeof(int16_t);
+            recorder.push(STREAM_MESSAGE_AUDIO, block->captureMs, pcm, len);
             
-        } else {
-            vTaskDelay(pdMS_TO_TICKS(100));
+            // One reference per destination, plus ours until posted
+            uint8_t destinations = fanout.getCount();
+            block->refs.store(destinations + 1, std::memory_order_relaxed);
+            fanout.postAudio(destinations, block->captureMs, pcm, len, block);
+            rtp.sendAudio(block->pcm, block->samples, block->captureMs);
+            releaseAudioBlock(block);
         }
     }
 }
@@ -142,11 +450,11 @@ void streamTask(void* parameter) {
 // ============================================================================
 
 void enterProvisioning() {
-    Serial.println("State: Entering provisioning mode");
+    LOG_I("State: Entering provisioning mode");
     currentState = AppState::PROVISIONING;
     
     // Start BLE provisioning
-    String deviceName = String(BLE_DEVICE_NAME) + "-" + String((uint32_t)ESP.getEfuseMac(), HEX);
+    String deviceName = getDeviceName();
     bleProvisioning.begin(deviceName.c_str());
     
     // Blink LED to indicate provisioning mode
@@ -154,13 +462,13 @@ void enterProvisioning() {
     
     // Set callback for when credentials are received
     bleProvisioning.onCredentialsReceived([]() {
-        Serial.println("State: Credentials received via BLE");
+        LOG_I("State: Credentials received via BLE");
         currentState = AppState::CONNECTING_WIFI;
     });
 }
 
 void enterConnectingWiFi() {
-    Serial.println("State: Connecting to WiFi");
+    LOG_I("State: Connecting to WiFi");
     currentState = AppState::CONNECTING_WIFI;
     
     // Stop BLE to save resources
@@ -168,7 +476,7 @@ void enterConnectingWiFi() {
     
     // Load credentials
     if (!bleProvisioning.loadWiFiCredentials(wifiSSID, wifiPassword)) {
-        Serial.println("State: Failed to load WiFi credentials");
+        LOG_E("State: Failed to load WiFi credentials");
         currentState = AppState::ERROR;
         return;
     }
@@ -179,36 +487,58 @@ void enterConnectingWiFi() {
     if (wifiManager.connect(wifiSSID, wifiPassword, WIFI_CONNECT_TIMEOUT_MS)) {
         currentState = AppState::CONNECTING_RTMP;
         setLED(true);  // Solid LED when WiFi connected
+        
+#if METRICS_ENABLED
+        metricsServer.begin(METRICS_PORT);
+#endif
+        
+#if RTP_ENABLED
+        String rtpTarget = RTP_DEFAULT_TARGET;
+        bleProvisioning.loadRTPTarget(rtpTarget);
+        if (rtpTarget.length() > 0 && !rtp.isEnabled()) {
+            rtp.begin(rtpTarget, getDeviceName().c_str(), RTP_FEC_GROUP);
+        }
+#endif
+        
+#if OSD_ENABLED || LATENCY_PROBE_ENABLED
+        // Wall-clock time for the OSD timestamp and latency stamps (syncs in
+        // the background)
+        configTzTime(OSD_TIMEZONE, OSD_NTP_SERVER);
+#endif
     } else {
-        Serial.println("State: WiFi connection failed");
+        LOG_E("State: WiFi connection failed");
         currentState = AppState::ERROR;
     }
 }
 
 void enterConnectingRTMP() {
-    Serial.println("State: Connecting to RTMP");
+    LOG_I("State: Connecting to RTMP");
     currentState = AppState::CONNECTING_RTMP;
     
     // Load RTMP credentials
     if (!bleProvisioning.loadRTMPCredentials(rtmpURL, rtmpKey)) {
-        Serial.println("State: Failed to load RTMP credentials");
+        LOG_E("State: Failed to load RTMP credentials");
         currentState = AppState::ERROR;
         return;
     }
     
-    // Connect to RTMP server
-    if (rtmpClient.connect(rtmpURL, rtmpKey)) {
-        currentState = AppState::STREAMING;
-        Serial.println("State: Streaming started!");
-    } else {
-        Serial.println("State: RTMP connection failed (implementation required)");
-        // For now, continue anyway to test camera/audio
-        currentState = AppState::STREAMING;
+    // Each destination connects, and keeps retrying, in its own task;
+    // capture and audio start right away
+    if (fanout.getCount() == 0) {
+        fanout.add(rtmpURL, rtmpKey, STREAM_BUFFER_BYTES);
+        for (uint8_t i = 1; i < RTMP_MAX_DESTINATIONS; i++) {
+            String url, key;
+            if (bleProvisioning.loadRTMPCredentials(url, key, i)) {
+                fanout.add(url, key, RTMP_MIRROR_BUFFER_BYTES);
+            }
+        }
     }
+    LOG_I("State: Streaming to %u destination(s)", fanout.getCount());
+    currentState = AppState::STREAMING;
 }
 
 void enterStreaming() {
-    Serial.println("State: Streaming mode");
+    LOG_I("State: Streaming mode");
     currentState = AppState::STREAMING;
     
     // Start FreeRTOS tasks on appropriate cores
@@ -242,7 +572,7 @@ void enterStreaming() {
         TASK_STREAM_CORE
     );
     
-    Serial.println("State: All tasks started");
+    LOG_I("State: All tasks started");
 }
 
 // ============================================================================
@@ -269,40 +599,81 @@ void setup() {
     Serial.printf("Free PSRAM: %d KB\n", ESP.getFreePsram() / 1024);
     Serial.println();
     
+    // From here on log lines are written by the log task
+    logger.begin(LOG_BUFFER_ENTRIES);
+    
+#if TRACE_ENABLED
+    tracer.begin(TRACE_BUFFER_EVENTS);
+#endif
+    
     // Initialize hardware
-    Serial.println("Initializing hardware...");
+    LOG_I("Initializing hardware...");
     
     if (!camera.begin()) {
-        Serial.println("ERROR: Camera initialization failed!");
+        LOG_E("Camera initialization failed!");
         currentState = AppState::ERROR;
         return;
     }
-    Serial.println("✓ Camera initialized");
+    LOG_I("✓ Camera initialized");
     
     if (!audio.begin()) {
-        Serial.println("ERROR: Audio initialization failed!");
+        LOG_E("Audio initialization failed!");
         currentState = AppState::ERROR;
         return;
     }
-    Serial.println("✓ Audio initialized");
+    LOG_I("✓ Audio initialized");
+    
+#if AUDIO_MFCC_ENABLED
+    audioFeatures.begin();
+#endif
+    
+    cameraPacer.begin(CAMERA_TARGET_FPS);
+    
+#if CAMERA_RATE_CONTROL_ENABLED
+    rateController.begin(CAMERA_TARGET_FRAME_BYTES, CAMERA_QUALITY_MIN, CAMERA_QUALITY_MAX,
+                         CAMERA_JPEG_QUALITY);
+#endif
+    
+#if OSD_ENABLED
+    osd.setPosition(OSD_POSITION_X, OSD_POSITION_Y);
+    osd.setScale(OSD_SCALE);
+#endif
     
     // Create queues
-    videoFrameQueue = xQueueCreate(2, sizeof(camera_fb_t*));
-    audioBufferQueue = xQueueCreate(4, sizeof(void*));
+    audioBufferQueue = xQueueCreate(AUDIO_QUEUE_BLOCKS, sizeof(AudioBlock*));
+    audioFreeQueue = xQueueCreate(AUDIO_POOL_BLOCKS, sizeof(AudioBlock*));
+    AudioBlock* audioBlocks = (AudioBlock*)ps_malloc(AUDIO_POOL_BLOCKS * sizeof(AudioBlock));
+    for (int i = 0; audioBlocks && i < AUDIO_POOL_BLOCKS; i++) {
+        AudioBlock* block = &audioBlocks[i];
+        block->refs.store(0, std::memory_order_relaxed);
+        xQueueSend(audioFreeQueue, &block, 0);
+    }
+    
+    fanout.setVideoInfo(resolution[CAMERA_FRAME_SIZE].width, resolution[CAMERA_FRAME_SIZE].height,
+                        CAMERA_TARGET_FPS);
     
-    Serial.println("\nHardware initialization complete\n");
+#if RECORDER_ENABLED
+    if (recorder.begin(RECORDER_BUFFER_BYTES, RECORDER_PRE_ROLL_MS)) {
+        recorder.setVideoInfo(resolution[CAMERA_FRAME_SIZE].width, resolution[CAMERA_FRAME_SIZE].height,
+                              CAMERA_TARGET_FPS);
+    }
+#endif
+    
+    LOG_I("Hardware initialization complete");
     
     // Check if already provisioned
     if (bleProvisioning.hasStoredCredentials()) {
-        Serial.println("Found stored credentials, connecting to WiFi...");
+        LOG_I("Found stored credentials, connecting to WiFi...");
         enterConnectingWiFi();
     } else {
-        Serial.println("No stored credentials, entering provisioning mode...");
+        LOG_I("No stored credentials, entering provisioning mode...");
         enterProvisioning();
     }
 }
 
 void loop() {
+    handleSerialCommands();
+    
     // State machine handler
     switch (currentState) {
         case AppState::INIT:
@@ -333,26 +704,119 @@ void loop() {
             if (millis() - lastHealthCheck >= 10000) {
                 lastHealthCheck = millis();
                 
-                Serial.printf("\n[Health] Heap: %d KB, PSRAM: %d KB, FPS: %.1f\n",
+                LOG_I("[Health] Heap: %d KB, PSRAM: %d KB, FPS: %.1f",
                              ESP.getFreeHeap() / 1024,
                              ESP.getFreePsram() / 1024,
                              camera.getFrameRate());
                 
-                if (rtmpClient.isConnected()) {
-                    Serial.printf("[RTMP] Frames: %d, Dropped: %d, Bytes: %d KB\n",
-                                 rtmpClient.getFramesSent(),
-                                 rtmpClient.getDroppedFrames(),
-                                 rtmpClient.getBytesSent() / 1024);
+                LOG_I("[Pacing] Jitter p50/p95/p99: %u/%u/%u us, Max: %u us, Skipped: %u",
+                             cameraPacer.getJitterPercentile(50),
+                             cameraPacer.getJitterPercentile(95),
+                             cameraPacer.getJitterPercentile(99),
+                             cameraPacer.getMaxJitterMicros(),
+                             cameraPacer.getSkipped());
+                
+                LOG_I("[Video] Posted: %u, Taken: %u, Overwritten: %u",
+                             videoMailbox.getPosted(),
+                             videoMailbox.getTaken(),
+                             videoMailbox.getOverwrites());
+                
+                LOG_I("[Frames] Live: %u (copies: %u), Wrapped: %u, Returned: %u, Failures: %u",
+                             framePool.getLiveFrames(),
+                             framePool.getLiveCopies(),
+                             framePool.getWrapped(),
+                             framePool.getReturned(),
+                             framePool.getFailures());
+                
+#if CAMERA_RATE_CONTROL_ENABLED
+                LOG_I("[Camera] Quality: %u, Avg: %.0f B, Peak: %u B, Slope: %.3f, Changes: %u",
+                             rateController.getQuality(),
+                             rateController.getAverageFrameBytes(),
+                             rateController.getPeakFrameBytes(),
+                             rateController.getSlope(),
+                             rateController.getQualityChanges());
+#endif
+                
+#if OSD_ENABLED
+                LOG_I("[OSD] Frames: %u, Failed: %u, Last: %u us",
+                             osd.getFramesProcessed(),
+                             osd.getFramesFailed(),
+                             osd.getLastApplyMicros());
+#endif
+                
+#if AUDIO_MFCC_ENABLED
+                LOG_I("[Audio] MFCC frames: %u, hop: %.0f us avg / %u us max",
+                             audioFeatures.getFrameCount(),
+                             audioFeatures.getAverageHopMicros(),
+                             audioFeatures.getMaxHopMicros());
+#endif
+                
+                if (recorder.isEnabled()) {
+                    LOG_I("[Recorder] %s; Files: %u, Written: %llu KB, Dropped: %u, Slowest block: %u us",
+                                 recorder.isRecording() ? "Recording" : "Pre-roll",
+                                 recorder.getFiles(),
+                                 (unsigned long long)(recorder.getBytesWritten() / 1024),
+                                 recorder.getDropped(),
+                                 recorder.getMaxWriteMicros());
+                }
+                
+                if (rtp.isEnabled()) {
+                    const RtpStream& video = rtp.getVideo();
+                    LOG_I("[RTP] Frames: %u, Skipped: %u, Dropped packets: %u, Send failures: %u, FEC packets: %u; "
+                          "receiver: %.1f%% lost, jitter %.1f ms, RTT %.1f ms",
+                                 rtp.getFramesSent(),
+                                 rtp.getFramesSkipped(),
+                                 rtp.getPacketsDropped(),
+                                 rtp.getSendFailures(),
+                                 rtp.getFecPackets(),
+                                 video.fractionLost * 100.0f,
+                                 video.jitterMs,
+                                 video.rttMs);
+                }
+                
+                for (uint8_t i = 0; i < fanout.getCount(); i++) {
+                    RTMPDestination* destination = fanout.get(i);
+                    LOG_I("[RTMP %u] %s; Frames: %u, Dropped: %u, Audio dropped: %u, Payload: %llu KB, Reconnects: %u",
+                                 i,
+                                 destination->isConnected() ? "Streaming" : "Down",
+                                 destination->getFramesSent(),
+                                 destination->getFramesDropped(),
+                                 destination->getAudioDropped(),
+                                 (unsigned long long)(destination->getPayloadBytes() / 1024),
+                                 destination->getReconnects());
+                    
+                    StreamBuffer& buffer = destination->getBuffer();
+                    if (buffer.isEnabled()) {
+                        LOG_I("[Buffer %u] Held: %u msgs, %u KB, %u ms; Stored: %u, Forwarded: %u, Evicted: %u",
+                                     i,
+                                     buffer.getCount(),
+                                     (unsigned)(buffer.getBytes() / 1024),
+                                     buffer.getBacklogMs(),
+                                     buffer.getStored(),
+                                     buffer.getForwarded(),
+                                     buffer.getEvicted());
+                    }
+                    
+                    const AVMux& mux = destination->getMux();
+                    LOG_I("[Mux %u] Reordered: %u, Late: %u, Max depth: %u",
+                                 i,
+                                 mux.getReordered(),
+                                 mux.getLate(),
+                                 mux.getMaxDepth());
                 }
             }
             
             // Handle WiFi reconnection
             wifiManager.handle();
+            
+#if METRICS_ENABLED
+            metricsServer.handle();
+#endif
             delay(100);
             break;
             
         case AppState::ERROR:
-            Serial.println("ERROR: System in error state");
+            LOG_E("System in error state");
             blinkLED(5, 100);
             delay(5000);
             break;
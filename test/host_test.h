@@ -0,0 +1,42 @@
+#ifndef HOST_TEST_H
+#define HOST_TEST_H
+
+#include <stdio.h>
+
+// Minimal checks for the host tests (ctest runs each test_* binary; a
+// non-zero exit is a failure). Every failed CHECK is reported with its
+// location and the test carries on, so one run shows all of them.
+
+static int hostTestFailures = 0;
+
+#define CHECK(condition)                                                        \
+    do {                                                                        \
+        if (!(condition)) {                                                     \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__,    \
+                    #condition);                                                \
+            hostTestFailures++;                                                 \
+        }                                                                       \
+    } while (0)
+
+#define CHECK_EQ(actual, expected)                                              \
+    do {                                                                        \
+        long long a_ = (long long)(actual);                                     \
+        long long e_ = (long long)(expected);                                   \
+        if (a_ != e_) {                                                         \
+            fprintf(stderr, "%s:%d: %s is %lld, expected %lld\n", __FILE__,     \
+                    __LINE__, #actual, a_, e_);                                 \
+            hostTestFailures++;                                                 \
+        }                                                                       \
+    } while (0)
+
+#define RUN_TEST(function)                                                      \
+    do {                                                                        \
+        int before_ = hostTestFailures;                                         \
+        function();                                                             \
+        printf("%s %s\n", hostTestFailures == before_ ? "PASS" : "FAIL",        \
+               #function);                                                      \
+    } while (0)
+
+#define TEST_RESULT() (hostTestFailures == 0 ? 0 : 1)
+
+#endif // HOST_TEST_H
@@ -0,0 +1,154 @@
+#include <AudioFeatures.h>
+#include <math.h>
+#include <algorithm>
+#include <vector>
+#include "../host_test.h"
+
+// lib/AudioFeatures against a double-precision MFCC of the same definition
+// (pre-emphasis 0.97, periodic Hann over 25 ms, 512-point DFT, triangular
+// mel filters at the bin frequencies, natural log, orthonormal DCT-II) on a
+// 440 Hz + 3 kHz tone: every coefficient within one int8 step.
+
+#define TEST_HOPS       50
+#define TEST_WARM_HOPS  3       // Hops until the 400-sample frame is full
+
+static std::vector<int16_t> tone(double amplitude) {
+    std::vector<int16_t> samples(TEST_HOPS * MFCC_HOP_LENGTH);
+    for (size_t n = 0; n < samples.size(); n++) {
+        double t = (double)n / AUDIO_SAMPLE_RATE;
+        samples[n] = (int16_t)lround(amplitude * (sin(2 * M_PI * 440 * t) + 0.5 * sin(2 * M_PI * 3000 * t)));
+    }
+    return samples;
+}
+
+static double hzToMel(double hz) {
+    return 2595.0 * log10(1.0 + hz / 700.0);
+}
+
+static double melToHz(double mel) {
+    return 700.0 * (pow(10.0, mel / 2595.0) - 1.0);
+}
+
+// Cepstrum of the frame ending with sample end - 1, in natural-log units of
+// the raw int16 power spectrum (what the int8 output counts at scale 1)
+static void referenceMfcc(const std::vector<double>& emphasised, size_t end, double cepstrum[AUDIO_MFCC_NUM_COEFFS]) {
+    double frame[MFCC_FFT_SIZE] = {0};
+    for (int n = 0; n < MFCC_FRAME_LENGTH; n++) {
+        long index = (long)end - MFCC_FRAME_LENGTH + n;
+        double window = 0.5 - 0.5 * cos(2 * M_PI * n / MFCC_FRAME_LENGTH);
+        frame[n] = index >= 0 ? emphasised[index] * window : 0.0;
+    }
+
+    double power[MFCC_NUM_BINS];
+    for (int k = 0; k < MFCC_NUM_BINS; k++) {
+        double re = 0;
+        double im = 0;
+        for (int n = 0; n < MFCC_FRAME_LENGTH; n++) {
+            double a = 2 * M_PI * k * n / MFCC_FFT_SIZE;
+            re += frame[n] * cos(a);
+            im -= frame[n] * sin(a);
+        }
+        power[k] = re * re + im * im;
+    }
+
+    const double binHz = (double)AUDIO_SAMPLE_RATE / MFCC_FFT_SIZE;
+    const double melLow = hzToMel(20.0);
+    const double melHigh = hzToMel(AUDIO_SAMPLE_RATE / 2.0);
+    const double melStep = (melHigh - melLow) / (AUDIO_MFCC_NUM_MEL + 1);
+    double logMel[AUDIO_MFCC_NUM_MEL];
+    for (int m = 0; m < AUDIO_MFCC_NUM_MEL; m++) {
+        double lo = melToHz(melLow + m * melStep);
+        double center = melToHz(melLow + (m + 1) * melStep);
+        double hi = melToHz(melLow + (m + 2) * melStep);
+        int first = (int)ceil(lo / binHz);
+        int last = std::min((int)floor(hi / binHz), MFCC_NUM_BINS - 1);
+
+        double energy = 0;
+        int bins = 0;
+        for (int k = first; k <= last; k++, bins++) {
+            double f = k * binHz;
+            double w = f <= center ? (f - lo) / (center - lo) : (hi - f) / (hi - center);
+            energy += power[k] * std::max(w, 0.0);
+        }
+        if (bins == 0) {
+            energy = power[std::min((int)lround(center / binHz), MFCC_NUM_BINS - 1)];
+        }
+        logMel[m] = log(energy);
+    }
+
+    for (int i = 0; i < AUDIO_MFCC_NUM_COEFFS; i++) {
+        double scale = sqrt((i == 0 ? 1.0 : 2.0) / AUDIO_MFCC_NUM_MEL);
+        double sum = 0;
+        for (int m = 0; m < AUDIO_MFCC_NUM_MEL; m++) {
+            sum += logMel[m] * cos(M_PI * i * (m + 0.5) / AUDIO_MFCC_NUM_MEL);
+        }
+        cepstrum[i] = sum * scale;
+    }
+}
+
+// Worst difference in int8 steps between the front end and the reference
+static int worstStep(double amplitude, float scale, size_t blockSize) {
+    std::vector<int16_t> samples = tone(amplitude);
+    std::vector<double> emphasised(samples.size());
+    for (size_t n = 0; n < samples.size(); n++) {
+        emphasised[n] = samples[n] - 0.97 * (n ? samples[n - 1] : 0);
+    }
+
+    AudioFeatures features;
+    CHECK(features.begin());
+    features.setQuantization(scale, 0);
+
+    int worst = 0;
+    int clipped = 0;
+    size_t hops = 0;
+    features.onFrame([&](const int8_t* mfcc, size_t count) {
+        hops++;
+        if (hops < TEST_WARM_HOPS) {
+            return;
+        }
+        double cepstrum[AUDIO_MFCC_NUM_COEFFS];
+        referenceMfcc(emphasised, hops * MFCC_HOP_LENGTH, cepstrum);
+        for (size_t i = 0; i < count; i++) {
+            long expected = lround(cepstrum[i] / scale);
+            clipped += expected > 127 || expected < -128;
+            expected = std::max(-128L, std::min(127L, expected));
+            worst = std::max(worst, (int)labs(mfcc[i] - expected));
+        }
+    });
+
+    // audioTask hands over whatever the I2S read returned
+    for (size_t offset = 0; offset < samples.size(); offset += blockSize) {
+        features.process(&samples[offset], std::min(blockSize, samples.size() - offset));
+    }
+    CHECK_EQ(hops, TEST_HOPS);
+    CHECK_EQ(clipped, 0);
+    return worst;
+}
+
+// The tone at a normal speaking level, in the blocks audioTask reads
+static void testToneMatchesReference() {
+    CHECK(worstStep(8000, 1.0f, AUDIO_BUFFER_SIZE) <= 1);
+}
+
+// Near full scale, where a 16-bit FFT's rounding floor shows most
+static void testLoudToneMatchesReference() {
+    CHECK(worstStep(20000, 1.0f, AUDIO_BUFFER_SIZE) <= 1);
+}
+
+// A quiet tone exercises the block normalisation: 40 dB down, same answer
+static void testQuietToneMatchesReference() {
+    CHECK(worstStep(80, 1.0f, AUDIO_BUFFER_SIZE) <= 1);
+}
+
+// Steps half as wide, in odd-sized blocks (quiet, so c0 still fits int8)
+static void testFineSteps() {
+    CHECK(worstStep(80, 0.5f, 100) <= 1);
+}
+
+int main() {
+    RUN_TEST(testToneMatchesReference);
+    RUN_TEST(testLoudToneMatchesReference);
+    RUN_TEST(testQuietToneMatchesReference);
+    RUN_TEST(testFineSteps);
+    return TEST_RESULT();
+}
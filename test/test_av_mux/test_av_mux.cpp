@@ -0,0 +1,150 @@
+#include <AVMux.h>
+#include "../host_test.h"
+
+// lib/AVMux: reordering by timestamp, the two late policies, and a full mux
+// whose due head the caller holds back (a destination keeping audio behind
+// a frame that is still going out).
+
+static MuxMessage message(uint8_t type, uint32_t timestamp) {
+    MuxMessage m = { type, timestamp, nullptr, 0, nullptr, 0 };
+    return m;
+}
+
+static MuxPush push(AVMux& mux, uint8_t type, uint32_t timestamp, uint32_t nowMs, uint8_t* depth = nullptr) {
+    uint8_t ignored;
+    MuxMessage evicted;
+    return mux.push(message(type, timestamp), nowMs, depth ? *depth : ignored, evicted);
+}
+
+// Audio arrives after a frame with a later timestamp and goes out first
+static void testReorder() {
+    AVMux mux;
+    mux.setWindow(100);
+    uint8_t depth = 0;
+    CHECK(push(mux, STREAM_MESSAGE_VIDEO, 100, 0, &depth) == MuxPush::QUEUED);
+    CHECK_EQ(depth, 0);
+    CHECK(push(mux, STREAM_MESSAGE_AUDIO, 40, 10, &depth) == MuxPush::QUEUED);
+    CHECK_EQ(depth, 1);
+
+    // The audio has video waiting behind it, so it may go at once
+    MuxMessage out;
+    CHECK(mux.pop(10, out));
+    CHECK_EQ(out.type, STREAM_MESSAGE_AUDIO);
+    CHECK_EQ(out.timestamp, 40);
+
+    // The frame waits for audio up to the window from its own arrival
+    CHECK(!mux.pop(50, out));
+    CHECK_EQ(mux.nextDueMs(50), 50);
+    CHECK(mux.pop(100, out));
+    CHECK_EQ(out.type, STREAM_MESSAGE_VIDEO);
+    CHECK_EQ(out.timestamp, 100);
+    CHECK(mux.isEmpty());
+    CHECK_EQ(mux.nextDueMs(100), UINT32_MAX);
+
+    CHECK_EQ(mux.getReordered(), 1);
+    CHECK_EQ(mux.getMaxDepth(), 1);
+    CHECK_EQ(mux.getLate(), 0);
+}
+
+// Equal timestamps keep their arrival order
+static void testStableOrder() {
+    AVMux mux;
+    mux.setWindow(100);
+    push(mux, STREAM_MESSAGE_VIDEO, 100, 0);
+    push(mux, STREAM_MESSAGE_AUDIO, 100, 1);
+    MuxMessage out;
+    CHECK(mux.pop(UINT32_MAX, out));
+    CHECK_EQ(out.type, STREAM_MESSAGE_VIDEO);
+    CHECK(mux.pop(UINT32_MAX, out));
+    CHECK_EQ(out.type, STREAM_MESSAGE_AUDIO);
+}
+
+// A message behind one already let go: dropped, or sent at that timestamp
+static void testLatePolicies() {
+    AVMux drop;
+    drop.setWindow(0);
+    drop.setLatePolicy(LatePolicy::DROP);
+    MuxMessage out;
+    push(drop, STREAM_MESSAGE_VIDEO, 100, 0);
+    CHECK(drop.pop(0, out));
+    CHECK(push(drop, STREAM_MESSAGE_AUDIO, 50, 1) == MuxPush::LATE);
+    CHECK(drop.isEmpty());
+    CHECK_EQ(drop.getLate(), 1);
+    CHECK_EQ(drop.getEvicted(), 0);
+
+    AVMux clamp;
+    clamp.setWindow(0);
+    clamp.setLatePolicy(LatePolicy::CLAMP);
+    push(clamp, STREAM_MESSAGE_VIDEO, 100, 0);
+    CHECK(clamp.pop(0, out));
+    CHECK(push(clamp, STREAM_MESSAGE_AUDIO, 50, 1) == MuxPush::QUEUED);
+    CHECK_EQ(clamp.getLate(), 1);
+    CHECK(clamp.pop(1, out));
+    CHECK_EQ(out.timestamp, 100);
+
+    // Equal to the last one let go is not late
+    push(clamp, STREAM_MESSAGE_AUDIO, 100, 2);
+    CHECK_EQ(clamp.getLate(), 1);
+}
+
+// The caller holds the due head back, as a destination does with audio
+// while a slow frame goes out: once full, every push makes room by handing
+// back the oldest, and the rest still come out in order afterwards
+static void testFullWhileHeld() {
+    AVMux mux;
+    mux.setWindow(100);
+    uint32_t now = 0;
+    for (uint32_t i = 0; i < AV_MUX_MAX_MESSAGES; i++) {
+        CHECK(push(mux, STREAM_MESSAGE_AUDIO, i * 64, now) == MuxPush::QUEUED);
+        now += 64;
+    }
+    CHECK_EQ(mux.getCount(), AV_MUX_MAX_MESSAGES);
+    CHECK_EQ(mux.nextDueMs(now), 0);
+
+    uint8_t depth;
+    MuxMessage evicted;
+    for (uint32_t i = AV_MUX_MAX_MESSAGES; i < AV_MUX_MAX_MESSAGES + 4; i++) {
+        CHECK(mux.push(message(STREAM_MESSAGE_AUDIO, i * 64), now, depth, evicted) == MuxPush::FULL);
+        CHECK_EQ(evicted.timestamp, (i - AV_MUX_MAX_MESSAGES) * 64);
+        CHECK_EQ(mux.getCount(), AV_MUX_MAX_MESSAGES);
+        now += 64;
+    }
+    CHECK_EQ(mux.getEvicted(), 4);
+    CHECK_EQ(mux.getLate(), 0);
+
+    // Older than everything waiting: it is the one handed back
+    CHECK(mux.push(message(STREAM_MESSAGE_VIDEO, 100), now, depth, evicted) == MuxPush::FULL);
+    CHECK_EQ(evicted.type, STREAM_MESSAGE_VIDEO);
+    CHECK_EQ(evicted.timestamp, 100);
+    CHECK_EQ(depth, 0);
+
+    // A frame among them goes in its place; the oldest audio leaves
+    CHECK(mux.push(message(STREAM_MESSAGE_VIDEO, 600), now, depth, evicted) == MuxPush::FULL);
+    CHECK_EQ(evicted.type, STREAM_MESSAGE_AUDIO);
+    CHECK_EQ(evicted.timestamp, 4 * 64);
+    CHECK_EQ(mux.getEvicted(), 6);
+
+    MuxMessage out;
+    uint32_t last = 0;
+    int popped = 0;
+    int video = 0;
+    bool ordered = true;
+    while (mux.pop(now + 100, out)) {
+        ordered &= out.timestamp >= last;
+        last = out.timestamp;
+        video += out.type == STREAM_MESSAGE_VIDEO;
+        popped++;
+    }
+    CHECK(ordered);
+    CHECK_EQ(popped, AV_MUX_MAX_MESSAGES);
+    CHECK_EQ(video, 1);
+    CHECK(mux.isEmpty());
+}
+
+int main() {
+    RUN_TEST(testReorder);
+    RUN_TEST(testStableOrder);
+    RUN_TEST(testLatePolicies);
+    RUN_TEST(testFullWhileHeld);
+    return TEST_RESULT();
+}
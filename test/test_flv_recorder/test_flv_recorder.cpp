@@ -0,0 +1,255 @@
+#include <FlvRecorder.h>
+#include <config.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include "../host_test.h"
+
+// lib/FlvRecorder on the host (files in a temporary HOST_RECORDER_DIR, the
+// writer driven by service()): the file is a well-formed FLV whose tag sizes
+// and back-pointers chain to the end, the recording starts with the
+// pre-roll, payloads arrive intact across block boundaries, the duration is
+// patched on close, and a full ring drops rather than evicts while
+// recording.
+
+struct FlvTag {
+    uint8_t type;
+    uint32_t timestamp;
+    std::vector<uint8_t> data;
+};
+
+// Payload bytes that say which message they belong to
+static std::vector<uint8_t> payload(uint32_t timestamp, size_t length) {
+    std::vector<uint8_t> data(length);
+    for (size_t i = 0; i < length; i++) {
+        data[i] = (uint8_t)(timestamp * 7 + i);
+    }
+    return data;
+}
+
+static void push(FlvRecorder& recorder, uint8_t type, uint32_t timestamp, size_t length) {
+    std::vector<uint8_t> data = payload(timestamp, length);
+    recorder.push(type, timestamp, data.data(), data.size());
+}
+
+static uint32_t readBE24(const uint8_t* p) {
+    return ((uint32_t)p[0] << 16) | ((uint32_t)p[1] << 8) | p[2];
+}
+
+static uint32_t readBE32(const uint8_t* p) {
+    return ((uint32_t)p[0] << 24) | readBE24(p + 1);
+}
+
+static std::vector<uint8_t> readFile(const char* path) {
+    std::vector<uint8_t> bytes;
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        return bytes;
+    }
+    uint8_t chunk[4096];
+    size_t got;
+    while ((got = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+        bytes.insert(bytes.end(), chunk, chunk + got);
+    }
+    fclose(file);
+    return bytes;
+}
+
+// Splits the file into tags, checking the header and that every
+// PreviousTagSize matches the tag before it and the chain ends at EOF
+static bool parseFlv(const std::vector<uint8_t>& file, std::vector<FlvTag>& tags) {
+    static const uint8_t header[13] = { 'F', 'L', 'V', 1, 0x05, 0, 0, 0, 9, 0, 0, 0, 0 };
+    if (file.size() < sizeof(header) || memcmp(file.data(), header, sizeof(header)) != 0) {
+        return false;
+    }
+    size_t pos = sizeof(header);
+    while (pos < file.size()) {
+        if (file.size() - pos < 11) {
+            return false;
+        }
+        const uint8_t* p = &file[pos];
+        uint32_t dataSize = readBE24(p + 1);
+        if (readBE24(p + 8) != 0 || file.size() - pos < 11 + dataSize + 4) {
+            return false;
+        }
+        if (readBE32(p + 11 + dataSize) != 11 + dataSize) {
+            return false;
+        }
+        FlvTag tag;
+        tag.type = p[0];
+        tag.timestamp = readBE24(p + 4) | ((uint32_t)p[7] << 24);
+        tag.data.assign(p + 11, p + 11 + dataSize);
+        tags.push_back(tag);
+        pos += 11 + dataSize + 4;
+    }
+    return pos == file.size();
+}
+
+// A number from the onMetaData ECMA array, or -1
+static double metaNumber(const FlvTag& tag, const char* name) {
+    const std::vector<uint8_t>& d = tag.data;
+    static const char onMetaData[] = "onMetaData";
+    size_t pos = 3 + strlen(onMetaData);
+    if (tag.type != 18 || d.size() < pos + 5 || d[0] != 0x02 || d[pos] != 0x08) {
+        return -1;
+    }
+    uint32_t count = readBE32(&d[pos + 1]);
+    pos += 5;
+    for (uint32_t i = 0; i < count && pos + 2 < d.size(); i++) {
+        size_t nameLen = ((size_t)d[pos] << 8) | d[pos + 1];
+        std::string key((const char*)&d[pos + 2], nameLen);
+        pos += 2 + nameLen;
+        uint8_t marker = d[pos++];
+        if (marker == 0x00) {
+            uint64_t bits = 0;
+            for (int b = 0; b < 8; b++) {
+                bits = (bits << 8) | d[pos + b];
+            }
+            pos += 8;
+            if (key == name) {
+                double value;
+                memcpy(&value, &bits, sizeof(value));
+                return value;
+            }
+        } else if (marker == 0x01) {
+            pos += 1;
+        } else if (marker == 0x02) {
+            pos += 2 + (((size_t)d[pos] << 8) | d[pos + 1]);
+        } else {
+            return -1;
+        }
+    }
+    return -1;
+}
+
+// Media tags must carry the messages pushed at firstMs..lastMs, every
+// stepMs alternating video and audio, with timestamps from the first one
+static void checkMediaTags(const std::vector<FlvTag>& tags, uint32_t firstMs, uint32_t lastMs, uint32_t stepMs,
+                           size_t videoBytes, size_t audioBytes) {
+    CHECK_EQ(tags.size(), 1 + (lastMs - firstMs) / stepMs + 1);
+    uint32_t timestamp = firstMs;
+    for (size_t i = 1; i < tags.size(); i++, timestamp += stepMs) {
+        const FlvTag& tag = tags[i];
+        bool video = (timestamp / stepMs) % 2 == 0;
+        CHECK_EQ(tag.type, video ? 9 : 8);
+        CHECK_EQ(tag.timestamp, timestamp - firstMs);
+        CHECK_EQ(tag.data.size(), 1 + (video ? videoBytes : audioBytes));
+        if (tag.data.empty()) {
+            continue;
+        }
+        CHECK_EQ(tag.data[0], video ? 0x11 : 0x32);
+        std::vector<uint8_t> expected = payload(timestamp, video ? videoBytes : audioBytes);
+        CHECK(memcmp(&tag.data[1], expected.data(), expected.size()) == 0);
+    }
+}
+
+static void pushRange(FlvRecorder& recorder, uint32_t firstMs, uint32_t lastMs, uint32_t stepMs,
+                      size_t videoBytes, size_t audioBytes) {
+    for (uint32_t t = firstMs; t <= lastMs; t += stepMs) {
+        bool video = (t / stepMs) % 2 == 0;
+        push(recorder, video ? STREAM_MESSAGE_VIDEO : STREAM_MESSAGE_AUDIO, t, video ? videoBytes : audioBytes);
+    }
+}
+
+// Frames larger than a storage block, so tags straddle block writes
+#define TEST_VIDEO_BYTES    (RECORDER_BLOCK_BYTES + 1234)
+#define TEST_AUDIO_BYTES    2048
+#define TEST_STEP_MS        50
+
+// A trigger keeps the last second, then everything until stop()
+static void testPreRollAndDuration() {
+    FlvRecorder recorder;
+    CHECK(recorder.begin(1024 * 1024, 1000, false));
+    recorder.setVideoInfo(320, 240, 10.0f);
+
+    pushRange(recorder, 0, 2950, TEST_STEP_MS, TEST_VIDEO_BYTES, TEST_AUDIO_BYTES);
+    recorder.trigger(60000);
+    recorder.service();
+    CHECK(recorder.isRecording());
+    pushRange(recorder, 3000, 4950, TEST_STEP_MS, TEST_VIDEO_BYTES, TEST_AUDIO_BYTES);
+    recorder.service();
+    recorder.stop();
+    recorder.service();
+    CHECK(!recorder.isRecording());
+    CHECK_EQ(recorder.getFiles(), 1);
+    CHECK_EQ(recorder.getDropped(), 0);
+
+    std::vector<uint8_t> file = readFile(recorder.getPath());
+    CHECK_EQ(file.size(), recorder.getBytesWritten());
+    std::vector<FlvTag> tags;
+    CHECK(parseFlv(file, tags));
+    if (tags.empty()) {
+        return;
+    }
+
+    // The pre-roll reaches back 1000 ms from the newest message at the trigger
+    CHECK_EQ(tags[0].type, 18);
+    CHECK_EQ(tags[0].timestamp, 0);
+    checkMediaTags(tags, 1950, 4950, TEST_STEP_MS, TEST_VIDEO_BYTES, TEST_AUDIO_BYTES);
+
+    CHECK(metaNumber(tags[0], "duration") == 3.0);
+    CHECK(metaNumber(tags[0], "width") == 320);
+    CHECK(metaNumber(tags[0], "height") == 240);
+    CHECK(metaNumber(tags[0], "audiosamplerate") == AUDIO_SAMPLE_RATE);
+    unlink(recorder.getPath());
+}
+
+// Between recordings a ring too small for the pre-roll evicts the oldest
+// (wrapping round the block); nothing counts as dropped
+static void testSmallRingKeepsNewest() {
+    FlvRecorder recorder;
+    CHECK(recorder.begin(4 * (TEST_AUDIO_BYTES + 16) + 8, 60000, false));
+
+    pushRange(recorder, 0, 950, TEST_STEP_MS, TEST_AUDIO_BYTES, TEST_AUDIO_BYTES);
+    recorder.trigger(60000);
+    recorder.service();
+    recorder.stop();
+    recorder.service();
+    CHECK_EQ(recorder.getDropped(), 0);
+
+    std::vector<uint8_t> file = readFile(recorder.getPath());
+    std::vector<FlvTag> tags;
+    CHECK(parseFlv(file, tags));
+    checkMediaTags(tags, 800, 950, TEST_STEP_MS, TEST_AUDIO_BYTES, TEST_AUDIO_BYTES);
+    CHECK(!tags.empty() && metaNumber(tags[0], "duration") == 0.15);
+    unlink(recorder.getPath());
+}
+
+// While recording the writer owns the ring: when it is full the new message
+// is dropped and counted, and what was kept is written intact
+static void testFullRingDropsWhileRecording() {
+    FlvRecorder recorder;
+    CHECK(recorder.begin(4 * (TEST_AUDIO_BYTES + 16) + 8, 60000, false));
+    recorder.trigger(60000);
+    recorder.service();
+    CHECK(recorder.isRecording());
+
+    pushRange(recorder, 0, 450, TEST_STEP_MS, TEST_AUDIO_BYTES, TEST_AUDIO_BYTES);
+    CHECK_EQ(recorder.getDropped(), 6);
+    recorder.stop();
+    recorder.service();
+
+    std::vector<uint8_t> file = readFile(recorder.getPath());
+    std::vector<FlvTag> tags;
+    CHECK(parseFlv(file, tags));
+    checkMediaTags(tags, 0, 150, TEST_STEP_MS, TEST_AUDIO_BYTES, TEST_AUDIO_BYTES);
+    unlink(recorder.getPath());
+}
+
+int main() {
+    char directory[] = "/tmp/test_flv_recorder.XXXXXX";
+    if (!mkdtemp(directory)) {
+        perror("mkdtemp");
+        return 1;
+    }
+    setenv("HOST_RECORDER_DIR", directory, 1);
+
+    RUN_TEST(testPreRollAndDuration);
+    RUN_TEST(testSmallRingKeepsNewest);
+    RUN_TEST(testFullRingDropsWhileRecording);
+
+    rmdir(directory);
+    return TEST_RESULT();
+}
@@ -0,0 +1,166 @@
+#include <math.h>
+#include <stdint.h>
+#include <FramePacer.h>
+#include "../host_test.h"
+
+// lib/FramePacer against a simulated clock: no drift over long runs, missed
+// slots skipped rather than run back to back, and the jitter it reports.
+//
+// The loop under test oversleeps by up to 1 ms (tick rounding), works for
+// 5-25 ms per frame and, in the stall runs, stops for 50-100 ms on 1% of
+// frames, as a capture loop does when the sensor or WiFi holds it up.
+
+static uint64_t simNow = 0;
+static uint32_t sleeps = 0;
+static uint32_t rng = 1;
+
+static uint32_t nextRandom(uint32_t range) {
+    rng = rng * 1664525u + 1013904223u;
+    return (rng >> 8) % range;
+}
+
+static uint64_t simClock() {
+    return simNow;
+}
+
+static void simSleep(uint32_t micros) {
+    simNow += micros + nextRandom(1000);
+    sleeps++;
+}
+
+#define BUNCH_WINDOW 11
+
+struct RunResult {
+    uint64_t elapsed;
+    uint64_t maxLateness;       // Wake after its slot's deadline, frames that slept
+    uint64_t maxLatenessLate;   // The same, frames that ran without sleeping
+    uint64_t minWindow;         // Shortest time BUNCH_WINDOW frames took
+    bool slotsIncrease;
+};
+
+static RunResult run(FramePacer& pacer, float fps, uint32_t frames, bool stalls) {
+    simNow = 1000000;
+    rng = 12345;
+    pacer.begin(fps);
+
+    RunResult result = { 0, 0, 0, UINT64_MAX, true };
+    uint64_t wakes[BUNCH_WINDOW] = { 0 };
+    uint64_t start = 0;
+    uint64_t lastSlot = 0;
+    double period = 1e6 / fps;
+    for (uint32_t i = 0; i < frames; i++) {
+        uint32_t sleepsBefore = sleeps;
+        pacer.wait();
+        bool slept = sleeps != sleepsBefore;
+        if (i == 0) {
+            start = simNow;
+        } else {
+            result.slotsIncrease &= pacer.getSlotIndex() > lastSlot;
+        }
+        lastSlot = pacer.getSlotIndex();
+
+        // How far behind its own slot this frame started
+        uint64_t due = start + (uint64_t)floor(lastSlot * period);
+        uint64_t lateness = simNow > due ? simNow - due : 0;
+        uint64_t& worst = slept || i == 0 ? result.maxLateness : result.maxLatenessLate;
+        worst = lateness > worst ? lateness : worst;
+
+        if (i >= BUNCH_WINDOW && simNow - wakes[i % BUNCH_WINDOW] < result.minWindow) {
+            result.minWindow = simNow - wakes[i % BUNCH_WINDOW];
+        }
+        wakes[i % BUNCH_WINDOW] = simNow;
+
+        simNow += 5000 + nextRandom(20000);
+        if (stalls && nextRandom(100) == 0) {
+            simNow += 50000 + nextRandom(50000);
+        }
+    }
+    result.elapsed = simNow - start;
+    return result;
+}
+
+// A million frames (9.3 h at 30 fps) land on exactly the slots the elapsed
+// time allows: nothing accumulates from oversleeping or work time
+static void testNoDrift() {
+    FramePacer pacer(simClock, simSleep);
+    const uint32_t frames = 1000000;
+    RunResult result = run(pacer, 30.0f, frames, false);
+
+    double expectedSlots = result.elapsed * 30.0 / 1e6;
+    CHECK(fabs((double)pacer.getSlotIndex() - expectedSlots) < 1.0);
+    CHECK_EQ(pacer.getFrames(), frames);
+    CHECK_EQ(pacer.getSkipped(), 0);
+    CHECK_EQ(pacer.getSlotIndex(), frames - 1);
+    CHECK(result.maxLateness <= 1000);      // Never more than one oversleep behind
+    CHECK_EQ(result.maxLatenessLate, 0);
+    CHECK(pacer.getJitterPercentile(50) <= 1000);
+    CHECK(pacer.getJitterPercentile(99) <= 1000);
+    CHECK(pacer.getMaxJitterMicros() < 1000);
+}
+
+// NTSC rates are held in millihertz, so 29.97 fps does not drift either
+static void testFractionalRate() {
+    FramePacer pacer(simClock, simSleep);
+    RunResult result = run(pacer, 29.97f, 300000, false);
+
+    double expectedSlots = result.elapsed * 29.97 / 1e6;
+    CHECK(fabs((double)pacer.getSlotIndex() - expectedSlots) < 1.0);
+    CHECK_EQ(pacer.getSkipped(), 0);
+    CHECK_EQ(pacer.getPeriodMicros(), 33366);
+}
+
+// With stalls, slots the loop missed are skipped: the slot count still
+// follows the elapsed time, a late frame takes the latest slot rather than
+// an old one, and no run of frames comes faster than the slots they use
+static void testStallsSkipSlots() {
+    FramePacer pacer(simClock, simSleep);
+    const uint32_t frames = 1000000;
+    RunResult result = run(pacer, 30.0f, frames, true);
+
+    double expectedSlots = result.elapsed * 30.0 / 1e6;
+    CHECK(fabs((double)pacer.getSlotIndex() - expectedSlots) < 1.0);
+    CHECK_EQ(pacer.getFrames(), frames);
+    CHECK(pacer.getSkipped() > 0);
+    CHECK_EQ((uint64_t)pacer.getFrames() + pacer.getSkipped(), pacer.getSlotIndex() + 1);
+    CHECK(result.slotsIncrease);
+    CHECK(result.maxLateness <= 1000);
+    CHECK(result.maxLatenessLate < pacer.getPeriodMicros());
+    CHECK(result.minWindow >= (BUNCH_WINDOW - 1) * pacer.getPeriodMicros());
+
+    // 1% of frames stall for 1.5-3 periods, skipping one or two slots each
+    double stallShare = (double)pacer.getSkipped() / frames;
+    CHECK(stallShare > 0.008 && stallShare < 0.02);
+
+    // Most intervals are on time to within the oversleep; the stalls
+    // show up in the tail
+    CHECK(pacer.getJitterPercentile(50) <= 1000);
+    CHECK(pacer.getJitterPercentile(95) <= 1000);
+    CHECK(pacer.getJitterPercentile(99.9f) > 1000);
+    CHECK(pacer.getMaxJitterMicros() >= 10000);
+}
+
+// reset() starts a new grid from the next wait, so a pause is not made up
+static void testResetAfterPause() {
+    FramePacer pacer(simClock, simSleep);
+    simNow = 0;
+    pacer.begin(10.0f);
+    for (int i = 0; i < 10; i++) {
+        pacer.wait();
+    }
+    uint64_t slots = pacer.getSlotIndex();
+    simNow += 5000000;
+    pacer.reset();
+    CHECK_EQ(pacer.wait(), 0);
+    CHECK_EQ(pacer.getSlotIndex(), 0);
+    CHECK_EQ(pacer.wait(), 0);
+    CHECK_EQ(pacer.getSkipped(), 0);
+    CHECK_EQ(slots, 9);
+}
+
+int main() {
+    RUN_TEST(testNoDrift);
+    RUN_TEST(testFractionalRate);
+    RUN_TEST(testStallsSkipSlots);
+    RUN_TEST(testResetAfterPause);
+    return TEST_RESULT();
+}
@@ -0,0 +1,242 @@
+#include <JpegOverlay.h>
+#include <SyntheticJpeg.h>
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+#include "../host_test.h"
+
+// lib/JpegOverlay on synthetic QVGA and VGA frames, greyscale and 4:2:2,
+// with and without restart markers: the output decodes, only the MCUs under
+// the box change, restart markers stay in sequence, and the scan ends in at
+// most seven bits of 1-padding right before EOI.
+
+#define OVERLAY_TEXT    "CAM1 2026-10-18 12:34:56"
+
+// Every component decoded to its own plane, plus where the scan ended
+struct Decoded {
+    JpegInfo info;
+    std::vector<uint8_t> planes[JPEG_MAX_COMPONENTS];
+    size_t planeWidth[JPEG_MAX_COMPONENTS];
+    int restarts;
+    int padding;
+    size_t eoiOffset;
+};
+
+// Reference float IDCT of a dequantised zigzag block
+static void inverseDct(const int16_t coeffs[64], const uint16_t quant[64], uint8_t* out, size_t stride) {
+    static float basis[8][8];
+    static bool ready = false;
+    if (!ready) {
+        for (int x = 0; x < 8; x++) {
+            for (int u = 0; u < 8; u++) {
+                basis[x][u] = (u == 0 ? sqrtf(0.5f) : 1.0f) * cosf((2 * x + 1) * u * (float)M_PI / 16.0f) / 2.0f;
+            }
+        }
+        ready = true;
+    }
+
+    float f[64];
+    for (int k = 0; k < 64; k++) {
+        f[kJpegZigzag[k]] = (float)coeffs[k] * quant[k];
+    }
+    float rows[64];
+    for (int v = 0; v < 8; v++) {
+        for (int x = 0; x < 8; x++) {
+            float sum = 0;
+            for (int u = 0; u < 8; u++) {
+                sum += basis[x][u] * f[v * 8 + u];
+            }
+            rows[v * 8 + x] = sum;
+        }
+    }
+    for (int y = 0; y < 8; y++) {
+        for (int x = 0; x < 8; x++) {
+            float sum = 128.0f;
+            for (int v = 0; v < 8; v++) {
+                sum += basis[y][v] * rows[v * 8 + x];
+            }
+            int value = (int)lroundf(sum);
+            out[y * stride + x] = (uint8_t)(value < 0 ? 0 : (value > 255 ? 255 : value));
+        }
+    }
+}
+
+static bool decode(const uint8_t* jpeg, size_t len, Decoded& d) {
+    if (!jpegParse(jpeg, len, d.info)) {
+        return false;
+    }
+    const JpegInfo& info = d.info;
+    for (int c = 0; c < info.numComponents; c++) {
+        const JpegComponent& comp = info.components[c];
+        d.planeWidth[c] = (size_t)info.mcusX * comp.h * 8;
+        d.planes[c].assign(d.planeWidth[c] * info.mcusY * comp.v * 8, 0);
+    }
+
+    JpegBitReader reader;
+    reader.begin(jpeg, len, info.scanOffset);
+    int16_t pred[JPEG_MAX_COMPONENTS] = {0};
+    int16_t coeffs[64];
+    const uint32_t totalMcus = (uint32_t)info.mcusX * info.mcusY;
+    d.restarts = 0;
+    for (uint32_t mcu = 0; mcu < totalMcus; mcu++) {
+        const uint16_t ri = info.restartInterval;
+        if (ri && mcu > 0 && mcu % ri == 0) {
+            // Only padding may be left before the marker, and RSTn counts 0-7
+            int left = reader.bitsAvailable();
+            if (left >= 8 || reader.marker() != JPEG_RST0 + ((mcu / ri - 1) & 7)) {
+                return false;
+            }
+            if (!reader.consumeRestart()) {
+                return false;
+            }
+            memset(pred, 0, sizeof(pred));
+            d.restarts++;
+        }
+        const uint32_t row = mcu / info.mcusX;
+        const uint32_t col = mcu % info.mcusX;
+        for (int c = 0; c < info.numComponents; c++) {
+            const JpegComponent& comp = info.components[c];
+            for (int by = 0; by < comp.v; by++) {
+                for (int bx = 0; bx < comp.h; bx++) {
+                    if (!jpegDecodeBlock(reader, info.dc[comp.td], info.ac[comp.ta], pred[c], coeffs)) {
+                        return false;
+                    }
+                    size_t px = (col * comp.h + bx) * 8;
+                    size_t py = (row * comp.v + by) * 8;
+                    inverseDct(coeffs, info.quant[comp.tq], &d.planes[c][py * d.planeWidth[c] + px], d.planeWidth[c]);
+                }
+            }
+        }
+    }
+
+    // What is left must be 1-padding, and the marker that ends it EOI
+    d.padding = reader.bitsAvailable();
+    if (d.padding > 0 && reader.peek(d.padding) != (1u << d.padding) - 1) {
+        return false;
+    }
+    if (reader.marker() != JPEG_EOI) {
+        return false;
+    }
+    d.eoiOffset = reader.rawOffset();
+    return true;
+}
+
+struct OverlayCase {
+    const char* name;
+    uint16_t width;
+    uint16_t height;
+    bool colour;
+    uint16_t restartInterval;
+    uint8_t scale;
+    uint16_t x;
+    uint16_t y;
+};
+
+static void runCase(const OverlayCase& test) {
+    SyntheticJpeg camera;
+    camera.begin(test.width, test.height, 12, test.colour);
+    camera.setRestartInterval(test.restartInterval);
+
+    JpegOverlay overlay;
+    overlay.setPosition(test.x, test.y);
+    overlay.setScale(test.scale);
+    overlay.setText(OVERLAY_TEXT);
+
+    // Successive frames end the band and the scan at different bit offsets
+    for (uint32_t frame = 0; frame < 16; frame++) {
+        std::vector<uint8_t> jpeg;
+        CHECK(camera.capture(frame, jpeg));
+
+        std::vector<uint8_t> out(JpegOverlay::maxOutputSize(jpeg.size()));
+        size_t outLen = overlay.apply(jpeg.data(), jpeg.size(), out.data(), out.size());
+        CHECK(outLen > 0);
+        if (outLen == 0) {
+            printf("  %s frame %u: apply failed\n", test.name, frame);
+            return;
+        }
+
+        Decoded before;
+        Decoded after;
+        CHECK(decode(jpeg.data(), jpeg.size(), before));
+        bool decoded = decode(out.data(), outLen, after);
+        CHECK(decoded);
+        if (!decoded) {
+            printf("  %s frame %u: output does not decode\n", test.name, frame);
+            return;
+        }
+
+        // No stray byte between the last block and EOI, nothing after it
+        CHECK(after.padding < 8);
+        CHECK_EQ(after.eoiOffset + 2, outLen);
+        CHECK_EQ(after.restarts, before.restarts);
+
+        // The box covers whole MCUs from the one holding (x, y)
+        const JpegInfo& info = after.info;
+        size_t boxWidth = (strlen(OVERLAY_TEXT) * 6 + 2) * test.scale;
+        size_t boxHeight = 8 * test.scale;
+        uint32_t col0 = test.x / info.mcuWidth;
+        uint32_t row0 = test.y / info.mcuHeight;
+        uint32_t col1 = std::min<uint32_t>(info.mcusX - 1, col0 + (boxWidth + info.mcuWidth - 1) / info.mcuWidth - 1);
+        uint32_t row1 = std::min<uint32_t>(info.mcusY - 1, row0 + (boxHeight + info.mcuHeight - 1) / info.mcuHeight - 1);
+
+        int outsideChanged = 0;
+        int dark = 0;
+        int bright = 0;
+        for (int c = 0; c < info.numComponents; c++) {
+            const JpegComponent& comp = info.components[c];
+            const size_t width = after.planeWidth[c];
+            const size_t height = after.planes[c].size() / width;
+            for (size_t py = 0; py < height; py++) {
+                for (size_t px = 0; px < width; px++) {
+                    uint32_t col = (uint32_t)(px / (comp.h * 8));
+                    uint32_t row = (uint32_t)(py / (comp.v * 8));
+                    bool inBox = col >= col0 && col <= col1 && row >= row0 && row <= row1;
+                    uint8_t value = after.planes[c][py * width + px];
+                    if (!inBox) {
+                        outsideChanged += value != before.planes[c][py * width + px];
+                    } else if (c == 0) {
+                        dark += value < 64;
+                        bright += value > 176;
+                    }
+                }
+            }
+        }
+        CHECK_EQ(outsideChanged, 0);
+        CHECK(dark > 0);
+        CHECK(bright > 0);
+    }
+}
+
+static void testQvga() {
+    runCase({ "QVGA 4:2:2", 320, 240, true, 0, 1, 0, 0 });
+    runCase({ "QVGA grey", 320, 240, false, 0, 1, 24, 120 });
+}
+
+static void testQvgaRestarts() {
+    runCase({ "QVGA 4:2:2 DRI", 320, 240, true, 7, 1, 0, 0 });
+    runCase({ "QVGA grey DRI", 320, 240, false, 40, 1, 24, 120 });
+}
+
+static void testVga() {
+    runCase({ "VGA 4:2:2", 640, 480, true, 0, 2, 16, 200 });
+}
+
+static void testVgaRestarts() {
+    runCase({ "VGA 4:2:2 DRI", 640, 480, true, 10, 2, 16, 200 });
+}
+
+// The box on the last MCU row: the band runs to the end of the scan
+static void testBottomEdge() {
+    runCase({ "QVGA 4:2:2 bottom", 320, 240, true, 0, 1, 160, 232 });
+    runCase({ "QVGA 4:2:2 bottom DRI", 320, 240, true, 7, 1, 160, 232 });
+}
+
+int main() {
+    RUN_TEST(testQvga);
+    RUN_TEST(testQvgaRestarts);
+    RUN_TEST(testVga);
+    RUN_TEST(testVgaRestarts);
+    RUN_TEST(testBottomEdge);
+    return TEST_RESULT();
+}
@@ -0,0 +1,229 @@
+#include <string.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <SharedFrame.h>
+#include "../host_test.h"
+
+// Ownership and leak accounting of lib/SharedFrame: FrameRef reference
+// counts, pool exhaustion, detach() and recycling, and releases on other
+// threads. Every test ends with the pool empty and every driver frame back.
+
+static std::atomic<uint32_t> driverReturns(0);
+
+static void returnFrame(camera_fb_t* fb) {
+    (void)fb;
+    driverReturns.fetch_add(1);
+}
+
+struct DriverFrames {
+    uint8_t data[FRAME_POOL_SIZE + 4][64];
+    camera_fb_t fbs[FRAME_POOL_SIZE + 4];
+
+    DriverFrames() {
+        for (int i = 0; i < FRAME_POOL_SIZE + 4; i++) {
+            memset(data[i], i, sizeof(data[i]));
+            memset(&fbs[i], 0, sizeof(fbs[i]));
+            fbs[i].buf = data[i];
+            fbs[i].len = sizeof(data[i]);
+        }
+    }
+};
+
+static void checkNoLeaks(const FramePool& pool) {
+    CHECK_EQ(pool.getLiveFrames(), 0);
+    CHECK_EQ(pool.getLiveCopies(), 0);
+    CHECK_EQ(driverReturns.load(), pool.getWrapped());
+}
+
+static void testCopyAndMove() {
+    driverReturns = 0;
+    FramePool pool(returnFrame);
+    DriverFrames driver;
+    {
+        FrameRef first(pool.wrap(&driver.fbs[0]));
+        CHECK(first);
+        CHECK_EQ(first->refs(), 1);
+
+        FrameRef copied(first);
+        CHECK_EQ(first->refs(), 2);
+        FrameRef assigned;
+        assigned = copied;
+        CHECK_EQ(first->refs(), 3);
+
+        FrameRef moved(std::move(copied));
+        CHECK(!copied);
+        CHECK_EQ(first->refs(), 3);
+        FrameRef moveAssigned;
+        moveAssigned = std::move(moved);
+        CHECK(!moved);
+        CHECK_EQ(first->refs(), 3);
+
+        assigned = assigned;
+        CHECK_EQ(first->refs(), 3);
+
+        SharedFrame* shared = first.share();
+        CHECK_EQ(first->refs(), 4);
+        shared->release();
+        CHECK_EQ(first->refs(), 3);
+
+        SharedFrame* taken = moveAssigned.take();
+        CHECK(!moveAssigned);
+        CHECK_EQ(first->refs(), 3);
+        taken->release();
+
+        assigned.reset();
+        CHECK_EQ(first->refs(), 1);
+        CHECK_EQ(driverReturns.load(), 0);
+        CHECK_EQ(pool.getLiveFrames(), 1);
+    }
+    CHECK_EQ(driverReturns.load(), 1);
+    checkNoLeaks(pool);
+}
+
+static void testExhaustion() {
+    driverReturns = 0;
+    FramePool pool(returnFrame);
+    DriverFrames driver;
+    std::vector<FrameRef> held;
+    for (int i = 0; i < FRAME_POOL_SIZE; i++) {
+        held.emplace_back(pool.wrap(&driver.fbs[i]));
+        CHECK(held.back());
+        CHECK_EQ(held.back()->sequence(), i);
+    }
+    CHECK_EQ(pool.getLiveFrames(), FRAME_POOL_SIZE);
+
+    // A full pool hands the frame straight back to the driver
+    CHECK(pool.wrap(&driver.fbs[FRAME_POOL_SIZE]) == nullptr);
+    CHECK_EQ(driverReturns.load(), 1);
+    CHECK_EQ(pool.getFailures(), 1);
+    CHECK(pool.copy(held[0].get()) == nullptr);
+    CHECK_EQ(pool.getFailures(), 2);
+    CHECK_EQ(pool.getLiveCopies(), 0);
+
+    // A released slot is reused
+    SharedFrame* freed = held[3].get();
+    held[3].reset();
+    FrameRef again(pool.wrap(&driver.fbs[FRAME_POOL_SIZE + 1]));
+    CHECK(again.get() == freed);
+
+    held.clear();
+    again.reset();
+    CHECK_EQ(pool.getLiveFrames(), 0);
+    CHECK_EQ(driverReturns.load(), FRAME_POOL_SIZE + 2);
+}
+
+static void testDetachAndRecycle() {
+    driverReturns = 0;
+    FramePool pool(returnFrame);
+    DriverFrames driver;
+    driver.fbs[0].width = 320;
+    driver.fbs[0].height = 240;
+
+    FrameRef original(pool.wrap(&driver.fbs[0]));
+    FrameRef consumer(original);
+    CHECK_EQ(original->refs(), 2);
+
+    // The consumer trades its reference for a private copy
+    FrameRef detached(pool.detach(consumer.take()));
+    CHECK(detached);
+    CHECK(detached->isCopy());
+    CHECK(!original->isCopy());
+    CHECK_EQ(original->refs(), 1);
+    CHECK_EQ(detached->refs(), 1);
+    CHECK(detached->data() != original->data());
+    CHECK_EQ(detached->length(), original->length());
+    CHECK(memcmp(detached->data(), original->data(), original->length()) == 0);
+    CHECK_EQ(detached->sequence(), original->sequence());
+    CHECK_EQ(detached->fb()->width, 320);
+    CHECK_EQ(pool.getLiveCopies(), 1);
+
+    // Releasing the original returns the driver buffer while the copy lives
+    original.reset();
+    CHECK_EQ(driverReturns.load(), 1);
+    CHECK_EQ(pool.getReturned(), 1);
+    CHECK_EQ(pool.getLiveFrames(), 1);
+    CHECK(memcmp(detached->data(), driver.data[0], sizeof(driver.data[0])) == 0);
+
+    // A copy detaches to itself
+    SharedFrame* same = pool.detach(detached.get());
+    CHECK(same == detached.get());
+    CHECK_EQ(pool.getCopies(), 1);
+
+    detached.reset();
+    CHECK_EQ(pool.getLiveCopies(), 0);
+
+    // Derived frames keep the description and start empty
+    FrameRef source(pool.wrap(&driver.fbs[1]));
+    FrameRef derived(pool.allocate(source.get(), 256));
+    CHECK(derived);
+    CHECK_EQ(derived->length(), 0);
+    CHECK_EQ(derived->sequence(), source->sequence());
+    derived.reset();
+    source.reset();
+    checkNoLeaks(pool);
+}
+
+// One producer wraps frames and shares each with consumer threads that
+// release them in whatever order they finish, as the stream, recorder and
+// RTMP destination tasks do
+static void testCrossThreadRelease() {
+    driverReturns = 0;
+    FramePool pool(returnFrame);
+    DriverFrames driver;
+    const int consumers = 3;
+    const int frames = 20000;
+
+    std::atomic<SharedFrame*> slots[consumers];
+    for (int c = 0; c < consumers; c++) {
+        slots[c] = nullptr;
+    }
+    std::atomic<bool> done(false);
+    std::vector<std::thread> threads;
+    for (int c = 0; c < consumers; c++) {
+        threads.emplace_back([&, c]() {
+            while (!done.load() || slots[c].load()) {
+                SharedFrame* frame = slots[c].exchange(nullptr);
+                if (frame) {
+                    frame->release();
+                } else {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    uint32_t dropped = 0;
+    for (int i = 0; i < frames; i++) {
+        FrameRef frame(pool.wrap(&driver.fbs[i % (FRAME_POOL_SIZE + 4)]));
+        if (!frame) {
+            dropped++;
+            continue;
+        }
+        for (int c = 0; c < consumers; c++) {
+            // A consumer that has not taken the last one gets the newer frame
+            SharedFrame* previous = slots[c].exchange(frame.share());
+            if (previous) {
+                previous->release();
+            }
+        }
+    }
+    done = true;
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    CHECK_EQ(pool.getWrapped(), frames - dropped);
+    CHECK_EQ(pool.getFailures(), dropped);
+    CHECK_EQ(driverReturns.load(), frames);     // Dropped frames go straight back too
+    CHECK_EQ(pool.getLiveFrames(), 0);
+    CHECK_EQ(pool.getLiveCopies(), 0);
+}
+
+int main() {
+    RUN_TEST(testCopyAndMove);
+    RUN_TEST(testExhaustion);
+    RUN_TEST(testDetachAndRecycle);
+    RUN_TEST(testCrossThreadRelease);
+    return TEST_RESULT();
+}
@@ -0,0 +1,279 @@
+// Inspects, unpacks and builds capture traces (see lib/CaptureTrace).
+//
+//   info     frame count, rate and size distribution, audio, duration
+//   extract  frames to DIR/frame_NNNNNN.jpg, audio to DIR/audio.s16le
+//   pack     a trace from a directory of *.jpg (at --fps) and optional raw
+//            s16le PCM, for footage that was not recorded on a device
+//
+// A device records with "capture" on the serial console; fetch the result
+// with curl http://<camera>:9100/capture -o scene.ctrace and replay it with
+// HOST_CAPTURE_TRACE=scene.ctrace ./build/camera_host.
+//
+// Build (host):
+//   g++ -O2 -std=gnu++17 -Ilib/CaptureTrace
+//       tools/capture_trace/capture_trace.cpp lib/CaptureTrace/CaptureTrace.cpp -o capture_trace
+//
+// Usage:
+//   capture_trace info FILE
+//   capture_trace extract FILE DIR
+//   capture_trace pack OUT JPEG_DIR [--fps F] [--audio PCM] [--rate HZ] [--block N]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <dirent.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <CaptureTrace.h>
+
+static bool readFile(const char* path, std::vector<uint8_t>& out) {
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        return false;
+    }
+    uint8_t chunk[65536];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) {
+        out.insert(out.end(), chunk, chunk + n);
+    }
+    fclose(f);
+    return true;
+}
+
+static bool openTrace(const char* path, std::vector<uint8_t>& data, CaptureTraceReader& reader) {
+    if (!readFile(path, data)) {
+        fprintf(stderr, "Cannot read %s\n", path);
+        return false;
+    }
+    if (!reader.open(data.data(), data.size())) {
+        fprintf(stderr, "%s is not a capture trace\n", path);
+        return false;
+    }
+    return true;
+}
+
+static double percentile(const std::vector<double>& sorted, double p) {
+    if (sorted.empty()) {
+        return 0.0;
+    }
+    size_t rank = (size_t)ceil(p / 100.0 * sorted.size());
+    rank = rank < 1 ? 1 : (rank > sorted.size() ? sorted.size() : rank);
+    return sorted[rank - 1];
+}
+
+static int info(const char* path) {
+    std::vector<uint8_t> data;
+    CaptureTraceReader reader;
+    if (!openTrace(path, data, reader)) {
+        return 1;
+    }
+
+    std::vector<double> sizes;
+    std::vector<double> intervals;
+    int64_t lastFrame = 0;
+    int64_t end = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t blocks = 0;
+    uint64_t samples = 0;
+    CaptureTraceRecord record;
+    while (reader.next(record)) {
+        end = std::max(end, record.micros);
+        if (record.kind == CAPTURE_TRACE_VIDEO) {
+            if (!sizes.empty()) {
+                intervals.push_back((record.micros - lastFrame) / 1000.0);
+            }
+            lastFrame = record.micros;
+            sizes.push_back(record.length);
+            width = record.width;
+            height = record.height;
+        } else if (record.kind == CAPTURE_TRACE_AUDIO) {
+            blocks++;
+            samples += record.length / 2;
+        }
+    }
+
+    printf("%s: %zu bytes, %.2f s%s\n", path, data.size(), end / 1e6,
+           reader.isTruncated() ? " (truncated at the end)" : "");
+    if (!sizes.empty()) {
+        double total = 0.0;
+        for (double s : sizes) {
+            total += s;
+        }
+        std::sort(sizes.begin(), sizes.end());
+        std::sort(intervals.begin(), intervals.end());
+        double span = 0.0;
+        for (double i : intervals) {
+            span += i;
+        }
+        printf("Video: %zu frames, %ux%u, %.2f fps\n", sizes.size(), width, height,
+               span > 0.0 ? 1000.0 * intervals.size() / span : 0.0);
+        printf("  bytes: min %.0f  p50 %.0f  p95 %.0f  max %.0f  mean %.0f (max/min %.1fx)\n", sizes.front(),
+               percentile(sizes, 50), percentile(sizes, 95), sizes.back(), total / sizes.size(),
+               sizes.front() > 0 ? sizes.back() / sizes.front() : 0.0);
+        if (!intervals.empty()) {
+            printf("  interval ms: p50 %.2f  p95 %.2f  max %.2f\n", percentile(intervals, 50),
+                   percentile(intervals, 95), intervals.back());
+        }
+    }
+    if (blocks) {
+        printf("Audio: %u blocks, %llu samples at %u Hz (%.2f s)\n", blocks, (unsigned long long)samples,
+               reader.getSampleRate(), reader.getSampleRate() ? (double)samples / reader.getSampleRate() : 0.0);
+    }
+    return 0;
+}
+
+static int extract(const char* path, const char* dir) {
+    std::vector<uint8_t> data;
+    CaptureTraceReader reader;
+    if (!openTrace(path, data, reader)) {
+        return 1;
+    }
+
+    std::string audioPath = std::string(dir) + "/audio.s16le";
+    FILE* audio = nullptr;
+    uint32_t frames = 0;
+    CaptureTraceRecord record;
+    while (reader.next(record)) {
+        if (record.kind == CAPTURE_TRACE_VIDEO) {
+            char name[32];
+            snprintf(name, sizeof(name), "/frame_%06u.jpg", frames++);
+            FILE* f = fopen((std::string(dir) + name).c_str(), "wb");
+            if (!f) {
+                fprintf(stderr, "Cannot write to %s\n", dir);
+                return 1;
+            }
+            fwrite(record.payload, 1, record.length, f);
+            fclose(f);
+        } else if (record.kind == CAPTURE_TRACE_AUDIO) {
+            if (!audio && !(audio = fopen(audioPath.c_str(), "wb"))) {
+                fprintf(stderr, "Cannot write %s\n", audioPath.c_str());
+                return 1;
+            }
+            fwrite(record.payload, 1, record.length, audio);
+        }
+    }
+    if (audio) {
+        fclose(audio);
+    }
+    printf("Extracted %u frames%s to %s\n", frames, audio ? " and audio.s16le" : "", dir);
+    return 0;
+}
+
+// Frames every 1/fps from time 0 and audio in blocks stamped when complete,
+// merged in time order as a device would have recorded them
+static int pack(const char* out, const char* dir, double fps, const char* audioPath, uint32_t rate,
+                uint32_t block) {
+    DIR* d = opendir(dir);
+    if (!d) {
+        fprintf(stderr, "Cannot open %s\n", dir);
+        return 1;
+    }
+    std::vector<std::string> names;
+    while (struct dirent* entry = readdir(d)) {
+        std::string name = entry->d_name;
+        if (name.size() > 4 && (name.compare(name.size() - 4, 4, ".jpg") == 0 ||
+                                name.compare(name.size() - 4, 4, ".JPG") == 0)) {
+            names.push_back(name);
+        }
+    }
+    closedir(d);
+    std::sort(names.begin(), names.end());
+
+    std::vector<uint8_t> pcm;
+    if (audioPath && !readFile(audioPath, pcm)) {
+        fprintf(stderr, "Cannot read %s\n", audioPath);
+        return 1;
+    }
+    FILE* f = fopen(out, "wb");
+    if (!f) {
+        fprintf(stderr, "Cannot write %s\n", out);
+        return 1;
+    }
+    uint8_t header[CAPTURE_TRACE_HEADER_SIZE];
+    CaptureTrace::writeHeader(header, rate);
+    fwrite(header, 1, sizeof(header), f);
+
+    size_t frameIndex = 0;
+    size_t blockIndex = 0;
+    size_t blocks = pcm.size() / 2 / block;
+    int64_t last = 0;
+    uint32_t frames = 0;
+    while (frameIndex < names.size() || blockIndex < blocks) {
+        int64_t frameTime = frameIndex < names.size() ? (int64_t)(frameIndex * 1e6 / fps) : INT64_MAX;
+        int64_t blockTime = blockIndex < blocks ? (int64_t)((blockIndex + 1) * (uint64_t)block * 1000000ULL / rate)
+                                                : INT64_MAX;
+        uint8_t record[CAPTURE_TRACE_RECORD_SIZE];
+        if (frameTime <= blockTime) {
+            std::vector<uint8_t> jpeg;
+            readFile((std::string(dir) + "/" + names[frameIndex++]).c_str(), jpeg);
+            if (jpeg.size() < 4 || jpeg[0] != 0xFF || jpeg[1] != 0xD8) {
+                continue;
+            }
+            // Dimensions from the first SOF marker
+            uint16_t width = 0;
+            uint16_t height = 0;
+            for (size_t i = 2; i + 8 < jpeg.size() && jpeg[i] == 0xFF;) {
+                uint8_t marker = jpeg[i + 1];
+                size_t len = ((size_t)jpeg[i + 2] << 8) | jpeg[i + 3];
+                if (marker >= 0xC0 && marker <= 0xC2) {
+                    height = (uint16_t)((jpeg[i + 5] << 8) | jpeg[i + 6]);
+                    width = (uint16_t)((jpeg[i + 7] << 8) | jpeg[i + 8]);
+                    break;
+                }
+                i += 2 + len;
+            }
+            CaptureTrace::writeRecord(record, CAPTURE_TRACE_VIDEO, 4 /* PIXFORMAT_JPEG */, width, height,
+                                      (int32_t)(frameTime - last), (uint32_t)jpeg.size());
+            fwrite(record, 1, sizeof(record), f);
+            fwrite(jpeg.data(), 1, jpeg.size(), f);
+            last = frameTime;
+            frames++;
+        } else {
+            CaptureTrace::writeRecord(record, CAPTURE_TRACE_AUDIO, 0, 0, 0, (int32_t)(blockTime - last),
+                                      block * 2);
+            fwrite(record, 1, sizeof(record), f);
+            fwrite(pcm.data() + blockIndex * block * 2, 1, block * 2, f);
+            last = blockTime;
+            blockIndex++;
+        }
+    }
+    fclose(f);
+    printf("Packed %u frames at %.2f fps and %zu audio blocks of %u samples into %s\n", frames, fps, blocks,
+           block, out);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc >= 3 && strcmp(argv[1], "info") == 0) {
+        return info(argv[2]);
+    }
+    if (argc >= 4 && strcmp(argv[1], "extract") == 0) {
+        return extract(argv[2], argv[3]);
+    }
+    if (argc >= 4 && strcmp(argv[1], "pack") == 0) {
+        double fps = 30.0;
+        const char* audio = nullptr;
+        uint32_t rate = 16000;
+        uint32_t block = 1024;
+        bool ok = true;
+        for (int i = 4; i < argc && ok; i++) {
+            bool hasValue = i + 1 < argc;
+            if (strcmp(argv[i], "--fps") == 0 && hasValue) fps = atof(argv[++i]);
+            else if (strcmp(argv[i], "--audio") == 0 && hasValue) audio = argv[++i];
+            else if (strcmp(argv[i], "--rate") == 0 && hasValue) rate = (uint32_t)atoi(argv[++i]);
+            else if (strcmp(argv[i], "--block") == 0 && hasValue) block = (uint32_t)atoi(argv[++i]);
+            else ok = false;
+        }
+        if (ok && fps > 0.0 && rate > 0 && block > 0) {
+            return pack(argv[2], argv[3], fps, audio, rate, block);
+        }
+    }
+    fprintf(stderr, "Usage: %s info FILE\n"
+                    "       %s extract FILE DIR\n"
+                    "       %s pack OUT JPEG_DIR [--fps F] [--audio PCM] [--rate HZ] [--block N]\n",
+            argv[0], argv[0], argv[0]);
+    return 2;
+}
@@ -0,0 +1,219 @@
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <vector>
+#include "RtmpPublisher.h"
+
+#define RTMP_HANDSHAKE_SIZE     1536
+#define RTMP_CHUNK_SIZE         128
+
+RtmpPublisher::RtmpPublisher()
+    : _fd(-1)
+    , _streamId(1)
+    , _bytes(0)
+{
+}
+
+RtmpPublisher::~RtmpPublisher() {
+    close();
+}
+
+void RtmpPublisher::close() {
+    if (_fd >= 0) {
+        ::close(_fd);
+        _fd = -1;
+    }
+}
+
+bool RtmpPublisher::writeFully(const uint8_t* data, size_t len) {
+    size_t sent = 0;
+    while (sent < len) {
+        ssize_t n = write(_fd, data + sent, len - sent);
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        sent += (size_t)n;
+    }
+    _bytes += len;
+    return true;
+}
+
+bool RtmpPublisher::readFully(uint8_t* data, size_t len) {
+    size_t got = 0;
+    while (got < len) {
+        ssize_t n = read(_fd, data + got, len - got);
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        got += (size_t)n;
+    }
+    return true;
+}
+
+// AMF0 helpers
+static void amfString(std::vector<uint8_t>& out, const std::string& s) {
+    out.push_back(0x02);
+    out.push_back((uint8_t)(s.size() >> 8));
+    out.push_back((uint8_t)s.size());
+    out.insert(out.end(), s.begin(), s.end());
+}
+
+static void amfNumber(std::vector<uint8_t>& out, double v) {
+    uint64_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    out.push_back(0x00);
+    for (int i = 7; i >= 0; i--) {
+        out.push_back((uint8_t)(bits >> (i * 8)));
+    }
+}
+
+static void amfKey(std::vector<uint8_t>& out, const char* key) {
+    size_t len = strlen(key);
+    out.push_back((uint8_t)(len >> 8));
+    out.push_back((uint8_t)len);
+    out.insert(out.end(), key, key + len);
+}
+
+bool RtmpPublisher::sendCommand(const char* name, double transactionId, const std::string& app,
+                                const std::string& stream) {
+    std::vector<uint8_t> body;
+    amfString(body, name);
+    amfNumber(body, transactionId);
+    if (strcmp(name, "connect") == 0) {
+        body.push_back(0x03);
+        amfKey(body, "app");
+        amfString(body, app);
+        amfKey(body, "type");
+        amfString(body, "nonprivate");
+        amfKey(body, "flashVer");
+        amfString(body, "FMLE/3.0");
+        amfKey(body, "tcUrl");
+        amfString(body, "rtmp://localhost/" + app);
+        body.push_back(0x00);
+        body.push_back(0x00);
+        body.push_back(0x09);
+    } else {
+        body.push_back(0x05);                   // Null command object
+    }
+    if (strcmp(name, "publish") == 0) {
+        amfString(body, stream);
+        amfString(body, "live");
+    }
+    return sendMessage(3, 20, 0, body.data(), body.size());
+}
+
+bool RtmpPublisher::connect(const char* host, uint16_t port, const char* app, const char* stream) {
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo* result = nullptr;
+    char portText[8];
+    snprintf(portText, sizeof(portText), "%u", port);
+    if (getaddrinfo(host, portText, &hints, &result) != 0 || !result) {
+        return false;
+    }
+
+    _fd = socket(result->ai_family, result->ai_socktype, result->ai_protocol);
+    bool connected = _fd >= 0 && ::connect(_fd, result->ai_addr, result->ai_addrlen) == 0;
+    freeaddrinfo(result);
+    if (!connected) {
+        close();
+        return false;
+    }
+
+    int one = 1;
+    setsockopt(_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    uint8_t c0c1[1 + RTMP_HANDSHAKE_SIZE];
+    memset(c0c1, 0, sizeof(c0c1));
+    c0c1[0] = 0x03;
+    uint8_t s0s1[1 + RTMP_HANDSHAKE_SIZE];
+    uint8_t s2[RTMP_HANDSHAKE_SIZE];
+    if (!writeFully(c0c1, sizeof(c0c1)) || !readFully(s0s1, sizeof(s0s1)) || s0s1[0] != 0x03 ||
+        !writeFully(s0s1 + 1, RTMP_HANDSHAKE_SIZE) || !readFully(s2, sizeof(s2))) {
+        close();
+        return false;
+    }
+
+    _streamId = 0;
+    if (!sendCommand("connect", 1, app, stream) || !sendCommand("createStream", 2, app, stream)) {
+        close();
+        return false;
+    }
+    _streamId = 1;                              // The firmware assumes 1 as well
+    if (!sendCommand("publish", 0, app, stream)) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+bool RtmpPublisher::sendMessage(uint8_t chunkStreamId, uint8_t type, uint32_t timestamp,
+                                const uint8_t* data, size_t len) {
+    if (_fd < 0) {
+        return false;
+    }
+
+    std::vector<uint8_t> out;
+    out.reserve(len + len / RTMP_CHUNK_SIZE + 16);
+    out.push_back(chunkStreamId & 0x3F);
+    uint32_t ts = timestamp < 0xFFFFFF ? timestamp : 0xFFFFFF;
+    out.push_back((uint8_t)(ts >> 16));
+    out.push_back((uint8_t)(ts >> 8));
+    out.push_back((uint8_t)ts);
+    out.push_back((uint8_t)(len >> 16));
+    out.push_back((uint8_t)(len >> 8));
+    out.push_back((uint8_t)len);
+    out.push_back(type);
+    for (int i = 0; i < 4; i++) {
+        out.push_back((uint8_t)(_streamId >> (i * 8)));
+    }
+    if (ts == 0xFFFFFF) {
+        for (int i = 3; i >= 0; i--) {
+            out.push_back((uint8_t)(timestamp >> (i * 8)));
+        }
+    }
+
+    for (size_t sent = 0; sent < len; sent += RTMP_CHUNK_SIZE) {
+        if (sent > 0) {
+            out.push_back(0xC0 | (chunkStreamId & 0x3F));
+            if (ts == 0xFFFFFF) {
+                for (int i = 3; i >= 0; i--) {
+                    out.push_back((uint8_t)(timestamp >> (i * 8)));
+                }
+            }
+        }
+        size_t n = len - sent < RTMP_CHUNK_SIZE ? len - sent : RTMP_CHUNK_SIZE;
+        out.insert(out.end(), data + sent, data + sent + n);
+    }
+    return writeFully(out.data(), out.size());
+}
+
+bool RtmpPublisher::sendVideo(const uint8_t* data, size_t len, uint32_t timestamp) {
+    // Same tag header as the firmware: keyframe, codec 7, NALU, zero CTS
+    std::vector<uint8_t> body(len + 5);
+    body[0] = 0x17;
+    body[1] = 0x01;
+    body[2] = body[3] = body[4] = 0x00;
+    memcpy(body.data() + 5, data, len);
+    return sendMessage(6, 9, timestamp, body.data(), body.size());
+}
+
+bool RtmpPublisher::sendAudio(const uint8_t* data, size_t len, uint32_t timestamp) {
+    std::vector<uint8_t> body(len + 1);
+    body[0] = 0x32;                             // PCM, 16-bit, mono (as the firmware)
+    memcpy(body.data() + 1, data, len);
+    return sendMessage(5, 8, timestamp, body.data(), body.size());
+}
@@ -0,0 +1,38 @@
+#ifndef RTMP_PUBLISHER_H
+#define RTMP_PUBLISHER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+
+// Minimal RTMP publisher for host tools, sending what the firmware's
+// RTMPClient sends: plain handshake, connect/createStream/publish, then
+// video and audio messages in 128-byte chunks with type 0 headers.
+
+class RtmpPublisher {
+public:
+    RtmpPublisher();
+    ~RtmpPublisher();
+
+    bool connect(const char* host, uint16_t port, const char* app, const char* stream);
+    void close();
+
+    bool sendVideo(const uint8_t* data, size_t len, uint32_t timestamp);
+    bool sendAudio(const uint8_t* data, size_t len, uint32_t timestamp);
+    bool sendMessage(uint8_t chunkStreamId, uint8_t type, uint32_t timestamp,
+                     const uint8_t* data, size_t len);
+
+    uint64_t getBytesSent() const { return _bytes; }
+
+private:
+    int _fd;
+    uint32_t _streamId;
+    uint64_t _bytes;
+
+    bool writeFully(const uint8_t* data, size_t len);
+    bool readFully(uint8_t* data, size_t len);
+    bool sendCommand(const char* name, double transactionId, const std::string& app,
+                     const std::string& stream);
+};
+
+#endif // RTMP_PUBLISHER_H
@@ -0,0 +1,770 @@
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <poll.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include "RtmpSink.h"
+
+#define RTMP_HANDSHAKE_SIZE     1536
+#define RTMP_DEFAULT_CHUNK_SIZE 128
+#define RTMP_POLL_MS            200
+#define RTMP_IMPAIR_POLL_MS     2       // Granularity of delay/rate/stall waits
+#define RTMP_RATE_BURST_MS      20      // Token bucket depth for the read rate
+#define RTMP_AMF_MAX_DEPTH      16
+
+RtmpSink::RtmpSink()
+    : _listenFd(-1)
+    , _fd(-1)
+    , _port(0)
+    , _stop(false)
+    , _disconnect(false)
+    , _chunkSize(RTMP_DEFAULT_CHUNK_SIZE)
+    , _serverMode(false)
+    , _ackWindow(0)
+    , _serverChunkSize(RTMP_DEFAULT_CHUNK_SIZE)
+    , _outChunkSize(RTMP_DEFAULT_CHUNK_SIZE)
+    , _lastAck(0)
+    , _pingInterval(0)
+    , _pinging(false)
+    , _lastPing(0)
+    , _impairment()
+    , _sessionStart(0)
+    , _readTokens(0)
+    , _lastRefill(0)
+    , _bytesSeen(0)
+    , _bytesReadable(0)
+    , _bytes(0)
+    , _headerBytes(0)
+    , _chunks(0)
+    , _messages(0)
+    , _acksSent(0)
+    , _bytesOut(0)
+    , _pingsSent(0)
+    , _pingsAnswered(0)
+{
+}
+
+RtmpSink::~RtmpSink() {
+    if (_fd >= 0) {
+        close(_fd);
+    }
+    if (_listenFd >= 0) {
+        close(_listenFd);
+    }
+}
+
+void RtmpSink::setServerMode(uint32_t ackWindow, uint32_t chunkSize) {
+    _serverMode = true;
+    _ackWindow = ackWindow;
+    _serverChunkSize = chunkSize ? chunkSize : RTMP_DEFAULT_CHUNK_SIZE;
+}
+
+uint64_t RtmpSink::realtimeMicros() {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000;
+}
+
+static uint64_t monotonicMicros() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000;
+}
+
+bool RtmpSink::fail(const char* message) {
+    _error = message;
+    return false;
+}
+
+bool RtmpSink::listen(uint16_t port) {
+    _listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    if (_listenFd < 0) {
+        return fail("socket() failed");
+    }
+
+    int one = 1;
+    setsockopt(_listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (_impairment.receiveBuffer) {
+        // Accepted sockets inherit it; it has to be set before the window is
+        // negotiated in the SYN-ACK
+        int size = (int)_impairment.receiveBuffer;
+        setsockopt(_listenFd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+    }
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    if (bind(_listenFd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        return fail("bind() failed (port in use?)");
+    }
+    if (::listen(_listenFd, 1) < 0) {
+        return fail("listen() failed");
+    }
+
+    socklen_t addrLen = sizeof(addr);
+    getsockname(_listenFd, (struct sockaddr*)&addr, &addrLen);
+    _port = ntohs(addr.sin_port);
+    return true;
+}
+
+// How many of the wanted bytes the impairments let us read now. Returns 0
+// with waitMs > 0 to sleep, or 0 with waitMs == 0 to wait for the socket.
+size_t RtmpSink::readAllowance(size_t wanted, int& waitMs) {
+    uint64_t now = monotonicMicros();
+    waitMs = 0;
+
+    if (_impairment.delayMs) {
+        // Timestamp bytes as they show up in the receive buffer and only
+        // release them delayMs later
+        int pending = 0;
+        if (ioctl(_fd, FIONREAD, &pending) == 0 && _bytes + (uint64_t)pending > _bytesSeen) {
+            _bytesSeen = _bytes + (uint64_t)pending;
+            _arrivals.push_back({ now, _bytesSeen });
+        }
+        uint64_t delay = (uint64_t)_impairment.delayMs * 1000;
+        while (!_arrivals.empty() && _arrivals.front().micros + delay <= now) {
+            _bytesReadable = _arrivals.front().bytes;
+            _arrivals.pop_front();
+        }
+        if (_bytesReadable <= _bytes) {
+            if (_arrivals.empty()) {
+                return 0;
+            }
+            waitMs = RTMP_IMPAIR_POLL_MS;
+            return 0;
+        }
+        if (wanted > _bytesReadable - _bytes) {
+            wanted = (size_t)(_bytesReadable - _bytes);
+        }
+    }
+
+    if (_impairment.stallEveryMs && _impairment.stallMs) {
+        // The last stallMs of every stallEveryMs period
+        uint64_t phase = ((now - _sessionStart) / 1000) % _impairment.stallEveryMs;
+        if (phase + _impairment.stallMs >= _impairment.stallEveryMs) {
+            waitMs = RTMP_IMPAIR_POLL_MS;
+            return 0;
+        }
+    }
+
+    if (_impairment.rateBytesPerSecond) {
+        uint64_t rate = _impairment.rateBytesPerSecond;
+        uint64_t burst = rate * RTMP_RATE_BURST_MS / 1000;
+        if (burst < 1) {
+            burst = 1;
+        }
+        _readTokens += (now - _lastRefill) * rate / 1000000;
+        _lastRefill = now;
+        if (_readTokens > burst) {
+            _readTokens = burst;
+        }
+        if (_readTokens == 0) {
+            waitMs = RTMP_IMPAIR_POLL_MS;
+            return 0;
+        }
+        if (wanted > _readTokens) {
+            wanted = (size_t)_readTokens;
+        }
+    }
+    return wanted;
+}
+
+bool RtmpSink::readFully(uint8_t* data, size_t len) {
+    bool impaired = _impairment.delayMs || _impairment.rateBytesPerSecond || _impairment.stallEveryMs;
+    size_t got = 0;
+    while (got < len) {
+        if (_stop.load()) {
+            return fail("stopped");
+        }
+        if (_disconnect.load()) {
+            return fail("disconnected by sink");
+        }
+        if (!pingIfDue()) {
+            return false;
+        }
+
+        size_t wanted = len - got;
+        if (impaired) {
+            int waitMs = 0;
+            wanted = readAllowance(wanted, waitMs);
+            if (wanted == 0 && waitMs > 0) {
+                poll(nullptr, 0, waitMs);
+                continue;
+            }
+        }
+
+        struct pollfd pfd = { _fd, POLLIN, 0 };
+        int ready = poll(&pfd, 1, impaired ? RTMP_IMPAIR_POLL_MS : RTMP_POLL_MS);
+        if (ready < 0 && errno != EINTR) {
+            return fail("poll() failed");
+        }
+        if (ready <= 0) {
+            continue;
+        }
+        if (wanted == 0) {
+            // Only waiting for bytes to timestamp; readable with nothing
+            // pending is the peer's FIN
+            int pending = 0;
+            if (ioctl(_fd, FIONREAD, &pending) == 0 && pending == 0) {
+                return fail("connection closed");
+            }
+            continue;
+        }
+
+        ssize_t n = read(_fd, data + got, wanted);
+        if (n == 0) {
+            return fail("connection closed");
+        }
+        if (n < 0) {
+            if (errno == EINTR || errno == EAGAIN) {
+                continue;
+            }
+            // A publisher that never reads our replies resets rather than
+            // closes when it exits
+            return fail(errno == ECONNRESET ? "connection reset" : "read() failed");
+        }
+        got += (size_t)n;
+        _bytes += (uint64_t)n;
+        if (_impairment.rateBytesPerSecond) {
+            _readTokens -= (uint64_t)n < _readTokens ? (uint64_t)n : _readTokens;
+        }
+
+        if (_serverMode && _ackWindow && _bytes - _lastAck >= _ackWindow) {
+            // Sequence number is the byte count so far (wraps at 4 GB)
+            if (!sendControl(RTMP_MSG_ACK, (uint32_t)_bytes)) {
+                return false;
+            }
+            _lastAck = _bytes;
+            _acksSent++;
+        }
+    }
+    return true;
+}
+
+bool RtmpSink::readHeader(uint8_t* data, size_t len) {
+    _headerBytes += len;
+    return readFully(data, len);
+}
+
+bool RtmpSink::writeFully(const uint8_t* data, size_t len) {
+    size_t sent = 0;
+    while (sent < len) {
+        ssize_t n = write(_fd, data + sent, len - sent);
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            return fail("write() failed");
+        }
+        sent += (size_t)n;
+    }
+    _bytesOut += len;
+    return true;
+}
+
+// Plain RTMP handshake: C0+C1 in, S0+S1+S2 out, C2 in (not verified)
+bool RtmpSink::handshake() {
+    uint8_t c0c1[1 + RTMP_HANDSHAKE_SIZE];
+    if (!readFully(c0c1, sizeof(c0c1))) {
+        return false;
+    }
+    if (c0c1[0] != 0x03) {
+        return fail("unsupported RTMP version in C0");
+    }
+
+    uint8_t reply[1 + 2 * RTMP_HANDSHAKE_SIZE];
+    reply[0] = 0x03;
+    uint8_t* s1 = reply + 1;
+    memset(s1, 0, RTMP_HANDSHAKE_SIZE);
+    uint32_t seed = (uint32_t)realtimeMicros();
+    for (int i = 8; i < RTMP_HANDSHAKE_SIZE; i++) {
+        seed = seed * 1664525u + 1013904223u;
+        s1[i] = (uint8_t)(seed >> 24);
+    }
+    memcpy(reply + 1 + RTMP_HANDSHAKE_SIZE, c0c1 + 1, RTMP_HANDSHAKE_SIZE);     // S2 echoes C1
+    if (!writeFully(reply, sizeof(reply))) {
+        return false;
+    }
+
+    uint8_t c2[RTMP_HANDSHAKE_SIZE];
+    return readFully(c2, sizeof(c2));
+}
+
+bool RtmpSink::readChunk(MessageHandler& handler) {
+    uint8_t basic;
+    if (!readHeader(&basic, 1)) {
+        return false;
+    }
+
+    uint8_t fmt = basic >> 6;
+    uint32_t csid = basic & 0x3F;
+    if (csid == 0) {
+        uint8_t b;
+        if (!readHeader(&b, 1)) {
+            return false;
+        }
+        csid = 64 + b;
+    } else if (csid == 1) {
+        uint8_t b[2];
+        if (!readHeader(b, 2)) {
+            return false;
+        }
+        csid = 64 + b[0] + ((uint32_t)b[1] << 8);
+    }
+
+    bool known = _streams.count(csid) != 0;
+    ChunkStream& stream = _streams[csid];
+    if (!known && fmt != 0) {
+        return fail("first chunk on a chunk stream is not type 0");
+    }
+    bool starting = stream.partial.empty();
+    if (fmt != 3 && !starting) {
+        return fail("new message header before the previous message was complete");
+    }
+
+    static const uint8_t headerSizes[4] = { 11, 7, 3, 0 };
+    uint8_t header[11];
+    if (!readHeader(header, headerSizes[fmt])) {
+        return false;
+    }
+
+    uint32_t field = fmt < 3 ? ((uint32_t)header[0] << 16) | ((uint32_t)header[1] << 8) | header[2] : 0;
+    if (fmt < 3) {
+        stream.extended = field == 0xFFFFFF;
+    }
+    if (fmt <= 1) {
+        stream.length = ((uint32_t)header[3] << 16) | ((uint32_t)header[4] << 8) | header[5];
+        stream.type = header[6];
+    }
+    if (fmt == 0) {
+        stream.streamId = header[7] | ((uint32_t)header[8] << 8) |
+                          ((uint32_t)header[9] << 16) | ((uint32_t)header[10] << 24);
+    }
+
+    if (stream.extended) {
+        uint8_t ext[4];
+        if (!readHeader(ext, 4)) {
+            return false;
+        }
+        if (fmt < 3) {
+            field = ((uint32_t)ext[0] << 24) | ((uint32_t)ext[1] << 16) | ((uint32_t)ext[2] << 8) | ext[3];
+        }
+    }
+
+    if (fmt == 0) {
+        stream.timestamp = field;
+        stream.delta = 0;
+    } else if (fmt < 3) {
+        stream.delta = field;
+        stream.timestamp += field;
+    } else if (starting) {
+        stream.timestamp += stream.delta;       // Type 3 starting a message repeats the delta
+    }
+
+    size_t remaining = stream.length - stream.partial.size();
+    size_t toRead = remaining < _chunkSize ? remaining : _chunkSize;
+    size_t offset = stream.partial.size();
+    stream.partial.resize(offset + toRead);
+    if (toRead && !readFully(stream.partial.data() + offset, toRead)) {
+        return false;
+    }
+    _chunks++;
+
+    if (stream.partial.size() < stream.length) {
+        return true;
+    }
+
+    RtmpMessage message;
+    message.chunkStreamId = csid;
+    message.timestamp = stream.timestamp;
+    message.type = stream.type;
+    message.streamId = stream.streamId;
+    message.payload.swap(stream.partial);
+    message.receivedMicros = realtimeMicros();
+    _messages++;
+
+    if (message.type == RTMP_MSG_SET_CHUNK_SIZE && message.payload.size() >= 4) {
+        const uint8_t* p = message.payload.data();
+        uint32_t size = (((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+                         ((uint32_t)p[2] << 8) | p[3]) & 0x7FFFFFFF;
+        if (size == 0) {
+            return fail("zero chunk size");
+        }
+        _chunkSize = size;
+    } else if (message.type == RTMP_MSG_ABORT && message.payload.size() >= 4) {
+        const uint8_t* p = message.payload.data();
+        uint32_t aborted = ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+        if (_streams.count(aborted)) {
+            _streams[aborted].partial.clear();
+        }
+    }
+
+    if (handler) {
+        handler(message);
+    }
+    return !_serverMode || reply(message);
+}
+
+// ============================================================================
+// Server side: control messages and command replies
+// ============================================================================
+
+// AMF0 helpers
+static void amfString(std::vector<uint8_t>& out, const std::string& s) {
+    out.push_back(0x02);
+    out.push_back((uint8_t)(s.size() >> 8));
+    out.push_back((uint8_t)s.size());
+    out.insert(out.end(), s.begin(), s.end());
+}
+
+static void amfNumber(std::vector<uint8_t>& out, double v) {
+    uint64_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    out.push_back(0x00);
+    for (int i = 7; i >= 0; i--) {
+        out.push_back((uint8_t)(bits >> (i * 8)));
+    }
+}
+
+static void amfKey(std::vector<uint8_t>& out, const char* key) {
+    size_t len = strlen(key);
+    out.push_back((uint8_t)(len >> 8));
+    out.push_back((uint8_t)len);
+    out.insert(out.end(), key, key + len);
+}
+
+static void amfObjectEnd(std::vector<uint8_t>& out) {
+    out.push_back(0x00);
+    out.push_back(0x00);
+    out.push_back(0x09);
+}
+
+static void amfStatus(std::vector<uint8_t>& out, const char* code, const char* description) {
+    out.push_back(0x03);
+    amfKey(out, "level");
+    amfString(out, "status");
+    amfKey(out, "code");
+    amfString(out, code);
+    amfKey(out, "description");
+    amfString(out, description);
+}
+
+static void putBig32(std::vector<uint8_t>& out, uint32_t value) {
+    for (int i = 3; i >= 0; i--) {
+        out.push_back((uint8_t)(value >> (i * 8)));
+    }
+}
+
+// Replies go out with a zero timestamp: fmt 0 then fmt 3 continuations
+bool RtmpSink::sendMessage(uint32_t chunkStreamId, uint8_t type, uint32_t streamId,
+                           const std::vector<uint8_t>& payload) {
+    std::vector<uint8_t> out;
+    out.reserve(payload.size() + payload.size() / _outChunkSize + 16);
+    out.push_back(chunkStreamId & 0x3F);
+    out.push_back(0);
+    out.push_back(0);
+    out.push_back(0);
+    out.push_back((uint8_t)(payload.size() >> 16));
+    out.push_back((uint8_t)(payload.size() >> 8));
+    out.push_back((uint8_t)payload.size());
+    out.push_back(type);
+    for (int i = 0; i < 4; i++) {
+        out.push_back((uint8_t)(streamId >> (i * 8)));
+    }
+    for (size_t sent = 0; sent < payload.size(); sent += _outChunkSize) {
+        if (sent > 0) {
+            out.push_back(0xC0 | (chunkStreamId & 0x3F));
+        }
+        size_t n = payload.size() - sent < _outChunkSize ? payload.size() - sent : _outChunkSize;
+        out.insert(out.end(), payload.begin() + sent, payload.begin() + sent + n);
+    }
+    return writeFully(out.data(), out.size());
+}
+
+// Protocol control message on chunk stream 2, message stream 0
+bool RtmpSink::sendControl(uint8_t type, uint32_t value, int extra) {
+    std::vector<uint8_t> payload;
+    putBig32(payload, value);
+    if (extra >= 0) {
+        payload.push_back((uint8_t)extra);
+    }
+    return sendMessage(2, type, 0, payload);
+}
+
+bool RtmpSink::reply(const RtmpMessage& message) {
+    if (message.type == RTMP_MSG_USER_CONTROL) {
+        const std::vector<uint8_t>& p = message.payload;
+        if (p.size() >= 6 && p[0] == 0 && p[1] == RTMP_UC_PING_REQUEST) {
+            std::vector<uint8_t> pong(p.begin(), p.begin() + 6);
+            pong[1] = RTMP_UC_PING_RESPONSE;
+            return sendMessage(2, RTMP_MSG_USER_CONTROL, 0, pong);
+        }
+        if (p.size() >= 2 && p[0] == 0 && p[1] == RTMP_UC_PING_RESPONSE) {
+            _pingsAnswered++;
+        }
+        return true;
+    }
+    if (message.type != RTMP_MSG_COMMAND_AMF0) {
+        return true;
+    }
+
+    RtmpCommand command;
+    if (!parseCommand(message.payload, command)) {
+        return true;                            // Malformed: the caller reports it
+    }
+
+    std::vector<uint8_t> body;
+    if (command.name == "connect") {
+        if (!sendControl(RTMP_MSG_WINDOW_ACK_SIZE, _ackWindow) ||
+            !sendControl(RTMP_MSG_SET_PEER_BANDWIDTH, _ackWindow, 2) ||  // Dynamic
+            !sendControl(RTMP_MSG_SET_CHUNK_SIZE, _serverChunkSize)) {
+            return false;
+        }
+        _outChunkSize = _serverChunkSize;
+
+        amfString(body, "_result");
+        amfNumber(body, command.transactionId);
+        body.push_back(0x03);
+        amfKey(body, "fmsVer");
+        amfString(body, "FMS/3,0,1,123");
+        amfKey(body, "capabilities");
+        amfNumber(body, 31);
+        amfObjectEnd(body);
+        amfStatus(body, "NetConnection.Connect.Success", "Connection succeeded.");
+        amfKey(body, "objectEncoding");
+        amfNumber(body, 0);
+        amfObjectEnd(body);
+        _pinging = true;
+        _lastPing = monotonicMicros();
+        return sendMessage(3, RTMP_MSG_COMMAND_AMF0, 0, body);
+    }
+    if (command.name == "createStream") {
+        amfString(body, "_result");
+        amfNumber(body, command.transactionId);
+        body.push_back(0x05);
+        amfNumber(body, 1);                     // The only stream ID we hand out
+        return sendMessage(3, RTMP_MSG_COMMAND_AMF0, 0, body);
+    }
+    if (command.name == "publish") {
+        std::vector<uint8_t> begin = { 0, RTMP_UC_STREAM_BEGIN };
+        putBig32(begin, message.streamId);
+        if (!sendMessage(2, RTMP_MSG_USER_CONTROL, 0, begin)) {
+            return false;
+        }
+        amfString(body, "onStatus");
+        amfNumber(body, 0);
+        body.push_back(0x05);
+        amfStatus(body, "NetStream.Publish.Start",
+                  command.strings.empty() ? "Publishing." : (command.strings[0] + " is now published.").c_str());
+        amfObjectEnd(body);
+        return sendMessage(5, RTMP_MSG_COMMAND_AMF0, message.streamId, body);
+    }
+    return true;
+}
+
+// Ping Request (User Control event 6) carrying our time in milliseconds;
+// the publisher should echo it in a Ping Response
+bool RtmpSink::pingIfDue() {
+    if (!_serverMode || !_pinging || !_pingInterval) {
+        return true;
+    }
+    uint64_t now = monotonicMicros();
+    if (now - _lastPing < (uint64_t)_pingInterval * 1000) {
+        return true;
+    }
+    _lastPing = now;
+    std::vector<uint8_t> ping = { 0, RTMP_UC_PING_REQUEST };
+    putBig32(ping, (uint32_t)(now / 1000));
+    if (!sendMessage(2, RTMP_MSG_USER_CONTROL, 0, ping)) {
+        return false;
+    }
+    _pingsSent++;
+    return true;
+}
+
+// ============================================================================
+// AMF0 command parsing
+// ============================================================================
+
+static bool amfReadString(const uint8_t*& p, const uint8_t* end, std::string* out) {
+    if (end - p < 2) {
+        return false;
+    }
+    size_t len = ((size_t)p[0] << 8) | p[1];
+    p += 2;
+    if ((size_t)(end - p) < len) {
+        return false;
+    }
+    if (out) {
+        out->assign((const char*)p, len);
+    }
+    p += len;
+    return true;
+}
+
+// Skip one value; strings and numbers are handed back when asked for
+static bool amfSkipValue(const uint8_t*& p, const uint8_t* end, int depth,
+                         std::string* string = nullptr, double* number = nullptr) {
+    if (p >= end || depth > RTMP_AMF_MAX_DEPTH) {
+        return false;
+    }
+    uint8_t marker = *p++;
+    switch (marker) {
+        case 0x00: {                            // Number
+            if (end - p < 8) {
+                return false;
+            }
+            uint64_t bits = 0;
+            for (int i = 0; i < 8; i++) {
+                bits = (bits << 8) | p[i];
+            }
+            if (number) {
+                memcpy(number, &bits, sizeof(*number));
+            }
+            p += 8;
+            return true;
+        }
+        case 0x01:                              // Boolean
+            if (p >= end) {
+                return false;
+            }
+            p++;
+            return true;
+        case 0x02:                              // String
+            return amfReadString(p, end, string);
+        case 0x05:                              // Null
+        case 0x06:                              // Undefined
+            return true;
+        case 0x08:                              // ECMA array: count, then as an object
+            if (end - p < 4) {
+                return false;
+            }
+            p += 4;
+            // Fall through
+        case 0x03:                              // Object
+            while (true) {
+                if (end - p >= 3 && p[0] == 0 && p[1] == 0 && p[2] == 0x09) {
+                    p += 3;
+                    return true;
+                }
+                if (!amfReadString(p, end, nullptr) || !amfSkipValue(p, end, depth + 1)) {
+                    return false;
+                }
+            }
+        default:
+            return false;                       // Nothing the publishers we test send
+    }
+}
+
+bool RtmpSink::parseCommand(const std::vector<uint8_t>& payload, RtmpCommand& command) {
+    const uint8_t* p = payload.data();
+    const uint8_t* end = p + payload.size();
+
+    command.name.clear();
+    command.transactionId = 0;
+    command.strings.clear();
+    if (p >= end || *p != 0x02 || !amfSkipValue(p, end, 0, &command.name)) {
+        return false;
+    }
+    if (p >= end || *p != 0x00 || !amfSkipValue(p, end, 0, nullptr, &command.transactionId)) {
+        return false;
+    }
+    if (p < end && !amfSkipValue(p, end, 0)) {  // Command object (or null)
+        return false;
+    }
+    while (p < end) {
+        std::string value;
+        bool isString = *p == 0x02;
+        if (!amfSkipValue(p, end, 0, &value)) {
+            return false;
+        }
+        if (isString) {
+            command.strings.push_back(value);
+        }
+    }
+    return true;
+}
+
+bool RtmpSink::serveOne(MessageHandler handler, int acceptTimeoutMs) {
+    if (_listenFd < 0) {
+        return fail("not listening");
+    }
+
+    int waited = 0;
+    while (true) {
+        if (_stop.load()) {
+            return fail("stopped");
+        }
+        struct pollfd pfd = { _listenFd, POLLIN, 0 };
+        int ready = poll(&pfd, 1, RTMP_POLL_MS);
+        if (ready > 0) {
+            break;
+        }
+        waited += RTMP_POLL_MS;
+        if (acceptTimeoutMs >= 0 && waited >= acceptTimeoutMs) {
+            return fail("no publisher connected");
+        }
+    }
+
+    struct sockaddr_in peer;
+    socklen_t peerLen = sizeof(peer);
+    _fd = accept(_listenFd, (struct sockaddr*)&peer, &peerLen);
+    if (_fd < 0) {
+        return fail("accept() failed");
+    }
+    int one = 1;
+    setsockopt(_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    char address[INET_ADDRSTRLEN] = "?";
+    inet_ntop(AF_INET, &peer.sin_addr, address, sizeof(address));
+    _peer = std::string(address) + ":" + std::to_string(ntohs(peer.sin_port));
+
+    _chunkSize = RTMP_DEFAULT_CHUNK_SIZE;
+    _outChunkSize = RTMP_DEFAULT_CHUNK_SIZE;
+    _streams.clear();
+    _disconnect.store(false);
+    _bytes = 0;
+    _headerBytes = 0;
+    _chunks = 0;
+    _messages = 0;
+    _acksSent = 0;
+    _bytesOut = 0;
+    _lastAck = 0;
+    _pinging = false;
+    _pingsSent = 0;
+    _pingsAnswered = 0;
+    _error.clear();
+
+    _sessionStart = monotonicMicros();
+    _lastRefill = _sessionStart;
+    _readTokens = 0;
+    _arrivals.clear();
+    _bytesSeen = 0;
+    _bytesReadable = 0;
+
+    bool ok = handshake();
+    while (ok) {
+        ok = readChunk(handler);
+    }
+
+    close(_fd);
+    _fd = -1;
+
+    // A publisher hanging up between chunks is the normal end of a session
+    bool cleanEnd = _error == "connection closed" || _error == "connection reset" || _error == "stopped" ||
+                    _error == "disconnected by sink";
+    for (auto& entry : _streams) {
+        if (!entry.second.partial.empty() && !_disconnect.load()) {
+            cleanEnd = false;
+            _error = "connection closed mid-message";
+        }
+    }
+    return _messages > 0 && cleanEnd;
+}
@@ -0,0 +1,187 @@
+#ifndef RTMP_SINK_H
+#define RTMP_SINK_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+// Minimal RTMP receiving end for host tools: accepts one publisher at a time,
+// answers the plain (unsigned) handshake, reassembles chunked messages and
+// hands each complete message to a callback.
+//
+// By default it does not answer commands (the firmware's client does not wait
+// for replies). setServerMode() makes it behave like an ingest server:
+// Window Acknowledgement Size, Set Peer Bandwidth and Set Chunk Size after
+// connect, _result/onStatus replies, Stream Begin, ping responses and
+// acknowledgements every window. setPingInterval() adds Ping Requests to the
+// publisher once it has connected, as servers do to detect dead peers.
+//
+// setImpairment() degrades the receive side to emulate a poor uplink: a read
+// rate limit, periodic read stalls and a fixed delay before received bytes
+// are read. The sender sees them through TCP flow control (and, for the
+// delay, through slower replies).
+
+// Message types
+#define RTMP_MSG_SET_CHUNK_SIZE     1
+#define RTMP_MSG_ABORT              2
+#define RTMP_MSG_ACK                3
+#define RTMP_MSG_USER_CONTROL       4
+#define RTMP_MSG_WINDOW_ACK_SIZE    5
+#define RTMP_MSG_SET_PEER_BANDWIDTH 6
+#define RTMP_MSG_AUDIO              8
+#define RTMP_MSG_VIDEO              9
+#define RTMP_MSG_DATA_AMF0          18
+#define RTMP_MSG_COMMAND_AMF0       20
+#define RTMP_MSG_AGGREGATE          22
+
+// User control events
+#define RTMP_UC_STREAM_BEGIN        0
+#define RTMP_UC_PING_REQUEST        6
+#define RTMP_UC_PING_RESPONSE       7
+
+// C0+C1 and C2 as received
+#define RTMP_HANDSHAKE_RECEIVED     (1 + 2 * 1536)
+
+struct RtmpMessage {
+    uint32_t chunkStreamId;
+    uint32_t timestamp;         // Absolute, milliseconds
+    uint8_t type;
+    uint32_t streamId;
+    std::vector<uint8_t> payload;
+    uint64_t receivedMicros;    // CLOCK_REALTIME when the last byte arrived
+};
+
+// AMF0 command as far as the tools care: name, transaction ID and the string
+// arguments after the command object (e.g. the publishing name)
+struct RtmpCommand {
+    std::string name;
+    double transactionId;
+    std::vector<std::string> strings;
+};
+
+struct RtmpImpairment {
+    uint32_t rateBytesPerSecond;    // 0 = unlimited
+    uint32_t stallMs;               // Stop reading for stallMs ...
+    uint32_t stallEveryMs;          // ... every stallEveryMs (0 = never)
+    uint32_t delayMs;               // Read bytes no earlier than this after they arrive
+    uint32_t receiveBuffer;         // SO_RCVBUF in bytes (0 = kernel default)
+};
+
+class RtmpSink {
+public:
+    typedef std::function<void(const RtmpMessage& message)> MessageHandler;
+
+    RtmpSink();
+    ~RtmpSink();
+
+    // Answer commands and acknowledge like a server (see above)
+    void setServerMode(uint32_t ackWindow, uint32_t chunkSize);
+    // Server mode: send a Ping Request every intervalMs (0 = never)
+    void setPingInterval(uint32_t intervalMs) { _pingInterval = intervalMs; }
+    // Call before listen() for the receive buffer to take effect
+    void setImpairment(const RtmpImpairment& impairment) { _impairment = impairment; }
+
+    // Listen on all interfaces (port 0 picks a free port; see getPort())
+    bool listen(uint16_t port);
+    uint16_t getPort() const { return _port; }
+
+    // Accept one connection and serve it until the peer closes, an error,
+    // disconnect() or stop(). Returns false if nothing connected or the
+    // stream was invalid.
+    bool serveOne(MessageHandler handler, int acceptTimeoutMs = -1);
+
+    // Ask serveOne() to return (safe from signal handlers and other threads)
+    void stop() { _stop.store(true); }
+    // Close the current connection from the sink's side (e.g. from the handler)
+    void disconnect() { _disconnect.store(true); }
+
+    const std::string& getError() const { return _error; }
+    const std::string& getPeer() const { return _peer; }
+
+    // Statistics for the last connection
+    uint64_t getBytesReceived() const { return _bytes; }
+    uint64_t getHeaderBytes() const { return _headerBytes; }
+    uint64_t getChunks() const { return _chunks; }
+    uint64_t getMessages() const { return _messages; }
+    uint32_t getChunkSize() const { return _chunkSize; }
+    uint32_t getAcksSent() const { return _acksSent; }
+    uint64_t getBytesSent() const { return _bytesOut; }
+    uint32_t getPingsSent() const { return _pingsSent; }
+    uint32_t getPingsAnswered() const { return _pingsAnswered; }
+
+    static uint64_t realtimeMicros();
+    static bool parseCommand(const std::vector<uint8_t>& payload, RtmpCommand& command);
+
+private:
+    struct ChunkStream {
+        uint32_t timestamp;
+        uint32_t delta;
+        uint32_t length;
+        uint8_t type;
+        uint32_t streamId;
+        bool extended;
+        std::vector<uint8_t> partial;
+    };
+
+    struct Arrival {
+        uint64_t micros;
+        uint64_t bytes;             // Total bytes seen on the socket by then
+    };
+
+    int _listenFd;
+    int _fd;
+    uint16_t _port;
+    std::atomic<bool> _stop;
+    std::atomic<bool> _disconnect;
+    std::string _error;
+    std::string _peer;
+    uint32_t _chunkSize;
+    std::map<uint32_t, ChunkStream> _streams;
+
+    bool _serverMode;
+    uint32_t _ackWindow;
+    uint32_t _serverChunkSize;      // Announced after connect
+    uint32_t _outChunkSize;         // In effect for what we send
+    uint64_t _lastAck;
+    uint32_t _pingInterval;
+    bool _pinging;                  // Connect answered: pings may go out
+    uint64_t _lastPing;
+
+    RtmpImpairment _impairment;
+    uint64_t _sessionStart;
+    uint64_t _readTokens;
+    uint64_t _lastRefill;
+    std::deque<Arrival> _arrivals;
+    uint64_t _bytesSeen;
+    uint64_t _bytesReadable;
+
+    uint64_t _bytes;
+    uint64_t _headerBytes;
+    uint64_t _chunks;
+    uint64_t _messages;
+    uint32_t _acksSent;
+    uint64_t _bytesOut;
+    uint32_t _pingsSent;
+    uint32_t _pingsAnswered;
+
+    bool readFully(uint8_t* data, size_t len);
+    bool readHeader(uint8_t* data, size_t len);
+    bool writeFully(const uint8_t* data, size_t len);
+    bool handshake();
+    bool readChunk(MessageHandler& handler);
+    bool fail(const char* message);
+
+    size_t readAllowance(size_t wanted, int& waitMs);
+
+    bool sendMessage(uint32_t chunkStreamId, uint8_t type, uint32_t streamId, const std::vector<uint8_t>& payload);
+    bool sendControl(uint8_t type, uint32_t value, int extra = -1);
+    bool reply(const RtmpMessage& message);
+    bool pingIfDue();
+};
+
+#endif // RTMP_SINK_H
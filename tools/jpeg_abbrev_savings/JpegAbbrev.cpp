@@ -0,0 +1,264 @@
+#include <string.h>
+#include <JpegCodec.h>
+#include "JpegAbbrev.h"
+
+static inline uint16_t readU16(const uint8_t* p) {
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static inline bool isTableMarker(uint8_t marker) {
+    return marker == JPEG_DQT || marker == JPEG_DHT;
+}
+
+// Advance to the next header marker, skipping fill bytes. On return, marker
+// is set and segBytes is the full segment size including the marker (2 for
+// SOI/EOI). Returns false on truncated or malformed data.
+static bool nextSegment(const uint8_t* data, size_t len, size_t& pos, uint8_t& marker,
+                        size_t& segBytes) {
+    while (pos + 2 <= len && data[pos] == 0xFF && data[pos + 1] == 0xFF) {
+        pos++;
+    }
+    if (pos + 2 > len || data[pos] != 0xFF) {
+        return false;
+    }
+    marker = data[pos + 1];
+    if (marker == JPEG_SOI || marker == JPEG_EOI) {
+        segBytes = 2;
+        return true;
+    }
+    if (pos + 4 > len) {
+        return false;
+    }
+    uint16_t segLen = readU16(&data[pos + 2]);
+    if (segLen < 2 || pos + 2 + segLen > len) {
+        return false;
+    }
+    segBytes = 2 + segLen;
+    return true;
+}
+
+// ============================================================================
+// Encoder
+// ============================================================================
+
+JpegAbbrevEncoder::JpegAbbrevEncoder()
+    : _tablesLength(0)
+    , _tablesChanged(false)
+    , _forceTables(true)
+    , _generation(0)
+    , _refreshInterval(0)
+    , _framesSinceTables(0)
+    , _framesEncoded(0)
+    , _tableSends(0)
+    , _bytesIn(0)
+    , _bytesOut(0)
+{
+}
+
+void JpegAbbrevEncoder::reset() {
+    _forceTables = true;
+    _framesSinceTables = 0;
+}
+
+size_t JpegAbbrevEncoder::encode(const uint8_t* jpeg, size_t len, uint8_t* out, size_t outCapacity) {
+    _tablesChanged = false;
+
+    if (!jpeg || !out || len < 4 || outCapacity < len ||
+        jpeg[0] != 0xFF || jpeg[1] != JPEG_SOI) {
+        return 0;
+    }
+
+    // Copy the non-table header segments while comparing the table segments
+    // against the ones last sent
+    out[0] = 0xFF;
+    out[1] = JPEG_SOI;
+    size_t outPos = 2;
+    size_t pos = 2;
+    size_t tableBytes = 0;
+    size_t tablePos = 2;        // Cursor into _tables, after its SOI
+    bool same = _tablesLength > 0;
+    uint8_t marker;
+    size_t segBytes;
+
+    while (true) {
+        if (!nextSegment(jpeg, len, pos, marker, segBytes) || marker == JPEG_SOI ||
+            marker == JPEG_EOI) {
+            return 0;
+        }
+        if (marker == JPEG_SOS) {
+            break;
+        }
+
+        if (isTableMarker(marker)) {
+            tableBytes += segBytes;
+            if (same && tablePos + segBytes + 2 <= _tablesLength &&
+                memcmp(&_tables[tablePos], &jpeg[pos], segBytes) == 0) {
+                tablePos += segBytes;
+            } else {
+                same = false;
+            }
+        } else {
+            memcpy(&out[outPos], &jpeg[pos], segBytes);
+            outPos += segBytes;
+        }
+        pos += segBytes;
+    }
+
+    if (tableBytes == 0) {
+        return 0;               // Already abbreviated
+    }
+    if (tablePos + 2 != _tablesLength) {
+        same = false;           // Previous tables had extra segments
+    }
+
+    if (!same) {
+        if (tableBytes + 4 > sizeof(_tables)) {
+            return 0;
+        }
+
+        // Rebuild the tables-only stream: SOI, table segments, EOI
+        size_t scan = 2;
+        size_t tablesLength = 2;
+        _tables[0] = 0xFF;
+        _tables[1] = JPEG_SOI;
+        while (scan < pos) {
+            nextSegment(jpeg, len, scan, marker, segBytes);
+            if (isTableMarker(marker)) {
+                memcpy(&_tables[tablesLength], &jpeg[scan], segBytes);
+                tablesLength += segBytes;
+            }
+            scan += segBytes;
+        }
+        _tables[tablesLength++] = 0xFF;
+        _tables[tablesLength++] = JPEG_EOI;
+        _tablesLength = tablesLength;
+        _generation++;
+    }
+
+    // SOS header, entropy-coded data and EOI are copied as they are
+    memcpy(&out[outPos], &jpeg[pos], len - pos);
+    outPos += len - pos;
+
+    _tablesChanged = !same || _forceTables ||
+                     (_refreshInterval > 0 && _framesSinceTables >= _refreshInterval);
+    if (_tablesChanged) {
+        _forceTables = false;
+        _framesSinceTables = 0;
+        _tableSends++;
+        _bytesOut += _tablesLength;
+    }
+    _framesSinceTables++;
+
+    _framesEncoded++;
+    _bytesIn += len;
+    _bytesOut += outPos;
+    return outPos;
+}
+
+// ============================================================================
+// Decoder
+// ============================================================================
+
+JpegAbbrevDecoder::JpegAbbrevDecoder()
+    : _tablesLength(0)
+{
+}
+
+JpegStreamKind JpegAbbrevDecoder::classify(const uint8_t* data, size_t len) {
+    if (!data || len < 4 || data[0] != 0xFF || data[1] != JPEG_SOI) {
+        return JpegStreamKind::INVALID;
+    }
+
+    bool haveDQT = false;
+    bool haveDHT = false;
+    bool haveFrame = false;
+    size_t pos = 2;
+    uint8_t marker;
+    size_t segBytes;
+
+    while (nextSegment(data, len, pos, marker, segBytes)) {
+        switch (marker) {
+            case JPEG_DQT:
+                haveDQT = true;
+                break;
+            case JPEG_DHT:
+                haveDHT = true;
+                break;
+            case JPEG_SOF0:
+            case JPEG_SOF1:
+                haveFrame = true;
+                break;
+            case JPEG_EOI:
+                return (!haveFrame && (haveDQT || haveDHT)) ? JpegStreamKind::TABLES
+                                                            : JpegStreamKind::INVALID;
+            case JPEG_SOS:
+                if (!haveFrame) {
+                    return JpegStreamKind::INVALID;
+                }
+                // A frame carrying only one kind of table still needs the
+                // other; its own segments override ours after the splice
+                return (haveDQT && haveDHT) ? JpegStreamKind::FULL
+                                            : JpegStreamKind::ABBREVIATED;
+            case JPEG_SOI:
+                return JpegStreamKind::INVALID;
+            default:
+                break;
+        }
+        pos += segBytes;
+    }
+    return JpegStreamKind::INVALID;
+}
+
+bool JpegAbbrevDecoder::setTables(const uint8_t* data, size_t len) {
+    if (classify(data, len) != JpegStreamKind::TABLES) {
+        return false;
+    }
+
+    // Keep the segments between SOI and EOI
+    size_t pos = 2;
+    size_t length = 0;
+    uint8_t marker;
+    size_t segBytes;
+    while (nextSegment(data, len, pos, marker, segBytes) && marker != JPEG_EOI) {
+        if (isTableMarker(marker)) {
+            if (length + segBytes > sizeof(_tables)) {
+                _tablesLength = 0;
+                return false;
+            }
+            memcpy(&_tables[length], &data[pos], segBytes);
+            length += segBytes;
+        }
+        pos += segBytes;
+    }
+    _tablesLength = length;
+    return true;
+}
+
+size_t JpegAbbrevDecoder::decode(const uint8_t* frame, size_t len, uint8_t* out, size_t outCapacity) {
+    if (!out) {
+        return 0;
+    }
+
+    switch (classify(frame, len)) {
+        case JpegStreamKind::FULL:
+            if (outCapacity < len) {
+                return 0;
+            }
+            memcpy(out, frame, len);
+            return len;
+
+        case JpegStreamKind::ABBREVIATED:
+            if (_tablesLength == 0 || outCapacity < len + _tablesLength) {
+                return 0;
+            }
+            // Tables go straight after SOI, ahead of the frame's own segments
+            out[0] = 0xFF;
+            out[1] = JPEG_SOI;
+            memcpy(&out[2], _tables, _tablesLength);
+            memcpy(&out[2 + _tablesLength], &frame[2], len - 2);
+            return len + _tablesLength;
+
+        default:
+            return 0;
+    }
+}
@@ -0,0 +1,105 @@
+#ifndef JPEG_ABBREV_H
+#define JPEG_ABBREV_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Abbreviated JPEG (ITU T.81 Annex B.5) for MJPEG transports we control.
+//
+// Every OV2640 frame carries the same DQT/DHT tables. The encoder strips them
+// and hands them out separately as a tables-only stream (SOI, DQT/DHT, EOI)
+// whenever they differ from what was last sent; frames then go out in
+// abbreviated form (SOI, APPn, SOF, SOS, scan, EOI). The decoder keeps the
+// latest tables and splices them back in to produce ordinary JPEGs.
+//
+// Both sides are self-describing: a tables-only stream has no SOF/SOS and a
+// full frame still contains its DQT segments, so a receiver can accept any
+// mix of the three on the same channel (full frames pass straight through).
+//
+// No transport in the firmware uses this: RTMP and the recorder's FLV files
+// must stay playable by stock decoders, and RTP (RFC 2435) strips the
+// headers itself. It lives with jpeg_abbrev_savings, which measures the
+// saving on captured frames for a transport that would have its own
+// receiver.
+
+#define JPEG_ABBREV_MAX_TABLES  2048    // OV2640 tables are ~570 bytes
+
+enum class JpegStreamKind {
+    INVALID,
+    TABLES,         // Tables-only stream
+    ABBREVIATED,    // Frame without DQT/DHT
+    FULL            // Complete interchange-format frame
+};
+
+class JpegAbbrevEncoder {
+public:
+    JpegAbbrevEncoder();
+
+    // Start a new session: the next frame's tables are sent unconditionally
+    void reset();
+
+    // Also resend the tables every N frames for lossy channels and late
+    // joiners (0 = only when they change)
+    void setRefreshInterval(uint32_t frames) { _refreshInterval = frames; }
+
+    // Write the abbreviated frame to out and return its length, or 0 if the
+    // frame could not be split (send the original instead). out needs at most
+    // the input length.
+    size_t encode(const uint8_t* jpeg, size_t len, uint8_t* out, size_t outCapacity);
+
+    // True after encode() when getTables() must be sent ahead of the frame
+    bool tablesChanged() const { return _tablesChanged; }
+    const uint8_t* getTables() const { return _tables; }
+    size_t getTablesLength() const { return _tablesLength; }
+    uint32_t getTablesGeneration() const { return _generation; }
+
+    // Statistics
+    uint32_t getFramesEncoded() const { return _framesEncoded; }
+    uint32_t getTableSends() const { return _tableSends; }
+    uint64_t getBytesIn() const { return _bytesIn; }
+    uint64_t getBytesOut() const { return _bytesOut; }  // Frames plus table sends
+
+private:
+    uint8_t _tables[JPEG_ABBREV_MAX_TABLES];
+    size_t _tablesLength;
+    bool _tablesChanged;
+    bool _forceTables;
+    uint32_t _generation;
+    uint32_t _refreshInterval;
+    uint32_t _framesSinceTables;
+
+    uint32_t _framesEncoded;
+    uint32_t _tableSends;
+    uint64_t _bytesIn;
+    uint64_t _bytesOut;
+};
+
+class JpegAbbrevDecoder {
+public:
+    JpegAbbrevDecoder();
+
+    // Forget the tables (new session)
+    void reset() { _tablesLength = 0; }
+
+    // Store a tables-only stream. Returns false if it is not one.
+    bool setTables(const uint8_t* data, size_t len);
+    bool hasTables() const { return _tablesLength > 0; }
+
+    // Rebuild a full JPEG from an abbreviated frame (full frames are copied
+    // unchanged). Returns the output length, or 0 if the frame is malformed,
+    // no tables have been received yet, or out is too small.
+    size_t decode(const uint8_t* frame, size_t len, uint8_t* out, size_t outCapacity);
+
+    // Output buffer size that is always sufficient for decode()
+    static size_t maxOutputSize(size_t inputLen) { return inputLen + JPEG_ABBREV_MAX_TABLES; }
+
+    // Classify a buffer by walking its header segments
+    static JpegStreamKind classify(const uint8_t* data, size_t len);
+
+private:
+    // Table segments only, without the SOI/EOI wrapper
+    uint8_t _tables[JPEG_ABBREV_MAX_TABLES];
+    size_t _tablesLength;
+};
+
+#endif // JPEG_ABBREV_H
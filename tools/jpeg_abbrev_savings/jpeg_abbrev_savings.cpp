@@ -0,0 +1,151 @@
+// Measures what abbreviated-JPEG transport saves on a set of captured frames.
+//
+// Feeds every .jpg in a directory (in name order) through JpegAbbrevEncoder,
+// as a stream would, then rebuilds each frame with JpegAbbrevDecoder and
+// checks that nothing but the table placement changed.
+//
+// Build (host):
+//   g++ -O2 -std=gnu++17 -Ilib/JpegCodec
+//       tools/jpeg_abbrev_savings/jpeg_abbrev_savings.cpp tools/jpeg_abbrev_savings/JpegAbbrev.cpp
+//       -o jpeg_abbrev_savings
+//
+// Usage:
+//   jpeg_abbrev_savings <frames-dir> [refresh-frames]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <JpegCodec.h>
+#include "JpegAbbrev.h"
+
+static bool readFile(const std::string& path, std::vector<uint8_t>& data) {
+    FILE* f = fopen(path.c_str(), "rb");
+    if (!f) {
+        return false;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    data.resize(size > 0 ? size : 0);
+    bool ok = size > 0 && fread(data.data(), 1, size, f) == (size_t)size;
+    fclose(f);
+    return ok;
+}
+
+static bool hasJpegExtension(const char* name) {
+    const char* dot = strrchr(name, '.');
+    return dot && (strcasecmp(dot, ".jpg") == 0 || strcasecmp(dot, ".jpeg") == 0);
+}
+
+// Offset of the SOS marker (everything from there on must survive untouched)
+static size_t findSOS(const std::vector<uint8_t>& data) {
+    for (size_t i = 2; i + 1 < data.size(); i++) {
+        if (data[i] == 0xFF && data[i + 1] == JPEG_SOS) {
+            return i;
+        }
+    }
+    return data.size();
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <frames-dir> [refresh-frames]\n", argv[0]);
+        return 2;
+    }
+    std::string dir = argv[1];
+    uint32_t refresh = argc > 2 ? (uint32_t)atoi(argv[2]) : 0;
+
+    DIR* d = opendir(dir.c_str());
+    if (!d) {
+        fprintf(stderr, "Cannot open %s\n", dir.c_str());
+        return 1;
+    }
+    std::vector<std::string> files;
+    while (struct dirent* entry = readdir(d)) {
+        if (hasJpegExtension(entry->d_name)) {
+            files.push_back(dir + "/" + entry->d_name);
+        }
+    }
+    closedir(d);
+    std::sort(files.begin(), files.end());
+    if (files.empty()) {
+        fprintf(stderr, "No .jpg files in %s\n", dir.c_str());
+        return 1;
+    }
+
+    JpegAbbrevEncoder encoder;
+    JpegAbbrevDecoder decoder;
+    encoder.setRefreshInterval(refresh);
+
+    std::vector<uint8_t> frame, abbreviated, rebuilt;
+    uint32_t skipped = 0;
+    uint32_t mismatches = 0;
+    uint64_t passthroughBytes = 0;
+
+    for (const std::string& path : files) {
+        if (!readFile(path, frame)) {
+            fprintf(stderr, "%s: read failed\n", path.c_str());
+            skipped++;
+            continue;
+        }
+
+        abbreviated.resize(frame.size());
+        size_t len = encoder.encode(frame.data(), frame.size(), abbreviated.data(), abbreviated.size());
+        if (len == 0) {
+            // The stream would send this frame whole
+            fprintf(stderr, "%s: not split, sent as full frame\n", path.c_str());
+            passthroughBytes += frame.size();
+            skipped++;
+            continue;
+        }
+
+        // Receiver side
+        if (encoder.tablesChanged() &&
+            !decoder.setTables(encoder.getTables(), encoder.getTablesLength())) {
+            fprintf(stderr, "%s: tables rejected by decoder\n", path.c_str());
+            return 1;
+        }
+        if (JpegAbbrevDecoder::classify(abbreviated.data(), len) != JpegStreamKind::ABBREVIATED) {
+            fprintf(stderr, "%s: output not recognised as abbreviated\n", path.c_str());
+            mismatches++;
+            continue;
+        }
+
+        rebuilt.resize(JpegAbbrevDecoder::maxOutputSize(len));
+        size_t rebuiltLen = decoder.decode(abbreviated.data(), len, rebuilt.data(), rebuilt.size());
+        rebuilt.resize(rebuiltLen);
+
+        size_t sos = findSOS(frame);
+        size_t rebuiltSos = findSOS(rebuilt);
+        if (rebuiltLen != frame.size() || frame.size() - sos != rebuiltLen - rebuiltSos ||
+            memcmp(&frame[sos], &rebuilt[rebuiltSos], frame.size() - sos) != 0) {
+            fprintf(stderr, "%s: reconstructed frame differs\n", path.c_str());
+            mismatches++;
+        }
+    }
+
+    uint32_t frames = encoder.getFramesEncoded();
+    uint64_t bytesIn = encoder.getBytesIn() + passthroughBytes;
+    uint64_t bytesOut = encoder.getBytesOut() + passthroughBytes;
+
+    printf("Frames:          %u (%u sent whole)\n", frames, skipped);
+    if (frames == 0) {
+        return 1;
+    }
+    printf("Average frame:   %.0f bytes\n", (double)encoder.getBytesIn() / frames);
+    printf("Tables:          %zu bytes, sent %u times (generation %u)\n",
+           encoder.getTablesLength(), encoder.getTableSends(), encoder.getTablesGeneration());
+    printf("Full stream:     %llu bytes\n", (unsigned long long)bytesIn);
+    printf("Abbreviated:     %llu bytes (incl. table sends)\n", (unsigned long long)bytesOut);
+    printf("Saved:           %llu bytes (%.2f%%), %.0f bytes/frame\n",
+           (unsigned long long)(bytesIn - bytesOut),
+           bytesIn ? 100.0 * (double)(bytesIn - bytesOut) / (double)bytesIn : 0.0,
+           (double)(bytesIn - bytesOut) / frames);
+    printf("Round trip:      %s\n", mismatches ? "MISMATCH" : "ok");
+
+    return mismatches ? 1 : 0;
+}
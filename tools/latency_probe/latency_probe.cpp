@@ -0,0 +1,371 @@
+// Measures capture->ingest latency from the stamps LATENCY_PROBE_ENABLED
+// firmware embeds in every frame (see lib/LatencyProbe).
+//
+// Listens as a local RTMP ingest, extracts each frame's sequence number and
+// timestamps, and reports:
+//   - capture->ingest latency (receiver UTC minus capture UTC; needs the
+//     camera's NTP-synced clock and a synced host)
+//   - on-device latency (capture to hand-off, from the device's own clock)
+//   - frame gaps, reordering and duplicates from the sequence numbers
+//
+// With --simulate the tool also runs a simulated camera in-process: synthetic
+// JPEG frames paced at --fps, stamped the same way, with configurable
+// pipeline delay, jitter, drops and reordering, published over loopback. No
+// hardware or network is needed, so it can run in CI.
+//
+// Build (host):
+//   g++ -O2 -std=gnu++17 -pthread -Ilib/JpegCodec -Ilib/LatencyProbe -Ilib/SyntheticJpeg
+//       -Itools/common tools/latency_probe/latency_probe.cpp lib/LatencyProbe/LatencyProbe.cpp
+//       lib/JpegCodec/JpegCodec.cpp lib/SyntheticJpeg/SyntheticJpeg.cpp
+//       tools/common/RtmpSink.cpp tools/common/RtmpPublisher.cpp -o latency_probe
+//
+// Usage:
+//   latency_probe [--port N] [--csv FILE]
+//   latency_probe --simulate [--frames N] [--fps F] [--delay-ms D] [--jitter-ms J]
+//                 [--drop P] [--reorder P] [--seed S] [--csv FILE]
+//
+// Point the camera at rtmp://<host>:<port>/live/test. Stops when the
+// publisher disconnects (or on Ctrl-C) and prints the report.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <math.h>
+#include <thread>
+#include <vector>
+#include <unordered_set>
+#include <algorithm>
+#include <LatencyProbe.h>
+#include <RtmpSink.h>
+#include <RtmpPublisher.h>
+#include <SyntheticJpeg.h>
+
+struct FrameRecord {
+    LatencyStamp stamp;
+    uint64_t receivedMicros;
+};
+
+struct SimulationConfig {
+    uint32_t frames;
+    double fps;
+    double delayMs;             // Fixed capture->send pipeline delay
+    double jitterMs;            // Extra uniformly distributed delay
+    double dropProbability;
+    double reorderProbability;
+    uint32_t seed;
+};
+
+static RtmpSink sink;
+
+static void onSignal(int) {
+    sink.stop();
+}
+
+static uint64_t monotonicMicros() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000;
+}
+
+static void sleepUntil(uint64_t monotonic) {
+    uint64_t now = monotonicMicros();
+    if (monotonic > now) {
+        struct timespec ts;
+        uint64_t wait = monotonic - now;
+        ts.tv_sec = (time_t)(wait / 1000000);
+        ts.tv_nsec = (long)(wait % 1000000) * 1000;
+        nanosleep(&ts, nullptr);
+    }
+}
+
+// Simulated camera: paced capture, stamping, pipeline delay, then publish.
+// A frame picked for reordering is held back and sent after the next one.
+static void runSimulatedCamera(uint16_t port, SimulationConfig config, uint32_t* sent) {
+    RtmpPublisher publisher;
+    for (int attempt = 0; attempt < 50 && !publisher.connect("127.0.0.1", port, "live", "test"); attempt++) {
+        usleep(20000);
+    }
+
+    SyntheticJpeg camera;
+    camera.begin(320, 240, 12);
+    srand(config.seed);
+
+    std::vector<uint8_t> jpeg;
+    std::vector<uint8_t> stamped;
+    std::vector<uint8_t> held;
+    uint32_t heldTimestamp = 0;
+    uint64_t start = monotonicMicros();
+    *sent = 0;
+
+    for (uint32_t i = 0; i < config.frames; i++) {
+        uint64_t capture = start + (uint64_t)(i * 1000000.0 / config.fps);
+        sleepUntil(capture);
+        if (!camera.capture(i, jpeg)) {
+            continue;
+        }
+
+        double jitter = config.jitterMs * (rand() / (double)RAND_MAX);
+        uint64_t send = capture + (uint64_t)((config.delayMs + jitter) * 1000.0);
+        sleepUntil(send);
+
+        if (rand() / (double)RAND_MAX < config.dropProbability) {
+            continue;
+        }
+
+        LatencyStamp stamp;
+        stamp.sequence = i;
+        stamp.captureMicros = capture;
+        stamp.sendMicros = monotonicMicros();
+        stamp.wallMicros = RtmpSink::realtimeMicros() - (stamp.sendMicros - capture);
+        stamp.flags = LATENCY_FLAG_WALL_CLOCK;
+
+        stamped.resize(LatencyProbe::maxOutputSize(jpeg.size()));
+        size_t len = LatencyProbe::stamp(jpeg.data(), jpeg.size(), stamp, stamped.data(), stamped.size());
+        stamped.resize(len);
+        uint32_t timestamp = (uint32_t)((capture - start) / 1000);
+
+        if (held.empty() && rand() / (double)RAND_MAX < config.reorderProbability) {
+            held.swap(stamped);
+            heldTimestamp = timestamp;
+            continue;
+        }
+
+        if (!publisher.sendVideo(stamped.data(), stamped.size(), timestamp)) {
+            break;
+        }
+        (*sent)++;
+        if (!held.empty()) {
+            if (!publisher.sendVideo(held.data(), held.size(), heldTimestamp)) {
+                break;
+            }
+            (*sent)++;
+            held.clear();
+        }
+    }
+    if (!held.empty() && publisher.sendVideo(held.data(), held.size(), heldTimestamp)) {
+        (*sent)++;
+    }
+    publisher.close();
+}
+
+static double percentile(const std::vector<double>& sorted, double p) {
+    if (sorted.empty()) {
+        return 0.0;
+    }
+    size_t rank = (size_t)ceil(p / 100.0 * sorted.size());
+    rank = rank < 1 ? 1 : (rank > sorted.size() ? sorted.size() : rank);
+    return sorted[rank - 1];
+}
+
+static void printDistribution(const char* title, std::vector<double> values) {
+    if (values.empty()) {
+        printf("%s: no samples\n", title);
+        return;
+    }
+    std::sort(values.begin(), values.end());
+    double sum = 0.0;
+    for (double v : values) {
+        sum += v;
+    }
+    printf("%s (%zu frames, ms)\n", title, values.size());
+    printf("  min %.2f  p50 %.2f  p90 %.2f  p95 %.2f  p99 %.2f  max %.2f  mean %.2f\n",
+           values.front(), percentile(values, 50), percentile(values, 90), percentile(values, 95),
+           percentile(values, 99), values.back(), sum / values.size());
+
+    // Coarse histogram with doubling buckets from 1 ms
+    const int buckets = 12;
+    uint32_t counts[buckets + 1] = { 0 };
+    for (double v : values) {
+        int b = 0;
+        double edge = 1.0;
+        while (b < buckets && v >= edge) {
+            edge *= 2.0;
+            b++;
+        }
+        counts[b]++;
+    }
+    double lower = 0.0;
+    double upper = 1.0;
+    for (int b = 0; b <= buckets; b++) {
+        if (counts[b]) {
+            int bar = (int)(40.0 * counts[b] / values.size() + 0.5);
+            if (b < buckets) {
+                printf("  %6.0f-%-6.0f %7u %s\n", lower, upper, counts[b], std::string(bar, '#').c_str());
+            } else {
+                printf("  %6.0f+       %7u %s\n", lower, counts[b], std::string(bar, '#').c_str());
+            }
+        }
+        lower = upper;
+        upper *= 2.0;
+    }
+}
+
+int main(int argc, char** argv) {
+    uint16_t port = 1935;
+    const char* csvPath = nullptr;
+    bool simulate = false;
+    SimulationConfig sim = { 300, 30.0, 40.0, 10.0, 0.0, 0.0, 1 };
+
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--simulate") == 0) simulate = true;
+        else if (strcmp(argv[i], "--port") == 0 && hasValue) port = (uint16_t)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--csv") == 0 && hasValue) csvPath = argv[++i];
+        else if (strcmp(argv[i], "--frames") == 0 && hasValue) sim.frames = (uint32_t)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--fps") == 0 && hasValue) sim.fps = atof(argv[++i]);
+        else if (strcmp(argv[i], "--delay-ms") == 0 && hasValue) sim.delayMs = atof(argv[++i]);
+        else if (strcmp(argv[i], "--jitter-ms") == 0 && hasValue) sim.jitterMs = atof(argv[++i]);
+        else if (strcmp(argv[i], "--drop") == 0 && hasValue) sim.dropProbability = atof(argv[++i]);
+        else if (strcmp(argv[i], "--reorder") == 0 && hasValue) sim.reorderProbability = atof(argv[++i]);
+        else if (strcmp(argv[i], "--seed") == 0 && hasValue) sim.seed = (uint32_t)atoi(argv[++i]);
+        else {
+            fprintf(stderr, "Usage: %s [--port N] [--csv FILE] [--simulate [--frames N] [--fps F]"
+                            " [--delay-ms D] [--jitter-ms J] [--drop P] [--reorder P] [--seed S]]\n",
+                    argv[0]);
+            return 2;
+        }
+    }
+
+    if (!sink.listen(simulate ? 0 : port)) {
+        fprintf(stderr, "Cannot listen on port %u: %s\n", port, sink.getError().c_str());
+        return 1;
+    }
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+
+    std::thread camera;
+    uint32_t simulatedSent = 0;
+    if (simulate) {
+        printf("Simulated camera: %u frames at %.2f fps, delay %.1f ms + up to %.1f ms jitter,"
+               " drop %.3f, reorder %.3f\n", sim.frames, sim.fps, sim.delayMs, sim.jitterMs,
+               sim.dropProbability, sim.reorderProbability);
+        camera = std::thread(runSimulatedCamera, sink.getPort(), sim, &simulatedSent);
+    } else {
+        printf("Waiting for a publisher on rtmp://0.0.0.0:%u/live/test ...\n", sink.getPort());
+    }
+
+    std::vector<FrameRecord> records;
+    uint32_t videoMessages = 0;
+    uint32_t unstamped = 0;
+
+    bool ok = sink.serveOne([&](const RtmpMessage& message) {
+        if (message.type != RTMP_MSG_VIDEO) {
+            return;
+        }
+        videoMessages++;
+
+        // The JPEG follows the FLV video tag header; find its SOI
+        const uint8_t* payload = message.payload.data();
+        size_t len = message.payload.size();
+        size_t soi = 0;
+        while (soi + 1 < len && soi < 16 && !(payload[soi] == 0xFF && payload[soi + 1] == 0xD8)) {
+            soi++;
+        }
+
+        FrameRecord record;
+        if (soi + 1 < len && LatencyProbe::parse(payload + soi, len - soi, record.stamp)) {
+            record.receivedMicros = message.receivedMicros;
+            records.push_back(record);
+        } else {
+            unstamped++;
+        }
+    }, simulate ? 5000 : -1);
+
+    if (camera.joinable()) {
+        camera.join();
+    }
+    if (!ok && records.empty()) {
+        fprintf(stderr, "No stream received: %s\n", sink.getError().c_str());
+        return 1;
+    }
+    if (!ok) {
+        printf("Stream ended abnormally: %s\n", sink.getError().c_str());
+    }
+
+    // Sequence analysis in arrival order
+    uint32_t missing = 0;
+    uint32_t gapEvents = 0;
+    uint32_t maxGap = 0;
+    uint32_t reordered = 0;
+    uint32_t duplicates = 0;
+    std::unordered_set<uint32_t> seen;
+    bool haveHighest = false;
+    uint32_t first = 0;
+    uint32_t highest = 0;
+
+    std::vector<double> ingest;
+    std::vector<double> device;
+    std::vector<double> transport;
+
+    for (const FrameRecord& r : records) {
+        uint32_t seq = r.stamp.sequence;
+        if (!seen.insert(seq).second) {
+            duplicates++;
+            continue;
+        }
+
+        if (!haveHighest) {
+            first = seq;
+            highest = seq;
+            haveHighest = true;
+        } else if (seq > highest) {
+            uint32_t gap = seq - highest - 1;
+            if (gap) {
+                missing += gap;
+                gapEvents++;
+                maxGap = std::max(maxGap, gap);
+            }
+            highest = seq;
+        } else {
+            // Late arrival: it was counted as missing when the gap opened
+            reordered++;
+            if (seq > first) {
+                missing--;
+            }
+        }
+
+        device.push_back((double)(r.stamp.sendMicros - r.stamp.captureMicros) / 1000.0);
+        if (r.stamp.flags & LATENCY_FLAG_WALL_CLOCK) {
+            double total = ((double)r.receivedMicros - (double)r.stamp.wallMicros) / 1000.0;
+            ingest.push_back(total);
+            transport.push_back(total - device.back());
+        }
+    }
+
+    if (csvPath) {
+        FILE* csv = fopen(csvPath, "w");
+        if (csv) {
+            fprintf(csv, "sequence,capture_us,send_us,wall_us,received_us,ingest_latency_us\n");
+            for (const FrameRecord& r : records) {
+                bool wall = (r.stamp.flags & LATENCY_FLAG_WALL_CLOCK) != 0;
+                fprintf(csv, "%u,%llu,%llu,%llu,%llu,%lld\n", r.stamp.sequence,
+                        (unsigned long long)r.stamp.captureMicros, (unsigned long long)r.stamp.sendMicros,
+                        (unsigned long long)r.stamp.wallMicros, (unsigned long long)r.receivedMicros,
+                        wall ? (long long)(r.receivedMicros - r.stamp.wallMicros) : -1LL);
+            }
+            fclose(csv);
+        } else {
+            fprintf(stderr, "Cannot write %s\n", csvPath);
+        }
+    }
+
+    printf("\nVideo messages: %u (stamped %zu, unstamped %u), %llu bytes, %llu chunks\n",
+           videoMessages, records.size(), unstamped,
+           (unsigned long long)sink.getBytesReceived(), (unsigned long long)sink.getChunks());
+    if (simulate) {
+        printf("Simulated camera sent: %u of %u frames\n", simulatedSent, sim.frames);
+    }
+    printf("Sequence: missing %u (%u gaps, longest %u), reordered %u, duplicates %u\n\n",
+           missing, gapEvents, maxGap, reordered, duplicates);
+
+    if (ingest.empty() && !device.empty()) {
+        printf("Capture->ingest: camera wall clock not synced (no NTP), skipped\n");
+    } else {
+        printDistribution("Capture->ingest", ingest);
+        printDistribution("Network and ingest (capture->ingest minus on-device)", transport);
+    }
+    printDistribution("On-device (capture->hand-off)", device);
+    return 0;
+}
@@ -0,0 +1,185 @@
+// Replays recorded frame-size traces through RateController and compares the
+// resulting size distribution and bursts with the fixed-quality stream.
+//
+// A trace line is either "RC,<quality>,<bytes>" (as logged by the camera
+// task with CAMERA_RATE_CONTROL_TRACE), "<quality> <bytes>", or just
+// "<bytes>" (recorded at --quality). Each recorded frame stands for the scene
+// content; its size at another quality is extrapolated with the exponential
+// model using --slope, so the trace should come from a fixed-quality run.
+//
+// Build (host):
+//   g++ -O2 -std=gnu++17 -Ilib/RateController
+//       tools/rate_control_sim/rate_control_sim.cpp lib/RateController/RateController.cpp
+//       -o rate_control_sim
+//
+// Usage:
+//   rate_control_sim <trace> [--target BYTES] [--quality Q] [--min Q] [--max Q]
+//                    [--slope K] [--latency FRAMES] [--window FRAMES]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include <algorithm>
+#include <RateController.h>
+
+struct TraceFrame {
+    int quality;
+    double bytes;
+};
+
+struct Summary {
+    double mean;
+    double stddev;
+    double p95;
+    double peak;
+    double peakWindow;          // Largest sum over any run of --window frames
+    uint32_t overBudget;        // Frames larger than twice the target
+    double meanQuality;
+    uint32_t qualityChanges;
+};
+
+static bool loadTrace(const char* path, int defaultQuality, std::vector<TraceFrame>& trace) {
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        return false;
+    }
+    char line[256];
+    while (fgets(line, sizeof(line), f)) {
+        // Firmware lines carry a log prefix ("I (1234) RC,...")
+        const char* p = line;
+        if (const char* rc = strstr(line, "RC,")) {
+            p = rc + 3;
+        }
+        if (*p == '#' || *p == '\n' || *p == '\0') {
+            continue;
+        }
+        double a, b;
+        int n = sscanf(p, "%lf%*[, \t]%lf", &a, &b);
+        if (n == 2) {
+            trace.push_back({ (int)a, b });
+        } else if (n == 1) {
+            trace.push_back({ defaultQuality, a });
+        }
+    }
+    fclose(f);
+    return !trace.empty();
+}
+
+static Summary summarise(const std::vector<double>& sizes, const std::vector<int>& qualities,
+                         double target, size_t window) {
+    Summary s = {};
+    size_t n = sizes.size();
+    for (size_t i = 0; i < n; i++) {
+        s.mean += sizes[i];
+        s.meanQuality += qualities[i];
+        if (sizes[i] > s.peak) s.peak = sizes[i];
+        if (sizes[i] > 2.0 * target) s.overBudget++;
+        if (i > 0 && qualities[i] != qualities[i - 1]) s.qualityChanges++;
+    }
+    s.mean /= n;
+    s.meanQuality /= n;
+    for (size_t i = 0; i < n; i++) {
+        s.stddev += (sizes[i] - s.mean) * (sizes[i] - s.mean);
+    }
+    s.stddev = sqrt(s.stddev / n);
+
+    std::vector<double> sorted = sizes;
+    std::sort(sorted.begin(), sorted.end());
+    s.p95 = sorted[std::min(n - 1, (size_t)(0.95 * n))];
+
+    double sum = 0;
+    for (size_t i = 0; i < n; i++) {
+        sum += sizes[i];
+        if (i >= window) sum -= sizes[i - window];
+        if (sum > s.peakWindow) s.peakWindow = sum;
+    }
+    return s;
+}
+
+static void printSummary(const char* name, const Summary& s) {
+    printf("%-16s %8.0f %8.0f %6.3f %8.0f %8.0f %10.0f %6u %6.1f %7u\n", name, s.mean, s.stddev,
+           s.stddev / s.mean, s.p95, s.peak, s.peakWindow, s.overBudget, s.meanQuality,
+           s.qualityChanges);
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <trace> [--target BYTES] [--quality Q] [--min Q] [--max Q]"
+                        " [--slope K] [--latency FRAMES] [--window FRAMES]\n", argv[0]);
+        return 2;
+    }
+
+    double target = 0;
+    int quality = 12;
+    int minQuality = 10;
+    int maxQuality = 40;
+    double slope = 0.058;
+    int latency = 1;
+    size_t window = 8;
+
+    for (int i = 2; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--target") == 0) target = atof(argv[i + 1]);
+        else if (strcmp(argv[i], "--quality") == 0) quality = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--min") == 0) minQuality = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--max") == 0) maxQuality = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--slope") == 0) slope = atof(argv[i + 1]);
+        else if (strcmp(argv[i], "--latency") == 0) latency = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--window") == 0) window = (size_t)atoi(argv[i + 1]);
+        else {
+            fprintf(stderr, "Unknown option %s\n", argv[i]);
+            return 2;
+        }
+    }
+
+    std::vector<TraceFrame> trace;
+    if (!loadTrace(argv[1], quality, trace)) {
+        fprintf(stderr, "Cannot read trace %s\n", argv[1]);
+        return 1;
+    }
+
+    // Fixed quality: the trace as recorded
+    std::vector<double> fixedSizes;
+    std::vector<int> fixedQualities;
+    for (const TraceFrame& frame : trace) {
+        fixedSizes.push_back(frame.bytes);
+        fixedQualities.push_back(frame.quality);
+    }
+    if (target <= 0) {
+        double mean = 0;
+        for (double bytes : fixedSizes) mean += bytes;
+        target = mean / fixedSizes.size();
+    }
+
+    // Controlled: each frame is captured with the quality chosen `latency`
+    // frames earlier
+    RateController controller;
+    controller.begin((uint32_t)target, minQuality, maxQuality, trace[0].quality);
+    controller.setLatency(latency);
+
+    std::vector<int> pending(latency + 1, trace[0].quality);
+    std::vector<double> controlledSizes;
+    std::vector<int> controlledQualities;
+    for (const TraceFrame& frame : trace) {
+        int q = pending.front();
+        double bytes = frame.bytes * exp(-slope * (q - frame.quality));
+        controlledSizes.push_back(bytes);
+        controlledQualities.push_back(q);
+
+        pending.erase(pending.begin());
+        pending.push_back(controller.update((size_t)bytes));
+    }
+
+    printf("Trace: %s, %zu frames, target %.0f bytes, burst window %zu frames\n\n", argv[1],
+           trace.size(), target, window);
+    printf("%-16s %8s %8s %6s %8s %8s %10s %6s %6s %7s\n", "", "mean", "stddev", "cv", "p95",
+           "peak", "peak-win", ">2x", "q-avg", "changes");
+    Summary fixed = summarise(fixedSizes, fixedQualities, target, window);
+    Summary controlled = summarise(controlledSizes, controlledQualities, target, window);
+    printSummary("fixed quality", fixed);
+    printSummary("rate controlled", controlled);
+    printf("\nLearned slope %.4f (simulated %.4f)\n", controller.getSlope(), slope);
+
+    return 0;
+}
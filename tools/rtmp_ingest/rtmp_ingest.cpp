@@ -0,0 +1,820 @@
+// Local RTMP ingest for testing the streaming path without YouTube/Twitch.
+//
+// Behaves like an ingest server towards the publisher: plain handshake,
+// Window Acknowledgement Size / Set Peer Bandwidth / Set Chunk Size after
+// connect, _result for connect and createStream, Stream Begin and
+// NetStream.Publish.Start for publish, ping responses and acknowledgements,
+// and Ping Requests to the publisher with --ping-ms.
+//
+// For every session it checks what the publisher sends against the RTMP and
+// FLV specs and reports:
+//   - conformance problems (control messages off chunk stream 2 / stream 0,
+//     bad control payloads, Ping Requests from the publisher, commands out
+//     of order, media before publish or on the wrong stream, timestamps
+//     going backwards or jumping (per type, and across audio and video),
+//     malformed AMF, FLV tag headers that do not match the payload,
+//     aggregates that do not parse)
+//   - per-message arrival times, video and audio inter-arrival percentiles,
+//     drift between message timestamps and arrival, and how much later than
+//     the earliest one each audio message arrived (time spent queued)
+//   - goodput (media payload) against wire bytes, with the overhead split
+//     into chunk headers, handshake and non-media messages (aggregate
+//     framing included)
+//
+// Aggregate messages are split and each sub-message is checked, recorded
+// and reported like one sent on its own.
+//
+// The receive side can be degraded to emulate a bad uplink: a read rate
+// limit, periodic stalls, a fixed delay and a small receive buffer (the
+// publisher sees them through TCP flow control), and the sink can drop the
+// connection a while after publish starts to exercise reconnects.
+//
+// Build (host):
+//   g++ -O2 -std=gnu++17 -pthread -Itools/common
+//       tools/rtmp_ingest/rtmp_ingest.cpp tools/common/RtmpSink.cpp -o rtmp_ingest
+//
+// Usage:
+//   rtmp_ingest [--port N] [--chunk-size N] [--ack-window N] [--ping-ms N] [--flv FILE]
+//               [--csv FILE] [--rate-kbps K] [--stall-ms S --stall-every-ms P] [--delay-ms D]
+//               [--rcvbuf-kb K] [--drop-after-s T] [--once]
+//
+// Point the camera at rtmp://<host>:<port>/live. Serves publishers one after
+// another until Ctrl-C (or after the first with --once). --flv writes each
+// session to FILE, FILE-2, ...; --csv logs every message of every session.
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <math.h>
+#include <map>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <RtmpSink.h>
+
+#define INGEST_STREAM_ID        1           // What RtmpSink hands out in createStream
+#define INGEST_MAX_EXAMPLES     3           // Per finding kind
+#define INGEST_TIMESTAMP_JUMP   5000        // ms; larger forward steps are flagged
+#define INGEST_MAX_CHUNK_SIZE   0xFFFFFF    // Largest chunk size a message length can use
+#define INGEST_FLV_TAG_HEADER   11          // Aggregate sub-message header
+
+static RtmpSink sink;
+
+static void onSignal(int) {
+    sink.stop();
+}
+
+static uint32_t readBig32(const uint8_t* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static double percentile(const std::vector<double>& sorted, double p) {
+    if (sorted.empty()) {
+        return 0.0;
+    }
+    size_t rank = (size_t)ceil(p / 100.0 * sorted.size());
+    rank = rank < 1 ? 1 : (rank > sorted.size() ? sorted.size() : rank);
+    return sorted[rank - 1];
+}
+
+static const char* typeName(uint8_t type) {
+    switch (type) {
+        case RTMP_MSG_SET_CHUNK_SIZE:       return "SetChunkSize";
+        case RTMP_MSG_ABORT:                return "Abort";
+        case RTMP_MSG_ACK:                  return "Acknowledgement";
+        case RTMP_MSG_USER_CONTROL:         return "UserControl";
+        case RTMP_MSG_WINDOW_ACK_SIZE:      return "WindowAckSize";
+        case RTMP_MSG_SET_PEER_BANDWIDTH:   return "SetPeerBandwidth";
+        case RTMP_MSG_AUDIO:                return "Audio";
+        case RTMP_MSG_VIDEO:                return "Video";
+        case RTMP_MSG_DATA_AMF0:            return "Data (AMF0)";
+        case RTMP_MSG_COMMAND_AMF0:         return "Command (AMF0)";
+        case RTMP_MSG_AGGREGATE:            return "Aggregate";
+        default:                            return "Unknown";
+    }
+}
+
+// ============================================================================
+// FLV file writer
+// ============================================================================
+
+class FlvWriter {
+public:
+    FlvWriter() : _file(nullptr) {}
+    ~FlvWriter() { close(); }
+
+    bool open(const std::string& path) {
+        _file = fopen(path.c_str(), "wb");
+        if (!_file) {
+            return false;
+        }
+        // Signature, version 1, audio + video present, header size 9,
+        // then PreviousTagSize0
+        static const uint8_t header[13] = { 'F', 'L', 'V', 1, 0x05, 0, 0, 0, 9, 0, 0, 0, 0 };
+        fwrite(header, 1, sizeof(header), _file);
+        return true;
+    }
+
+    // Audio, video and script data messages become tags; RTMP data messages
+    // carry "@setDataFrame" in front of what FLV stores
+    void write(const RtmpMessage& message) {
+        if (!_file) {
+            return;
+        }
+        const uint8_t* data = message.payload.data();
+        size_t len = message.payload.size();
+        if (message.type == RTMP_MSG_DATA_AMF0) {
+            static const uint8_t prefix[] = { 0x02, 0x00, 0x0D, '@', 's', 'e', 't', 'D', 'a', 't', 'a',
+                                              'F', 'r', 'a', 'm', 'e' };
+            if (len > sizeof(prefix) && memcmp(data, prefix, sizeof(prefix)) == 0) {
+                data += sizeof(prefix);
+                len -= sizeof(prefix);
+            }
+        } else if (message.type != RTMP_MSG_AUDIO && message.type != RTMP_MSG_VIDEO) {
+            return;
+        }
+
+        uint8_t tag[11];
+        tag[0] = message.type;
+        tag[1] = (uint8_t)(len >> 16);
+        tag[2] = (uint8_t)(len >> 8);
+        tag[3] = (uint8_t)len;
+        tag[4] = (uint8_t)(message.timestamp >> 16);
+        tag[5] = (uint8_t)(message.timestamp >> 8);
+        tag[6] = (uint8_t)message.timestamp;
+        tag[7] = (uint8_t)(message.timestamp >> 24);     // TimestampExtended
+        tag[8] = tag[9] = tag[10] = 0;                      // StreamID, always 0
+        fwrite(tag, 1, sizeof(tag), _file);
+        fwrite(data, 1, len, _file);
+
+        uint32_t previous = (uint32_t)(sizeof(tag) + len);
+        uint8_t size[4] = { (uint8_t)(previous >> 24), (uint8_t)(previous >> 16),
+                            (uint8_t)(previous >> 8), (uint8_t)previous };
+        fwrite(size, 1, sizeof(size), _file);
+    }
+
+    void close() {
+        if (_file) {
+            fclose(_file);
+            _file = nullptr;
+        }
+    }
+
+private:
+    FILE* _file;
+};
+
+// ============================================================================
+// Per-session analysis
+// ============================================================================
+
+struct TypeStats {
+    uint32_t count;
+    uint64_t bytes;
+};
+
+class Session {
+public:
+    Session(uint32_t number, FILE* csv)
+        : _number(number)
+        , _csv(csv)
+        , _index(0)
+        , _connected(false)
+        , _created(false)
+        , _published(false)
+        , _publishMicros(0)
+        , _firstMicros(0)
+        , _lastMicros(0)
+        , _mediaBytes(0)
+        , _payloadBytes(0)
+        , _sawAvcHeader(false)
+        , _audioFlags(-1)
+        , _audioBytes(0)
+        , _firstAudioTs(0)
+        , _lastAudioTs(0)
+        , _sawMedia(false)
+        , _newestMediaTs(0)
+        , _aggregates(0)
+        , _aggregated(0)
+        , _aggregateFraming(0)
+    {
+    }
+
+    FlvWriter flv;
+
+    uint32_t messages() const { return _index; }
+
+    bool publishedFor(uint64_t micros, uint64_t now) const {
+        return _published && now >= _publishMicros + micros;
+    }
+
+    void onMessage(const RtmpMessage& message) {
+        _index++;
+        if (_firstMicros == 0) {
+            _firstMicros = message.receivedMicros;
+        }
+        _lastMicros = message.receivedMicros;
+        _payloadBytes += message.payload.size();
+
+        if (_csv) {
+            fprintf(_csv, "%u,%u,%u,%u,%u,%u,%zu,%llu\n", _number, _index, message.type,
+                    message.chunkStreamId, message.streamId, message.timestamp, message.payload.size(),
+                    (unsigned long long)message.receivedMicros);
+        }
+        dispatch(message);
+    }
+
+    // Counted and checked per message; the sub-messages of an aggregate come
+    // through here as well
+    void dispatch(const RtmpMessage& message) {
+        TypeStats& stats = _types[message.type];
+        stats.count++;
+        stats.bytes += message.payload.size();
+
+        checkTimestamp(message);
+        switch (message.type) {
+            case RTMP_MSG_SET_CHUNK_SIZE:
+            case RTMP_MSG_ABORT:
+            case RTMP_MSG_ACK:
+            case RTMP_MSG_WINDOW_ACK_SIZE:
+            case RTMP_MSG_SET_PEER_BANDWIDTH:
+            case RTMP_MSG_USER_CONTROL:
+                checkControl(message);
+                break;
+            case RTMP_MSG_COMMAND_AMF0:
+                checkCommand(message);
+                break;
+            case RTMP_MSG_AUDIO:
+            case RTMP_MSG_VIDEO:
+            case RTMP_MSG_DATA_AMF0:
+                checkMedia(message);
+                flv.write(message);
+                break;
+            case RTMP_MSG_AGGREGATE:
+                checkAggregate(message);
+                break;
+            default:
+                finding("unsupported message type", message, "type %u", message.type);
+                break;
+        }
+    }
+
+    void report(const RtmpSink& sink, const std::string& endReason) {
+        double seconds = _lastMicros > _firstMicros ? (_lastMicros - _firstMicros) / 1e6 : 0.0;
+        uint64_t wire = sink.getBytesReceived();
+        uint64_t headers = sink.getHeaderBytes();
+        uint64_t handshake = wire >= RTMP_HANDSHAKE_RECEIVED ? RTMP_HANDSHAKE_RECEIVED : wire;
+
+        printf("\n=== Session %u: %s, %.1f s, ended: %s ===\n", _number, sink.getPeer().c_str(), seconds,
+               endReason.c_str());
+        printf("Publisher chunk size %u; %u acknowledgements sent, %llu bytes sent\n",
+               sink.getChunkSize(), sink.getAcksSent(), (unsigned long long)sink.getBytesSent());
+        if (sink.getPingsSent() > 0) {
+            printf("Pings: %u sent, %u answered\n", sink.getPingsSent(), sink.getPingsAnswered());
+        }
+
+        printf("Messages (%llu in %llu chunks)\n", (unsigned long long)sink.getMessages(),
+               (unsigned long long)sink.getChunks());
+        for (const auto& entry : _types) {
+            printf("  %-18s %3u  %8u msgs  %12llu bytes\n", typeName(entry.first), entry.first,
+                   entry.second.count, (unsigned long long)entry.second.bytes);
+        }
+
+        printf("Throughput\n");
+        if (seconds > 0.0) {
+            printf("  wire %.3f Mbit/s, goodput %.3f Mbit/s (media payload)\n", wire * 8.0 / seconds / 1e6,
+                   _mediaBytes * 8.0 / seconds / 1e6);
+        }
+        if (wire > 0) {
+            uint64_t other = _payloadBytes - _mediaBytes;
+            printf("  overhead %.2f%%: chunk headers %llu (%.2f%%), handshake %llu (%.2f%%),"
+                   " non-media messages %llu (%.2f%%)\n",
+                   100.0 * (wire - _mediaBytes) / wire, (unsigned long long)headers, 100.0 * headers / wire,
+                   (unsigned long long)handshake, 100.0 * handshake / wire, (unsigned long long)other,
+                   100.0 * other / wire);
+        }
+        if (_perSecond.size() > 1) {
+            // The last second is partial
+            std::vector<uint64_t> whole(_perSecond.begin(), _perSecond.end() - 1);
+            uint64_t low = *std::min_element(whole.begin(), whole.end());
+            uint64_t high = *std::max_element(whole.begin(), whole.end());
+            uint64_t sum = 0;
+            for (uint64_t b : whole) {
+                sum += b;
+            }
+            printf("  per-second goodput min %.3f / avg %.3f / max %.3f Mbit/s over %zu s\n", low * 8.0 / 1e6,
+                   sum * 8.0 / whole.size() / 1e6, high * 8.0 / 1e6, whole.size());
+        }
+
+        if (_aggregates > 0) {
+            printf("Aggregates\n");
+            printf("  %u aggregates carrying %u messages (%.1f each), framing %llu bytes (%.2f%% of wire)\n",
+                   _aggregates, _aggregated, (double)_aggregated / _aggregates,
+                   (unsigned long long)_aggregateFraming, wire > 0 ? 100.0 * _aggregateFraming / wire : 0.0);
+        }
+
+        reportVideo();
+        reportAudio();
+
+        printf("Conformance\n");
+        if (_findings.empty()) {
+            printf("  no problems found\n");
+        }
+        for (const auto& entry : _findings) {
+            printf("  %-44s %u\n", entry.first.c_str(), entry.second);
+        }
+    }
+
+private:
+    uint32_t _number;
+    FILE* _csv;
+    uint32_t _index;
+
+    bool _connected;
+    bool _created;
+    bool _published;
+    uint64_t _publishMicros;
+
+    uint64_t _firstMicros;
+    uint64_t _lastMicros;
+    uint64_t _mediaBytes;
+    uint64_t _payloadBytes;
+    std::map<uint8_t, TypeStats> _types;
+    std::vector<uint64_t> _perSecond;
+    std::map<uint64_t, uint32_t> _lastTimestamp;    // By (stream ID, type)
+    std::map<std::string, uint32_t> _findings;
+
+    std::vector<uint64_t> _videoArrivals;
+    std::vector<uint32_t> _videoTimestamps;
+    bool _sawAvcHeader;
+
+    int _audioFlags;
+    uint64_t _audioBytes;
+    uint32_t _firstAudioTs;
+    uint32_t _lastAudioTs;
+    std::vector<uint64_t> _audioArrivals;
+    std::vector<uint32_t> _audioTimestamps;
+
+    bool _sawMedia;
+    uint32_t _newestMediaTs;                        // Audio and video together
+
+    uint32_t _aggregates;
+    uint32_t _aggregated;                           // Sub-messages
+    uint64_t _aggregateFraming;                     // Tag headers and back-pointers
+
+    // Count a problem; print the first few occurrences as they happen
+    void finding(const char* kind, const RtmpMessage& message, const char* format, ...)
+        __attribute__((format(printf, 4, 5))) {
+        uint32_t& count = _findings[kind];
+        if (++count > INGEST_MAX_EXAMPLES) {
+            return;
+        }
+        char detail[160];
+        va_list args;
+        va_start(args, format);
+        vsnprintf(detail, sizeof(detail), format, args);
+        va_end(args);
+        printf("  ! #%u %s (csid %u, stream %u, type %u, ts %u): %s\n", _index, kind, message.chunkStreamId,
+               message.streamId, message.type, message.timestamp, detail);
+    }
+
+    void checkTimestamp(const RtmpMessage& message) {
+        uint64_t key = ((uint64_t)message.streamId << 8) | message.type;
+        auto last = _lastTimestamp.find(key);
+        if (last != _lastTimestamp.end()) {
+            if (message.timestamp < last->second) {
+                finding("timestamp went backwards", message, "%u after %u", message.timestamp, last->second);
+            } else if (message.timestamp - last->second > INGEST_TIMESTAMP_JUMP) {
+                finding("timestamp jumped forward", message, "%u after %u", message.timestamp, last->second);
+            }
+        }
+        _lastTimestamp[key] = message.timestamp;
+    }
+
+    void checkControl(const RtmpMessage& message) {
+        const std::vector<uint8_t>& p = message.payload;
+        if (message.chunkStreamId != 2 || message.streamId != 0) {
+            finding("control message not on csid 2 / stream 0", message, "%s", typeName(message.type));
+        }
+
+        size_t expected = message.type == RTMP_MSG_SET_PEER_BANDWIDTH ? 5 : 4;
+        if (message.type == RTMP_MSG_USER_CONTROL) {
+            if (p.size() < 2) {
+                finding("malformed user control", message, "%zu bytes", p.size());
+                return;
+            }
+            uint16_t event = ((uint16_t)p[0] << 8) | p[1];
+            expected = event == 3 ? 10 : 6;             // SetBufferLength carries a length too
+            if (event > RTMP_UC_PING_RESPONSE || event == 5) {
+                finding("malformed user control", message, "unknown event %u", event);
+                return;
+            }
+            if (p.size() != expected) {
+                finding("malformed user control", message, "event %u with %zu bytes, expected %zu", event,
+                        p.size(), expected);
+            }
+            if (event == RTMP_UC_PING_REQUEST) {
+                finding("ping request from the publisher", message, "User Control event 6 is server to client");
+            }
+            return;
+        }
+        if (p.size() != expected) {
+            finding("bad control payload length", message, "%s with %zu bytes, expected %zu",
+                    typeName(message.type), p.size(), expected);
+            return;
+        }
+        if (message.type == RTMP_MSG_SET_CHUNK_SIZE) {
+            uint32_t size = readBig32(p.data());
+            if (size & 0x80000000) {
+                finding("bad chunk size", message, "0x%08X has the reserved bit set", size);
+            } else if (size == 0 || size > INGEST_MAX_CHUNK_SIZE) {
+                finding("bad chunk size", message, "%u", size);
+            }
+        }
+    }
+
+    void checkCommand(const RtmpMessage& message) {
+        RtmpCommand command;
+        if (!RtmpSink::parseCommand(message.payload, command)) {
+            finding("malformed AMF0 command", message, "%zu bytes", message.payload.size());
+            return;
+        }
+
+        if (command.name == "connect") {
+            if (_connected) {
+                finding("command out of order", message, "second connect");
+            }
+            if (message.streamId != 0) {
+                finding("command on wrong stream", message, "connect");
+            }
+            _connected = true;
+        } else if (command.name == "createStream") {
+            if (!_connected) {
+                finding("command out of order", message, "createStream before connect");
+            }
+            if (message.streamId != 0) {
+                finding("command on wrong stream", message, "createStream");
+            }
+            _created = true;
+        } else if (command.name == "publish") {
+            if (!_created) {
+                finding("command out of order", message, "publish before createStream");
+            }
+            if (message.streamId != INGEST_STREAM_ID) {
+                finding("command on wrong stream", message, "publish on %u, created %u", message.streamId,
+                        INGEST_STREAM_ID);
+            }
+            if (command.strings.empty() || command.strings[0].empty()) {
+                finding("malformed AMF0 command", message, "publish without a stream name");
+            }
+            _published = true;
+            _publishMicros = message.receivedMicros;
+            printf("  publish \"%s\" (%s)\n", command.strings.empty() ? "" : command.strings[0].c_str(),
+                   command.strings.size() > 1 ? command.strings[1].c_str() : "no type");
+        } else if (!_connected) {
+            finding("command out of order", message, "%s before connect", command.name.c_str());
+        }
+    }
+
+    void checkMedia(const RtmpMessage& message) {
+        if (!_published) {
+            finding("media before publish", message, "%s", typeName(message.type));
+        } else if (message.streamId != INGEST_STREAM_ID) {
+            finding("media on wrong stream", message, "stream %u, published %u", message.streamId,
+                    INGEST_STREAM_ID);
+        }
+        if (message.type == RTMP_MSG_DATA_AMF0) {
+            return;
+        }
+
+        const std::vector<uint8_t>& p = message.payload;
+        _mediaBytes += p.size();
+        size_t second = (size_t)((message.receivedMicros - _firstMicros) / 1000000);
+        if (_perSecond.size() <= second) {
+            _perSecond.resize(second + 1, 0);
+        }
+        _perSecond[second] += p.size();
+
+        if (p.empty()) {
+            finding("empty media message", message, "%s", typeName(message.type));
+            return;
+        }
+
+        // Each type on its own is checked in checkTimestamp(); across the two,
+        // many ingests cannot take a step back either
+        if (_sawMedia && message.timestamp < _newestMediaTs) {
+            finding("audio/video timestamps interleave backwards", message, "%u ms behind the newest (%u)",
+                    _newestMediaTs - message.timestamp, _newestMediaTs);
+        }
+        _newestMediaTs = _sawMedia ? std::max(_newestMediaTs, message.timestamp) : message.timestamp;
+        _sawMedia = true;
+        if (message.type == RTMP_MSG_VIDEO) {
+            checkVideo(message);
+        } else {
+            checkAudio(message);
+        }
+    }
+
+    // FLV tags back to back, each followed by its size as a back-pointer.
+    // Sub-message timestamps count from the first one, which is the
+    // aggregate's own timestamp; the aggregate's stream ID applies to all.
+    void checkAggregate(const RtmpMessage& message) {
+        const std::vector<uint8_t>& p = message.payload;
+        _aggregates++;
+        size_t pos = 0;
+        bool haveFirst = false;
+        uint32_t first = 0;
+        while (pos < p.size()) {
+            if (p.size() - pos < INGEST_FLV_TAG_HEADER + 4) {
+                finding("malformed aggregate", message, "%zu stray bytes at %zu", p.size() - pos, pos);
+                return;
+            }
+            const uint8_t* tag = &p[pos];
+            uint8_t type = tag[0];
+            size_t len = ((size_t)tag[1] << 16) | (tag[2] << 8) | tag[3];
+            uint32_t ts = ((uint32_t)tag[7] << 24) | (tag[4] << 16) | (tag[5] << 8) | tag[6];
+            if (p.size() - pos < INGEST_FLV_TAG_HEADER + len + 4) {
+                finding("malformed aggregate", message, "%zu byte sub-message overruns the payload at %zu", len,
+                        pos);
+                return;
+            }
+            const uint8_t* back = tag + INGEST_FLV_TAG_HEADER + len;
+            uint32_t backPointer = readBig32(back);
+            if (backPointer != INGEST_FLV_TAG_HEADER + len) {
+                finding("aggregate back-pointer mismatch", message, "%u for a %zu byte tag", backPointer,
+                        INGEST_FLV_TAG_HEADER + len);
+            }
+            if (!haveFirst) {
+                first = ts;
+                haveFirst = true;
+            }
+
+            RtmpMessage sub;
+            sub.chunkStreamId = message.chunkStreamId;
+            sub.timestamp = message.timestamp + (ts - first);
+            sub.type = type;
+            sub.streamId = message.streamId;
+            sub.payload.assign(tag + INGEST_FLV_TAG_HEADER, tag + INGEST_FLV_TAG_HEADER + len);
+            sub.receivedMicros = message.receivedMicros;
+            _aggregated++;
+            _aggregateFraming += INGEST_FLV_TAG_HEADER + 4;
+            if (type == RTMP_MSG_AGGREGATE) {
+                finding("aggregate inside an aggregate", message, "at %zu", pos);
+            } else {
+                dispatch(sub);
+            }
+            pos += INGEST_FLV_TAG_HEADER + len + 4;
+        }
+        if (!haveFirst) {
+            finding("malformed aggregate", message, "no sub-messages");
+        }
+    }
+
+    void checkVideo(const RtmpMessage& message) {
+        const std::vector<uint8_t>& p = message.payload;
+        _videoArrivals.push_back(message.receivedMicros);
+        _videoTimestamps.push_back(message.timestamp);
+
+        uint8_t codec = p[0] & 0x0F;
+        if (codec != 7) {
+            return;
+        }
+        // AVC: packet type, composition time, then the sequence header or NALUs
+        if (p.size() < 5) {
+            finding("malformed FLV video tag", message, "AVC tag of %zu bytes", p.size());
+            return;
+        }
+        if (p[1] == 0) {
+            _sawAvcHeader = true;
+        } else if (p[1] == 1 && !_sawAvcHeader) {
+            finding("AVC NALU before sequence header", message, "no AVCDecoderConfigurationRecord yet");
+        }
+        if (p[1] == 1 && p.size() >= 7 && p[5] == 0xFF && p[6] == 0xD8) {
+            finding("AVC-tagged payload is a JPEG", message, "codec 7 header, SOI at byte 5");
+        }
+    }
+
+    void checkAudio(const RtmpMessage& message) {
+        const std::vector<uint8_t>& p = message.payload;
+        if (_audioFlags < 0) {
+            _audioFlags = p[0];
+            _firstAudioTs = message.timestamp;
+        } else if (_audioFlags != p[0]) {
+            finding("audio tag header changed", message, "0x%02X after 0x%02X", p[0], _audioFlags);
+        }
+        _audioBytes += p.size() - 1;
+        _lastAudioTs = message.timestamp;
+        _audioArrivals.push_back(message.receivedMicros);
+        _audioTimestamps.push_back(message.timestamp);
+    }
+
+    void reportVideo() {
+        if (_videoArrivals.size() < 2) {
+            return;
+        }
+        std::vector<double> gaps;
+        for (size_t i = 1; i < _videoArrivals.size(); i++) {
+            gaps.push_back((_videoArrivals[i] - _videoArrivals[i - 1]) / 1000.0);
+        }
+        std::sort(gaps.begin(), gaps.end());
+
+        double wallMs = (_videoArrivals.back() - _videoArrivals.front()) / 1000.0;
+        double tsMs = (double)_videoTimestamps.back() - (double)_videoTimestamps.front();
+        double maxDrift = 0.0;
+        for (size_t i = 0; i < _videoArrivals.size(); i++) {
+            double drift = (_videoArrivals[i] - _videoArrivals.front()) / 1000.0 -
+                           ((double)_videoTimestamps[i] - (double)_videoTimestamps.front());
+            if (fabs(drift) > fabs(maxDrift)) {
+                maxDrift = drift;
+            }
+        }
+
+        printf("Video\n");
+        printf("  %zu frames, %.2f fps by arrival\n", _videoArrivals.size(),
+               wallMs > 0.0 ? (_videoArrivals.size() - 1) * 1000.0 / wallMs : 0.0);
+        printf("  inter-arrival ms: p50 %.2f  p95 %.2f  p99 %.2f  max %.2f\n", percentile(gaps, 50),
+               percentile(gaps, 95), percentile(gaps, 99), gaps.back());
+        printf("  timestamps advance %.3f ms per wall ms; arrival minus timestamp: end %+.1f ms,"
+               " worst %+.1f ms\n", wallMs > 0.0 ? tsMs / wallMs : 0.0, wallMs - tsMs, maxDrift);
+    }
+
+    void reportAudio() {
+        if (_audioFlags < 0) {
+            return;
+        }
+        static const uint32_t rates[4] = { 5512, 11025, 22050, 44100 };
+        uint32_t declared = rates[(_audioFlags >> 2) & 0x03];
+        uint32_t bytesPerSample = ((_audioFlags >> 1) & 0x01) ? 2 : 1;
+        uint32_t channels = (_audioFlags & 0x01) ? 2 : 1;
+        uint8_t format = _audioFlags >> 4;
+
+        printf("Audio\n");
+        printf("  tag 0x%02X: format %u, %u Hz, %u-bit, %s\n", _audioFlags, format, declared,
+               bytesPerSample * 8, channels == 2 ? "stereo" : "mono");
+
+        double spanMs = (double)_lastAudioTs - (double)_firstAudioTs;
+        if ((format == 0 || format == 3) && spanMs > 1000.0) {
+            // Raw PCM: the payload size over the timestamp span gives the real rate
+            double measured = _audioBytes / (double)(bytesPerSample * channels) * 1000.0 / spanMs;
+            printf("  payload carries %.0f samples/s\n", measured);
+            if (fabs(measured - declared) > declared * 0.1) {
+                _findings["audio rate field does not match payload"]++;
+            }
+        }
+
+        if (_audioArrivals.size() < 2) {
+            return;
+        }
+        // How late each message arrived compared with the earliest one for
+        // its timestamp: the time it spent queued behind other data
+        std::vector<double> gaps;
+        std::vector<double> late;
+        double earliest = 0.0;
+        for (size_t i = 0; i < _audioArrivals.size(); i++) {
+            double offset = (_audioArrivals[i] - _audioArrivals.front()) / 1000.0 -
+                            ((double)_audioTimestamps[i] - (double)_audioTimestamps.front());
+            late.push_back(offset);
+            earliest = i == 0 ? offset : std::min(earliest, offset);
+            if (i > 0) {
+                gaps.push_back((_audioArrivals[i] - _audioArrivals[i - 1]) / 1000.0);
+            }
+        }
+        for (double& offset : late) {
+            offset -= earliest;
+        }
+        std::sort(gaps.begin(), gaps.end());
+        std::sort(late.begin(), late.end());
+        printf("  inter-arrival ms: p50 %.2f  p95 %.2f  p99 %.2f  max %.2f\n", percentile(gaps, 50),
+               percentile(gaps, 95), percentile(gaps, 99), gaps.back());
+        printf("  later than the earliest message ms: p50 %.2f  p95 %.2f  p99 %.2f  max %.2f\n",
+               percentile(late, 50), percentile(late, 95), percentile(late, 99), late.back());
+    }
+};
+
+// ============================================================================
+// Main
+// ============================================================================
+
+int main(int argc, char** argv) {
+    uint16_t port = 1935;
+    uint32_t chunkSize = 4096;
+    uint32_t ackWindow = 5000000;
+    uint32_t pingMs = 0;
+    const char* flvPath = nullptr;
+    const char* csvPath = nullptr;
+    double dropAfterSeconds = 0.0;
+    bool once = false;
+    RtmpImpairment impairment = {};
+
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--once") == 0) once = true;
+        else if (strcmp(argv[i], "--port") == 0 && hasValue) port = (uint16_t)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--chunk-size") == 0 && hasValue) chunkSize = (uint32_t)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--ack-window") == 0 && hasValue) ackWindow = (uint32_t)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--ping-ms") == 0 && hasValue) pingMs = (uint32_t)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--flv") == 0 && hasValue) flvPath = argv[++i];
+        else if (strcmp(argv[i], "--csv") == 0 && hasValue) csvPath = argv[++i];
+        else if (strcmp(argv[i], "--rate-kbps") == 0 && hasValue)
+            impairment.rateBytesPerSecond = (uint32_t)(atof(argv[++i]) * 1000 / 8);
+        else if (strcmp(argv[i], "--stall-ms") == 0 && hasValue) impairment.stallMs = (uint32_t)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--stall-every-ms") == 0 && hasValue)
+            impairment.stallEveryMs = (uint32_t)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--delay-ms") == 0 && hasValue) impairment.delayMs = (uint32_t)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--rcvbuf-kb") == 0 && hasValue)
+            impairment.receiveBuffer = (uint32_t)atoi(argv[++i]) * 1024;
+        else if (strcmp(argv[i], "--drop-after-s") == 0 && hasValue) dropAfterSeconds = atof(argv[++i]);
+        else {
+            fprintf(stderr, "Usage: %s [--port N] [--chunk-size N] [--ack-window N] [--ping-ms N] [--flv FILE]"
+                            " [--csv FILE] [--rate-kbps K] [--stall-ms S --stall-every-ms P] [--delay-ms D]"
+                            " [--rcvbuf-kb K] [--drop-after-s T] [--once]\n",
+                    argv[0]);
+            return 2;
+        }
+    }
+    if (impairment.stallMs >= impairment.stallEveryMs) {
+        impairment.stallMs = 0;
+        impairment.stallEveryMs = 0;
+    }
+
+    sink.setServerMode(ackWindow, chunkSize);
+    sink.setPingInterval(pingMs);
+    sink.setImpairment(impairment);
+    if (!sink.listen(port)) {
+        fprintf(stderr, "Cannot listen on port %u: %s\n", port, sink.getError().c_str());
+        return 1;
+    }
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+
+    printf("Waiting for publishers on rtmp://0.0.0.0:%u/live (chunk size %u, ack window %u)\n", sink.getPort(),
+           chunkSize, ackWindow);
+    if (impairment.rateBytesPerSecond || impairment.stallEveryMs || impairment.delayMs ||
+        impairment.receiveBuffer) {
+        printf("Receive side: rate %s, stall %u ms every %u ms, delay %u ms, rcvbuf %u bytes\n",
+               impairment.rateBytesPerSecond ? (std::to_string(impairment.rateBytesPerSecond * 8 / 1000) +
+                                                " kbit/s").c_str() : "unlimited",
+               impairment.stallMs, impairment.stallEveryMs, impairment.delayMs, impairment.receiveBuffer);
+    }
+
+    FILE* csv = nullptr;
+    if (csvPath) {
+        csv = fopen(csvPath, "w");
+        if (!csv) {
+            fprintf(stderr, "Cannot write %s\n", csvPath);
+            return 1;
+        }
+        fprintf(csv, "session,index,type,csid,stream,timestamp,bytes,arrival_us\n");
+    }
+
+    uint32_t sessions = 0;
+    bool anyOk = false;
+    while (true) {
+        Session session(sessions + 1, csv);
+        std::string path;
+        if (flvPath) {
+            path = flvPath;
+            if (sessions > 0) {
+                size_t dot = path.rfind('.');
+                std::string suffix = "-" + std::to_string(sessions + 1);
+                path = dot == std::string::npos ? path + suffix : path.substr(0, dot) + suffix + path.substr(dot);
+            }
+            if (!session.flv.open(path)) {
+                fprintf(stderr, "Cannot write %s\n", path.c_str());
+                return 1;
+            }
+        }
+
+        uint64_t dropAfter = (uint64_t)(dropAfterSeconds * 1e6);
+        bool ok = sink.serveOne([&](const RtmpMessage& message) {
+            session.onMessage(message);
+            if (dropAfter && session.publishedFor(dropAfter, message.receivedMicros)) {
+                sink.disconnect();
+            }
+        });
+        session.flv.close();
+        if (session.messages() == 0 && sink.getError() == "stopped") {
+            if (!path.empty()) {
+                remove(path.c_str());
+            }
+            break;
+        }
+
+        sessions++;
+        anyOk = anyOk || ok;
+        session.report(sink, sink.getError());
+        if (csv) {
+            fflush(csv);
+        }
+        if (once || sink.getError() == "stopped") {
+            break;
+        }
+    }
+
+    if (csv) {
+        fclose(csv);
+    }
+    return anyOk || sessions == 0 ? 0 : 1;
+}
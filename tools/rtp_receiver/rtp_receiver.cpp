@@ -0,0 +1,943 @@
+// Local receiver for the camera's RTP output (lib/RTPSender): RFC 2435
+// JPEG video, L16 audio, RFC 5109 XOR FEC and RTCP.
+//
+// Listens on the four ports the camera sends to (video on --port P and its
+// RTCP on P+1, audio on P+2 and P+3), puts frames back together, repairs
+// what the FEC allows, answers sender reports with receiver reports (so the
+// camera's rtp_remote_* metrics fill in), and reports per stream:
+//   - packets expected, received, lost before and after FEC repair
+//   - complete and incomplete frames
+//   - interarrival jitter (RFC 3550), as the camera will see it reported
+//   - latency: capture time (the RTP timestamp, mapped to wall-clock time
+//     through the sender reports) to the arrival of the last packet of a
+//     frame or of an audio packet; needs the two clocks to agree, as they
+//     do on loopback
+//
+// Loss can be induced on receipt: --loss drops that percentage of RTP
+// packets at random, and --burst makes drops come in runs of that mean
+// length (a drop is followed by another with probability 1 - 1/burst).
+// RTCP is never dropped.
+//
+// Build (host):
+//   g++ -O2 -std=gnu++17 tools/rtp_receiver/rtp_receiver.cpp -o rtp_receiver
+//
+// Usage:
+//   rtp_receiver [--port N] [--loss PCT] [--burst N] [--seed S] [--seconds T]
+//                [--jpeg-dir DIR]
+//
+// Point the camera at <host>:<port> (NVS rtp/target; NVS_RTP_TARGET on the
+// host build). Runs until Ctrl-C or --seconds, then prints the report.
+// --jpeg-dir writes every complete frame as a standalone JPEG.
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <math.h>
+#include <poll.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <map>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#define RTP_VIDEO_PAYLOAD_TYPE      26
+#define RTP_AUDIO_PAYLOAD_TYPE      96
+#define RTP_FEC_PAYLOAD_TYPE        127
+#define RTP_VIDEO_CLOCK             90000
+#define RTP_AUDIO_CLOCK             16000      // AUDIO_SAMPLE_RATE
+#define RECEIVER_REPORT_MS          1000
+#define FEC_HISTORY                 128         // Video packets kept for repair
+
+static volatile bool stopping = false;
+
+static void onSignal(int) {
+    stopping = true;
+}
+
+static uint64_t wallMicros() {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+static uint64_t ntpFromMicros(uint64_t micros) {
+    uint64_t seconds = micros / 1000000 + 2208988800ULL;
+    uint64_t fraction = ((micros % 1000000) << 32) / 1000000;
+    return (seconds << 32) | fraction;
+}
+
+static uint64_t microsFromNtp(uint64_t ntp) {
+    return ((ntp >> 32) - 2208988800ULL) * 1000000ULL + (((ntp & 0xFFFFFFFFULL) * 1000000ULL) >> 32);
+}
+
+static uint16_t get16(const uint8_t* p) {
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static uint32_t get32(const uint8_t* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static void put16(uint8_t* p, uint32_t value) {
+    p[0] = (uint8_t)(value >> 8);
+    p[1] = (uint8_t)value;
+}
+
+static void put32(uint8_t* p, uint32_t value) {
+    p[0] = (uint8_t)(value >> 24);
+    p[1] = (uint8_t)(value >> 16);
+    p[2] = (uint8_t)(value >> 8);
+    p[3] = (uint8_t)value;
+}
+
+static double percentile(const std::vector<double>& sorted, double p) {
+    if (sorted.empty()) {
+        return 0.0;
+    }
+    size_t rank = (size_t)ceil(p / 100.0 * sorted.size());
+    rank = rank < 1 ? 1 : (rank > sorted.size() ? sorted.size() : rank);
+    return sorted[rank - 1];
+}
+
+// ============================================================================
+// JPEG headers (RFC 2435 Appendix A and B)
+// ============================================================================
+
+static const uint8_t kZigzag[64] = {
+    0,  1,  8, 16,  9,  2,  3, 10, 17, 24, 32, 25, 18, 11,  4,  5,
+    12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13,  6,  7, 14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63
+};
+
+// Natural order
+static const uint8_t kLumaQuant[64] = {
+    16, 11, 10, 16,  24,  40,  51,  61,  12, 12, 14, 19,  26,  58,  60,  55,
+    14, 13, 16, 24,  40,  57,  69,  56,  14, 17, 22, 29,  51,  87,  80,  62,
+    18, 22, 37, 56,  68, 109, 103,  77,  24, 35, 55, 64,  81, 104, 113,  92,
+    49, 64, 78, 87, 103, 121, 120, 101,  72, 92, 95, 98, 112, 100, 103,  99
+};
+static const uint8_t kChromaQuant[64] = {
+    17, 18, 24, 47, 99, 99, 99, 99,  18, 21, 26, 66, 99, 99, 99, 99,
+    24, 26, 56, 99, 99, 99, 99, 99,  47, 66, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,  99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,  99, 99, 99, 99, 99, 99, 99, 99
+};
+
+static const uint8_t kLumaDcBits[16] = { 0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0 };
+static const uint8_t kChromaDcBits[16] = { 0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0 };
+static const uint8_t kDcVals[12] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 };
+
+static const uint8_t kLumaAcBits[16] = { 0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7D };
+static const uint8_t kLumaAcVals[162] = {
+    0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+    0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xA1, 0x08, 0x23, 0x42, 0xB1, 0xC1, 0x15, 0x52, 0xD1, 0xF0,
+    0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0A, 0x16, 0x17, 0x18, 0x19, 0x1A, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2A, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+    0x4A, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5A, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+    0x6A, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+    0x8A, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A, 0xA2, 0xA3, 0xA4, 0xA5, 0xA6, 0xA7,
+    0xA8, 0xA9, 0xAA, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA, 0xC2, 0xC3, 0xC4, 0xC5,
+    0xC6, 0xC7, 0xC8, 0xC9, 0xCA, 0xD2, 0xD3, 0xD4, 0xD5, 0xD6, 0xD7, 0xD8, 0xD9, 0xDA, 0xE1, 0xE2,
+    0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA, 0xF1, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8,
+    0xF9, 0xFA
+};
+
+static const uint8_t kChromaAcBits[16] = { 0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77 };
+static const uint8_t kChromaAcVals[162] = {
+    0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71,
+    0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xA1, 0xB1, 0xC1, 0x09, 0x23, 0x33, 0x52, 0xF0,
+    0x15, 0x62, 0x72, 0xD1, 0x0A, 0x16, 0x24, 0x34, 0xE1, 0x25, 0xF1, 0x17, 0x18, 0x19, 0x1A, 0x26,
+    0x27, 0x28, 0x29, 0x2A, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+    0x49, 0x4A, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5A, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+    0x69, 0x6A, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+    0x88, 0x89, 0x8A, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A, 0xA2, 0xA3, 0xA4, 0xA5,
+    0xA6, 0xA7, 0xA8, 0xA9, 0xAA, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA, 0xC2, 0xC3,
+    0xC4, 0xC5, 0xC6, 0xC7, 0xC8, 0xC9, 0xCA, 0xD2, 0xD3, 0xD4, 0xD5, 0xD6, 0xD7, 0xD8, 0xD9, 0xDA,
+    0xE2, 0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8,
+    0xF9, 0xFA
+};
+
+// Q 1-99: the Annex K tables scaled as the IJG library does, zigzag order
+static void makeTables(int q, uint8_t tables[128]) {
+    int factor = q < 1 ? 1 : (q > 99 ? 99 : q);
+    int scale = factor < 50 ? 5000 / factor : 200 - factor * 2;
+    for (int i = 0; i < 64; i++) {
+        int luma = (kLumaQuant[kZigzag[i]] * scale + 50) / 100;
+        int chroma = (kChromaQuant[kZigzag[i]] * scale + 50) / 100;
+        tables[i] = (uint8_t)std::min(255, std::max(1, luma));
+        tables[64 + i] = (uint8_t)std::min(255, std::max(1, chroma));
+    }
+}
+
+static void putSegment(std::vector<uint8_t>& out, uint8_t marker, size_t length) {
+    out.push_back(0xFF);
+    out.push_back(marker);
+    out.push_back((uint8_t)((length + 2) >> 8));
+    out.push_back((uint8_t)(length + 2));
+}
+
+static void putHuffman(std::vector<uint8_t>& out, uint8_t cls, const uint8_t* bits, const uint8_t* vals,
+                       size_t count) {
+    putSegment(out, 0xC4, 17 + count);
+    out.push_back(cls);
+    out.insert(out.end(), bits, bits + 16);
+    out.insert(out.end(), vals, vals + count);
+}
+
+// Everything a decoder needs in front of the scan
+static void makeHeaders(std::vector<uint8_t>& out, uint8_t type, uint16_t width, uint16_t height,
+                        const uint8_t tables[128], uint16_t restartInterval) {
+    out.push_back(0xFF);
+    out.push_back(0xD8);
+
+    putSegment(out, 0xDB, 2 * 65);
+    out.push_back(0x00);
+    out.insert(out.end(), tables, tables + 64);
+    out.push_back(0x01);
+    out.insert(out.end(), tables + 64, tables + 128);
+
+    if (restartInterval) {
+        putSegment(out, 0xDD, 2);
+        out.push_back((uint8_t)(restartInterval >> 8));
+        out.push_back((uint8_t)restartInterval);
+    }
+
+    putSegment(out, 0xC0, 15);
+    static const uint8_t sampling[2] = { 0x21, 0x22 };
+    uint8_t sof[15] = { 8, (uint8_t)(height >> 8), (uint8_t)height, (uint8_t)(width >> 8), (uint8_t)width, 3,
+                        1, sampling[(type & 0x3F) == 1], 0, 2, 0x11, 1, 3, 0x11, 1 };
+    out.insert(out.end(), sof, sof + sizeof(sof));
+
+    putHuffman(out, 0x00, kLumaDcBits, kDcVals, sizeof(kDcVals));
+    putHuffman(out, 0x10, kLumaAcBits, kLumaAcVals, sizeof(kLumaAcVals));
+    putHuffman(out, 0x01, kChromaDcBits, kDcVals, sizeof(kDcVals));
+    putHuffman(out, 0x11, kChromaAcBits, kChromaAcVals, sizeof(kChromaAcVals));
+
+    putSegment(out, 0xDA, 10);
+    static const uint8_t sos[10] = { 3, 1, 0x00, 2, 0x11, 3, 0x11, 0, 63, 0 };
+    out.insert(out.end(), sos, sos + sizeof(sos));
+}
+
+// ============================================================================
+// Streams
+// ============================================================================
+
+struct SenderReport {
+    bool present;
+    uint64_t ntp;
+    uint32_t rtp;
+    uint64_t arrivalMicros;
+    struct sockaddr_in from;
+};
+
+// Reception statistics for one SSRC (RFC 3550 Appendix A)
+struct MediaStream {
+    const char* name;
+    uint32_t clock;
+    bool started;
+    uint32_t ssrc;
+    uint16_t baseSeq;
+    uint16_t maxSeq;
+    uint32_t cycles;
+    uint32_t received;          // Off the wire, after induced loss
+    uint32_t recovered;         // Rebuilt from FEC
+    uint32_t duplicates;
+    uint32_t expectedPrior;
+    uint32_t receivedPrior;
+    double transit;
+    double jitter;              // Clock units
+    double maxJitter;
+    std::vector<double> latencyMs;
+    SenderReport report;
+    int rtcpSocket;
+
+    uint32_t extendedMax() const { return cycles + maxSeq; }
+    uint32_t expected() const { return started ? extendedMax() - baseSeq + 1 : 0; }
+};
+
+static void initStream(MediaStream& stream, const char* name, uint32_t clock, int rtcpSocket) {
+    stream.name = name;
+    stream.clock = clock;
+    stream.started = false;
+    stream.ssrc = 0;
+    stream.baseSeq = 0;
+    stream.maxSeq = 0;
+    stream.cycles = 0;
+    stream.received = 0;
+    stream.recovered = 0;
+    stream.duplicates = 0;
+    stream.expectedPrior = 0;
+    stream.receivedPrior = 0;
+    stream.transit = 0.0;
+    stream.jitter = 0.0;
+    stream.maxJitter = 0.0;
+    memset(&stream.report, 0, sizeof(stream.report));
+    stream.rtcpSocket = rtcpSocket;
+}
+
+// Sequence and jitter bookkeeping for a packet off the wire
+static void track(MediaStream& stream, uint16_t seq, uint32_t timestamp, uint32_t ssrc, uint64_t arrival) {
+    if (!stream.started) {
+        stream.started = true;
+        stream.ssrc = ssrc;
+        stream.baseSeq = seq;
+        stream.maxSeq = seq;
+    } else {
+        uint16_t delta = (uint16_t)(seq - stream.maxSeq);
+        if (delta == 0) {
+            stream.duplicates++;
+            return;
+        }
+        if (delta < 0x8000) {
+            if (seq < stream.maxSeq) {
+                stream.cycles += 0x10000;
+            }
+            stream.maxSeq = seq;
+        }
+    }
+    stream.received++;
+
+    double arrivalUnits = (double)arrival * stream.clock / 1e6;
+    double transit = arrivalUnits - timestamp;
+    if (stream.received > 1) {
+        double d = fabs(transit - stream.transit);
+        // Transit wraps with the 32-bit timestamp
+        if (d < 2147483648.0) {
+            stream.jitter += (d - stream.jitter) / 16.0;
+            stream.maxJitter = std::max(stream.maxJitter, stream.jitter);
+        }
+    }
+    stream.transit = transit;
+}
+
+// Wall-clock capture time of an RTP timestamp, from the latest sender report
+static bool captureMicros(const MediaStream& stream, uint32_t timestamp, uint64_t& micros) {
+    if (!stream.report.present) {
+        return false;
+    }
+    int32_t delta = (int32_t)(timestamp - stream.report.rtp);
+    micros = microsFromNtp(stream.report.ntp) + (int64_t)delta * 1000000 / (int64_t)stream.clock;
+    return true;
+}
+
+// ============================================================================
+// Receiver
+// ============================================================================
+
+class Receiver {
+public:
+    Receiver(int videoRtcp, int audioRtcp, const char* jpegDir)
+        : _jpegDir(jpegDir)
+        , _haveFrame(false)
+        , _frameTs(0)
+        , _lastFinishedTs(0)
+        , _finishedAny(false)
+        , _framesComplete(0)
+        , _framesIncomplete(0)
+        , _framesWritten(0)
+        , _frameType(0)
+        , _width(0)
+        , _height(0)
+        , _fecReceived(0)
+        , _fecUnrecoverable(0)
+        , _fecNothingLost(0)
+        , _reportsSent(0)
+        , _senderReports(0)
+        , _lastReportMicros(0)
+    {
+        initStream(_video, "Video", RTP_VIDEO_CLOCK, videoRtcp);
+        initStream(_audio, "Audio", RTP_AUDIO_CLOCK, audioRtcp);
+        initStream(_fec, "FEC", RTP_VIDEO_CLOCK, videoRtcp);
+    }
+
+    MediaStream& video() { return _video; }
+    MediaStream& audio() { return _audio; }
+
+    void onRtp(const uint8_t* p, size_t len, uint64_t arrival) {
+        if (len < 12 || (p[0] & 0xC0) != 0x80) {
+            _malformed++;
+            return;
+        }
+        size_t header = 12 + 4 * (p[0] & 0x0F);
+        if (p[0] & 0x10) {
+            if (len < header + 4) {
+                _malformed++;
+                return;
+            }
+            header += 4 + 4 * get16(p + header + 2);
+        }
+        size_t end = len;
+        if ((p[0] & 0x20) && len > 0) {
+            end -= p[len - 1];
+        }
+        if (end < header) {
+            _malformed++;
+            return;
+        }
+
+        uint8_t payloadType = p[1] & 0x7F;
+        uint16_t seq = get16(p + 2);
+        uint32_t timestamp = get32(p + 4);
+        uint32_t ssrc = get32(p + 8);
+        if (payloadType == RTP_VIDEO_PAYLOAD_TYPE) {
+            track(_video, seq, timestamp, ssrc, arrival);
+            remember(p, len);
+            onJpeg(p, header, end, arrival);
+        } else if (payloadType == RTP_AUDIO_PAYLOAD_TYPE) {
+            track(_audio, seq, timestamp, ssrc, arrival);
+            uint64_t captured;
+            if (captureMicros(_audio, timestamp, captured)) {
+                _audio.latencyMs.push_back(((double)arrival - (double)captured) / 1000.0);
+            }
+        } else if (payloadType == RTP_FEC_PAYLOAD_TYPE) {
+            track(_fec, seq, timestamp, ssrc, arrival);
+            onFec(p + header, end - header, arrival);
+        } else {
+            _otherTypes++;
+        }
+    }
+
+    void onRtcp(MediaStream& stream, const uint8_t* p, size_t len, const struct sockaddr_in& from, uint64_t arrival) {
+        size_t pos = 0;
+        while (pos + 8 <= len) {
+            uint8_t count = p[pos] & 0x1F;
+            uint8_t type = p[pos + 1];
+            size_t size = 4 + 4 * (size_t)get16(p + pos + 2);
+            if ((p[pos] & 0xC0) != 0x80 || pos + size > len) {
+                _malformedRtcp++;
+                return;
+            }
+            if (type == 200 && size >= 28) {
+                stream.report.present = true;
+                stream.report.ntp = ((uint64_t)get32(p + pos + 8) << 32) | get32(p + pos + 12);
+                stream.report.rtp = get32(p + pos + 16);
+                stream.report.arrivalMicros = arrival;
+                stream.report.from = from;
+                _senderReports++;
+            } else if (type == 202 && count > 0 && size >= 12 && p[pos + 8] == 1) {
+                size_t nameLen = p[pos + 9];
+                if (_cname.empty() && pos + 10 + nameLen <= len) {
+                    _cname.assign((const char*)p + pos + 10, nameLen);
+                }
+            }
+            pos += size;
+        }
+    }
+
+    // Receiver reports back to wherever the sender reports came from
+    void service(uint64_t now) {
+        if (now < _lastReportMicros + RECEIVER_REPORT_MS * 1000ULL) {
+            return;
+        }
+        _lastReportMicros = now;
+        sendReceiverReport(_video, now);
+        sendReceiverReport(_audio, now);
+
+        // A frame that never completes (its last packet and FEC lost) is
+        // given up on after a second
+        if (_haveFrame && now > _frameStarted + 1000000) {
+            finishFrame(false);
+        }
+    }
+
+    void report(double seconds, double lossPercent, double burst) {
+        if (_haveFrame) {
+            finishFrame(false);
+        }
+        printf("\n=== RTP receiver: %.1f s, CNAME %s, induced loss %.1f%%", seconds,
+               _cname.empty() ? "(none)" : _cname.c_str(), lossPercent);
+        if (burst > 1.0) {
+            printf(" in bursts of %.1f", burst);
+        }
+        printf(" ===\n");
+
+        reportStream(_video);
+        printf("  frames: %u complete, %u incomplete (%.2f%%)", _framesComplete, _framesIncomplete,
+               _framesComplete + _framesIncomplete
+                   ? 100.0 * _framesIncomplete / (_framesComplete + _framesIncomplete) : 0.0);
+        if (_width) {
+            printf(", %ux%u type %u", _width, _height, _frameType);
+        }
+        printf("\n");
+        if (_jpegDir) {
+            printf("  %u frames written to %s\n", _framesWritten, _jpegDir);
+        }
+        reportLatency("capture to last packet", _video.latencyMs);
+
+        reportStream(_audio);
+        reportLatency("first sample to arrival", _audio.latencyMs);
+
+        if (_fecReceived) {
+            printf("FEC\n");
+            printf("  %u packets (%.1f%% of video), %u packets repaired, %u groups with nothing lost,"
+                   " %u groups with more lost than one FEC packet repairs\n",
+                   _fecReceived, _video.received ? 100.0 * _fecReceived / _video.received : 0.0,
+                   _video.recovered, _fecNothingLost, _fecUnrecoverable);
+        }
+        printf("RTCP\n");
+        printf("  %u sender reports received, %u receiver reports sent\n", _senderReports, _reportsSent);
+        if (_malformed || _malformedRtcp || _otherTypes) {
+            printf("  %u malformed RTP, %u malformed RTCP, %u packets of other payload types\n", _malformed,
+                   _malformedRtcp, _otherTypes);
+        }
+    }
+
+private:
+    MediaStream _video;
+    MediaStream _audio;
+    MediaStream _fec;
+    std::string _cname;
+    const char* _jpegDir;
+
+    // Frame being put together: fragments by offset
+    bool _haveFrame;
+    uint32_t _frameTs;
+    uint64_t _frameStarted;
+    std::map<uint32_t, std::vector<uint8_t>> _fragments;
+    bool _haveEnd;
+    uint32_t _frameEnd;
+    uint8_t _tables[128];
+    bool _haveTables;
+    uint16_t _restartInterval;
+    uint32_t _lastFinishedTs;
+    bool _finishedAny;
+
+    uint32_t _framesComplete;
+    uint32_t _framesIncomplete;
+    uint32_t _framesWritten;
+    uint8_t _frameType;
+    uint16_t _width;
+    uint16_t _height;
+
+    // Recent video packets for repair, by sequence number
+    std::map<uint16_t, std::vector<uint8_t>> _history;
+    uint32_t _fecReceived;
+    uint32_t _fecUnrecoverable;
+    uint32_t _fecNothingLost;
+
+    uint32_t _reportsSent;
+    uint32_t _senderReports;
+    uint64_t _lastReportMicros;
+    uint32_t _malformed = 0;
+    uint32_t _malformedRtcp = 0;
+    uint32_t _otherTypes = 0;
+
+    void remember(const uint8_t* p, size_t len) {
+        uint16_t seq = get16(p + 2);
+        _history[seq].assign(p, p + len);
+        while (_history.size() > FEC_HISTORY) {
+            // The oldest in sequence order, allowing for wrap
+            auto oldest = _history.begin();
+            for (auto it = _history.begin(); it != _history.end(); ++it) {
+                if ((int16_t)(it->first - oldest->first) < 0) {
+                    oldest = it;
+                }
+            }
+            _history.erase(oldest);
+        }
+    }
+
+    void onJpeg(const uint8_t* p, size_t header, size_t end, uint64_t arrival) {
+        const uint8_t* jpeg = p + header;
+        size_t len = end - header;
+        if (len < 8) {
+            _malformed++;
+            return;
+        }
+        uint32_t timestamp = get32(p + 4);
+        bool marker = (p[1] & 0x80) != 0;
+        uint32_t offset = ((uint32_t)jpeg[1] << 16) | (jpeg[2] << 8) | jpeg[3];
+        uint8_t type = jpeg[4];
+        uint8_t q = jpeg[5];
+        size_t pos = 8;
+
+        if (_finishedAny && (int32_t)(timestamp - _lastFinishedTs) <= 0) {
+            return;     // A frame already done with (a repaired duplicate, or too late)
+        }
+        if (_haveFrame && timestamp != _frameTs) {
+            finishFrame(false);
+        }
+        if (!_haveFrame) {
+            _haveFrame = true;
+            _frameTs = timestamp;
+            _frameStarted = arrival;
+            _fragments.clear();
+            _haveEnd = false;
+            _haveTables = false;
+            _restartInterval = 0;
+        }
+        _frameType = type;
+        _width = jpeg[6] * 8;
+        _height = jpeg[7] * 8;
+
+        if (type >= 64 && type < 128) {
+            if (len < pos + 4) {
+                _malformed++;
+                return;
+            }
+            _restartInterval = get16(jpeg + pos);
+            pos += 4;
+        }
+        if (offset == 0) {
+            if (q >= 128) {
+                if (len < pos + 4) {
+                    _malformed++;
+                    return;
+                }
+                uint16_t tableLen = get16(jpeg + pos + 2);
+                if (jpeg[pos + 1] != 0 || tableLen < 128 || len < pos + 4 + tableLen) {
+                    _malformed++;   // Only two 8-bit tables are supported
+                    return;
+                }
+                memcpy(_tables, jpeg + pos + 4, 128);
+                pos += 4 + tableLen;
+            } else {
+                makeTables(q, _tables);
+            }
+            _haveTables = true;
+        }
+
+        _fragments[offset].assign(jpeg + pos, jpeg + len);
+        if (marker) {
+            _haveEnd = true;
+            _frameEnd = offset + (uint32_t)(len - pos);
+        }
+        if (isComplete()) {
+            uint64_t captured;
+            if (captureMicros(_video, timestamp, captured)) {
+                _video.latencyMs.push_back(((double)arrival - (double)captured) / 1000.0);
+            }
+            finishFrame(true);
+        }
+    }
+
+    bool isComplete() const {
+        if (!_haveEnd || !_haveTables) {
+            return false;
+        }
+        uint32_t next = 0;
+        for (const auto& fragment : _fragments) {
+            if (fragment.first != next) {
+                return false;
+            }
+            next += (uint32_t)fragment.second.size();
+        }
+        return next == _frameEnd;
+    }
+
+    void finishFrame(bool complete) {
+        if (complete) {
+            _framesComplete++;
+            if (_jpegDir) {
+                writeFrame();
+            }
+        } else {
+            _framesIncomplete++;
+        }
+        _haveFrame = false;
+        _finishedAny = true;
+        _lastFinishedTs = _frameTs;
+    }
+
+    void writeFrame() {
+        std::vector<uint8_t> out;
+        makeHeaders(out, _frameType, _width, _height, _tables, _restartInterval);
+        for (const auto& fragment : _fragments) {
+            out.insert(out.end(), fragment.second.begin(), fragment.second.end());
+        }
+        if (out.size() < 2 || out[out.size() - 2] != 0xFF || out.back() != 0xD9) {
+            out.push_back(0xFF);
+            out.push_back(0xD9);
+        }
+        char path[512];
+        snprintf(path, sizeof(path), "%s/frame_%05u.jpg", _jpegDir, _framesComplete);
+        FILE* file = fopen(path, "wb");
+        if (file) {
+            fwrite(out.data(), 1, out.size(), file);
+            fclose(file);
+            _framesWritten++;
+        }
+    }
+
+    // RFC 5109: XOR the FEC packet with the packets of its group that did
+    // arrive; with one missing, what is left is that packet
+    void onFec(const uint8_t* fec, size_t len, uint64_t arrival) {
+        _fecReceived++;
+        if (len < 10) {
+            _malformed++;
+            return;
+        }
+        bool longMask = (fec[0] & 0x40) != 0;
+        size_t levelHeader = longMask ? 8 : 4;
+        if (len < 10 + levelHeader) {
+            _malformed++;
+            return;
+        }
+        uint16_t base = get16(fec + 2);
+        uint16_t protectedLen = get16(fec + 10);
+        uint64_t mask = get16(fec + 12);
+        int maskBits = 16;
+        if (longMask) {
+            mask = (mask << 32) | get32(fec + 14);
+            maskBits = 48;
+        }
+        const uint8_t* payload = fec + 10 + levelHeader;
+        if (len < 10 + levelHeader + protectedLen) {
+            _malformed++;
+            return;
+        }
+
+        std::vector<uint16_t> present;
+        int missing = 0;
+        uint16_t missingSeq = 0;
+        for (int i = 0; i < maskBits; i++) {
+            if (!(mask & (1ULL << (maskBits - 1 - i)))) {
+                continue;
+            }
+            uint16_t seq = (uint16_t)(base + i);
+            if (_history.count(seq)) {
+                present.push_back(seq);
+            } else {
+                missing++;
+                missingSeq = seq;
+            }
+        }
+        if (missing == 0) {
+            _fecNothingLost++;
+            return;
+        }
+        if (missing > 1) {
+            _fecUnrecoverable++;
+            return;
+        }
+
+        uint8_t bits0 = fec[0];
+        uint8_t bits1 = fec[1];
+        uint32_t timestamp = get32(fec + 4);
+        uint16_t length = get16(fec + 8);
+        std::vector<uint8_t> data(payload, payload + protectedLen);
+        for (uint16_t seq : present) {
+            const std::vector<uint8_t>& packet = _history[seq];
+            bits0 ^= packet[0];
+            bits1 ^= packet[1];
+            timestamp ^= get32(&packet[4]);
+            length ^= (uint16_t)(packet.size() - 12);
+            for (size_t i = 12; i < packet.size() && i - 12 < data.size(); i++) {
+                data[i - 12] ^= packet[i];
+            }
+        }
+        if (length > data.size()) {
+            _fecUnrecoverable++;
+            return;
+        }
+
+        std::vector<uint8_t> packet(12 + length);
+        packet[0] = 0x80 | (bits0 & 0x3F);
+        packet[1] = bits1;
+        put16(&packet[2], missingSeq);
+        put32(&packet[4], timestamp);
+        put32(&packet[8], _video.ssrc);
+        memcpy(&packet[12], data.data(), length);
+
+        _video.recovered++;
+        remember(packet.data(), packet.size());
+        if ((bits1 & 0x7F) == RTP_VIDEO_PAYLOAD_TYPE) {
+            onJpeg(packet.data(), 12, packet.size(), arrival);
+        }
+    }
+
+    void sendReceiverReport(MediaStream& stream, uint64_t now) {
+        if (!stream.started || !stream.report.present) {
+            return;
+        }
+        uint32_t expected = stream.expected();
+        uint32_t expectedInterval = expected - stream.expectedPrior;
+        uint32_t receivedInterval = stream.received - stream.receivedPrior;
+        stream.expectedPrior = expected;
+        stream.receivedPrior = stream.received;
+        int32_t lostInterval = (int32_t)(expectedInterval - receivedInterval);
+        uint8_t fraction = expectedInterval == 0 || lostInterval <= 0
+                               ? 0 : (uint8_t)(((uint32_t)lostInterval << 8) / expectedInterval);
+        int32_t lost = (int32_t)(expected - stream.received);
+        lost = std::max(-0x800000, std::min(0x7FFFFF, lost));
+
+        uint8_t packet[32];
+        packet[0] = 0x81;                       // One report block
+        packet[1] = 201;                        // RR
+        put16(packet + 2, 7);
+        put32(packet + 4, stream.ssrc ^ 0x5A5A5A5A);
+        put32(packet + 8, stream.ssrc);
+        put32(packet + 12, ((uint32_t)fraction << 24) | ((uint32_t)lost & 0xFFFFFF));
+        put32(packet + 16, stream.extendedMax());
+        put32(packet + 20, (uint32_t)stream.jitter);
+        put32(packet + 24, (uint32_t)(stream.report.ntp >> 16));
+        uint64_t delay = ntpFromMicros(now) - ntpFromMicros(stream.report.arrivalMicros);
+        put32(packet + 28, (uint32_t)(delay >> 16));
+        if (sendto(stream.rtcpSocket, packet, sizeof(packet), 0, (const struct sockaddr*)&stream.report.from,
+                   sizeof(stream.report.from)) == (ssize_t)sizeof(packet)) {
+            _reportsSent++;
+        }
+    }
+
+    void reportStream(const MediaStream& stream) {
+        printf("%s", stream.name);
+        if (!stream.started) {
+            printf(": nothing received\n");
+            return;
+        }
+        uint32_t expected = stream.expected();
+        int64_t lost = (int64_t)expected - stream.received;
+        int64_t remaining = lost - stream.recovered;
+        printf(" (SSRC %08X)\n", stream.ssrc);
+        printf("  packets: %u expected, %u received, %lld lost (%.2f%%)", expected, stream.received,
+               (long long)lost, expected ? 100.0 * lost / expected : 0.0);
+        if (stream.recovered) {
+            printf(", %u repaired, %lld still lost (%.2f%%)", stream.recovered, (long long)remaining,
+                   expected ? 100.0 * remaining / expected : 0.0);
+        }
+        printf("\n");
+        printf("  jitter ms: %.2f at the end, %.2f at most\n", stream.jitter * 1000.0 / stream.clock,
+               stream.maxJitter * 1000.0 / stream.clock);
+    }
+
+    void reportLatency(const char* what, std::vector<double> values) {
+        if (values.empty()) {
+            printf("  latency: no sender report yet\n");
+            return;
+        }
+        std::sort(values.begin(), values.end());
+        printf("  latency ms, %s: p50 %.1f  p95 %.1f  p99 %.1f  max %.1f\n", what, percentile(values, 50),
+               percentile(values, 95), percentile(values, 99), values.back());
+    }
+};
+
+// ============================================================================
+// Main
+// ============================================================================
+
+static int openPort(uint16_t port) {
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    int size = 4 * 1024 * 1024;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int main(int argc, char** argv) {
+    uint16_t port = 5004;
+    double lossPercent = 0.0;
+    double burst = 1.0;
+    uint32_t seed = 1;
+    double runSeconds = 0.0;
+    const char* jpegDir = nullptr;
+
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--port") == 0 && hasValue) port = (uint16_t)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--loss") == 0 && hasValue) lossPercent = atof(argv[++i]);
+        else if (strcmp(argv[i], "--burst") == 0 && hasValue) burst = std::max(1.0, atof(argv[++i]));
+        else if (strcmp(argv[i], "--seed") == 0 && hasValue) seed = (uint32_t)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--seconds") == 0 && hasValue) runSeconds = atof(argv[++i]);
+        else if (strcmp(argv[i], "--jpeg-dir") == 0 && hasValue) jpegDir = argv[++i];
+        else {
+            fprintf(stderr, "Usage: %s [--port N] [--loss PCT] [--burst N] [--seed S] [--seconds T]"
+                            " [--jpeg-dir DIR]\n",
+                    argv[0]);
+            return 2;
+        }
+    }
+
+    int sockets[4];
+    for (int i = 0; i < 4; i++) {
+        sockets[i] = openPort((uint16_t)(port + i));
+        if (sockets[i] < 0) {
+            fprintf(stderr, "Cannot listen on UDP port %u: %s\n", port + i, strerror(errno));
+            return 1;
+        }
+    }
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+
+    // Drops come in runs: after a drop, the next one follows with
+    // probability 1 - 1/burst; the start probability keeps the overall rate
+    double keepDropping = 1.0 - 1.0 / burst;
+    double loss = lossPercent / 100.0;
+    double startDropping = loss >= 1.0 ? 1.0 : loss * (1.0 - keepDropping) / (1.0 - loss * keepDropping);
+    srand(seed);
+
+    printf("Listening for RTP on udp/%u (video), %u (audio), RTCP on %u and %u\n", port, port + 2, port + 1,
+           port + 3);
+
+    Receiver receiver(sockets[1], sockets[3], jpegDir);
+    uint64_t started = 0;
+    uint64_t lastPacket = 0;
+    bool dropping = false;
+    uint8_t buffer[65536];
+
+    while (!stopping) {
+        struct pollfd fds[4];
+        for (int i = 0; i < 4; i++) {
+            fds[i].fd = sockets[i];
+            fds[i].events = POLLIN;
+            fds[i].revents = 0;
+        }
+        int ready = poll(fds, 4, 100);
+        uint64_t now = wallMicros();
+        if (runSeconds > 0.0 && started && now - started >= (uint64_t)(runSeconds * 1e6)) {
+            break;
+        }
+        if (ready < 0 && errno != EINTR) {
+            break;
+        }
+        for (int i = 0; ready > 0 && i < 4; i++) {
+            if (!(fds[i].revents & POLLIN)) {
+                continue;
+            }
+            struct sockaddr_in from;
+            socklen_t fromLen = sizeof(from);
+            ssize_t len = recvfrom(sockets[i], buffer, sizeof(buffer), 0, (struct sockaddr*)&from, &fromLen);
+            if (len <= 0) {
+                continue;
+            }
+            uint64_t arrival = wallMicros();
+            if (!started) {
+                started = arrival;
+            }
+            lastPacket = arrival;
+            if (i == 1 || i == 3) {
+                receiver.onRtcp(i == 1 ? receiver.video() : receiver.audio(), buffer, (size_t)len, from, arrival);
+                continue;
+            }
+            double draw = (double)rand() / ((double)RAND_MAX + 1.0);
+            dropping = draw < (dropping ? keepDropping : startDropping);
+            if (!dropping) {
+                receiver.onRtp(buffer, (size_t)len, arrival);
+            }
+        }
+        receiver.service(now);
+    }
+
+    receiver.report(started ? (lastPacket - started) / 1e6 : 0.0, lossPercent, burst);
+    for (int i = 0; i < 4; i++) {
+        close(sockets[i]);
+    }
+    return 0;
+}
@@ -0,0 +1,338 @@
+// TLS-terminating front for a local RTMP server, so rtmps:// can be tested
+// without a commercial ingest: accepts TLS on --port, relays the plaintext
+// to --forward (rtmp_ingest, latency_probe, any RTMP server) and reports
+// every handshake: how long it took and whether it resumed a session.
+//
+// Sessions resume by ticket, or by session ID with --no-tickets (the
+// server keeps a session cache either way), so both paths of the camera's
+// TLS transport can be exercised. The time is measured from accept() to
+// the handshake finishing, which on a local link is dominated by the
+// client's key exchange and certificate checks: the number to compare
+// between full and resumed handshakes. The camera logs its own view
+// ("TLS: Resumed handshake in N ms") and exports rtmp_tls_handshake_seconds.
+//
+// Without --cert/--key a self-signed P-256 certificate for "localhost" is
+// generated at start; build the firmware with RTMP_TLS_VERIFY_PEER false to
+// accept it.
+//
+// Build (host, needs OpenSSL):
+//   g++ -O2 -std=gnu++17 -pthread tools/tls_terminator/tls_terminator.cpp -lssl -lcrypto
+//       -o tls_terminator
+//
+// Usage:
+//   tls_terminator [--port N] [--forward HOST:PORT] [--cert FILE --key FILE]
+//                  [--no-tickets] [--tls12] [--once]
+//
+// Point the camera at rtmps://<host>:<port>/live. Prints a summary of full
+// against resumed handshakes on exit (Ctrl-C, or after one session with --once).
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/x509.h>
+
+struct HandshakeRecord {
+    double ms;
+    bool resumed;
+};
+
+static std::atomic<bool> stopping(false);
+static std::mutex recordsMutex;
+static std::vector<HandshakeRecord> records;
+static std::atomic<uint32_t> sessionCount(0);
+
+static void onSignal(int) {
+    stopping.store(true);
+}
+
+static double nowMs() {
+    using namespace std::chrono;
+    return duration<double, std::milli>(steady_clock::now().time_since_epoch()).count();
+}
+
+static std::string sslError() {
+    char text[256];
+    unsigned long code = ERR_get_error();
+    if (!code) {
+        return "unknown error";
+    }
+    ERR_error_string_n(code, text, sizeof(text));
+    return text;
+}
+
+// ============================================================================
+// Certificate
+// ============================================================================
+
+static bool selfSign(SSL_CTX* ctx) {
+    EVP_PKEY* key = EVP_EC_gen("P-256");
+    X509* cert = X509_new();
+    if (!key || !cert) {
+        EVP_PKEY_free(key);
+        X509_free(cert);
+        return false;
+    }
+    ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+    X509_gmtime_adj(X509_getm_notBefore(cert), -3600);
+    X509_gmtime_adj(X509_getm_notAfter(cert), 30L * 24 * 3600);
+    X509_set_pubkey(cert, key);
+    X509_NAME* name = X509_get_subject_name(cert);
+    X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, (const unsigned char*)"localhost", -1, -1, 0);
+    X509_set_issuer_name(cert, name);
+    bool ok = X509_sign(cert, key, EVP_sha256()) > 0 && SSL_CTX_use_certificate(ctx, cert) == 1 &&
+              SSL_CTX_use_PrivateKey(ctx, key) == 1;
+    EVP_PKEY_free(key);
+    X509_free(cert);
+    return ok;
+}
+
+// ============================================================================
+// Sessions
+// ============================================================================
+
+static int connectTo(const std::string& host, const std::string& port) {
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo* result = nullptr;
+    if (getaddrinfo(host.c_str(), port.c_str(), &hints, &result) != 0 || !result) {
+        return -1;
+    }
+    int fd = socket(result->ai_family, result->ai_socktype, result->ai_protocol);
+    if (fd >= 0 && connect(fd, result->ai_addr, result->ai_addrlen) != 0) {
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(result);
+    if (fd >= 0) {
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+    return fd;
+}
+
+// Copies both ways until either side closes
+static uint64_t relay(SSL* ssl, int clientFd, int serverFd) {
+    uint64_t relayed = 0;
+    uint8_t buffer[16384];
+    for (;;) {
+        // Decrypted bytes OpenSSL already holds do not show up in poll()
+        if (SSL_pending(ssl) == 0) {
+            struct pollfd fds[2] = { { clientFd, POLLIN, 0 }, { serverFd, POLLIN, 0 } };
+            if (poll(fds, 2, 200) < 0 && errno != EINTR) {
+                break;
+            }
+            if (stopping.load()) {
+                break;
+            }
+            if (fds[1].revents & (POLLIN | POLLHUP | POLLERR)) {
+                ssize_t n = recv(serverFd, buffer, sizeof(buffer), 0);
+                if (n <= 0 || SSL_write(ssl, buffer, (int)n) <= 0) {
+                    break;
+                }
+            }
+            if (!(fds[0].revents & (POLLIN | POLLHUP | POLLERR))) {
+                continue;
+            }
+        }
+        int n = SSL_read(ssl, buffer, sizeof(buffer));
+        if (n <= 0) {
+            break;
+        }
+        relayed += (uint64_t)n;
+        for (int sent = 0; sent < n;) {
+            ssize_t w = send(serverFd, buffer + sent, n - sent, MSG_NOSIGNAL);
+            if (w <= 0) {
+                return relayed;
+            }
+            sent += (int)w;
+        }
+    }
+    return relayed;
+}
+
+static void serve(SSL_CTX* ctx, int clientFd, std::string peer, std::string forwardHost,
+                  std::string forwardPort) {
+    uint32_t id = ++sessionCount;
+    double start = nowMs();
+    SSL* ssl = SSL_new(ctx);
+    SSL_set_fd(ssl, clientFd);
+    if (SSL_accept(ssl) != 1) {
+        printf("Session %u: %s, handshake failed: %s\n", id, peer.c_str(), sslError().c_str());
+        SSL_free(ssl);
+        close(clientFd);
+        return;
+    }
+    double ms = nowMs() - start;
+    bool resumed = SSL_session_reused(ssl) == 1;
+    {
+        std::lock_guard<std::mutex> lock(recordsMutex);
+        records.push_back({ ms, resumed });
+    }
+    printf("Session %u: %s, %s handshake %.1f ms, %s %s\n", id, peer.c_str(), resumed ? "resumed" : "full", ms,
+           SSL_get_version(ssl), SSL_get_cipher_name(ssl));
+    fflush(stdout);
+
+    int serverFd = connectTo(forwardHost, forwardPort);
+    if (serverFd < 0) {
+        printf("Session %u: cannot reach %s:%s\n", id, forwardHost.c_str(), forwardPort.c_str());
+    } else {
+        uint64_t relayed = relay(ssl, clientFd, serverFd);
+        printf("Session %u: closed, %llu bytes relayed\n", id, (unsigned long long)relayed);
+        close(serverFd);
+    }
+    SSL_shutdown(ssl);
+    SSL_free(ssl);
+    close(clientFd);
+    fflush(stdout);
+}
+
+static void summarize(const char* label, std::vector<double> times) {
+    if (times.empty()) {
+        printf("  %-8s none\n", label);
+        return;
+    }
+    std::sort(times.begin(), times.end());
+    double sum = 0.0;
+    for (double t : times) {
+        sum += t;
+    }
+    printf("  %-8s %3zu  min %.1f / median %.1f / mean %.1f / max %.1f ms\n", label, times.size(), times.front(),
+           times[times.size() / 2], sum / times.size(), times.back());
+}
+
+// ============================================================================
+// Main
+// ============================================================================
+
+int main(int argc, char** argv) {
+    uint16_t port = 1936;
+    std::string forward = "127.0.0.1:1935";
+    const char* certPath = nullptr;
+    const char* keyPath = nullptr;
+    bool tickets = true;
+    bool tls12 = false;
+    bool once = false;
+
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--once") == 0) once = true;
+        else if (strcmp(argv[i], "--no-tickets") == 0) tickets = false;
+        else if (strcmp(argv[i], "--tls12") == 0) tls12 = true;
+        else if (strcmp(argv[i], "--port") == 0 && hasValue) port = (uint16_t)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--forward") == 0 && hasValue) forward = argv[++i];
+        else if (strcmp(argv[i], "--cert") == 0 && hasValue) certPath = argv[++i];
+        else if (strcmp(argv[i], "--key") == 0 && hasValue) keyPath = argv[++i];
+        else {
+            fprintf(stderr, "Usage: %s [--port N] [--forward HOST:PORT] [--cert FILE --key FILE]"
+                            " [--no-tickets] [--tls12] [--once]\n",
+                    argv[0]);
+            return 2;
+        }
+    }
+    size_t colon = forward.rfind(':');
+    if (colon == std::string::npos) {
+        fprintf(stderr, "--forward needs HOST:PORT\n");
+        return 2;
+    }
+    std::string forwardHost = forward.substr(0, colon);
+    std::string forwardPort = forward.substr(colon + 1);
+
+    SSL_CTX* ctx = SSL_CTX_new(TLS_server_method());
+    SSL_CTX_set_min_proto_version(ctx, TLS1_2_VERSION);
+    if (tls12) {
+        SSL_CTX_set_max_proto_version(ctx, TLS1_2_VERSION);
+    }
+    SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER);
+    SSL_CTX_set_session_id_context(ctx, (const unsigned char*)"rtmps", 5);
+    if (!tickets) {
+        SSL_CTX_set_options(ctx, SSL_OP_NO_TICKET);
+    }
+    bool haveCert = certPath && keyPath
+                        ? SSL_CTX_use_certificate_chain_file(ctx, certPath) == 1 &&
+                              SSL_CTX_use_PrivateKey_file(ctx, keyPath, SSL_FILETYPE_PEM) == 1
+                        : selfSign(ctx);
+    if (!haveCert) {
+        fprintf(stderr, "Cannot set up the certificate: %s\n", sslError().c_str());
+        return 1;
+    }
+
+    int listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    if (bind(listenFd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(listenFd, 4) != 0) {
+        fprintf(stderr, "Cannot listen on port %u: %s\n", port, strerror(errno));
+        return 1;
+    }
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+    signal(SIGPIPE, SIG_IGN);
+
+    printf("Terminating TLS on port %u for %s (%s, %s resumption, %s certificate)\n", port, forward.c_str(),
+           tls12 ? "TLS 1.2" : "TLS 1.2-1.3", tickets ? "ticket and session ID" : "session ID",
+           certPath ? "given" : "self-signed");
+    fflush(stdout);
+
+    std::vector<std::thread> threads;
+    while (!stopping.load()) {
+        struct pollfd pfd = { listenFd, POLLIN, 0 };
+        if (poll(&pfd, 1, 200) <= 0) {
+            continue;
+        }
+        struct sockaddr_in peer;
+        socklen_t peerLen = sizeof(peer);
+        int clientFd = accept(listenFd, (struct sockaddr*)&peer, &peerLen);
+        if (clientFd < 0) {
+            continue;
+        }
+        setsockopt(clientFd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        char peerText[64];
+        snprintf(peerText, sizeof(peerText), "%s:%u", inet_ntoa(peer.sin_addr), ntohs(peer.sin_port));
+        if (once) {
+            serve(ctx, clientFd, peerText, forwardHost, forwardPort);
+            break;
+        }
+        threads.emplace_back(serve, ctx, clientFd, std::string(peerText), forwardHost, forwardPort);
+    }
+    stopping.store(true);
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    close(listenFd);
+
+    std::vector<double> full;
+    std::vector<double> resumed;
+    for (const HandshakeRecord& record : records) {
+        (record.resumed ? resumed : full).push_back(record.ms);
+    }
+    printf("\nHandshakes\n");
+    summarize("full", full);
+    summarize("resumed", resumed);
+    SSL_CTX_free(ctx);
+    return 0;
+}